@@ -0,0 +1,1549 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
+#include "..\..\Common\Header Files\ShingleFile.h"
+#include "..\..\Common\Header Files\ShingleIndex.h"
+#include "..\..\Common\Header Files\SetIntersection.h"
+#include "..\..\Common\Header Files\Tokenizer.h"
+#include "..\..\Common\Header Files\ServerProtocol.h"
+
+#define true 1
+#define false 0
+#define formatVersion 1 //Bumped whenever the meaning of a field in the JSON results changes
+#define passageLength 32 //Words per run of a document that is either copied from a source document or freshly drawn
+#define linesLength 12 //Words per line of a generated text file
+#define maxStages 32
+#define maxCommandLength 8000 //Stays under the 8191 characters cmd.exe accepts
+#define indexTopCount 10
+#define defaultClientCount 4
+#define defaultPipelineDepth 16
+#define defaultServerRequests 20000
+#define selfTestCases 3000 //Random pairs of sets that -selftest checks every kernel on
+#define selfTestMaxSize 600 //Most values in the shorter set of a -selftest pair; the longer can hold up to 64 times as many, so galloping is tested too
+
+#ifdef _WIN32
+	#define pathSeparator "\\"
+	#define nullDevice "NUL"
+	#define executableExtension ".exe"
+#else
+	#define pathSeparator "/"
+	#define nullDevice "/dev/null"
+	#define executableExtension ""
+#endif
+
+/**
+ * Everything that shapes the synthetic corpus and the benchmark run, as set by the console flags:
+ */
+typedef struct {
+	int documentCount;
+	int wordsPerDocument; //Mean; each document has between half and one and a half times this many words
+	int vocabularySize; //Distinct words, drawn with Zipf-distributed frequencies like natural text
+	double overlap; //Share of each document's passages copied from a pool of shared source documents, so documents overlap
+	uint64_t seed; //The same seed and settings always give the same corpus, on any platform
+	int shingleSize;
+	int repeatCount; //Times each stage is run; the fastest and the median are reported
+	long long maxPairs; //Pairs timed by the in-process intersection stages, taken in (i,k) order
+	char* generateDirectory; //Only write the corpus to this directory as text files, without benchmarking, or NULL
+	char* workDirectory; //Where the end-to-end stages write their inputs and outputs
+	char* programDirectory; //Where the shingle and jaccard executables are, or NULL to skip the end-to-end stages
+	char* outputFileName; //Where the JSON results are written, or NULL for the console
+	char* serverSocket; //Only load the server listening here, instead of timing the other stages, or NULL
+	int clientCount; //Connections the server is loaded through, each on a thread of its own
+	int pipelineDepth; //Requests each connection sends ahead of the responses it has received
+	int serverRequests; //Compare and top requests made per run
+	int selfTest; //Only check every intersection kernel against a plain merge on random sets (and, with programDirectory, the .csv files shingle writes), instead of timing anything
+} BenchmarkOptions;
+
+/**
+ * The generated documents. Each word is stored as its rank in the vocabulary, and spelled out when needed:
+ */
+typedef struct {
+	int documentCount;
+	uint32_t** words; //Array of each document's word ranks
+	int* wordCounts;
+	char* shingleText; //Every shingle of every document, one after another, with nothing between them
+	uint64_t* shingleStarts; //Shingle s is shingleText[shingleStarts[s]] up to shingleText[shingleStarts[s + 1]]
+	uint64_t* documentStarts; //Document d's shingles are documentStarts[d] up to documentStarts[d + 1]
+	uint64_t shingleCount;
+} SyntheticCorpus;
+
+/**
+ * One timed stage. Each run's time is kept, so the fastest and the median can both be reported:
+ */
+typedef struct {
+	char* name;
+	const char* unit; //What items counts
+	uint64_t items; //Work done per run, so items / seconds is the throughput
+	uint64_t checksum; //A value every run must agree on, and that changes if the stage computes a different result
+	double* seconds;
+	int runCount;
+	double* latencies; //Seconds each request of every run took from being sent to its response arriving, or NULL if not measured
+	uint64_t latencyCount;
+	int64_t collidingShingles; //Distinct shingles that share their hash with another distinct shingle, or -1 if not counted
+} StageResult;
+
+typedef struct {
+	StageResult stages[maxStages];
+	int stageCount;
+} BenchmarkReport;
+
+/**
+ * One run of requests of a single type, made through every client connection at once. Request r goes through
+ * connection r % clientCount, and each connection's requests are sent and answered in order.
+ */
+typedef struct {
+	uint32_t type; //One of the SERVER_ request types
+	uint64_t requestCount;
+	int clientCount;
+	int pipelineDepth;
+	int documentCount;
+	char** texts; //SERVER_ADD: request r adds corpus document r, with this text
+	size_t* textLengths;
+	uint32_t* numbers; //The number the server gave each corpus document when it was added
+	const uint32_t* pairs; //SERVER_COMPARE: request r compares corpus documents pairs[2r] and pairs[2r + 1]
+	double* latencies; //Request r's latency, in seconds
+} ServerLoad;
+
+typedef struct {
+	ServerLoad* load;
+	int client;
+	int socket;
+	pthread_t thread;
+	uint64_t checksum; //Made from the responses alone, so it does not depend on the numbers the server hands out
+	int failed;
+} ServerClient;
+
+void interpretConsoleFlags(int argc, char* argv[], BenchmarkOptions* options);
+	long long parseCount(int argc, char* argv[], int i, long long minimum, const char* what); /** Sub-function of interpretConsoleFlags, reads the number after flag i, exiting if it is missing or below minimum **/
+uint64_t nextRandom(uint64_t* state); /** SplitMix64: a fast generator with a 64-bit state that gives the same sequence everywhere **/
+double randomUnit(uint64_t* state); /** Uniform in [0, 1) **/
+SyntheticCorpus* generateCorpus(const BenchmarkOptions* options);
+	uint32_t drawWord(const double* cumulative, int vocabularySize, uint64_t* state); /** Sub-function of generateCorpus, draws a word rank from the Zipf distribution **/
+	void buildShingles(SyntheticCorpus* corpus, int shingleSize); /** Sub-function of generateCorpus, spells out every shingle into one buffer **/
+	size_t spellWord(uint32_t rank, char* output); /** Sub-function of buildShingles, writes the word of the given rank and returns its length; output needs 16 bytes **/
+void deleteCorpus(SyntheticCorpus* corpus);
+void writeCorpusTexts(const SyntheticCorpus* corpus, const char* directory, char** fileNames); /** Writes each document to directory as a text file; fileNames, if not NULL, receives each name **/
+void runInProcessStages(const SyntheticCorpus* corpus, const BenchmarkOptions* options, BenchmarkReport* report);
+	char* spellCorpus(const SyntheticCorpus* corpus, size_t* length); /** Sub-function of runInProcessStages, every document as one text, laid out as writeCorpusTexts() writes it **/
+	uint64_t tokenizeText(const DelimiterSet* delimiters, char* text, size_t length, int foldCase); /** Sub-function of runInProcessStages, returns the number of tokens plus their total length **/
+	uint64_t** hashCorpus(const SyntheticCorpus* corpus, uint32_t hashAlgorithm, uint64_t* checksum); /** Sub-function of runInProcessStages, hashes every shingle, per document **/
+	uint64_t* findDistinctShingles(const SyntheticCorpus* corpus, uint64_t* distinctCount); /** Sub-function of runInProcessStages, returns the number of the first occurrence of each distinct shingle in the corpus **/
+	uint64_t countCollidingShingles(const SyntheticCorpus* corpus, const uint64_t* distinct, uint64_t distinctCount, uint32_t hashAlgorithm); /** Sub-function of runInProcessStages, hashes each distinct shingle and returns how many share their hash with another **/
+		int compareShingleHashes(const void* a, const void* b); /** Sub-function of countCollidingShingles, qsort() comparator for hashes **/
+	uint64_t intersectPairs(uint64_t* const* sets, const uint64_t* sizes, int documentCount, long long pairCount); /** Sub-function of runInProcessStages, the all-pairs loop over sorted sets **/
+	uint64_t intersectBitsetPairs(uint64_t* const* bitsets, uint64_t words, int documentCount, long long pairCount); /** Sub-function of runInProcessStages, the all-pairs loop over bitsets **/
+void runEndToEndStages(const SyntheticCorpus* corpus, const BenchmarkOptions* options, BenchmarkReport* report);
+	char* joinPath(const char* directory, const char* name); /** Sub-function of runEndToEndStages, returns directory/name in a new allocation **/
+	char* buildCommand(const char* program, const char* arguments, char** fileNames, int fileCount); /** Sub-function of runEndToEndStages, quotes program and each file name, and joins them with arguments into one command line **/
+	void runCommand(const char* command, const char* outputFileName); /** Sub-function of runEndToEndStages, runs a command with its output sent to outputFileName (or discarded if NULL), exiting if it fails **/
+	uint64_t checksumOutputs(const char* directory, const char* extension, int documentCount); /** Sub-function of runEndToEndStages, the checksum of every document's output file in directory **/
+uint64_t checksumFile(const char* fileName); /** XXH64 of the file's contents, so a stage that writes files can be checked to have written the same ones **/
+char* readOutputFile(const char* fileName, size_t* length); /** Returns the whole of a file a program wrote, in a new allocation, exiting if it was not written **/
+void runServerStages(const SyntheticCorpus* corpus, const BenchmarkOptions* options, BenchmarkReport* report);
+	char* spellDocument(const SyntheticCorpus* corpus, int document, size_t* length); /** Sub-function of runServerStages, the document's text, laid out as writeCorpusTexts() writes it **/
+	uint64_t runServerLoad(ServerLoad* load, ServerClient* clients, StageResult* stage, int run); /** Sub-function of runServerStages, makes every request of one run and returns the checksum of the responses **/
+	void* runServerClient(void* argument); /** Sub-function of runServerLoad, the body of each client thread **/
+int runSelfTest(const BenchmarkOptions* options); /** Checks every kernel the processor supports against a plain merge, on random sets, and returns the number of mismatches **/
+	uint64_t drawSortedSet(uint64_t* values, uint64_t count, uint64_t universe, uint64_t* state); /** Sub-function of runSelfTest, fills values with up to count random values below universe (any value if 0), sorted and distinct, and returns how many there are **/
+	uint64_t mergeIntersectionCount(const uint64_t* a, uint64_t aCount, const uint64_t* b, uint64_t bCount); /** Sub-function of runSelfTest, the plain merge that every kernel must agree with **/
+int checkShingleOutput(const SyntheticCorpus* corpus, const BenchmarkOptions* options); /** Shingles the corpus with the shingle executable, and returns how many of its .csv files differ from a reference de-duplication **/
+	char* referenceCsv(const SyntheticCorpus* corpus, int document, size_t* length); /** Sub-function of checkShingleOutput, the document's distinct shingles in the order they first appear, found by sorting rather than with a hash table **/
+	int compareShingleNumbers(const void* a, const void* b); /** Sub-function of referenceCsv and findDistinctShingles, qsort() comparator ordering shingles by their text, then by where they appear **/
+StageResult* beginStage(BenchmarkReport* report, const char* name, const char* unit, uint64_t items, int runCount);
+void recordRun(StageResult* stage, int run, double seconds, uint64_t checksum); /** Exits if checksum differs from the first run's **/
+void writeReport(FILE* output, const BenchmarkReport* report, const BenchmarkOptions* options, const SyntheticCorpus* corpus);
+	void printJsonString(FILE* output, const char* text); /** Sub-function of writeReport, prints text as a quoted JSON string **/
+	int compareSeconds(const void* a, const void* b); /** Sub-function of writeReport, qsort() comparator for run times **/
+
+/**
+ * Declare any (absolutely necessary) global variables:
+ */
+const SyntheticCorpus* sortedCorpus = NULL; //The corpus whose shingles compareShingleNumbers() compares, since qsort() passes no context
+
+int main(int argc, char* argv[]) {
+	BenchmarkOptions options = {1000, 1000, 50000, 0.3, 1, 3, 5, 500000, NULL, "benchmark-work", NULL, NULL, NULL, defaultClientCount, defaultPipelineDepth, defaultServerRequests, false};
+	interpretConsoleFlags(argc, argv, &options);
+	
+	/**In self-test mode, the kernels (and, with -programs, what shingle writes) are checked rather than timed:**/
+	if(options.selfTest == true) {
+		int failures = runSelfTest(&options);
+		if(options.programDirectory != NULL) {
+			SyntheticCorpus* corpus = generateCorpus(&options);
+			failures += checkShingleOutput(corpus, &options);
+			deleteCorpus(corpus);
+		}
+		return (failures == 0) ? 0 : 1;
+	}
+	
+	SyntheticCorpus* corpus = generateCorpus(&options);
+	
+	/**In generate mode, the corpus is written out as text files and nothing is timed:**/
+	if(options.generateDirectory != NULL) {
+		if(makeDirectory(options.generateDirectory) != 0) {
+			printf("\nERROR: Unable to create directory \"%s\"!\n", options.generateDirectory);
+			exit(1);
+		}
+		writeCorpusTexts(corpus, options.generateDirectory, NULL);
+		printf("Wrote %d documents (%llu shingles of %d words) to \"%s\".\n", corpus->documentCount, (unsigned long long)corpus->shingleCount, options.shingleSize, options.generateDirectory);
+		deleteCorpus(corpus);
+		return 0;
+	}
+	
+	BenchmarkReport report;
+	report.stageCount = 0;
+	if(options.serverSocket != NULL) {
+		runServerStages(corpus, &options, &report);
+	} else {
+		runInProcessStages(corpus, &options, &report);
+		if(options.programDirectory != NULL) {
+			runEndToEndStages(corpus, &options, &report);
+		}
+	}
+	
+	FILE* output = stdout;
+	if(options.outputFileName != NULL) {
+		output = fopen(options.outputFileName, "w");
+		if(output == NULL) {
+			printf("\nERROR: Unable to open file \"%s\" for writing!\n", options.outputFileName);
+			exit(1);
+		}
+	}
+	writeReport(output, &report, &options, corpus);
+	if(output != stdout) {
+		fclose(output);
+		printf("Wrote the results of %d stages to \"%s\".\n", report.stageCount, options.outputFileName);
+	}
+	
+	for(int s = 0; s < report.stageCount; s++) {
+		free(report.stages[s].name);
+		free(report.stages[s].seconds);
+		free(report.stages[s].latencies);
+	}
+	deleteCorpus(corpus);
+	return 0;
+}
+
+void interpretConsoleFlags(int argc, char* argv[], BenchmarkOptions* options) {
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "-docs") == 0) { //Number of documents in the corpus
+			options->documentCount = (int)parseCount(argc, argv, i++, 2, "document count");
+		} else if(strcmp(argv[i], "-words") == 0) { //Mean number of words per document
+			options->wordsPerDocument = (int)parseCount(argc, argv, i++, 2, "number of words per document");
+		} else if(strcmp(argv[i], "-vocab") == 0) { //Number of distinct words
+			options->vocabularySize = (int)parseCount(argc, argv, i++, 1, "vocabulary size");
+		} else if(strcmp(argv[i], "-overlap") == 0) { //Share of each document copied from shared sources
+			if(i + 1 >= argc || atof(argv[i + 1]) < 0.0 || atof(argv[i + 1]) > 1.0) {
+				printf("\nERROR: You must enter an overlap between 0 and 1!\n");
+				exit(1);
+			}
+			options->overlap = atof(argv[++i]);
+		} else if(strcmp(argv[i], "-seed") == 0) { //Seed of the corpus generator
+			options->seed = (uint64_t)parseCount(argc, argv, i++, 0, "seed");
+		} else if(strcmp(argv[i], "-s") == 0) { //Words per shingle
+			options->shingleSize = (int)parseCount(argc, argv, i++, 1, "shingle size");
+		} else if(strcmp(argv[i], "-repeat") == 0) { //Runs of each stage
+			options->repeatCount = (int)parseCount(argc, argv, i++, 1, "repeat count");
+		} else if(strcmp(argv[i], "-pairs") == 0) { //Pairs timed by the in-process intersection stages
+			options->maxPairs = parseCount(argc, argv, i++, 1, "number of pairs");
+		} else if(strcmp(argv[i], "-selftest") == 0) { //Only check the intersection kernels, and with -programs the .csv files shingle writes
+			options->selfTest = true;
+		} else if(strcmp(argv[i], "-generate") == 0 && i + 1 < argc) { //Only write the corpus to the given directory
+			options->generateDirectory = argv[++i];
+		} else if(strcmp(argv[i], "-workdir") == 0 && i + 1 < argc) { //Directory for the end-to-end stages' files
+			options->workDirectory = argv[++i];
+		} else if(strcmp(argv[i], "-programs") == 0 && i + 1 < argc) { //Directory holding the shingle and jaccard executables
+			options->programDirectory = argv[++i];
+		} else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc) { //File the JSON results are written to
+			options->outputFileName = argv[++i];
+		} else if(strcmp(argv[i], "-server") == 0 && i + 1 < argc) { //Socket of a running server to load
+			options->serverSocket = argv[++i];
+		} else if(strcmp(argv[i], "-clients") == 0) { //Connections the server is loaded through
+			options->clientCount = (int)parseCount(argc, argv, i++, 1, "client count");
+		} else if(strcmp(argv[i], "-depth") == 0) { //Requests each connection has in flight
+			options->pipelineDepth = (int)parseCount(argc, argv, i++, 1, "pipeline depth");
+		} else if(strcmp(argv[i], "-requests") == 0) { //Compare and top requests per run
+			options->serverRequests = (int)parseCount(argc, argv, i++, 1, "request count");
+		} else {
+			printf("\nERROR: Unrecognized argument \"%s\"!\n", argv[i]);
+			exit(1);
+		}
+	}
+}
+
+long long parseCount(int argc, char* argv[], int i, long long minimum, const char* what) { /** Sub-function of interpretConsoleFlags, reads the number after flag i, exiting if it is missing or below minimum **/
+	if(i + 1 >= argc || atoll(argv[i + 1]) < minimum) {
+		printf("\nERROR: You must enter a %s of at least %lld!\n", what, minimum);
+		exit(1);
+	}
+	return atoll(argv[i + 1]);
+}
+
+uint64_t nextRandom(uint64_t* state) { /** SplitMix64: a fast generator with a 64-bit state that gives the same sequence everywhere **/
+	uint64_t value = (*state += 0x9E3779B97F4A7C15ULL);
+	value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+	return value ^ (value >> 31);
+}
+
+double randomUnit(uint64_t* state) { /** Uniform in [0, 1) **/
+	return (double)(nextRandom(state) >> 11) / 9007199254740992.0; //2^53
+}
+
+/**
+ * Generates the corpus. There are sqrt(documentCount) source documents of random words; each document is built a
+ * passage at a time, and each passage is copied from a source with probability options->overlap, or otherwise drawn
+ * fresh. A document mostly copies from its own "home" source, so documents sharing a home are near-duplicates of
+ * each other, while the rest only share common words by chance, as with real text.
+ */
+SyntheticCorpus* generateCorpus(const BenchmarkOptions* options) {
+	uint64_t state = options->seed;
+	int sourceCount = (int)sqrt((double)options->documentCount);
+	int sourceLength = options->wordsPerDocument * 2;
+	double* cumulative = malloc(options->vocabularySize * sizeof(double)); //Running total of the Zipf weight 1 / (rank + 1)
+	uint32_t* sources = malloc((size_t)sourceCount * sourceLength * sizeof(uint32_t));
+	SyntheticCorpus* corpus = malloc(sizeof(SyntheticCorpus));
+	if(cumulative == NULL || sources == NULL || corpus == NULL) {
+		printf("\nERROR: Unable to allocate memory for the synthetic corpus!\n");
+		exit(1);
+	}
+	corpus->documentCount = options->documentCount;
+	corpus->words = malloc(options->documentCount * sizeof(uint32_t*));
+	corpus->wordCounts = malloc(options->documentCount * sizeof(int));
+	if(corpus->words == NULL || corpus->wordCounts == NULL) {
+		printf("\nERROR: Unable to allocate memory for the synthetic corpus!\n");
+		exit(1);
+	}
+	
+	double total = 0.0;
+	for(int r = 0; r < options->vocabularySize; r++) {
+		total += 1.0 / (r + 1);
+		cumulative[r] = total;
+	}
+	for(size_t w = 0; w < (size_t)sourceCount * sourceLength; w++) {
+		sources[w] = drawWord(cumulative, options->vocabularySize, &state);
+	}
+	
+	for(int d = 0; d < options->documentCount; d++) {
+		int length = options->wordsPerDocument / 2 + (int)(nextRandom(&state) % (uint64_t)(options->wordsPerDocument + 1));
+		int home = (int)(nextRandom(&state) % (uint64_t)sourceCount);
+		uint32_t* words = malloc(length * sizeof(uint32_t));
+		if(words == NULL) {
+			printf("\nERROR: Unable to allocate memory for the synthetic corpus!\n");
+			exit(1);
+		}
+		
+		for(int w = 0; w < length; ) {
+			int run = (length - w < passageLength) ? length - w : passageLength;
+			if(randomUnit(&state) < options->overlap) {
+				int source = (randomUnit(&state) < 0.8) ? home : (int)(nextRandom(&state) % (uint64_t)sourceCount);
+				int offset = (int)(nextRandom(&state) % (uint64_t)(sourceLength - run + 1));
+				memcpy(words + w, sources + (size_t)source * sourceLength + offset, run * sizeof(uint32_t));
+			} else {
+				for(int r = 0; r < run; r++) {
+					words[w + r] = drawWord(cumulative, options->vocabularySize, &state);
+				}
+			}
+			w += run;
+		}
+		corpus->words[d] = words;
+		corpus->wordCounts[d] = length;
+	}
+	
+	free(cumulative);
+	free(sources);
+	buildShingles(corpus, options->shingleSize);
+	return corpus;
+}
+
+uint32_t drawWord(const double* cumulative, int vocabularySize, uint64_t* state) { /** Sub-function of generateCorpus, draws a word rank from the Zipf distribution **/
+	double target = randomUnit(state) * cumulative[vocabularySize - 1];
+	int low = 0, high = vocabularySize - 1;
+	while(low < high) {
+		int middle = low + (high - low) / 2;
+		if(cumulative[middle] <= target) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	return (uint32_t)low;
+}
+
+/**
+ * Spells out every shingle of every document, as shingle writes them (words joined by single spaces), into one
+ * buffer, so the hashing stages time the hash alone.
+ */
+void buildShingles(SyntheticCorpus* corpus, int shingleSize) { /** Sub-function of generateCorpus, spells out every shingle into one buffer **/
+	uint64_t shingleCount = 0;
+	for(int d = 0; d < corpus->documentCount; d++) {
+		if(corpus->wordCounts[d] >= shingleSize) {
+			shingleCount += (uint64_t)(corpus->wordCounts[d] - shingleSize + 1);
+		}
+	}
+	size_t textCapacity = (size_t)shingleCount * shingleSize * 17 + 1; //Up to 16 letters per word, and a space after all but the last
+	corpus->shingleText = malloc(textCapacity);
+	corpus->shingleStarts = malloc((shingleCount + 1) * sizeof(uint64_t));
+	corpus->documentStarts = malloc((corpus->documentCount + 1) * sizeof(uint64_t));
+	if(corpus->shingleText == NULL || corpus->shingleStarts == NULL || corpus->documentStarts == NULL) {
+		printf("\nERROR: Unable to allocate memory for the synthetic shingles!\n");
+		exit(1);
+	}
+	
+	uint64_t s = 0;
+	size_t position = 0;
+	for(int d = 0; d < corpus->documentCount; d++) {
+		corpus->documentStarts[d] = s;
+		for(int w = 0; w + shingleSize <= corpus->wordCounts[d]; w++) {
+			corpus->shingleStarts[s++] = position;
+			for(int k = 0; k < shingleSize; k++) {
+				if(k > 0) {
+					corpus->shingleText[position++] = ' ';
+				}
+				position += spellWord(corpus->words[d][w + k], corpus->shingleText + position);
+			}
+		}
+	}
+	corpus->documentStarts[corpus->documentCount] = s;
+	corpus->shingleStarts[s] = position;
+	corpus->shingleCount = shingleCount;
+}
+
+/**
+ * Spells the word of the given rank as syllables, one per base-16 digit of the rank, so common words are short
+ * and rare ones long, and every rank has its own spelling.
+ */
+size_t spellWord(uint32_t rank, char* output) { /** Sub-function of buildShingles, writes the word of the given rank and returns its length; output needs 16 bytes **/
+	static const char* syllables[16] = {"ba", "ce", "di", "fo", "gu", "ha", "je", "ki", "lo", "mu", "na", "pe", "ri", "so", "tu", "vy"};
+	size_t length = 0;
+	do {
+		output[length++] = syllables[rank % 16][0];
+		output[length++] = syllables[rank % 16][1];
+		rank /= 16;
+	} while(rank > 0);
+	return length;
+}
+
+void deleteCorpus(SyntheticCorpus* corpus) {
+	for(int d = 0; d < corpus->documentCount; d++) {
+		free(corpus->words[d]);
+	}
+	free(corpus->words);
+	free(corpus->wordCounts);
+	free(corpus->shingleText);
+	free(corpus->shingleStarts);
+	free(corpus->documentStarts);
+	free(corpus);
+}
+
+void writeCorpusTexts(const SyntheticCorpus* corpus, const char* directory, char** fileNames) { /** Writes each document to directory as a text file; fileNames, if not NULL, receives each name **/
+	char word[16];
+	for(int d = 0; d < corpus->documentCount; d++) {
+		char name[32];
+		sprintf(name, "doc%06d.txt", d);
+		char* fileName = joinPath(directory, name);
+		FILE* output = fopen(fileName, "w");
+		if(output == NULL) {
+			printf("\nERROR: Unable to open file \"%s\" for writing!\n", fileName);
+			exit(1);
+		}
+		
+		for(int w = 0; w < corpus->wordCounts[d]; w++) {
+			size_t length = spellWord(corpus->words[d][w], word);
+			fwrite(word, 1, length, output);
+			fputc((w % linesLength == linesLength - 1 || w == corpus->wordCounts[d] - 1) ? '\n' : ' ', output);
+		}
+		if(fclose(output) != 0) {
+			printf("\nERROR: Unable to write file \"%s\"!\n", fileName);
+			exit(1);
+		}
+		
+		if(fileNames != NULL) {
+			fileNames[d] = fileName;
+		} else {
+			free(fileName);
+		}
+	}
+}
+
+/**
+ * Times the stages that run inside this process, through the same shared code shingle and jaccard use:
+ *  - tokenize.KERNEL: splitting the text of the corpus into words, once with each tokenizer kernel this processor supports
+ *  - tokenize.fold: the same with the selected kernel, folding the text to lower case in the same pass
+ *  - hash.xxh64, hash.legacy: hashing every shingle of the corpus
+ *  - collisions.xxh64, collisions.legacy: hashing each distinct shingle once, and counting those whose hash another shares
+ *  - sortUnique: sorting and de-duplicating each document's hashes into a set
+ *  - intersect.KERNEL: the all-pairs loop over sorted sets, once with each kernel this processor supports
+ *  - bitset.KERNEL: the all-pairs loop over legacy-hashed sets held as bitsets, with each kernel
+ *  - index.build, index.query: writing an inverted index of every set, and finding each set's top matches in it
+ */
+void runInProcessStages(const SyntheticCorpus* corpus, const BenchmarkOptions* options, BenchmarkReport* report) {
+	int documentCount = corpus->documentCount;
+	long long allPairs = (long long)documentCount * (documentCount - 1) / 2;
+	long long pairCount = (allPairs < options->maxPairs) ? allPairs : options->maxPairs;
+	uint64_t checksum = 0;
+	uint64_t** hashes = NULL;
+	uint64_t** legacyHashes = NULL;
+	uint64_t* setSizes = malloc(documentCount * sizeof(uint64_t));
+	uint64_t* legacySizes = malloc(documentCount * sizeof(uint64_t));
+	if(setSizes == NULL || legacySizes == NULL) {
+		printf("\nERROR: Unable to allocate memory for the benchmark!\n");
+		exit(1);
+	}
+	
+	/**Tokenizing the text, with each kernel; every kernel must find the same words:**/
+	const char* tokenizers[3] = {"scalar", "ssse3", "avx2"};
+	DelimiterSet delimiters;
+	size_t textLength = 0;
+	char* text = spellCorpus(corpus, &textLength);
+	StageResult* stage = NULL;
+	initDelimiterSet(&delimiters, " .,\"\n\r()"); //The delimiters shingle splits words at
+	for(int k = 0; k < 3; k++) {
+		char name[32];
+		if(selectTokenizerKernel(tokenizers[k]) == false) {
+			continue;
+		}
+		sprintf(name, "tokenize.%s", tokenizers[k]);
+		stage = beginStage(report, name, "bytes", (uint64_t)textLength, options->repeatCount);
+		for(int run = 0; run < options->repeatCount; run++) {
+			double start = wallClockSeconds();
+			checksum = tokenizeText(&delimiters, text, textLength, false);
+			recordRun(stage, run, wallClockSeconds() - start, checksum);
+		}
+	}
+	selectTokenizerKernel("auto");
+	stage = beginStage(report, "tokenize.fold", "bytes", (uint64_t)textLength, options->repeatCount);
+	for(int run = 0; run < options->repeatCount; run++) {
+		double start = wallClockSeconds();
+		checksum = tokenizeText(&delimiters, text, textLength, true);
+		recordRun(stage, run, wallClockSeconds() - start, checksum);
+	}
+	free(text);
+	
+	stage = beginStage(report, "hash.xxh64", "shingles", corpus->shingleCount, options->repeatCount);
+	for(int run = 0; run < options->repeatCount; run++) {
+		if(hashes != NULL) {
+			for(int d = 0; d < documentCount; d++) {
+				free(hashes[d]);
+			}
+			free(hashes);
+		}
+		double start = wallClockSeconds();
+		hashes = hashCorpus(corpus, HASH_XXH64, &checksum);
+		recordRun(stage, run, wallClockSeconds() - start, checksum);
+	}
+	stage = beginStage(report, "hash.legacy", "shingles", corpus->shingleCount, options->repeatCount);
+	for(int run = 0; run < options->repeatCount; run++) {
+		if(legacyHashes != NULL) {
+			for(int d = 0; d < documentCount; d++) {
+				free(legacyHashes[d]);
+			}
+			free(legacyHashes);
+		}
+		double start = wallClockSeconds();
+		legacyHashes = hashCorpus(corpus, HASH_LEGACY, &checksum);
+		recordRun(stage, run, wallClockSeconds() - start, checksum);
+	}
+	
+	/**How many distinct shingles each algorithm makes collide; the legacy hash has only 104729 values to give them:**/
+	const char* collisionStages[2] = {"collisions.xxh64", "collisions.legacy"};
+	uint32_t collisionAlgorithms[2] = {HASH_XXH64, HASH_LEGACY};
+	uint64_t distinctCount = 0;
+	uint64_t* distinct = findDistinctShingles(corpus, &distinctCount);
+	for(int a = 0; a < 2; a++) {
+		stage = beginStage(report, collisionStages[a], "shingles", distinctCount, options->repeatCount);
+		for(int run = 0; run < options->repeatCount; run++) {
+			double start = wallClockSeconds();
+			checksum = countCollidingShingles(corpus, distinct, distinctCount, collisionAlgorithms[a]);
+			recordRun(stage, run, wallClockSeconds() - start, checksum);
+		}
+		stage->collidingShingles = (int64_t)checksum;
+	}
+	free(distinct);
+	
+	/**Sort copies, so every run starts from the same unsorted hashes; the sorted copies of the last run are kept:**/
+	uint64_t** sets = malloc(documentCount * sizeof(uint64_t*));
+	if(sets == NULL) {
+		printf("\nERROR: Unable to allocate memory for the benchmark!\n");
+		exit(1);
+	}
+	for(int d = 0; d < documentCount; d++) {
+		uint64_t count = corpus->documentStarts[d + 1] - corpus->documentStarts[d];
+		sets[d] = malloc((count > 0 ? count : 1) * sizeof(uint64_t));
+		if(sets[d] == NULL) {
+			printf("\nERROR: Unable to allocate memory for the benchmark!\n");
+			exit(1);
+		}
+	}
+	stage = beginStage(report, "sortUnique", "hashes", corpus->shingleCount, options->repeatCount);
+	for(int run = 0; run < options->repeatCount; run++) {
+		checksum = 0;
+		double start = wallClockSeconds();
+		for(int d = 0; d < documentCount; d++) {
+			uint64_t count = corpus->documentStarts[d + 1] - corpus->documentStarts[d];
+			memcpy(sets[d], hashes[d], count * sizeof(uint64_t));
+			setSizes[d] = sortUniqueHashes(sets[d], count);
+			checksum += setSizes[d];
+		}
+		recordRun(stage, run, wallClockSeconds() - start, checksum);
+	}
+	for(int d = 0; d < documentCount; d++) {
+		uint64_t count = corpus->documentStarts[d + 1] - corpus->documentStarts[d];
+		legacySizes[d] = sortUniqueHashes(legacyHashes[d], count);
+	}
+	
+	/**The all-pairs loop, with each kernel; every kernel must find the same intersections:**/
+	const char* kernels[3] = {"scalar", "sse4", "avx2"};
+	uint64_t bitsetWords = BITSET_WORDS(hashUniverseSize(HASH_LEGACY));
+	uint64_t** bitsets = malloc(documentCount * sizeof(uint64_t*));
+	if(bitsets == NULL) {
+		printf("\nERROR: Unable to allocate memory for the benchmark!\n");
+		exit(1);
+	}
+	for(int d = 0; d < documentCount; d++) {
+		uint64_t kept = 0; //The legacy hash can give out-of-range values for non-ASCII text; generated text is ASCII, but stay safe
+		while(kept < legacySizes[d] && legacyHashes[d][kept] < hashUniverseSize(HASH_LEGACY)) {
+			kept++;
+		}
+		bitsets[d] = createBitset(legacyHashes[d], kept, hashUniverseSize(HASH_LEGACY));
+		if(bitsets[d] == NULL) {
+			printf("\nERROR: Unable to allocate memory for the benchmark!\n");
+			exit(1);
+		}
+	}
+	for(int k = 0; k < 3; k++) {
+		char name[32];
+		if(selectIntersectionKernel(kernels[k]) == false) {
+			continue;
+		}
+		sprintf(name, "intersect.%s", kernels[k]);
+		stage = beginStage(report, name, "pairs", (uint64_t)pairCount, options->repeatCount);
+		for(int run = 0; run < options->repeatCount; run++) {
+			double start = wallClockSeconds();
+			checksum = intersectPairs(sets, setSizes, documentCount, pairCount);
+			recordRun(stage, run, wallClockSeconds() - start, checksum);
+		}
+		sprintf(name, "bitset.%s", kernels[k]);
+		stage = beginStage(report, name, "pairs", (uint64_t)pairCount, options->repeatCount);
+		for(int run = 0; run < options->repeatCount; run++) {
+			double start = wallClockSeconds();
+			checksum = intersectBitsetPairs(bitsets, bitsetWords, documentCount, pairCount);
+			recordRun(stage, run, wallClockSeconds() - start, checksum);
+		}
+	}
+	selectIntersectionKernel("auto");
+	
+	/**The inverted index, written to the work directory:**/
+	if(makeDirectory(options->workDirectory) != 0) {
+		printf("\nERROR: Unable to create directory \"%s\"!\n", options->workDirectory);
+		exit(1);
+	}
+	char* indexName = joinPath(options->workDirectory, "benchmark.idx");
+	char** names = malloc(documentCount * sizeof(char*));
+	int* sizes = malloc(documentCount * sizeof(int));
+	IndexMatch* matches = malloc(indexTopCount * sizeof(IndexMatch));
+	if(names == NULL || sizes == NULL || matches == NULL) {
+		printf("\nERROR: Unable to allocate memory for the benchmark!\n");
+		exit(1);
+	}
+	for(int d = 0; d < documentCount; d++) {
+		names[d] = malloc(32);
+		if(names[d] == NULL) {
+			printf("\nERROR: Unable to allocate memory for the benchmark!\n");
+			exit(1);
+		}
+		sprintf(names[d], "doc%06d", d);
+		sizes[d] = (int)setSizes[d];
+	}
+	stage = beginStage(report, "index.build", "documents", (uint64_t)documentCount, options->repeatCount);
+	for(int run = 0; run < options->repeatCount; run++) {
+		double start = wallClockSeconds();
+		writeShingleIndex(indexName, documentCount, (const uint64_t* const*)sets, sizes, (const char* const*)names, HASH_XXH64);
+		double seconds = wallClockSeconds() - start;
+		recordRun(stage, run, seconds, checksumFile(indexName));
+	}
+	MappedShingleIndex* index = openShingleIndex(indexName);
+	IndexQuery* query = createIndexQuery(index);
+	stage = beginStage(report, "index.query", "queries", (uint64_t)documentCount, options->repeatCount);
+	for(int run = 0; run < options->repeatCount; run++) {
+		checksum = 0;
+		double start = wallClockSeconds();
+		for(int d = 0; d < documentCount; d++) {
+			int found = queryShingleIndex(index, query, sets[d], setSizes[d], indexTopCount, matches);
+			for(int m = 0; m < found; m++) {
+				checksum += matches[m].document + matches[m].shared;
+			}
+		}
+		recordRun(stage, run, wallClockSeconds() - start, checksum);
+	}
+	deleteIndexQuery(query);
+	closeShingleIndex(index);
+	remove(indexName);
+	free(indexName);
+	
+	for(int d = 0; d < documentCount; d++) {
+		free(hashes[d]);
+		free(legacyHashes[d]);
+		free(sets[d]);
+		free(bitsets[d]);
+		free(names[d]);
+	}
+	free(hashes);
+	free(legacyHashes);
+	free(sets);
+	free(bitsets);
+	free(names);
+	free(sizes);
+	free(matches);
+	free(setSizes);
+	free(legacySizes);
+}
+
+char* spellCorpus(const SyntheticCorpus* corpus, size_t* length) { /** Sub-function of runInProcessStages, every document as one text, laid out as writeCorpusTexts() writes it **/
+	uint64_t wordCount = 0;
+	for(int d = 0; d < corpus->documentCount; d++) {
+		wordCount += (uint64_t)corpus->wordCounts[d];
+	}
+	char* text = malloc((size_t)wordCount * 17 + 1); //Up to 16 letters per word, and a space or line break after each
+	if(text == NULL) {
+		printf("\nERROR: Unable to allocate memory for the benchmark!\n");
+		exit(1);
+	}
+	
+	size_t position = 0;
+	for(int d = 0; d < corpus->documentCount; d++) {
+		for(int w = 0; w < corpus->wordCounts[d]; w++) {
+			position += spellWord(corpus->words[d][w], text + position);
+			text[position++] = (w % linesLength == linesLength - 1 || w == corpus->wordCounts[d] - 1) ? '\n' : ' ';
+		}
+	}
+	text[position] = '\0';
+	*length = position;
+	return text;
+}
+
+uint64_t tokenizeText(const DelimiterSet* delimiters, char* text, size_t length, int foldCase) { /** Sub-function of runInProcessStages, returns the number of tokens plus their total length **/
+	Tokenizer tokenizer;
+	size_t start = 0, tokenLength = 0;
+	uint64_t checksum = 0;
+	if(foldCase == true) {
+		beginFoldedTokens(&tokenizer, delimiters, text, length);
+	} else {
+		beginTokens(&tokenizer, delimiters, text, length);
+	}
+	while(nextToken(&tokenizer, &start, &tokenLength) == true) {
+		checksum += 1 + tokenLength;
+	}
+	return checksum;
+}
+
+uint64_t** hashCorpus(const SyntheticCorpus* corpus, uint32_t hashAlgorithm, uint64_t* checksum) { /** Sub-function of runInProcessStages, hashes every shingle, per document **/
+	uint64_t** hashes = malloc(corpus->documentCount * sizeof(uint64_t*));
+	if(hashes == NULL) {
+		printf("\nERROR: Unable to allocate memory for the benchmark!\n");
+		exit(1);
+	}
+	*checksum = 0;
+	for(int d = 0; d < corpus->documentCount; d++) {
+		uint64_t first = corpus->documentStarts[d];
+		uint64_t count = corpus->documentStarts[d + 1] - first;
+		hashes[d] = malloc((count > 0 ? count : 1) * sizeof(uint64_t));
+		if(hashes[d] == NULL) {
+			printf("\nERROR: Unable to allocate memory for the benchmark!\n");
+			exit(1);
+		}
+		for(uint64_t s = 0; s < count; s++) {
+			const uint64_t* start = corpus->shingleStarts + first + s;
+			hashes[d][s] = hashShingleBytes(corpus->shingleText + start[0], (size_t)(start[1] - start[0]), hashAlgorithm);
+			*checksum += hashes[d][s];
+		}
+	}
+	return hashes;
+}
+
+uint64_t* findDistinctShingles(const SyntheticCorpus* corpus, uint64_t* distinctCount) { /** Sub-function of runInProcessStages, returns the number of the first occurrence of each distinct shingle in the corpus **/
+	uint64_t* order = malloc((corpus->shingleCount > 0 ? corpus->shingleCount : 1) * sizeof(uint64_t));
+	if(order == NULL) {
+		printf("\nERROR: Unable to allocate memory for the benchmark!\n");
+		exit(1);
+	}
+	for(uint64_t s = 0; s < corpus->shingleCount; s++) {
+		order[s] = s;
+	}
+	sortedCorpus = corpus;
+	qsort(order, corpus->shingleCount, sizeof(uint64_t), compareShingleNumbers);
+	
+	*distinctCount = 0;
+	for(uint64_t s = 0; s < corpus->shingleCount; s++) { //Copies of a shingle are now adjacent, the first to appear leading
+		uint64_t start = corpus->shingleStarts[order[s]];
+		uint64_t length = corpus->shingleStarts[order[s] + 1] - start;
+		if(*distinctCount == 0 || length != corpus->shingleStarts[order[s - 1] + 1] - corpus->shingleStarts[order[s - 1]] || memcmp(corpus->shingleText + start, corpus->shingleText + corpus->shingleStarts[order[s - 1]], length) != 0) {
+			order[(*distinctCount)++] = order[s];
+		}
+	}
+	return order;
+}
+
+uint64_t countCollidingShingles(const SyntheticCorpus* corpus, const uint64_t* distinct, uint64_t distinctCount, uint32_t hashAlgorithm) { /** Sub-function of runInProcessStages, hashes each distinct shingle and returns how many share their hash with another **/
+	uint64_t* hashes = malloc((distinctCount > 0 ? distinctCount : 1) * sizeof(uint64_t));
+	uint64_t colliding = 0;
+	if(hashes == NULL) {
+		printf("\nERROR: Unable to allocate memory for the benchmark!\n");
+		exit(1);
+	}
+	for(uint64_t s = 0; s < distinctCount; s++) {
+		const uint64_t* start = corpus->shingleStarts + distinct[s];
+		hashes[s] = hashShingleBytes(corpus->shingleText + start[0], (size_t)(start[1] - start[0]), hashAlgorithm);
+	}
+	
+	/**Once sorted, every run of equal hashes longer than one is a set of shingles that collide:**/
+	qsort(hashes, distinctCount, sizeof(uint64_t), compareShingleHashes);
+	for(uint64_t s = 0; s < distinctCount; ) {
+		uint64_t end = s + 1;
+		while(end < distinctCount && hashes[end] == hashes[s]) {
+			end++;
+		}
+		if(end - s > 1) {
+			colliding += end - s;
+		}
+		s = end;
+	}
+	free(hashes);
+	return colliding;
+}
+
+int compareShingleHashes(const void* a, const void* b) { /** Sub-function of countCollidingShingles, qsort() comparator for hashes **/
+	uint64_t left = *((const uint64_t*)a);
+	uint64_t right = *((const uint64_t*)b);
+	return (left > right) - (left < right);
+}
+
+uint64_t intersectPairs(uint64_t* const* sets, const uint64_t* sizes, int documentCount, long long pairCount) { /** Sub-function of runInProcessStages, the all-pairs loop over sorted sets **/
+	uint64_t total = 0;
+	long long done = 0;
+	for(int i = 0; i < documentCount && done < pairCount; i++) {
+		for(int k = i + 1; k < documentCount && done < pairCount; k++, done++) {
+			total += intersectionCount64(sets[i], sizes[i], sets[k], sizes[k]);
+		}
+	}
+	return total;
+}
+
+uint64_t intersectBitsetPairs(uint64_t* const* bitsets, uint64_t words, int documentCount, long long pairCount) { /** Sub-function of runInProcessStages, the all-pairs loop over bitsets **/
+	uint64_t total = 0;
+	long long done = 0;
+	for(int i = 0; i < documentCount && done < pairCount; i++) {
+		for(int k = i + 1; k < documentCount && done < pairCount; k++, done++) {
+			total += bitsetIntersectionCount(bitsets[i], bitsets[k], words);
+		}
+	}
+	return total;
+}
+
+/**
+ * Times the real shingle and jaccard executables on the corpus, written out as text files. These include reading
+ * and writing files and starting the process, as a user would see them. The shingle stages are checksummed from the
+ * files they write, and the jaccard stages from what they print, which is kept in a file in the work directory:
+ *  - shingle.batch.csv, shingle.batch.binary: shingling every text file, to .csv and to binary shingle files
+ *  - jaccard.allPairs.csv, jaccard.allPairs.binary: comparing every pair of the shingled files
+ *  - jaccard.join: finding every pair of binary shingle files at least 50% similar, with -t
+ * A command line can only be so long, so the jaccard stages use as many of the files as fit in one.
+ */
+void runEndToEndStages(const SyntheticCorpus* corpus, const BenchmarkOptions* options, BenchmarkReport* report) {
+	char* textDirectory = joinPath(options->workDirectory, "text");
+	char* csvDirectory = joinPath(options->workDirectory, "csv");
+	char* binaryDirectory = joinPath(options->workDirectory, "bin");
+	char* shingleProgram = joinPath(options->programDirectory, "shingle" executableExtension);
+	char* jaccardProgram = joinPath(options->programDirectory, "jaccard" executableExtension);
+	char* jaccardOutput = joinPath(options->workDirectory, "jaccard.out");
+	char** fileNames = malloc(corpus->documentCount * sizeof(char*));
+	char arguments[1024];
+	if(fileNames == NULL) {
+		printf("\nERROR: Unable to allocate memory for the benchmark!\n");
+		exit(1);
+	}
+	if(makeDirectory(options->workDirectory) != 0 || makeDirectory(textDirectory) != 0 || makeDirectory(csvDirectory) != 0 || makeDirectory(binaryDirectory) != 0) {
+		printf("\nERROR: Unable to create the directories under \"%s\"!\n", options->workDirectory);
+		exit(1);
+	}
+	writeCorpusTexts(corpus, textDirectory, fileNames);
+	
+	const char* outputs[2] = {csvDirectory, binaryDirectory};
+	const char* stageNames[2] = {"shingle.batch.csv", "shingle.batch.binary"};
+	for(int b = 0; b < 2; b++) {
+		sprintf(arguments, "-batch \"%s\" -outdir \"%s\" -s %d -j 1%s", textDirectory, outputs[b], options->shingleSize, b == 1 ? " -b" : "");
+		char* command = buildCommand(shingleProgram, arguments, NULL, 0);
+		StageResult* stage = beginStage(report, stageNames[b], "files", (uint64_t)corpus->documentCount, options->repeatCount);
+		for(int run = 0; run < options->repeatCount; run++) {
+			double start = wallClockSeconds();
+			runCommand(command, NULL);
+			double seconds = wallClockSeconds() - start;
+			recordRun(stage, run, seconds, checksumOutputs(outputs[b], b == 1 ? ".bin" : ".csv", corpus->documentCount));
+		}
+		free(command);
+	}
+	
+	const char* extensions[3] = {".csv", ".bin", ".bin"};
+	const char* directories[3] = {csvDirectory, binaryDirectory, binaryDirectory};
+	const char* jaccardStages[3] = {"jaccard.allPairs.csv", "jaccard.allPairs.binary", "jaccard.join"};
+	for(int j = 0; j < 3; j++) {
+		for(int d = 0; d < corpus->documentCount; d++) { //The outputs are named after the inputs, in the output directory
+			char name[32];
+			sprintf(name, "doc%06d%s", d, extensions[j]);
+			free(fileNames[d]);
+			fileNames[d] = joinPath(directories[j], name);
+		}
+		int fileCount = corpus->documentCount;
+		char* command = buildCommand(jaccardProgram, j == 2 ? "-t 0.5 -i" : "-i", fileNames, fileCount);
+		while(strlen(command) > maxCommandLength && fileCount > 2) {
+			free(command);
+			fileCount = fileCount * 3 / 4;
+			command = buildCommand(jaccardProgram, j == 2 ? "-t 0.5 -i" : "-i", fileNames, fileCount);
+		}
+		StageResult* stage = beginStage(report, jaccardStages[j], "pairs", (uint64_t)fileCount * (fileCount - 1) / 2, options->repeatCount);
+		for(int run = 0; run < options->repeatCount; run++) {
+			double start = wallClockSeconds();
+			runCommand(command, jaccardOutput);
+			double seconds = wallClockSeconds() - start;
+			recordRun(stage, run, seconds, checksumFile(jaccardOutput));
+		}
+		free(command);
+	}
+	remove(jaccardOutput);
+	
+	for(int d = 0; d < corpus->documentCount; d++) {
+		free(fileNames[d]);
+	}
+	free(fileNames);
+	free(textDirectory);
+	free(csvDirectory);
+	free(binaryDirectory);
+	free(shingleProgram);
+	free(jaccardProgram);
+	free(jaccardOutput);
+}
+
+char* joinPath(const char* directory, const char* name) { /** Sub-function of runEndToEndStages, returns directory/name in a new allocation **/
+	char* path = malloc(strlen(directory) + strlen(name) + 2);
+	if(path == NULL) {
+		printf("\nERROR: Unable to allocate memory for a file name!\n");
+		exit(1);
+	}
+	sprintf(path, "%s%s%s", directory, pathSeparator, name);
+	return path;
+}
+
+char* buildCommand(const char* program, const char* arguments, char** fileNames, int fileCount) { /** Sub-function of runEndToEndStages, quotes program and each file name, and joins them with arguments into one command line **/
+	size_t length = strlen(program) + strlen(arguments) + 32;
+	for(int f = 0; f < fileCount; f++) {
+		length += strlen(fileNames[f]) + 3;
+	}
+	char* command = malloc(length);
+	if(command == NULL) {
+		printf("\nERROR: Unable to allocate memory for a command line!\n");
+		exit(1);
+	}
+	
+	size_t position = (size_t)sprintf(command, "\"%s\" %s", program, arguments);
+	for(int f = 0; f < fileCount; f++) {
+		position += (size_t)sprintf(command + position, " \"%s\"", fileNames[f]);
+	}
+	return command;
+}
+
+void runCommand(const char* command, const char* outputFileName) { /** Sub-function of runEndToEndStages, runs a command with its output sent to outputFileName (or discarded if NULL), exiting if it fails **/
+	char* redirected = malloc(strlen(command) + (outputFileName != NULL ? strlen(outputFileName) : 0) + 32);
+	if(redirected == NULL) {
+		printf("\nERROR: Unable to allocate memory for a command line!\n");
+		exit(1);
+	}
+	if(outputFileName != NULL) {
+		sprintf(redirected, "%s > \"%s\"", command, outputFileName);
+	} else {
+		sprintf(redirected, "%s > %s", command, nullDevice);
+	}
+	if(system(redirected) != 0) {
+		printf("\nERROR: The command \"%.200s\" failed!\n", command);
+		exit(1);
+	}
+	free(redirected);
+}
+
+uint64_t checksumOutputs(const char* directory, const char* extension, int documentCount) { /** Sub-function of runEndToEndStages, the checksum of every document's output file in directory **/
+	uint64_t checksum = 0;
+	for(int d = 0; d < documentCount; d++) { //Named after the inputs, as in the jaccard stages
+		char name[32];
+		sprintf(name, "doc%06d%s", d, extension);
+		char* fileName = joinPath(directory, name);
+		checksum += checksumFile(fileName);
+		free(fileName);
+	}
+	return checksum;
+}
+
+uint64_t checksumFile(const char* fileName) { /** XXH64 of the file's contents, so a stage that writes files can be checked to have written the same ones **/
+	size_t length = 0;
+	char* contents = readOutputFile(fileName, &length);
+	uint64_t checksum = hashShingleBytes(contents, length, HASH_XXH64);
+	free(contents);
+	return checksum;
+}
+
+char* readOutputFile(const char* fileName, size_t* length) { /** Returns the whole of a file a program wrote, in a new allocation, exiting if it was not written **/
+	FILE* file = fopen(fileName, "rb");
+	char* contents = NULL;
+	size_t capacity = 65536, bytesRead = 0;
+	
+	*length = 0;
+	
+	if(file == NULL) {
+		printf("\nERROR: Output file \"%s\" was not written!\n", fileName);
+		exit(1);
+	}
+	contents = malloc(capacity);
+	while(contents != NULL && (bytesRead = fread(contents + *length, 1, capacity - *length, file)) > 0) {
+		*length += bytesRead;
+		if(*length == capacity) {
+			capacity *= 2;
+			contents = realloc(contents, capacity);
+		}
+	}
+	fclose(file);
+	if(contents == NULL) {
+		printf("\nERROR: Unable to allocate memory for the contents of \"%s\"!\n", fileName);
+		exit(1);
+	}
+	return contents;
+}
+
+/**
+ * Loads a running server (started with "server -socket NAME") through several client connections at once, each
+ * on a thread of its own and keeping several requests in flight, and times each run of:
+ *  - server.add: adding every document of the corpus, as text
+ *  - server.compare: comparing random pairs of the added documents
+ *  - server.top: finding the indexTopCount documents most similar to each added document, in turn
+ *  - server.remove: removing every added document, which leaves the server as it was found, ready for the next run
+ * The throughput of each stage is the server's requests per second, and the time each request took from being
+ * sent to its response arriving is kept, for the latency percentiles.
+ */
+void runServerStages(const SyntheticCorpus* corpus, const BenchmarkOptions* options, BenchmarkReport* report) {
+	int documentCount = corpus->documentCount;
+	ServerClient* clients = calloc(options->clientCount, sizeof(ServerClient));
+	ServerLoad load;
+	memset(&load, 0, sizeof(ServerLoad));
+	load.clientCount = options->clientCount;
+	load.pipelineDepth = options->pipelineDepth;
+	load.documentCount = documentCount;
+	load.texts = malloc(documentCount * sizeof(char*));
+	load.textLengths = malloc(documentCount * sizeof(size_t));
+	load.numbers = malloc(documentCount * sizeof(uint32_t));
+	uint32_t* pairs = malloc((size_t)options->serverRequests * 2 * sizeof(uint32_t));
+	if(clients == NULL || load.texts == NULL || load.textLengths == NULL || load.numbers == NULL || pairs == NULL) {
+		printf("\nERROR: Unable to allocate memory for the benchmark!\n");
+		exit(1);
+	}
+	for(int d = 0; d < documentCount; d++) {
+		load.texts[d] = spellDocument(corpus, d, &load.textLengths[d]);
+	}
+	uint64_t random = options->seed; //The same pairs every run, and every time the benchmark is run with this seed
+	for(int r = 0; r < options->serverRequests; r++) {
+		pairs[2 * r] = (uint32_t)(nextRandom(&random) % (uint64_t)documentCount);
+		pairs[2 * r + 1] = (uint32_t)((pairs[2 * r] + 1 + nextRandom(&random) % (uint64_t)(documentCount - 1)) % (uint64_t)documentCount); //Never the same document twice
+	}
+	load.pairs = pairs;
+	for(int c = 0; c < options->clientCount; c++) {
+		clients[c].load = &load;
+		clients[c].client = c;
+		clients[c].socket = connectLocalSocket(options->serverSocket);
+		if(clients[c].socket < 0) {
+			printf("\nERROR: Unable to connect to a server at \"%s\"!\n", options->serverSocket);
+			exit(1);
+		}
+	}
+	
+	StageResult* stages[4];
+	const uint32_t types[4] = {SERVER_ADD, SERVER_COMPARE, SERVER_TOP, SERVER_REMOVE};
+	const uint64_t counts[4] = {(uint64_t)documentCount, (uint64_t)options->serverRequests, (uint64_t)options->serverRequests, (uint64_t)documentCount};
+	const char* names[4] = {"server.add", "server.compare", "server.top", "server.remove"};
+	for(int s = 0; s < 4; s++) {
+		stages[s] = beginStage(report, names[s], "requests", counts[s], options->repeatCount);
+		stages[s]->latencyCount = counts[s] * (uint64_t)options->repeatCount;
+		stages[s]->latencies = malloc((size_t)stages[s]->latencyCount * sizeof(double));
+		if(stages[s]->latencies == NULL) {
+			printf("\nERROR: Unable to allocate memory for the benchmark results!\n");
+			exit(1);
+		}
+	}
+	for(int run = 0; run < options->repeatCount; run++) {
+		for(int s = 0; s < 4; s++) { //Each run adds the corpus, queries it, and removes it again
+			load.type = types[s];
+			load.requestCount = counts[s];
+			load.latencies = stages[s]->latencies + (size_t)run * counts[s];
+			double start = wallClockSeconds();
+			uint64_t checksum = runServerLoad(&load, clients, stages[s], run);
+			recordRun(stages[s], run, wallClockSeconds() - start, checksum);
+		}
+	}
+	
+	for(int c = 0; c < options->clientCount; c++) {
+		closeLocalSocket(clients[c].socket);
+	}
+	for(int d = 0; d < documentCount; d++) {
+		free(load.texts[d]);
+	}
+	free(load.texts);
+	free(load.textLengths);
+	free(load.numbers);
+	free(pairs);
+	free(clients);
+}
+
+char* spellDocument(const SyntheticCorpus* corpus, int document, size_t* length) { /** Sub-function of runServerStages, the document's text, laid out as writeCorpusTexts() writes it **/
+	char* text = malloc((size_t)corpus->wordCounts[document] * 17 + 1); //Up to 16 letters per word, and a space or line break after each
+	if(text == NULL) {
+		printf("\nERROR: Unable to allocate memory for the benchmark!\n");
+		exit(1);
+	}
+	
+	size_t position = 0;
+	for(int w = 0; w < corpus->wordCounts[document]; w++) {
+		position += spellWord(corpus->words[document][w], text + position);
+		text[position++] = (w % linesLength == linesLength - 1 || w == corpus->wordCounts[document] - 1) ? '\n' : ' ';
+	}
+	text[position] = '\0';
+	*length = position;
+	return text;
+}
+
+uint64_t runServerLoad(ServerLoad* load, ServerClient* clients, StageResult* stage, int run) { /** Sub-function of runServerStages, makes every request of one run and returns the checksum of the responses **/
+	uint64_t checksum = 0;
+	for(int c = 0; c < load->clientCount; c++) {
+		clients[c].checksum = 0;
+		clients[c].failed = false;
+		if(pthread_create(&clients[c].thread, NULL, runServerClient, &clients[c]) != 0) {
+			printf("\nERROR: Unable to start client thread %d!\n", c);
+			exit(1);
+		}
+	}
+	for(int c = 0; c < load->clientCount; c++) {
+		pthread_join(clients[c].thread, NULL);
+	}
+	for(int c = 0; c < load->clientCount; c++) {
+		if(clients[c].failed == true) {
+			printf("\nERROR: Run %d of stage %s got a failed or missing response from the server!\n", run + 1, stage->name);
+			exit(1);
+		}
+		checksum += clients[c].checksum;
+	}
+	return checksum;
+}
+
+/**
+ * Sends this client's requests, keeping up to pipelineDepth of them in flight, and reads the responses as they come.
+ * The server answers each connection's requests in order, so each response is matched to the oldest request
+ * still waiting for one.
+ */
+void* runServerClient(void* argument) { /** Sub-function of runServerLoad, the body of each client thread **/
+	ServerClient* client = argument;
+	ServerLoad* load = client->load;
+	uint64_t requestCount = (load->requestCount > (uint64_t)client->client) ? (load->requestCount - client->client - 1) / load->clientCount + 1 : 0;
+	uint64_t sent = 0, received = 0;
+	double* sentTimes = malloc(load->pipelineDepth * sizeof(double)); //When each request in flight was sent
+	IndexMatch matches[indexTopCount];
+	if(sentTimes == NULL) {
+		client->failed = true;
+		return NULL;
+	}
+	
+	while(received < requestCount) {
+		while(sent < requestCount && sent - received < (uint64_t)load->pipelineDepth) {
+			uint64_t r = client->client + sent * load->clientCount;
+			ServerRequest request = {load->type, (uint32_t)r, 0, 0, 0};
+			const char* payload = NULL;
+			if(load->type == SERVER_ADD) {
+				payload = load->texts[r];
+				request.length = load->textLengths[r];
+			} else if(load->type == SERVER_COMPARE) {
+				request.document = load->numbers[load->pairs[2 * r]];
+				request.other = load->numbers[load->pairs[2 * r + 1]];
+			} else if(load->type == SERVER_TOP) {
+				request.document = load->numbers[r % (uint64_t)load->documentCount];
+				request.other = indexTopCount;
+			} else {
+				request.document = load->numbers[r];
+			}
+			sentTimes[sent % load->pipelineDepth] = wallClockSeconds();
+			if(sendAll(client->socket, &request, sizeof(ServerRequest)) != 0 || (payload != NULL && sendAll(client->socket, payload, (size_t)request.length) != 0)) {
+				client->failed = true;
+				break;
+			}
+			sent++;
+		}
+		
+		ServerResponse response;
+		uint64_t r = client->client + received * load->clientCount;
+		if(client->failed == true || receiveAll(client->socket, &response, sizeof(ServerResponse)) != 0) {
+			client->failed = true;
+			break;
+		}
+		load->latencies[r] = wallClockSeconds() - sentTimes[received % load->pipelineDepth];
+		if(response.tag != (uint32_t)r || response.status != SERVER_OK) {
+			client->failed = true;
+			break;
+		}
+		if(load->type == SERVER_ADD) {
+			load->numbers[r] = response.document; //Each client adds different documents, so no two threads write the same entry
+			client->checksum++;
+		} else if(load->type == SERVER_COMPARE) {
+			client->checksum += (uint64_t)(response.similarity * 4294967296.0);
+		} else if(load->type == SERVER_TOP) {
+			if(response.count > indexTopCount || response.length != response.count * sizeof(IndexMatch) || receiveAll(client->socket, matches, (size_t)response.length) != 0) {
+				client->failed = true;
+				break;
+			}
+			for(uint32_t m = 0; m < response.count; m++) { //Documents tied at the cut-off are picked by number, so only their similarities are summed
+				client->checksum += (uint64_t)(matches[m].similarity * 4294967296.0);
+			}
+		} else {
+			client->checksum++;
+		}
+		received++;
+	}
+	free(sentTimes);
+	return NULL;
+}
+
+/**
+ * Every kernel must count exactly what a plain merge counts, so the kernels are checked on random pairs of sets
+ * rather than on the corpus alone. The pairs vary the things the kernels treat specially: sizes that are not a
+ * multiple of a vector, sets that do not start on a vector boundary, one set many times longer than the other
+ * (which gallops), values with the top bit set (which signed vector comparisons get wrong), and sets drawn from a
+ * small universe (which share many values) as well as from the whole 32- or 64-bit range (which share few). The sets
+ * drawn from a small universe are also checked as bitsets. The seed is -seed, so a failure can be repeated.
+ */
+int runSelfTest(const BenchmarkOptions* options) { /** Checks every kernel the processor supports against a plain merge, on random sets, and returns the number of mismatches **/
+	const char* kernels[3] = {"scalar", "sse4", "avx2"};
+	const char* functions[3] = {"intersectionCount64", "intersectionCount32", "bitsetIntersectionCount"};
+	uint64_t state = options->seed;
+	uint64_t maxCount = (uint64_t)selfTestMaxSize * 64 + 8;
+	uint64_t* aBuffer = malloc((maxCount + 4) * sizeof(uint64_t));
+	uint64_t* bBuffer = malloc((maxCount + 4) * sizeof(uint64_t));
+	uint32_t* aIds = malloc((maxCount + 4) * sizeof(uint32_t));
+	uint32_t* bIds = malloc((maxCount + 4) * sizeof(uint32_t));
+	uint64_t checks[3] = {0, 0, 0};
+	int failures = 0;
+	
+	if(aBuffer == NULL || bBuffer == NULL || aIds == NULL || bIds == NULL) {
+		printf("\nERROR: Unable to allocate memory for the self-test!\n");
+		exit(1);
+	}
+	for(int c = 0; c < selfTestCases; c++) {
+		uint64_t aCount = nextRandom(&state) % (selfTestMaxSize + 1);
+		uint64_t bCount = nextRandom(&state) % (selfTestMaxSize + 1);
+		if(c % 4 == 3) { //Lopsided enough to gallop
+			bCount = aCount * (GALLOP_RATIO + nextRandom(&state) % (64 - GALLOP_RATIO + 1)) + nextRandom(&state) % 8;
+		}
+		uint64_t universes[3] = {(aCount + bCount) * 2 + 1 + nextRandom(&state) % 64, 0x100000000ULL, 0};
+		uint64_t universe = universes[c % 3];
+		int aOffset = (int)(nextRandom(&state) % 4); //So the kernels are not always handed aligned sets
+		int bOffset = (int)(nextRandom(&state) % 4);
+		uint64_t* a = aBuffer + aOffset;
+		uint64_t* b = bBuffer + bOffset;
+		aCount = drawSortedSet(a, aCount, universe, &state);
+		bCount = drawSortedSet(b, bCount, universe, &state);
+		uint64_t expected = mergeIntersectionCount(a, aCount, b, bCount);
+		
+		uint32_t* a32 = aIds + aOffset;
+		uint32_t* b32 = bIds + bOffset;
+		if(universe != 0) { //Both sets fit in 32 bits
+			for(uint64_t v = 0; v < aCount; v++) {
+				a32[v] = (uint32_t)a[v];
+			}
+			for(uint64_t v = 0; v < bCount; v++) {
+				b32[v] = (uint32_t)b[v];
+			}
+		}
+		uint64_t* aBits = NULL;
+		uint64_t* bBits = NULL;
+		if(c % 3 == 0) {
+			aBits = createBitset(a, aCount, universe);
+			bBits = createBitset(b, bCount, universe);
+			if(aBits == NULL || bBits == NULL) {
+				printf("\nERROR: Unable to allocate memory for the self-test!\n");
+				exit(1);
+			}
+		}
+		
+		for(int k = 0; k < 3; k++) {
+			if(selectIntersectionKernel(kernels[k]) == false) {
+				continue;
+			}
+			uint64_t found[3];
+			found[0] = intersectionCount64(a, aCount, b, bCount);
+			found[1] = (universe != 0) ? intersectionCount32(a32, aCount, b32, bCount) : expected;
+			found[2] = (aBits != NULL) ? bitsetIntersectionCount(aBits, bBits, BITSET_WORDS(universe)) : expected;
+			for(int f = 0; f < 3; f++) {
+				if(found[f] != expected) {
+					printf("\nERROR: %s with the %s kernel found %llu shared values instead of %llu, in sets of %llu and %llu values below %llu (case %d, seed %llu)!\n", functions[f], kernels[k], (unsigned long long)found[f], (unsigned long long)expected, (unsigned long long)aCount, (unsigned long long)bCount, (unsigned long long)universe, c, (unsigned long long)options->seed);
+					failures++;
+				}
+			}
+			if(intersectionCount64(b, bCount, a, aCount) != expected || (universe != 0 && intersectionCount32(b32, bCount, a32, aCount) != expected)) { //Either set may be the longer one
+				printf("\nERROR: The %s kernel counts differently with the sets swapped, in sets of %llu and %llu values (case %d, seed %llu)!\n", kernels[k], (unsigned long long)aCount, (unsigned long long)bCount, c, (unsigned long long)options->seed);
+				failures++;
+			}
+			checks[k]++;
+		}
+		free(aBits);
+		free(bBits);
+	}
+	selectIntersectionKernel("auto");
+	
+	for(int k = 0; k < 3; k++) {
+		if(checks[k] > 0) {
+			printf("Kernel \"%s\": checked on %llu random pairs of sets.\n", kernels[k], (unsigned long long)checks[k]);
+		} else {
+			printf("Kernel \"%s\": not supported by this processor, so not checked.\n", kernels[k]);
+		}
+	}
+	if(failures == 0) {
+		printf("Every kernel agrees with a plain merge.\n");
+	} else {
+		printf("%d mismatches with a plain merge.\n", failures);
+	}
+	free(aBuffer);
+	free(bBuffer);
+	free(aIds);
+	free(bIds);
+	return failures;
+}
+
+uint64_t drawSortedSet(uint64_t* values, uint64_t count, uint64_t universe, uint64_t* state) { /** Sub-function of runSelfTest, fills values with up to count random values below universe (any value if 0), sorted and distinct, and returns how many there are **/
+	for(uint64_t v = 0; v < count; v++) {
+		values[v] = (universe != 0) ? nextRandom(state) % universe : nextRandom(state);
+	}
+	return sortUniqueHashes(values, count);
+}
+
+uint64_t mergeIntersectionCount(const uint64_t* a, uint64_t aCount, const uint64_t* b, uint64_t bCount) { /** Sub-function of runSelfTest, the plain merge that every kernel must agree with **/
+	uint64_t i = 0, k = 0, shared = 0;
+	while(i < aCount && k < bCount) {
+		if(a[i] < b[k]) {
+			i++;
+		} else if(a[i] > b[k]) {
+			k++;
+		} else {
+			shared++;
+			i++;
+			k++;
+		}
+	}
+	return shared;
+}
+
+/**
+ * Shingle keeps only the first occurrence of each shingle, in the order they appear, as it did when every shingle
+ * was compared with every later one and the later copies removed. The check works that out a different way, by
+ * sorting each document's shingles, which it spells out itself from the corpus, and compares the .csv files that
+ * shingle -batch writes with it byte for byte.
+ */
+int checkShingleOutput(const SyntheticCorpus* corpus, const BenchmarkOptions* options) { /** Shingles the corpus with the shingle executable, and returns how many of its .csv files differ from a reference de-duplication **/
+	char* textDirectory = joinPath(options->workDirectory, "text");
+	char* csvDirectory = joinPath(options->workDirectory, "csv");
+	char* shingleProgram = joinPath(options->programDirectory, "shingle" executableExtension);
+	char arguments[1024];
+	int failures = 0;
+	
+	if(makeDirectory(options->workDirectory) != 0 || makeDirectory(textDirectory) != 0 || makeDirectory(csvDirectory) != 0) {
+		printf("\nERROR: Unable to create the directories under \"%s\"!\n", options->workDirectory);
+		exit(1);
+	}
+	writeCorpusTexts(corpus, textDirectory, NULL);
+	sprintf(arguments, "-batch \"%s\" -outdir \"%s\" -s %d", textDirectory, csvDirectory, options->shingleSize);
+	char* command = buildCommand(shingleProgram, arguments, NULL, 0);
+	runCommand(command, NULL);
+	
+	for(int d = 0; d < corpus->documentCount; d++) {
+		char name[32];
+		size_t expectedLength = 0, foundLength = 0;
+		sprintf(name, "doc%06d.csv", d);
+		char* fileName = joinPath(csvDirectory, name);
+		char* expected = referenceCsv(corpus, d, &expectedLength);
+		char* found = readOutputFile(fileName, &foundLength);
+		if(foundLength != expectedLength || memcmp(found, expected, expectedLength) != 0) {
+			size_t at = 0;
+			while(at < foundLength && at < expectedLength && found[at] == expected[at]) {
+				at++;
+			}
+			printf("\nERROR: \"%s\" differs from the first occurrences of its shingles from byte %llu (it has %llu bytes, not %llu)!\n", fileName, (unsigned long long)at, (unsigned long long)foundLength, (unsigned long long)expectedLength);
+			failures++;
+		}
+		free(expected);
+		free(found);
+		free(fileName);
+	}
+	
+	if(failures == 0) {
+		printf("Shingle: the .csv files of all %d documents (%llu shingles of %d words) keep exactly the first occurrence of each shingle, in order.\n", corpus->documentCount, (unsigned long long)corpus->shingleCount, options->shingleSize);
+	} else {
+		printf("Shingle: %d of %d .csv files differ.\n", failures, corpus->documentCount);
+	}
+	free(command);
+	free(textDirectory);
+	free(csvDirectory);
+	free(shingleProgram);
+	return failures;
+}
+
+char* referenceCsv(const SyntheticCorpus* corpus, int document, size_t* length) { /** Sub-function of checkShingleOutput, the document's distinct shingles in the order they first appear, found by sorting rather than with a hash table **/
+	uint64_t first = corpus->documentStarts[document];
+	uint64_t count = corpus->documentStarts[document + 1] - first;
+	uint64_t* order = malloc((count > 0 ? count : 1) * sizeof(uint64_t));
+	char* keep = calloc(count > 0 ? count : 1, 1);
+	char* csv = malloc(corpus->shingleStarts[first + count] - corpus->shingleStarts[first] + count + 1);
+	if(order == NULL || keep == NULL || csv == NULL) {
+		printf("\nERROR: Unable to allocate memory for the self-test!\n");
+		exit(1);
+	}
+	
+	for(uint64_t s = 0; s < count; s++) {
+		order[s] = first + s;
+	}
+	sortedCorpus = corpus;
+	qsort(order, count, sizeof(uint64_t), compareShingleNumbers);
+	for(uint64_t s = 0; s < count; s++) { //Copies of a shingle are now adjacent, the first to appear leading
+		uint64_t start = corpus->shingleStarts[order[s]];
+		uint64_t shingleLength = corpus->shingleStarts[order[s] + 1] - start;
+		if(s == 0 || shingleLength != corpus->shingleStarts[order[s - 1] + 1] - corpus->shingleStarts[order[s - 1]] || memcmp(corpus->shingleText + start, corpus->shingleText + corpus->shingleStarts[order[s - 1]], shingleLength) != 0) {
+			keep[order[s] - first] = true;
+		}
+	}
+	*length = 0;
+	for(uint64_t s = 0; s < count; s++) {
+		if(keep[s] == false) {
+			continue;
+		}
+		uint64_t start = corpus->shingleStarts[first + s];
+		uint64_t shingleLength = corpus->shingleStarts[first + s + 1] - start;
+		if(*length > 0) {
+			csv[(*length)++] = ',';
+		}
+		memcpy(csv + *length, corpus->shingleText + start, shingleLength);
+		*length += shingleLength;
+	}
+	free(order);
+	free(keep);
+	return csv;
+}
+
+int compareShingleNumbers(const void* a, const void* b) { /** Sub-function of referenceCsv and findDistinctShingles, qsort() comparator ordering shingles by their text, then by where they appear **/
+	uint64_t left = *((const uint64_t*)a);
+	uint64_t right = *((const uint64_t*)b);
+	uint64_t leftLength = sortedCorpus->shingleStarts[left + 1] - sortedCorpus->shingleStarts[left];
+	uint64_t rightLength = sortedCorpus->shingleStarts[right + 1] - sortedCorpus->shingleStarts[right];
+	int order = memcmp(sortedCorpus->shingleText + sortedCorpus->shingleStarts[left], sortedCorpus->shingleText + sortedCorpus->shingleStarts[right], leftLength < rightLength ? leftLength : rightLength);
+	if(order == 0) {
+		order = (leftLength > rightLength) - (leftLength < rightLength);
+	}
+	if(order == 0) {
+		order = (left > right) - (left < right);
+	}
+	return order;
+}
+
+StageResult* beginStage(BenchmarkReport* report, const char* name, const char* unit, uint64_t items, int runCount) {
+	if(report->stageCount == maxStages) {
+		printf("\nERROR: Too many benchmark stages!\n");
+		exit(1);
+	}
+	StageResult* stage = &report->stages[report->stageCount++];
+	stage->name = malloc(strlen(name) + 1); //Names may be built in a temporary buffer, so keep a copy
+	stage->unit = unit;
+	stage->items = items;
+	stage->checksum = 0;
+	stage->runCount = runCount;
+	stage->latencies = NULL;
+	stage->latencyCount = 0;
+	stage->collidingShingles = -1;
+	stage->seconds = malloc(runCount * sizeof(double));
+	if(stage->name == NULL || stage->seconds == NULL) {
+		printf("\nERROR: Unable to allocate memory for the benchmark results!\n");
+		exit(1);
+	}
+	strcpy(stage->name, name);
+	fprintf(stderr, "Running %s...\n", name); //Progress goes to stderr, so the results can be piped from standard output
+	return stage;
+}
+
+void recordRun(StageResult* stage, int run, double seconds, uint64_t checksum) { /** Exits if checksum differs from the first run's **/
+	if(run == 0) {
+		stage->checksum = checksum;
+	} else if(checksum != stage->checksum) {
+		printf("\nERROR: Run %d of stage %s computed a different result from the first run!\n", run + 1, stage->name);
+		exit(1);
+	}
+	stage->seconds[run] = seconds;
+}
+
+/**
+ * Writes the results as one JSON object: the settings the corpus was generated with, where it ran, and for each
+ * stage the work done per run, the fastest and median run times, and the throughput of the fastest run. The
+ * checksums let two result files be checked to have computed the same thing before their times are compared. Stages
+ * that time requests to the server also give the median and 99th percentile latency of every request of every run.
+ */
+void writeReport(FILE* output, const BenchmarkReport* report, const BenchmarkOptions* options, const SyntheticCorpus* corpus) {
+	fprintf(output, "{\n");
+	fprintf(output, "  \"formatVersion\": %d,\n", formatVersion);
+	fprintf(output, "  \"corpus\": {\"documents\": %d, \"wordsPerDocument\": %d, \"vocabulary\": %d, \"overlap\": %.4f, \"seed\": %llu, \"shingleSize\": %d, \"shingles\": %llu},\n", options->documentCount, options->wordsPerDocument, options->vocabularySize, options->overlap, (unsigned long long)options->seed, options->shingleSize, (unsigned long long)corpus->shingleCount);
+	fprintf(output, "  \"environment\": {\"processors\": %d, \"intersectionKernel\": ", processorCount());
+	printJsonString(output, intersectionKernelName());
+	fprintf(output, "},\n");
+	fprintf(output, "  \"stages\": [\n");
+	for(int s = 0; s < report->stageCount; s++) {
+		const StageResult* stage = &report->stages[s];
+		double* sorted = malloc(stage->runCount * sizeof(double));
+		if(sorted == NULL) {
+			printf("\nERROR: Unable to allocate memory for the benchmark results!\n");
+			exit(1);
+		}
+		memcpy(sorted, stage->seconds, stage->runCount * sizeof(double));
+		qsort(sorted, stage->runCount, sizeof(double), compareSeconds);
+		double median = (stage->runCount % 2 == 1) ? sorted[stage->runCount / 2] : (sorted[stage->runCount / 2 - 1] + sorted[stage->runCount / 2]) / 2;
+		
+		fprintf(output, "    {\"name\": ");
+		printJsonString(output, stage->name);
+		fprintf(output, ", \"unit\": ");
+		printJsonString(output, stage->unit);
+		fprintf(output, ", \"items\": %llu, \"runs\": %d, \"minSeconds\": %.6f, \"medianSeconds\": %.6f, \"itemsPerSecond\": %.1f, \"checksum\": %llu", (unsigned long long)stage->items, stage->runCount, sorted[0], median, sorted[0] > 0 ? stage->items / sorted[0] : 0.0, (unsigned long long)stage->checksum);
+		if(stage->latencyCount > 0) { //Nearest rank: the smallest latency at least that share of the requests did not exceed
+			qsort(stage->latencies, stage->latencyCount, sizeof(double), compareSeconds);
+			fprintf(output, ", \"p50Seconds\": %.6f, \"p99Seconds\": %.6f", stage->latencies[(stage->latencyCount * 50 + 99) / 100 - 1], stage->latencies[(stage->latencyCount * 99 + 99) / 100 - 1]);
+		}
+		if(stage->collidingShingles >= 0) {
+			fprintf(output, ", \"collidingShingles\": %lld", (long long)stage->collidingShingles);
+		}
+		fprintf(output, "}%s\n", s + 1 < report->stageCount ? "," : "");
+		free(sorted);
+	}
+	fprintf(output, "  ]\n");
+	fprintf(output, "}\n");
+}
+
+void printJsonString(FILE* output, const char* text) { /** Sub-function of writeReport, prints text as a quoted JSON string **/
+	fputc('"', output);
+	for(; *text != '\0'; text++) {
+		if(*text == '"' || *text == '\\') {
+			fputc('\\', output);
+		}
+		fputc(*text, output);
+	}
+	fputc('"', output);
+}
+
+int compareSeconds(const void* a, const void* b) { /** Sub-function of writeReport, qsort() comparator for run times **/
+	double left = *((const double*)a);
+	double right = *((const double*)b);
+	return (left > right) - (left < right);
+}
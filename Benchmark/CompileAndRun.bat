@@ -0,0 +1,10 @@
+if not exist "Object Files" mkdir "Object Files"
+gcc -std=c99 -c "C Files\benchmark.c" -o "Object Files\benchmark.o"
+gcc -std=c99 -c "..\Common\C Files\ShingleFile.c" -o "Object Files\ShingleFile.o"
+gcc -std=c99 -c "..\Common\C Files\ShingleIndex.c" -o "Object Files\ShingleIndex.o"
+gcc -std=c99 -c "..\Common\C Files\SetIntersection.c" -o "Object Files\SetIntersection.o"
+gcc -std=c99 -c "..\Common\C Files\Platform.c" -o "Object Files\Platform.o"
+gcc -std=c99 -c "..\Common\C Files\Tokenizer.c" -o "Object Files\Tokenizer.o"
+gcc -std=c99 -c "..\Common\C Files\ServerProtocol.c" -o "Object Files\ServerProtocol.o"
+
+gcc -std=c99 "Object Files\benchmark.o" "Object Files\ShingleFile.o" "Object Files\ShingleIndex.o" "Object Files\SetIntersection.o" "Object Files\Platform.o" "Object Files\Tokenizer.o" "Object Files\ServerProtocol.o" -o benchmark -lpthread -lws2_32 -lm
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include <stdlib.h>
+#include "..\Header Files\Arena.h"
+
+ArenaBlock* addArenaBlock(Arena* arena, size_t minimumCapacity); /** Sub-function of arenaAllocate, makes a new block of at least minimumCapacity bytes the current one **/
+
+Arena* createArena(size_t blockSize) { /** Returns NULL if out of memory **/
+	Arena* arena = malloc(sizeof(Arena));
+	if(arena == NULL) {
+		return NULL;
+	}
+	
+	arena->blocks = NULL;
+	arena->blockSize = (blockSize > 0) ? blockSize : ARENA_DEFAULT_BLOCK_SIZE;
+	arena->reservedBytes = 0;
+	return arena;
+}
+
+void* arenaAllocate(Arena* arena, size_t bytes) { /** Returns ARENA_ALIGNMENT-aligned memory, or NULL if out of memory **/
+	ArenaBlock* block = arena->blocks;
+	size_t rounded = (bytes + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+	if(rounded < bytes) { //bytes was within ARENA_ALIGNMENT of SIZE_MAX
+		return NULL;
+	}
+	
+	if(block == NULL || block->capacity - block->used < rounded) {
+		block = addArenaBlock(arena, rounded);
+		if(block == NULL) {
+			return NULL;
+		}
+	}
+	void* allocation = block->data + block->used;
+	block->used += rounded;
+	return allocation;
+}
+
+/**
+ * Lets a caller allocate for the most it could need, then give back what it did not use. Anything allocated after
+ * allocation is given back as well, so this only makes sense for the allocation made last.
+ */
+void arenaTrim(Arena* arena, void* allocation, size_t bytes) { /** Shrinks the most recent allocation to bytes, giving the rest back to the arena **/
+	ArenaBlock* block = arena->blocks;
+	unsigned char* start = allocation;
+	if(block == NULL || start < block->data || start > block->data + block->used) { //Not from the current block, so it cannot be shrunk in place
+		return;
+	}
+	
+	size_t used = (size_t)(start - block->data) + ((bytes + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1));
+	if(used < block->used) {
+		block->used = used;
+	}
+}
+
+void resetArena(Arena* arena) { /** Gives back everything allocated, but keeps the current block for reuse **/
+	if(arena->blocks == NULL) {
+		return;
+	}
+	ArenaBlock* block = arena->blocks->next;
+	while(block != NULL) {
+		ArenaBlock* next = block->next;
+		arena->reservedBytes -= block->capacity;
+		free(block);
+		block = next;
+	}
+	arena->blocks->next = NULL;
+	arena->blocks->used = 0;
+}
+
+void deleteArena(Arena* arena) {
+	if(arena == NULL) {
+		return;
+	}
+	resetArena(arena);
+	free(arena->blocks);
+	free(arena);
+}
+
+ArenaBlock* addArenaBlock(Arena* arena, size_t minimumCapacity) { /** Sub-function of arenaAllocate, makes a new block of at least minimumCapacity bytes the current one **/
+	size_t capacity = (minimumCapacity > arena->blockSize) ? minimumCapacity : arena->blockSize;
+	if(capacity > SIZE_MAX - sizeof(ArenaBlock) - ARENA_ALIGNMENT) {
+		return NULL;
+	}
+	
+	//The header and the block's memory are one allocation, with room to move the start of the memory up to ARENA_ALIGNMENT:
+	ArenaBlock* block = malloc(sizeof(ArenaBlock) + capacity + ARENA_ALIGNMENT);
+	if(block == NULL) {
+		return NULL;
+	}
+	uintptr_t start = (uintptr_t)(block + 1);
+	block->data = (unsigned char*)((start + ARENA_ALIGNMENT - 1) & ~(uintptr_t)(ARENA_ALIGNMENT - 1));
+	block->used = 0;
+	block->capacity = capacity;
+	block->next = arena->blocks;
+	arena->blocks = block;
+	arena->reservedBytes += capacity;
+	return block;
+}
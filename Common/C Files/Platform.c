@@ -0,0 +1,166 @@
+#ifndef _WIN32
+#define _XOPEN_SOURCE 700 //For clock_gettime(), sysconf(), fseeko() and (an XSI extension) realpath() under -std=c99
+#define _FILE_OFFSET_BITS 64 //Gives fseeko() a 64-bit offset on 32-bit systems too
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include "..\Header Files\Platform.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#define PSAPI_VERSION 2 //Resolves GetProcessMemoryInfo() to the version in kernel32, so no extra library is needed
+#include <psapi.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#endif
+
+double wallClockSeconds() { /** Seconds on a monotonic clock; only differences between two calls are meaningful **/
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+#endif
+}
+
+int processorCount() { /** Number of processors available to this process, at least 1 **/
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (info.dwNumberOfProcessors > 0) ? (int)info.dwNumberOfProcessors : 1;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return (count > 0) ? (int)count : 1;
+#endif
+}
+
+char* absolutePath(const char* fileName) { /** Returns a newly allocated absolute path for fileName, or NULL if it does not exist **/
+#ifdef _WIN32
+	char* path = _fullpath(NULL, fileName, 0);
+	if(path != NULL && GetFileAttributesA(path) == INVALID_FILE_ATTRIBUTES) {
+		free(path);
+		return NULL;
+	}
+	return path;
+#else
+	return realpath(fileName, NULL);
+#endif
+}
+
+/**
+ * Maps all of fileName read-only. Pages are only read in from disk as they are touched. A file shorter than
+ * minimumLength (e.g. too short to hold a header) is not mapped, which also avoids mapping an empty file.
+ */
+int mapFileReadOnly(const char* fileName, uint64_t minimumLength, MappedRegion* region) { /** Returns 0 on success, -1 if the file does not exist, or -2 if it is shorter than minimumLength or cannot be mapped **/
+	memset(region, 0, sizeof(MappedRegion));
+#ifdef _WIN32
+	LARGE_INTEGER fileSize;
+	region->fileHandle = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(region->fileHandle == INVALID_HANDLE_VALUE) {
+		return -1;
+	}
+	GetFileSizeEx(region->fileHandle, &fileSize);
+	region->length = (uint64_t)fileSize.QuadPart;
+	if(region->length >= minimumLength && region->length > 0) {
+		region->mappingHandle = CreateFileMappingA(region->fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+		region->data = (region->mappingHandle == NULL) ? NULL : MapViewOfFile(region->mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	}
+	if(region->data == NULL) {
+		if(region->mappingHandle != NULL) {
+			CloseHandle(region->mappingHandle);
+		}
+		CloseHandle(region->fileHandle);
+		return -2;
+	}
+#else
+	struct stat fileStatus;
+	int descriptor = open(fileName, O_RDONLY);
+	if(descriptor < 0) {
+		return -1;
+	}
+	fstat(descriptor, &fileStatus);
+	region->length = (uint64_t)fileStatus.st_size;
+	if(region->length >= minimumLength && region->length > 0) {
+		region->data = mmap(NULL, region->length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+		if(region->data == MAP_FAILED) {
+			region->data = NULL;
+		}
+	}
+	close(descriptor); //The mapping stays valid after the descriptor is closed
+	if(region->data == NULL) {
+		return -2;
+	}
+#endif
+	return 0;
+}
+
+void unmapFile(MappedRegion* region) {
+#ifdef _WIN32
+	UnmapViewOfFile(region->data);
+	CloseHandle(region->mappingHandle);
+	CloseHandle(region->fileHandle);
+#else
+	munmap(region->data, region->length);
+#endif
+	region->data = NULL;
+}
+
+int seekFile(FILE* file, uint64_t offset) { /** fseek() from the start of the file, but with a 64-bit offset; returns 0 on success **/
+#ifdef _WIN32
+	return _fseeki64(file, (__int64)offset, SEEK_SET);
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
+
+int makeDirectory(const char* path) { /** Creates the directory, unless it already exists; returns 0 on success **/
+#ifdef _WIN32
+	if(CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS) {
+		return 0;
+	}
+	return -1;
+#else
+	struct stat status;
+	if(mkdir(path, 0777) == 0 || (stat(path, &status) == 0 && S_ISDIR(status.st_mode))) {
+		return 0;
+	}
+	return -1;
+#endif
+}
+
+uint64_t peakResidentBytes() { /** Most physical memory this process has used at once so far, or 0 if unknown **/
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return (uint64_t)counters.PeakWorkingSetSize;
+	}
+	return 0;
+#else
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) != 0) {
+		return 0;
+	}
+#ifdef __APPLE__
+	return (uint64_t)usage.ru_maxrss; //In bytes on macOS
+#else
+	return (uint64_t)usage.ru_maxrss * 1024; //In kilobytes elsewhere
+#endif
+#endif
+}
+
+uint64_t countBits(uint64_t word) { /** Number of set bits in word, counted with shifts, masks and one multiply, so it needs no popcnt instruction or compiler builtin **/
+	word = word - ((word >> 1) & 0x5555555555555555ULL); //Each 2 bits now hold the count of their own bits
+	word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL); //Each 4 bits
+	word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL; //Each byte
+	return (word * 0x0101010101010101ULL) >> 56; //Sums every byte into the top one
+}
@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "..\Header Files\ResultSink.h"
+#include "..\Header Files\Platform.h"
+#include "..\Header Files\Stats.h"
+
+#define true 1
+#define false 0
+
+FILE* beginResultFile(const char* fileName, ResultFileHeader* header, char** fileNames); /** Sub-function of openResultSink, writes the header and names, leaving the file at header->dataOffset **/
+void handOverBuffer(ResultSink* sink); /** Sub-function of addResult, passes the filled buffer to the writer and waits for the next one to be free **/
+void* runResultWriter(void* context); /** Sub-function of openResultSink, the body of the writer thread **/
+	void writeResults(ResultSink* sink, ResultEdge* records, uint64_t count); /** Sub-function of runResultWriter **/
+	void flushMatrixRun(ResultSink* sink); /** Sub-function of writeResults, writes the values of a run of consecutive pairs **/
+	void insertNeighbor(ResultSink* sink, uint32_t document, uint32_t neighbor, float similarity); /** Sub-function of writeResults, keeps each document's neighbors sorted, most similar first **/
+void finishResultFile(FILE* file, const char* fileName); /** Sub-function of closeResultSink **/
+
+ResultSink* openResultSink(char** fileNames, uint32_t fileCount, const char* matrixName, const char* edgesName, double edgeThreshold, const char* topName, uint32_t topCount) { /** Any of the three names may be NULL **/
+	ResultSink* sink = calloc(1, sizeof(ResultSink));
+	ResultFileHeader header;
+	if(sink == NULL) {
+		printf("\nERROR: Unable to allocate memory for the result files!\n");
+		exit(1);
+	}
+	sink->fileCount = fileCount;
+	sink->matrixName = matrixName;
+	sink->edgesName = edgesName;
+	sink->topName = topName;
+	sink->edgeThreshold = edgeThreshold;
+	sink->topCount = (topName != NULL) ? topCount : 0;
+	
+	memset(&header, 0, sizeof(ResultFileHeader));
+	header.fileCount = fileCount;
+	if(matrixName != NULL) {
+		header.kind = RESULT_MATRIX;
+		header.recordCount = (uint64_t)fileCount * (fileCount > 0 ? fileCount - 1 : 0) / 2;
+		sink->matrixFile = beginResultFile(matrixName, &header, fileNames);
+		sink->matrixOffset = header.dataOffset;
+		sink->matrixRun = malloc(RESULT_BUFFER_RECORDS * sizeof(float));
+		if(sink->matrixRun == NULL) {
+			printf("\nERROR: Unable to allocate memory for the result files!\n");
+			exit(1);
+		}
+	}
+	if(edgesName != NULL) {
+		header.kind = RESULT_EDGES;
+		header.threshold = edgeThreshold;
+		header.recordCount = 0; //Filled in once every edge is written
+		sink->edgesFile = beginResultFile(edgesName, &header, fileNames);
+		sink->edgesOffset = header.dataOffset;
+		header.threshold = 0;
+	}
+	if(topName != NULL) {
+		header.kind = RESULT_TOP;
+		header.topCount = topCount;
+		header.recordCount = (uint64_t)fileCount * topCount;
+		sink->topFile = beginResultFile(topName, &header, fileNames);
+		sink->topOffset = header.dataOffset;
+		sink->neighbors = malloc((header.recordCount > 0 ? header.recordCount : 1) * sizeof(ResultNeighbor));
+		sink->neighborCounts = calloc(fileCount > 0 ? fileCount : 1, sizeof(uint32_t));
+		if(sink->neighbors == NULL || sink->neighborCounts == NULL) {
+			printf("\nERROR: Unable to allocate memory for the nearest neighbors of every file!\n");
+			exit(1);
+		}
+	}
+	
+	for(int b = 0; b < RESULT_BUFFER_COUNT; b++) {
+		sink->buffers[b] = malloc(RESULT_BUFFER_RECORDS * sizeof(ResultEdge));
+		if(sink->buffers[b] == NULL) {
+			printf("\nERROR: Unable to allocate memory for the result files!\n");
+			exit(1);
+		}
+	}
+	pthread_mutex_init(&sink->lock, NULL);
+	pthread_cond_init(&sink->changed, NULL);
+	if(pthread_create(&sink->writer, NULL, runResultWriter, sink) != 0) {
+		printf("\nERROR: Unable to start the thread that writes the result files!\n");
+		exit(1);
+	}
+	return sink;
+}
+
+FILE* beginResultFile(const char* fileName, ResultFileHeader* header, char** fileNames) { /** Sub-function of openResultSink, writes the header and names, leaving the file at header->dataOffset **/
+	static const char padding[8] = {0};
+	FILE* file = fopen(fileName, "wb");
+	if(file == NULL) {
+		printf("\nERROR: Unable to create result file \"%s\"!\n", fileName);
+		exit(1);
+	}
+	setvbuf(file, NULL, _IOFBF, RESULT_FILE_BUFFER_SIZE);
+	
+	memcpy(header->magic, RESULT_FILE_MAGIC, sizeof(header->magic));
+	header->version = RESULT_FILE_VERSION;
+	header->namesLength = 0;
+	for(uint32_t d = 0; d < header->fileCount; d++) {
+		header->namesLength += strlen(fileNames[d]) + 1;
+	}
+	header->dataOffset = (sizeof(ResultFileHeader) + header->namesLength + 7) & ~(uint64_t)7;
+	
+	int failed = (fwrite(header, sizeof(ResultFileHeader), 1, file) != 1);
+	for(uint32_t d = 0; d < header->fileCount && failed == false; d++) {
+		size_t length = strlen(fileNames[d]) + 1;
+		failed = (fwrite(fileNames[d], 1, length, file) != length);
+	}
+	size_t paddingLength = (size_t)(header->dataOffset - sizeof(ResultFileHeader) - header->namesLength);
+	if(failed == true || fwrite(padding, 1, paddingLength, file) != paddingLength) {
+		printf("\nERROR: Unable to write to result file \"%s\"!\n", fileName);
+		exit(1);
+	}
+	return file;
+}
+
+void addResult(ResultSink* sink, uint32_t i, uint32_t k, double similarity) {
+	ResultEdge* record = &sink->buffers[sink->filling][sink->filled++];
+	record->i = i;
+	record->k = k;
+	record->similarity = (float)similarity;
+	if(sink->filled == RESULT_BUFFER_RECORDS) {
+		handOverBuffer(sink);
+	}
+}
+
+void handOverBuffer(ResultSink* sink) { /** Sub-function of addResult, passes the filled buffer to the writer and waits for the next one to be free **/
+	pthread_mutex_lock(&sink->lock);
+	sink->bufferCounts[sink->filling] = sink->filled;
+	pthread_cond_broadcast(&sink->changed);
+	sink->filling = (sink->filling + 1) % RESULT_BUFFER_COUNT;
+	while(sink->bufferCounts[sink->filling] != 0) { //The writer takes the buffers in turn, so this is the one it will free next
+		pthread_cond_wait(&sink->changed, &sink->lock);
+	}
+	pthread_mutex_unlock(&sink->lock);
+	sink->filled = 0;
+}
+
+void* runResultWriter(void* context) { /** Sub-function of openResultSink, the body of the writer thread **/
+	ResultSink* sink = context;
+	int current = 0;
+	
+	while(true) {
+		pthread_mutex_lock(&sink->lock);
+		while(sink->bufferCounts[current] == 0 && sink->finished == false) {
+			pthread_cond_wait(&sink->changed, &sink->lock);
+		}
+		uint64_t count = sink->bufferCounts[current];
+		pthread_mutex_unlock(&sink->lock);
+		if(count == 0) { //Finished, and every buffer handed over has been written
+			break;
+		}
+		
+		writeResults(sink, sink->buffers[current], count);
+		pthread_mutex_lock(&sink->lock);
+		sink->bufferCounts[current] = 0;
+		pthread_cond_broadcast(&sink->changed);
+		pthread_mutex_unlock(&sink->lock);
+		current = (current + 1) % RESULT_BUFFER_COUNT;
+	}
+	return NULL;
+}
+
+/**
+ * Pairs usually arrive in (i,k) order, so their matrix values are gathered into runs of consecutive records and each
+ * run is written with one seek and one fwrite(). The edges are compacted to the front of the buffer as it is read,
+ * and also written with one fwrite().
+ */
+void writeResults(ResultSink* sink, ResultEdge* records, uint64_t count) { /** Sub-function of runResultWriter **/
+	double startTime = statsClock();
+	uint64_t rowBase = 2 * (uint64_t)sink->fileCount - 1;
+	uint64_t edgeCount = 0;
+	float edgeThreshold = (float)sink->edgeThreshold;
+	
+	for(uint64_t r = 0; r < count; r++) {
+		ResultEdge record = records[r];
+		if(sink->matrixFile != NULL) {
+			uint64_t index = (uint64_t)record.i * (rowBase - record.i) / 2 + (record.k - record.i - 1);
+			if(sink->matrixRunLength > 0 && (index != sink->matrixRunStart + sink->matrixRunLength || sink->matrixRunLength == RESULT_BUFFER_RECORDS)) {
+				flushMatrixRun(sink);
+			}
+			if(sink->matrixRunLength == 0) {
+				sink->matrixRunStart = index;
+			}
+			sink->matrixRun[sink->matrixRunLength++] = record.similarity;
+		}
+		if(record.similarity > 0 && sink->topFile != NULL) {
+			insertNeighbor(sink, record.i, record.k, record.similarity);
+			insertNeighbor(sink, record.k, record.i, record.similarity);
+		}
+		if(record.similarity > 0 && record.similarity >= edgeThreshold) {
+			records[edgeCount++] = record; //Never ahead of r, so no record is overwritten before it is read
+		}
+	}
+	
+	if(sink->edgesFile != NULL && edgeCount > 0) {
+		if(fwrite(records, sizeof(ResultEdge), (size_t)edgeCount, sink->edgesFile) != (size_t)edgeCount) {
+			printf("\nERROR: Unable to write to result file \"%s\"!\n", sink->edgesName);
+			exit(1);
+		}
+		sink->edgeCount += edgeCount;
+	}
+	addStageTime("write", startTime, count, 0);
+}
+
+void flushMatrixRun(ResultSink* sink) { /** Sub-function of writeResults, writes the values of a run of consecutive pairs **/
+	if(seekFile(sink->matrixFile, sink->matrixOffset + sink->matrixRunStart * sizeof(float)) != 0 || fwrite(sink->matrixRun, sizeof(float), (size_t)sink->matrixRunLength, sink->matrixFile) != (size_t)sink->matrixRunLength) {
+		printf("\nERROR: Unable to write to result file \"%s\"!\n", sink->matrixName);
+		exit(1);
+	}
+	if(sink->matrixRunStart + sink->matrixRunLength > sink->matrixEnd) {
+		sink->matrixEnd = sink->matrixRunStart + sink->matrixRunLength;
+	}
+	sink->matrixRunLength = 0;
+}
+
+void insertNeighbor(ResultSink* sink, uint32_t document, uint32_t neighbor, float similarity) { /** Sub-function of writeResults, keeps each document's neighbors sorted, most similar first **/
+	ResultNeighbor* list = sink->neighbors + (uint64_t)document * sink->topCount;
+	uint32_t count = sink->neighborCounts[document];
+	uint32_t position = count;
+	while(position > 0 && (list[position - 1].similarity < similarity || (list[position - 1].similarity == similarity && list[position - 1].document > neighbor))) {
+		position--;
+	}
+	if(position >= sink->topCount) {
+		return;
+	}
+	
+	uint32_t last = (count < sink->topCount) ? count : sink->topCount - 1;
+	memmove(list + position + 1, list + position, (last - position) * sizeof(ResultNeighbor));
+	list[position].document = neighbor;
+	list[position].similarity = similarity;
+	if(count < sink->topCount) {
+		sink->neighborCounts[document]++;
+	}
+}
+
+void closeResultSink(ResultSink* sink) { /** Writes everything still buffered, and finishes each file **/
+	pthread_mutex_lock(&sink->lock);
+	sink->bufferCounts[sink->filling] = sink->filled; //The writer stops at the first empty buffer, so a last buffer with nothing in it is simply not handed over
+	sink->finished = true;
+	pthread_cond_broadcast(&sink->changed);
+	pthread_mutex_unlock(&sink->lock);
+	pthread_join(sink->writer, NULL);
+	pthread_mutex_destroy(&sink->lock);
+	pthread_cond_destroy(&sink->changed);
+	
+	if(sink->matrixFile != NULL) {
+		uint64_t pairCount = (uint64_t)sink->fileCount * (sink->fileCount > 0 ? sink->fileCount - 1 : 0) / 2;
+		if(sink->matrixRunLength > 0) {
+			flushMatrixRun(sink);
+		}
+		if(sink->matrixEnd < pairCount) { //Writing the last value extends the file to its full length, and anything skipped over reads as 0
+			sink->matrixRunStart = pairCount - 1;
+			sink->matrixRun[0] = 0.0f;
+			sink->matrixRunLength = 1;
+			flushMatrixRun(sink);
+		}
+		finishResultFile(sink->matrixFile, sink->matrixName);
+	}
+	if(sink->edgesFile != NULL) {
+		if(seekFile(sink->edgesFile, offsetof(ResultFileHeader, recordCount)) != 0 || fwrite(&sink->edgeCount, sizeof(uint64_t), 1, sink->edgesFile) != 1) {
+			printf("\nERROR: Unable to write to result file \"%s\"!\n", sink->edgesName);
+			exit(1);
+		}
+		finishResultFile(sink->edgesFile, sink->edgesName);
+	}
+	if(sink->topFile != NULL) {
+		for(uint32_t d = 0; d < sink->fileCount; d++) {
+			for(uint32_t n = sink->neighborCounts[d]; n < sink->topCount; n++) {
+				sink->neighbors[(uint64_t)d * sink->topCount + n].document = RESULT_NO_DOCUMENT;
+				sink->neighbors[(uint64_t)d * sink->topCount + n].similarity = 0.0f;
+			}
+		}
+		uint64_t neighborCount = (uint64_t)sink->fileCount * sink->topCount;
+		if(fwrite(sink->neighbors, sizeof(ResultNeighbor), (size_t)neighborCount, sink->topFile) != (size_t)neighborCount) {
+			printf("\nERROR: Unable to write to result file \"%s\"!\n", sink->topName);
+			exit(1);
+		}
+		finishResultFile(sink->topFile, sink->topName);
+	}
+	
+	for(int b = 0; b < RESULT_BUFFER_COUNT; b++) {
+		free(sink->buffers[b]);
+	}
+	free(sink->matrixRun);
+	free(sink->neighbors);
+	free(sink->neighborCounts);
+	free(sink);
+}
+
+void finishResultFile(FILE* file, const char* fileName) { /** Sub-function of closeResultSink **/
+	if(fclose(file) != 0) {
+		printf("\nERROR: Unable to write to result file \"%s\"!\n", fileName);
+		exit(1);
+	}
+}
@@ -0,0 +1,168 @@
+#ifndef _WIN32
+#define _XOPEN_SOURCE 700 //For struct sockaddr_un, poll() and unlink() under -std=c99
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include "..\Header Files\ServerProtocol.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#define pollSockets WSAPoll
+typedef WSAPOLLFD SocketPoll;
+typedef int SocketLength;
+#else
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#define pollSockets poll
+typedef struct pollfd SocketPoll;
+typedef socklen_t SocketLength;
+#endif
+
+#ifndef MSG_NOSIGNAL
+	#define MSG_NOSIGNAL 0 //Platforms without it rely on SIGPIPE being ignored
+#endif
+#define true 1
+#define false 0
+#define listenBacklog 128 //Connections the operating system queues before the server accepts them
+
+int startSockets(); /** Sub-function of listenLocalSocket and connectLocalSocket, starts Winsock once; returns 0 on success **/
+int fillSocketAddress(const char* path, struct sockaddr_un* address); /** Sub-function of listenLocalSocket and connectLocalSocket, returns 0 if path fits **/
+
+int listenLocalSocket(const char* path) { /** Replaces any socket file left at path, and listens there **/
+	struct sockaddr_un address;
+	if(startSockets() != 0 || fillSocketAddress(path, &address) != 0) {
+		return -1;
+	}
+	int listener = (int)socket(AF_UNIX, SOCK_STREAM, 0);
+	if(listener < 0) {
+		return -1;
+	}
+	removeLocalSocket(path); //Left behind by a server that did not shut down cleanly
+	if(bind(listener, (struct sockaddr*)&address, (SocketLength)sizeof(address)) != 0 || listen(listener, listenBacklog) != 0) {
+		closeLocalSocket(listener);
+		return -1;
+	}
+	return listener;
+}
+
+int acceptLocalSocket(int listener) { /** Waits for the next connection to a listening socket **/
+	int connection = (int)accept(listener, NULL, NULL);
+	return (connection >= 0) ? connection : -1;
+}
+
+int connectLocalSocket(const char* path) {
+	struct sockaddr_un address;
+	if(startSockets() != 0 || fillSocketAddress(path, &address) != 0) {
+		return -1;
+	}
+	int connection = (int)socket(AF_UNIX, SOCK_STREAM, 0);
+	if(connection < 0) {
+		return -1;
+	}
+	if(connect(connection, (struct sockaddr*)&address, (SocketLength)sizeof(address)) != 0) {
+		closeLocalSocket(connection);
+		return -1;
+	}
+	return connection;
+}
+
+int sendAll(int socket, const void* data, size_t length) { /** Returns 0 once every byte is sent **/
+	const char* next = data;
+	while(length > 0) {
+		int chunk = (length > 1048576) ? 1048576 : (int)length; //send() takes an int length on Windows
+		int sent = (int)send(socket, next, chunk, MSG_NOSIGNAL);
+		if(sent <= 0) {
+			return -1;
+		}
+		next += sent;
+		length -= (size_t)sent;
+	}
+	return 0;
+}
+
+int receiveAll(int socket, void* data, size_t length) { /** Returns 0 once length bytes are received, or -1 if the connection closes first **/
+	char* next = data;
+	while(length > 0) {
+		long long received = receiveSome(socket, next, length);
+		if(received <= 0) {
+			return -1;
+		}
+		next += received;
+		length -= (size_t)received;
+	}
+	return 0;
+}
+
+long long receiveSome(int socket, void* buffer, size_t capacity) { /** Returns the bytes received (at least 1), 0 if the connection closed, or -1 **/
+	int chunk = (capacity > 1048576) ? 1048576 : (int)capacity;
+	int received = (int)recv(socket, buffer, chunk, 0);
+	return (received >= 0) ? received : -1;
+}
+
+/**
+ * Waits until at least one of the sockets has something to read, or milliseconds pass (forever if it is negative).
+ * A closed or failed connection counts as ready, so the next receiveSome() on it reports the close.
+ */
+int waitForSockets(const int* sockets, int count, int milliseconds, int* ready) { /** Sets ready[s] to true for each socket with data (or a closed connection) to read, and returns how many are ready, 0 on time out, or -1 **/
+	SocketPoll* polls = malloc((count > 0 ? count : 1) * sizeof(SocketPoll));
+	if(polls == NULL) {
+		return -1;
+	}
+	for(int s = 0; s < count; s++) {
+		polls[s].fd = sockets[s];
+		polls[s].events = POLLIN;
+		polls[s].revents = 0;
+	}
+	
+	int readyCount = pollSockets(polls, count, milliseconds);
+	for(int s = 0; s < count; s++) {
+		ready[s] = (readyCount > 0 && (polls[s].revents & (POLLIN | POLLHUP | POLLERR)) != 0) ? true : false;
+	}
+	free(polls);
+	return (readyCount >= 0) ? readyCount : -1;
+}
+
+void closeLocalSocket(int socket) {
+#ifdef _WIN32
+	closesocket((SOCKET)socket);
+#else
+	close(socket);
+#endif
+}
+
+void removeLocalSocket(const char* path) { /** Deletes the socket file a listener leaves behind **/
+#ifdef _WIN32
+	DeleteFileA(path);
+#else
+	unlink(path);
+#endif
+}
+
+int startSockets() { /** Sub-function of listenLocalSocket and connectLocalSocket, starts Winsock once; returns 0 on success **/
+#ifdef _WIN32
+	static int started = false; //Set before any worker thread could connect, so it needs no lock
+	if(started == false) {
+		WSADATA data;
+		if(WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+			return -1;
+		}
+		started = true;
+	}
+#endif
+	return 0;
+}
+
+int fillSocketAddress(const char* path, struct sockaddr_un* address) { /** Sub-function of listenLocalSocket and connectLocalSocket, returns 0 if path fits **/
+	memset(address, 0, sizeof(struct sockaddr_un));
+	address->sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(address->sun_path)) {
+		return -1;
+	}
+	strcpy(address->sun_path, path);
+	return 0;
+}
@@ -0,0 +1,386 @@
+#include <stdlib.h>
+#include <string.h>
+#include "..\Header Files\SetIntersection.h"
+#include "..\Header Files\Platform.h"
+
+#define true 1
+#define false 0
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define HAVE_X86_KERNELS
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define TARGET_SSE4
+		#define TARGET_POPCNT
+		#define TARGET_AVX2
+		#ifdef _M_X64
+			#define POPCOUNT64(word) __popcnt64(word)
+		#else
+			#define POPCOUNT64(word) (__popcnt((unsigned int)(word)) + __popcnt((unsigned int)((word) >> 32)))
+		#endif
+	#else
+		#define TARGET_SSE4 __attribute__((target("sse4.1")))
+		#define TARGET_POPCNT __attribute__((target("popcnt")))
+		#define TARGET_AVX2 __attribute__((target("avx2")))
+		#define POPCOUNT64(word) __builtin_popcountll(word)
+	#endif
+#endif
+
+typedef uint64_t (*Kernel64)(const uint64_t* a, uint64_t aCount, const uint64_t* b, uint64_t bCount);
+typedef uint64_t (*Kernel32)(const uint32_t* a, uint64_t aCount, const uint32_t* b, uint64_t bCount);
+typedef uint64_t (*BitsetKernel)(const uint64_t* a, const uint64_t* b, uint64_t words);
+
+uint64_t mergeCount64(const uint64_t* a, uint64_t aCount, const uint64_t* b, uint64_t bCount); /** Sub-function of intersectionCount64, the scalar kernel **/
+uint64_t mergeCount32(const uint32_t* a, uint64_t aCount, const uint32_t* b, uint64_t bCount); /** Sub-function of intersectionCount32, the scalar kernel **/
+uint64_t gallopCount64(const uint64_t* small, uint64_t smallCount, const uint64_t* large, uint64_t largeCount); /** Sub-function of intersectionCount64, for arrays of very different lengths **/
+uint64_t gallopCount32(const uint32_t* small, uint64_t smallCount, const uint32_t* large, uint64_t largeCount); /** Sub-function of intersectionCount32, for arrays of very different lengths **/
+uint64_t swarBitsetCount(const uint64_t* a, const uint64_t* b, uint64_t words); /** Sub-function of bitsetIntersectionCount, the scalar kernel **/
+#ifdef HAVE_X86_KERNELS
+	int cpuSupports(const char* feature); /** Sub-function of selectIntersectionKernel, asks the processor (and operating system) whether "sse4.1", "popcnt" or "avx2" can be used **/
+	uint64_t sse4Count64(const uint64_t* a, uint64_t aCount, const uint64_t* b, uint64_t bCount);
+	uint64_t sse4Count32(const uint32_t* a, uint64_t aCount, const uint32_t* b, uint64_t bCount);
+	uint64_t avx2Count64(const uint64_t* a, uint64_t aCount, const uint64_t* b, uint64_t bCount);
+	uint64_t avx2Count32(const uint32_t* a, uint64_t aCount, const uint32_t* b, uint64_t bCount);
+	uint64_t popcntBitsetCount(const uint64_t* a, const uint64_t* b, uint64_t words);
+	uint64_t avx2BitsetCount(const uint64_t* a, const uint64_t* b, uint64_t words);
+#endif
+
+/**
+ * The selected kernels. They are chosen once, before any comparison starts, and never change while threads use them:
+ */
+Kernel64 blockCount64 = NULL;
+Kernel32 blockCount32 = NULL;
+BitsetKernel bitsetCount = swarBitsetCount;
+const char* selectedKernelName = NULL;
+
+/**
+ * Number of set bits in each 4-bit movemask result:
+ */
+const uint8_t nibbleBits[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+
+int selectIntersectionKernel(const char* name) { /** "auto", "scalar", "sse4" or "avx2"; returns false if the name is unknown or the processor lacks the instructions **/
+	int automatic = (strcmp(name, "auto") == 0);
+
+#ifdef HAVE_X86_KERNELS
+	if((automatic || strcmp(name, "avx2") == 0) && cpuSupports("avx2")) {
+		blockCount64 = avx2Count64;
+		blockCount32 = avx2Count32;
+		bitsetCount = avx2BitsetCount;
+		selectedKernelName = "avx2";
+		return true;
+	}
+	if((automatic || strcmp(name, "sse4") == 0) && cpuSupports("sse4.1")) {
+		blockCount64 = sse4Count64;
+		blockCount32 = sse4Count32;
+		bitsetCount = cpuSupports("popcnt") ? popcntBitsetCount : swarBitsetCount;
+		selectedKernelName = "sse4";
+		return true;
+	}
+#endif
+	if(automatic || strcmp(name, "scalar") == 0) {
+		blockCount64 = mergeCount64;
+		blockCount32 = mergeCount32;
+		bitsetCount = swarBitsetCount;
+		selectedKernelName = "scalar";
+		return true;
+	}
+	return false;
+}
+
+const char* intersectionKernelName() {
+	if(selectedKernelName == NULL) {
+		selectIntersectionKernel("auto");
+	}
+	return selectedKernelName;
+}
+
+uint64_t intersectionCount64(const uint64_t* a, uint64_t aCount, const uint64_t* b, uint64_t bCount) {
+	if(aCount == 0 || bCount == 0) {
+		return 0;
+	}
+	if(aCount / GALLOP_RATIO >= bCount) {
+		return gallopCount64(b, bCount, a, aCount);
+	}
+	if(bCount / GALLOP_RATIO >= aCount) {
+		return gallopCount64(a, aCount, b, bCount);
+	}
+	if(blockCount64 == NULL) {
+		selectIntersectionKernel("auto");
+	}
+	return blockCount64(a, aCount, b, bCount);
+}
+
+uint64_t intersectionCount32(const uint32_t* a, uint64_t aCount, const uint32_t* b, uint64_t bCount) {
+	if(aCount == 0 || bCount == 0) {
+		return 0;
+	}
+	if(aCount / GALLOP_RATIO >= bCount) {
+		return gallopCount32(b, bCount, a, aCount);
+	}
+	if(bCount / GALLOP_RATIO >= aCount) {
+		return gallopCount32(a, aCount, b, bCount);
+	}
+	if(blockCount32 == NULL) {
+		selectIntersectionKernel("auto");
+	}
+	return blockCount32(a, aCount, b, bCount);
+}
+
+uint64_t* createBitset(const uint64_t* values, uint64_t count, uint64_t universe) { /** Returns a newly allocated bitset holding values, every one of which must be below universe, or NULL if out of memory **/
+	uint64_t* bits = calloc(BITSET_WORDS(universe) > 0 ? BITSET_WORDS(universe) : 1, sizeof(uint64_t));
+	if(bits == NULL) {
+		return NULL;
+	}
+	for(uint64_t i = 0; i < count; i++) {
+		bits[values[i] / 64] |= (uint64_t)1 << (values[i] % 64);
+	}
+	return bits;
+}
+
+uint64_t bitsetIntersectionCount(const uint64_t* a, const uint64_t* b, uint64_t words) { /** Values held by both bitsets **/
+	if(selectedKernelName == NULL) {
+		selectIntersectionKernel("auto");
+	}
+	return bitsetCount(a, b, words);
+}
+
+/**
+ * Advances through both arrays without branching on which value is smaller, so the loop runs at the same speed
+ * however the values interleave, instead of stalling on mispredicted branches.
+ */
+uint64_t mergeCount64(const uint64_t* a, uint64_t aCount, const uint64_t* b, uint64_t bCount) { /** Sub-function of intersectionCount64, the scalar kernel **/
+	uint64_t i = 0, k = 0, count = 0;
+	while(i < aCount && k < bCount) {
+		uint64_t x = a[i];
+		uint64_t y = b[k];
+		count += (x == y);
+		i += (x <= y);
+		k += (y <= x);
+	}
+	return count;
+}
+
+uint64_t mergeCount32(const uint32_t* a, uint64_t aCount, const uint32_t* b, uint64_t bCount) { /** Sub-function of intersectionCount32, the scalar kernel **/
+	uint64_t i = 0, k = 0, count = 0;
+	while(i < aCount && k < bCount) {
+		uint32_t x = a[i];
+		uint32_t y = b[k];
+		count += (x == y);
+		i += (x <= y);
+		k += (y <= x);
+	}
+	return count;
+}
+
+/**
+ * Looks each value of the short array up in the long one. The search starts where the previous one ended and
+ * doubles its step until it overshoots, then finishes with a binary search, so it costs O(small * log(large / small)).
+ */
+uint64_t gallopCount64(const uint64_t* small, uint64_t smallCount, const uint64_t* large, uint64_t largeCount) { /** Sub-function of intersectionCount64, for arrays of very different lengths **/
+	uint64_t low = 0, count = 0;
+	for(uint64_t i = 0; i < smallCount && low < largeCount; i++) {
+		uint64_t value = small[i];
+		uint64_t step = 1;
+		uint64_t high = low;
+		while(high < largeCount && large[high] < value) { //Find a position at or past value, so it lies in [low, high]
+			low = high + 1;
+			high += step;
+			step *= 2;
+		}
+		if(high > largeCount) {
+			high = largeCount;
+		}
+		while(low < high) {
+			uint64_t middle = low + (high - low) / 2;
+			if(large[middle] < value) {
+				low = middle + 1;
+			} else {
+				high = middle;
+			}
+		}
+		if(low < largeCount && large[low] == value) {
+			count++;
+			low++;
+		}
+	}
+	return count;
+}
+
+uint64_t gallopCount32(const uint32_t* small, uint64_t smallCount, const uint32_t* large, uint64_t largeCount) { /** Sub-function of intersectionCount32, for arrays of very different lengths **/
+	uint64_t low = 0, count = 0;
+	for(uint64_t i = 0; i < smallCount && low < largeCount; i++) {
+		uint32_t value = small[i];
+		uint64_t step = 1;
+		uint64_t high = low;
+		while(high < largeCount && large[high] < value) {
+			low = high + 1;
+			high += step;
+			step *= 2;
+		}
+		if(high > largeCount) {
+			high = largeCount;
+		}
+		while(low < high) {
+			uint64_t middle = low + (high - low) / 2;
+			if(large[middle] < value) {
+				low = middle + 1;
+			} else {
+				high = middle;
+			}
+		}
+		if(low < largeCount && large[low] == value) {
+			count++;
+			low++;
+		}
+	}
+	return count;
+}
+
+uint64_t swarBitsetCount(const uint64_t* a, const uint64_t* b, uint64_t words) { /** Sub-function of bitsetIntersectionCount, the scalar kernel **/
+	uint64_t count = 0;
+	for(uint64_t w = 0; w < words; w++) {
+		count += countBits(a[w] & b[w]);
+	}
+	return count;
+}
+
+#ifdef HAVE_X86_KERNELS
+int cpuSupports(const char* feature) { /** Sub-function of selectIntersectionKernel, asks the processor (and operating system) whether "sse4.1" or "avx2" can be used **/
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	if(strcmp(feature, "sse4.1") == 0) {
+		return (info[2] & (1 << 19)) != 0;
+	}
+	if(strcmp(feature, "popcnt") == 0) {
+		return (info[2] & (1 << 23)) != 0;
+	}
+	if((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6) { //The operating system must save the AVX registers on a context switch
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	if(strcmp(feature, "sse4.1") == 0) {
+		return __builtin_cpu_supports("sse4.1");
+	}
+	if(strcmp(feature, "popcnt") == 0) {
+		return __builtin_cpu_supports("popcnt");
+	}
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+/**
+ * The block kernels load the next block of each array and compare one block against every rotation of the other,
+ * which finds every equal pair between the two blocks. Both arrays are free of duplicates, so each value of a
+ * matches at most once and the matches are simply counted. Whichever block ends with the smaller value cannot match
+ * anything further on, so it is the one replaced (or both, if they end equally). The rest is finished by the merge.
+ */
+TARGET_SSE4 uint64_t sse4Count64(const uint64_t* a, uint64_t aCount, const uint64_t* b, uint64_t bCount) {
+	uint64_t i = 0, k = 0, count = 0;
+	while(i + 2 <= aCount && k + 2 <= bCount) {
+		__m128i blockA = _mm_loadu_si128((const __m128i*)(a + i));
+		__m128i blockB = _mm_loadu_si128((const __m128i*)(b + k));
+		__m128i matches = _mm_or_si128(_mm_cmpeq_epi64(blockA, blockB), _mm_cmpeq_epi64(blockA, _mm_shuffle_epi32(blockB, 0x4E)));
+		count += nibbleBits[_mm_movemask_pd(_mm_castsi128_pd(matches))];
+		
+		uint64_t lastA = a[i + 1];
+		uint64_t lastB = b[k + 1];
+		i += (lastA <= lastB) * 2;
+		k += (lastB <= lastA) * 2;
+	}
+	return count + mergeCount64(a + i, aCount - i, b + k, bCount - k);
+}
+
+TARGET_SSE4 uint64_t sse4Count32(const uint32_t* a, uint64_t aCount, const uint32_t* b, uint64_t bCount) {
+	uint64_t i = 0, k = 0, count = 0;
+	while(i + 4 <= aCount && k + 4 <= bCount) {
+		__m128i blockA = _mm_loadu_si128((const __m128i*)(a + i));
+		__m128i blockB = _mm_loadu_si128((const __m128i*)(b + k));
+		__m128i matches = _mm_cmpeq_epi32(blockA, blockB);
+		matches = _mm_or_si128(matches, _mm_cmpeq_epi32(blockA, _mm_shuffle_epi32(blockB, 0x39)));
+		matches = _mm_or_si128(matches, _mm_cmpeq_epi32(blockA, _mm_shuffle_epi32(blockB, 0x4E)));
+		matches = _mm_or_si128(matches, _mm_cmpeq_epi32(blockA, _mm_shuffle_epi32(blockB, 0x93)));
+		count += nibbleBits[_mm_movemask_ps(_mm_castsi128_ps(matches))];
+		
+		uint32_t lastA = a[i + 3];
+		uint32_t lastB = b[k + 3];
+		i += (lastA <= lastB) * 4;
+		k += (lastB <= lastA) * 4;
+	}
+	return count + mergeCount32(a + i, aCount - i, b + k, bCount - k);
+}
+
+TARGET_AVX2 uint64_t avx2Count64(const uint64_t* a, uint64_t aCount, const uint64_t* b, uint64_t bCount) {
+	uint64_t i = 0, k = 0, count = 0;
+	while(i + 4 <= aCount && k + 4 <= bCount) {
+		__m256i blockA = _mm256_loadu_si256((const __m256i*)(a + i));
+		__m256i blockB = _mm256_loadu_si256((const __m256i*)(b + k));
+		__m256i matches = _mm256_cmpeq_epi64(blockA, blockB);
+		matches = _mm256_or_si256(matches, _mm256_cmpeq_epi64(blockA, _mm256_permute4x64_epi64(blockB, 0x39)));
+		matches = _mm256_or_si256(matches, _mm256_cmpeq_epi64(blockA, _mm256_permute4x64_epi64(blockB, 0x4E)));
+		matches = _mm256_or_si256(matches, _mm256_cmpeq_epi64(blockA, _mm256_permute4x64_epi64(blockB, 0x93)));
+		count += nibbleBits[_mm256_movemask_pd(_mm256_castsi256_pd(matches))];
+		
+		uint64_t lastA = a[i + 3];
+		uint64_t lastB = b[k + 3];
+		i += (lastA <= lastB) * 4;
+		k += (lastB <= lastA) * 4;
+	}
+	return count + mergeCount64(a + i, aCount - i, b + k, bCount - k);
+}
+
+TARGET_AVX2 uint64_t avx2Count32(const uint32_t* a, uint64_t aCount, const uint32_t* b, uint64_t bCount) {
+	uint64_t i = 0, k = 0, count = 0;
+	__m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+	while(i + 8 <= aCount && k + 8 <= bCount) {
+		__m256i blockA = _mm256_loadu_si256((const __m256i*)(a + i));
+		__m256i blockB = _mm256_loadu_si256((const __m256i*)(b + k));
+		__m256i matches = _mm256_cmpeq_epi32(blockA, blockB);
+		for(int r = 1; r < 8; r++) {
+			blockB = _mm256_permutevar8x32_epi32(blockB, rotate);
+			matches = _mm256_or_si256(matches, _mm256_cmpeq_epi32(blockA, blockB));
+		}
+		int mask = _mm256_movemask_ps(_mm256_castsi256_ps(matches));
+		count += nibbleBits[mask & 0xF] + nibbleBits[mask >> 4];
+		
+		uint32_t lastA = a[i + 7];
+		uint32_t lastB = b[k + 7];
+		i += (lastA <= lastB) * 8;
+		k += (lastB <= lastA) * 8;
+	}
+	return count + mergeCount32(a + i, aCount - i, b + k, bCount - k);
+}
+
+TARGET_POPCNT uint64_t popcntBitsetCount(const uint64_t* a, const uint64_t* b, uint64_t words) {
+	uint64_t count = 0;
+	for(uint64_t w = 0; w < words; w++) {
+		count += POPCOUNT64(a[w] & b[w]);
+	}
+	return count;
+}
+
+/**
+ * Counts the bits of 32 bytes at once by looking each half-byte up in a 16-entry table with a shuffle, then sums
+ * the byte counts into four 64-bit totals, which cannot overflow, every 256 bits.
+ */
+TARGET_AVX2 uint64_t avx2BitsetCount(const uint64_t* a, const uint64_t* b, uint64_t words) {
+	__m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	__m256i lowNibbles = _mm256_set1_epi8(0x0F);
+	__m256i totals = _mm256_setzero_si256();
+	uint64_t w = 0;
+	for(; w + 4 <= words; w += 4) {
+		__m256i both = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(a + w)), _mm256_loadu_si256((const __m256i*)(b + w)));
+		__m256i low = _mm256_shuffle_epi8(table, _mm256_and_si256(both, lowNibbles));
+		__m256i high = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(both, 4), lowNibbles));
+		totals = _mm256_add_epi64(totals, _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256()));
+	}
+	
+	uint64_t lanes[4];
+	_mm256_storeu_si256((__m256i*)lanes, totals);
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3] + swarBitsetCount(a + w, b + w, words - w);
+}
+#endif
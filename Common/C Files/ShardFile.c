@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "..\Header Files\ShardFile.h"
+#include "..\Header Files\Platform.h"
+
+#define true 1
+#define false 0
+#define shardFileBufferSize 1048576 //Bytes of stdio buffer given to a partial result file
+
+/**
+ * Writes the header (with a resultCount of 0) and the names, leaving the file at header->dataOffset.
+ */
+FILE* beginShardFile(const char* fileName, ShardFileHeader* header, char** fileNames) { /** Fills in the magic, version and name fields of header, and writes it and the names; the caller then fwrite()s the results **/
+	static const char padding[8] = {0};
+	FILE* file = fopen(fileName, "wb");
+	if(file == NULL) {
+		printf("\nERROR: Unable to create partial result file \"%s\"!\n", fileName);
+		exit(1);
+	}
+	setvbuf(file, NULL, _IOFBF, shardFileBufferSize);
+	
+	memcpy(header->magic, SHARD_FILE_MAGIC, sizeof(header->magic));
+	header->version = SHARD_FILE_VERSION;
+	header->namesLength = 0;
+	for(uint32_t d = 0; d < header->fileCount; d++) {
+		header->namesLength += strlen(fileNames[d]) + 1;
+	}
+	header->dataOffset = (sizeof(ShardFileHeader) + header->namesLength + 7) & ~(uint64_t)7;
+	header->resultCount = 0;
+	
+	int failed = (fwrite(header, sizeof(ShardFileHeader), 1, file) != 1);
+	for(uint32_t d = 0; d < header->fileCount && failed == false; d++) {
+		size_t length = strlen(fileNames[d]) + 1;
+		failed = (fwrite(fileNames[d], 1, length, file) != length);
+	}
+	size_t paddingLength = (size_t)(header->dataOffset - sizeof(ShardFileHeader) - header->namesLength);
+	if(failed == true || fwrite(padding, 1, paddingLength, file) != paddingLength) {
+		printf("\nERROR: Unable to write to partial result file \"%s\"!\n", fileName);
+		exit(1);
+	}
+	return file;
+}
+
+void finishShardFile(FILE* file, const char* fileName, uint64_t resultCount) { /** Fills in the final count in the header, and closes the file **/
+	if(fflush(file) != 0 || seekFile(file, offsetof(ShardFileHeader, resultCount)) != 0 || fwrite(&resultCount, sizeof(resultCount), 1, file) != 1 || fclose(file) != 0) {
+		printf("\nERROR: Unable to write to partial result file \"%s\"!\n", fileName);
+		exit(1);
+	}
+}
+
+/**
+ * Maps a partial result file read-only and checks that its names and results lie within it. Nothing is copied
+ * except the table of name pointers.
+ */
+MappedShardFile* openShardFile(const char* fileName) {
+	MappedShardFile* file = calloc(1, sizeof(MappedShardFile));
+	if(file == NULL) {
+		printf("\nERROR: Unable to allocate memory for partial result file \"%s\"!\n", fileName);
+		exit(1);
+	}
+	
+	int status = mapFileReadOnly(fileName, sizeof(ShardFileHeader), &file->region);
+	if(status == -1) {
+		printf("\nERROR: File \"%s\" not found!\n", fileName);
+		exit(1);
+	} else if(status != 0) {
+		printf("\nERROR: File \"%s\" is too short or could not be mapped into memory!\n", fileName);
+		exit(1);
+	}
+	
+	const ShardFileHeader* header = file->header = file->region.data;
+	const char* data = file->region.data;
+	if(memcmp(header->magic, SHARD_FILE_MAGIC, sizeof(header->magic)) != 0 || header->version != SHARD_FILE_VERSION) {
+		printf("\nERROR: File \"%s\" is not a version %d partial result file!\n", fileName, SHARD_FILE_VERSION);
+		exit(1);
+	}
+	if(header->dataOffset < sizeof(ShardFileHeader) + header->namesLength || header->dataOffset > file->region.length || header->resultCount > (file->region.length - header->dataOffset) / sizeof(ShardResult)) {
+		printf("\nERROR: Partial result file \"%s\" is truncated!\n", fileName);
+		exit(1);
+	}
+	
+	file->fileNames = malloc((header->fileCount > 0 ? header->fileCount : 1) * sizeof(char*));
+	if(file->fileNames == NULL) {
+		printf("\nERROR: Unable to allocate memory for partial result file \"%s\"!\n", fileName);
+		exit(1);
+	}
+	const char* name = data + sizeof(ShardFileHeader);
+	const char* namesEnd = name + header->namesLength;
+	for(uint32_t d = 0; d < header->fileCount; d++) {
+		const char* nameEnd = (name < namesEnd) ? memchr(name, '\0', (size_t)(namesEnd - name)) : NULL;
+		if(nameEnd == NULL) {
+			printf("\nERROR: Partial result file \"%s\" is damaged!\n", fileName);
+			exit(1);
+		}
+		file->fileNames[d] = name;
+		name = nameEnd + 1;
+	}
+	file->results = (const ShardResult*)(data + header->dataOffset);
+	return file;
+}
+
+void closeShardFile(MappedShardFile* file) {
+	unmapFile(&file->region);
+	free(file->fileNames);
+	free(file);
+}
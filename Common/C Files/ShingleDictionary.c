@@ -0,0 +1,328 @@
+#ifndef _WIN32
+#define _FILE_OFFSET_BITS 64 //So dictionaries over 2 GB can be read and appended to
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "..\Header Files\ShingleDictionary.h"
+#include "..\Header Files\ShingleFile.h"
+#include "..\Header Files\Platform.h"
+#include "..\Header Files\Tokenizer.h"
+
+#define true 1
+#define false 0
+#define initialDictionarySlots 1024 //Slots in a new dictionary's lookup table, which doubles whenever it becomes half full
+#define maxDictionaryShingles 0xFFFFFFFEU //Every id, plus one, must fit in a slot
+#define listDelimiters ",\r\n" //A hand-written .csv file may end in a newline, which must not become part of a shingle
+
+void readShingleDictionary(ShingleDictionary* dictionary, FILE* file); /** Sub-function of openShingleDictionary, loads every shingle of the file **/
+uint32_t internShingle(ShingleDictionary* dictionary, const char* shingle, size_t length, uint32_t hash); /** Returns the id of the shingle, adding it if it is new **/
+	uint32_t* findDictionarySlot(ShingleDictionary* dictionary, const char* shingle, size_t length, uint32_t hash); /** Sub-function of internShingle, returns the slot holding the shingle's id, or the empty one it would go in **/
+	void growDictionarySlots(ShingleDictionary* dictionary); /** Sub-function of internShingle, doubles the number of slots, re-inserting every id **/
+	void reserveDictionaryIds(ShingleDictionary* dictionary, uint64_t textNeeded); /** Sub-function of internShingle, makes room for one more id and textNeeded more bytes of text **/
+uint32_t hashDictionaryShingle(const char* shingle, size_t length);
+uint64_t newDictionaryIdentity(const char* fileName); /** Sub-function of openShingleDictionary, a random identity for a new dictionary **/
+int compareShingleIds(const void* a, const void* b); /** Sub-function of internShingleList, qsort() comparator for uint32_t ids **/
+
+/**
+ * Opens the dictionary in fileName, or starts an empty one if there is no such file; it is only written by
+ * saveShingleDictionary(). Unlike a signature cache, a damaged dictionary cannot just be rebuilt, since the ids in
+ * shingle files already written refer to it, so it is an error.
+ */
+ShingleDictionary* openShingleDictionary(const char* fileName) { /** Loads the dictionary, or starts an empty one if the file does not exist yet **/
+	ShingleDictionary* dictionary = calloc(1, sizeof(ShingleDictionary));
+	FILE* file = NULL;
+	
+	if(dictionary == NULL) {
+		printf("\nERROR: Unable to allocate memory for the shingle dictionary!\n");
+		exit(1);
+	}
+	dictionary->fileName = malloc(strlen(fileName) + 1);
+	dictionary->slotCapacity = initialDictionarySlots;
+	dictionary->slots = calloc(dictionary->slotCapacity, sizeof(uint32_t));
+	dictionary->offsets = malloc(sizeof(uint64_t));
+	if(dictionary->fileName == NULL || dictionary->slots == NULL || dictionary->offsets == NULL) {
+		printf("\nERROR: Unable to allocate memory for the shingle dictionary!\n");
+		exit(1);
+	}
+	strcpy(dictionary->fileName, fileName);
+	dictionary->offsets[0] = 0;
+	pthread_mutex_init(&dictionary->lock, NULL);
+	
+	file = fopen(fileName, "rb");
+	if(file != NULL) {
+		readShingleDictionary(dictionary, file);
+		fclose(file);
+	} else {
+		dictionary->identity = newDictionaryIdentity(fileName);
+	}
+	dictionary->savedCount = dictionary->count;
+	dictionary->savedLength = dictionary->textLength;
+	return dictionary;
+}
+
+void readShingleDictionary(ShingleDictionary* dictionary, FILE* file) { /** Sub-function of openShingleDictionary, loads every shingle of the file **/
+	ShingleDictionaryHeader header;
+	char* text = NULL;
+	uint64_t start = 0;
+	
+	if(fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, SHINGLE_DICTIONARY_MAGIC, sizeof(header.magic)) != 0 || header.version != SHINGLE_DICTIONARY_VERSION) {
+		printf("\nERROR: File \"%s\" is not a version %d shingle dictionary!\n", dictionary->fileName, SHINGLE_DICTIONARY_VERSION);
+		exit(1);
+	}
+	if(header.shingleCount > maxDictionaryShingles || header.textLength > (uint64_t)SIZE_MAX - 1) {
+		printf("\nERROR: Shingle dictionary \"%s\" is too large to load!\n", dictionary->fileName);
+		exit(1);
+	}
+	dictionary->identity = header.identity;
+	
+	text = malloc((size_t)header.textLength + 1);
+	if(text == NULL) {
+		printf("\nERROR: Unable to allocate memory for the shingle dictionary!\n");
+		exit(1);
+	}
+	if(fread(text, 1, (size_t)header.textLength, file) != header.textLength) {
+		printf("\nERROR: Shingle dictionary \"%s\" is truncated!\n", dictionary->fileName);
+		exit(1);
+	}
+	for(uint64_t i = 0; i < header.textLength; i++) {
+		if(text[i] == '\n') {
+			internShingle(dictionary, text + start, (size_t)(i - start), hashDictionaryShingle(text + start, (size_t)(i - start)));
+			start = i + 1;
+		}
+	}
+	if(start != header.textLength || dictionary->count != header.shingleCount) { //A repeated shingle would have been given no id of its own
+		printf("\nERROR: Shingle dictionary \"%s\" is damaged!\n", dictionary->fileName);
+		exit(1);
+	}
+	free(text);
+}
+
+/**
+ * Interns every shingle of a document while holding the lock once, rather than once per shingle, so that threads
+ * interning different documents wait on each other as little as possible. The shingles are hashed and counted
+ * before the lock is taken, and the ids are sorted after it is released.
+ */
+uint32_t* internShingleList(ShingleDictionary* dictionary, const char* text, size_t length, uint64_t* count) { /** Returns the sorted, distinct ids of the comma-delimited shingles in text, in a new allocation, giving any new shingle the next free id **/
+	DelimiterSet delimiters;
+	Tokenizer tokenizer;
+	size_t start = 0, shingleLength = 0;
+	uint64_t shingleCount = 0, unique = 0, s = 0;
+	
+	initDelimiterSet(&delimiters, listDelimiters);
+	shingleCount = countTokens(&delimiters, text, length);
+	uint32_t* ids = malloc((shingleCount > 0 ? shingleCount : 1) * sizeof(uint32_t)); //Each shingle's hash, until it is replaced by its id
+	if(ids == NULL) {
+		printf("\nERROR: Unable to allocate memory for the shingle ids!\n");
+		exit(1);
+	}
+	beginTokens(&tokenizer, &delimiters, text, length);
+	while(nextToken(&tokenizer, &start, &shingleLength) == true) {
+		ids[s++] = hashDictionaryShingle(text + start, shingleLength);
+	}
+	
+	pthread_mutex_lock(&dictionary->lock);
+	s = 0;
+	beginTokens(&tokenizer, &delimiters, text, length);
+	while(nextToken(&tokenizer, &start, &shingleLength) == true) {
+		ids[s] = internShingle(dictionary, text + start, shingleLength, ids[s]);
+		s++;
+	}
+	pthread_mutex_unlock(&dictionary->lock);
+	
+	qsort(ids, shingleCount, sizeof(uint32_t), compareShingleIds);
+	for(s = 0; s < shingleCount; s++) { //Once sorted, repeated shingles are adjacent, so only the first of each run needs to be kept
+		if(unique == 0 || ids[s] != ids[unique - 1]) {
+			ids[unique++] = ids[s];
+		}
+	}
+	*count = unique;
+	return ids;
+}
+
+uint32_t internShingle(ShingleDictionary* dictionary, const char* shingle, size_t length, uint32_t hash) { /** Returns the id of the shingle, adding it if it is new **/
+	uint32_t* slot = findDictionarySlot(dictionary, shingle, length, hash);
+	if(*slot != 0) {
+		return *slot - 1;
+	}
+	if(dictionary->count == maxDictionaryShingles) {
+		printf("\nERROR: Shingle dictionary \"%s\" is full!\n", dictionary->fileName);
+		exit(1);
+	}
+	
+	uint32_t id = dictionary->count;
+	reserveDictionaryIds(dictionary, (uint64_t)length + 1);
+	memcpy(dictionary->text + dictionary->textLength, shingle, length);
+	dictionary->textLength += (uint64_t)length;
+	dictionary->text[dictionary->textLength++] = '\n';
+	dictionary->hashes[id] = hash;
+	dictionary->offsets[id + 1] = dictionary->textLength;
+	dictionary->count++;
+	*slot = id + 1;
+	if(dictionary->count * 2ULL > dictionary->slotCapacity) {
+		growDictionarySlots(dictionary);
+	}
+	return id;
+}
+
+uint32_t* findDictionarySlot(ShingleDictionary* dictionary, const char* shingle, size_t length, uint32_t hash) { /** Sub-function of internShingle, returns the slot holding the shingle's id, or the empty one it would go in **/
+	uint32_t mask = dictionary->slotCapacity - 1;
+	uint32_t slot = hash & mask;
+	
+	while(dictionary->slots[slot] != 0) { //Linear probing, as in the signature cache
+		uint32_t id = dictionary->slots[slot] - 1;
+		uint64_t start = dictionary->offsets[id];
+		if(dictionary->hashes[id] == hash && dictionary->offsets[id + 1] - start - 1 == (uint64_t)length && memcmp(dictionary->text + start, shingle, length) == 0) {
+			break;
+		}
+		slot = (slot + 1) & mask;
+	}
+	return &dictionary->slots[slot];
+}
+
+void growDictionarySlots(ShingleDictionary* dictionary) { /** Sub-function of internShingle, doubles the number of slots, re-inserting every id **/
+	uint32_t id;
+	
+	if(dictionary->slotCapacity >= 0x80000000U) {
+		printf("\nERROR: Shingle dictionary \"%s\" is full!\n", dictionary->fileName);
+		exit(1);
+	}
+	dictionary->slotCapacity *= 2;
+	free(dictionary->slots);
+	dictionary->slots = calloc(dictionary->slotCapacity, sizeof(uint32_t));
+	if(dictionary->slots == NULL) {
+		printf("\nERROR: Unable to re-allocate memory for the shingle dictionary!\n");
+		exit(1);
+	}
+	for(id = 0; id < dictionary->count; id++) { //Every id is distinct, so each only needs an empty slot
+		uint32_t mask = dictionary->slotCapacity - 1;
+		uint32_t slot = dictionary->hashes[id] & mask;
+		while(dictionary->slots[slot] != 0) {
+			slot = (slot + 1) & mask;
+		}
+		dictionary->slots[slot] = id + 1;
+	}
+}
+
+void reserveDictionaryIds(ShingleDictionary* dictionary, uint64_t textNeeded) { /** Sub-function of internShingle, makes room for one more id and textNeeded more bytes of text **/
+	if(dictionary->count == dictionary->capacity) {
+		uint64_t capacity = (dictionary->capacity > 0) ? dictionary->capacity * 2ULL : 1024;
+		if(capacity > maxDictionaryShingles) {
+			capacity = maxDictionaryShingles;
+		}
+		dictionary->hashes = realloc(dictionary->hashes, (size_t)capacity * sizeof(uint32_t));
+		dictionary->offsets = realloc(dictionary->offsets, ((size_t)capacity + 1) * sizeof(uint64_t));
+		if(dictionary->hashes == NULL || dictionary->offsets == NULL) {
+			printf("\nERROR: Unable to re-allocate memory for the shingle dictionary!\n");
+			exit(1);
+		}
+		dictionary->capacity = (uint32_t)capacity;
+	}
+	if(dictionary->textLength + textNeeded > dictionary->textCapacity) {
+		uint64_t capacity = (dictionary->textCapacity > 0) ? dictionary->textCapacity * 2 : 65536;
+		while(capacity < dictionary->textLength + textNeeded) {
+			capacity *= 2;
+		}
+		dictionary->text = realloc(dictionary->text, (size_t)capacity);
+		if(dictionary->text == NULL) {
+			printf("\nERROR: Unable to re-allocate memory for the shingle dictionary!\n");
+			exit(1);
+		}
+		dictionary->textCapacity = capacity;
+	}
+}
+
+uint32_t hashDictionaryShingle(const char* shingle, size_t length) {
+	return (uint32_t)hashShingleBytes(shingle, length, HASH_XXH64);
+}
+
+/**
+ * The identity only has to differ between dictionaries, not be unpredictable, so it is the hash of whatever differs
+ * between the runs that create them: the time, the processor time used, where the stack is, and the file's name.
+ */
+uint64_t newDictionaryIdentity(const char* fileName) { /** Sub-function of openShingleDictionary, a random identity for a new dictionary **/
+	struct {
+		uint64_t wallTime;
+		uint64_t processorTime;
+		uint64_t stackAddress;
+		uint64_t nameHash;
+	} entropy;
+	
+	entropy.wallTime = (uint64_t)time(NULL);
+	entropy.processorTime = (uint64_t)clock();
+	entropy.stackAddress = (uint64_t)(uintptr_t)&entropy; //Differs between runs wherever addresses are randomized
+	entropy.nameHash = hashShingleBytes(fileName, strlen(fileName), HASH_XXH64);
+	return hashShingleBytes((const char*)&entropy, sizeof(entropy), HASH_XXH64);
+}
+
+int compareShingleIds(const void* a, const void* b) { /** Sub-function of internShingleList, qsort() comparator for uint32_t ids **/
+	uint32_t left = *((const uint32_t*)a);
+	uint32_t right = *((const uint32_t*)b);
+	return (left > right) - (left < right);
+}
+
+/**
+ * The new text is written before the header that counts it, so a run that stops part way through leaves the file
+ * as it was: the header still describes the text from before, and whatever follows it is overwritten next time.
+ * Takes the lock, so a thread can save the ids it has just interned while others go on interning theirs.
+ */
+uint32_t saveShingleDictionary(ShingleDictionary* dictionary) { /** Appends the shingles interned since the file was last saved, then updates its header; returns how many shingles are now saved **/
+	ShingleDictionaryHeader header;
+	FILE* file = NULL;
+	uint32_t savedCount = 0;
+	
+	pthread_mutex_lock(&dictionary->lock);
+	if(dictionary->count == dictionary->savedCount && dictionary->savedLength > 0) { //Nothing new to write
+		savedCount = dictionary->savedCount;
+		pthread_mutex_unlock(&dictionary->lock);
+		return savedCount;
+	}
+	file = fopen(dictionary->fileName, "r+b");
+	if(file == NULL) {
+		file = fopen(dictionary->fileName, "w+b");
+	}
+	if(file == NULL) {
+		printf("\nERROR: File \"%s\" could not be opened for writing!\n", dictionary->fileName);
+		exit(1);
+	}
+	
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SHINGLE_DICTIONARY_MAGIC, sizeof(header.magic));
+	header.version = SHINGLE_DICTIONARY_VERSION;
+	header.identity = dictionary->identity;
+	header.shingleCount = dictionary->savedCount;
+	header.textLength = dictionary->savedLength;
+	if(dictionary->savedLength == 0 && fwrite(&header, sizeof(header), 1, file) != 1) { //A new file
+		printf("\nERROR: The header could not be written to file \"%s\"!\n", dictionary->fileName);
+		exit(1);
+	}
+	
+	uint64_t newLength = dictionary->textLength - dictionary->savedLength;
+	if(seekFile(file, sizeof(header) + dictionary->savedLength) != 0 || fwrite(dictionary->text + dictionary->savedLength, 1, (size_t)newLength, file) != newLength || fflush(file) != 0) {
+		printf("\nERROR: Not all of the new shingles were written to dictionary \"%s\"!\n", dictionary->fileName);
+		exit(1);
+	}
+	header.shingleCount = dictionary->count;
+	header.textLength = dictionary->textLength;
+	if(seekFile(file, 0) != 0 || fwrite(&header, sizeof(header), 1, file) != 1 || fclose(file) != 0) {
+		printf("\nERROR: The header could not be written to file \"%s\"!\n", dictionary->fileName);
+		exit(1);
+	}
+	dictionary->savedCount = dictionary->count;
+	dictionary->savedLength = dictionary->textLength;
+	savedCount = dictionary->savedCount;
+	pthread_mutex_unlock(&dictionary->lock);
+	return savedCount;
+}
+
+void closeShingleDictionary(ShingleDictionary* dictionary) {
+	pthread_mutex_destroy(&dictionary->lock);
+	free(dictionary->text);
+	free(dictionary->offsets);
+	free(dictionary->hashes);
+	free(dictionary->slots);
+	free(dictionary->fileName);
+	free(dictionary);
+}
@@ -0,0 +1,426 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "..\Header Files\ShingleFile.h"
+
+#define true 1
+#define false 0
+#define legacyTableSize 104729L
+
+#define xxh64Prime1 0x9E3779B185EBCA87ULL
+#define xxh64Prime2 0xC2B2AE3D27D4EB4FULL
+#define xxh64Prime3 0x165667B19E3779F9ULL
+#define xxh64Prime4 0x85EBCA77C2B2AE63ULL
+#define xxh64Prime5 0x27D4EB2F165667C5ULL
+
+uint64_t hashXxh64(const unsigned char* input, size_t length);
+	uint64_t xxh64Round(uint64_t lane, uint64_t input); /** Sub-function of hashXxh64, mixes 8 bytes of input into one lane **/
+	uint64_t rotateLeft64(uint64_t value, int bits);
+	uint64_t readUnaligned64(const unsigned char* bytes); /** memcpy() compiles to a single load, without needing bytes to be aligned. XXH64 is specified little-endian, which every target of this code is **/
+int compareHashValues(const void* a, const void* b); /** Sub-function of sortUniqueHashes, qsort() comparator for uint64_t values **/
+
+uint64_t hashShingleText(const char* text, uint32_t hashAlgorithm) { /** Hashes a null-terminated shingle **/
+	return hashShingleBytes(text, strlen(text), hashAlgorithm);
+}
+
+/**
+ * Hashes the text of one shingle with the given algorithm. Every algorithm gives the same value for a shingle
+ * whether it is hashed from its .csv text or straight from the buffer it was formed in; for HASH_ROLLING, the words
+ * are split apart again at the spaces between them, so a .csv shingle hashes exactly as the rolling window did.
+ */
+uint64_t hashShingleBytes(const char* text, size_t length, uint32_t hashAlgorithm) { /** Hashes a shingle of the given length, which need not be null-terminated **/
+	if(hashAlgorithm == HASH_XXH64) {
+		return hashXxh64((const unsigned char*)text, length);
+	} else if(hashAlgorithm == HASH_LEGACY) {
+		int h = 0, a = 31;
+		size_t i;
+		for(i = 0; i < length; i++) {
+			h = (a * h + text[i]) % legacyTableSize;
+		}
+		return (uint64_t)h;
+	} else if(hashAlgorithm == HASH_ROLLING) {
+		uint64_t polynomial = 0;
+		size_t start = 0;
+		for(size_t i = 0; i <= length; i++) {
+			if(i == length || text[i] == ' ') {
+				polynomial = addModRolling(multiplyModRolling(polynomial, ROLLING_BASE), rollingWordTerm(text + start, i - start));
+				start = i + 1;
+			}
+		}
+		return finishRollingHash(polynomial);
+	}
+	
+	printf("\nERROR: Unknown hash algorithm %u!\n", (unsigned int)hashAlgorithm);
+	exit(1);
+}
+
+int parseHashAlgorithm(const char* name) { /** Returns the HASH_ constant with the given name, or -1 if there is none **/
+	if(strcmp(name, "legacy") == 0) {
+		return HASH_LEGACY;
+	} else if(strcmp(name, "xxh64") == 0) {
+		return HASH_XXH64;
+	} else if(strcmp(name, "rolling") == 0) {
+		return HASH_ROLLING;
+	}
+	return -1;
+}
+
+const char* hashAlgorithmName(uint32_t hashAlgorithm) {
+	if(hashAlgorithm == HASH_LEGACY) {
+		return "legacy";
+	} else if(hashAlgorithm == HASH_XXH64) {
+		return "xxh64";
+	} else if(hashAlgorithm == HASH_ROLLING) {
+		return "rolling";
+	} else if(hashAlgorithm == HASH_DICTIONARY) {
+		return "dictionary";
+	}
+	return "unknown";
+}
+
+uint64_t hashUniverseSize(uint32_t hashAlgorithm) { /** Number of distinct values the algorithm can produce, or 0 if it can produce any 64-bit value **/
+	if(hashAlgorithm == HASH_LEGACY) {
+		return (uint64_t)legacyTableSize;
+	}
+	return 0;
+}
+
+size_t shingleValueSize(uint32_t hashAlgorithm) { /** Bytes each value takes in a shingle file: 4 for the ids of HASH_DICTIONARY, otherwise 8 **/
+	return (hashAlgorithm == HASH_DICTIONARY) ? sizeof(uint32_t) : sizeof(uint64_t);
+}
+
+uint64_t rollingWordTerm(const char* word, size_t length) { /** A word's term in a HASH_ROLLING polynomial **/
+	return reduceModRolling(hashXxh64((const unsigned char*)word, length));
+}
+
+/**
+ * Multiplies in 32-bit halves, so no 128-bit type is needed. With a and b below 2^61, the high halves are below 2^29,
+ * and since 2^61 = 1 modulo 2^61 - 1, bits at 2^64 and above fold back in at 2^3 and up, and bits at 2^61 at 2^0.
+ */
+uint64_t multiplyModRolling(uint64_t a, uint64_t b) { /** (a * b) modulo ROLLING_MODULUS, for a and b below it **/
+	uint64_t aHigh = a >> 32, aLow = a & 0xFFFFFFFFULL;
+	uint64_t bHigh = b >> 32, bLow = b & 0xFFFFFFFFULL;
+	uint64_t middle = aHigh * bLow + aLow * bHigh; //Below 2^62, and worth middle * 2^32
+	uint64_t sum = ((aHigh * bHigh) << 3) + (middle >> 29) + ((middle & 0x1FFFFFFFULL) << 32) + reduceModRolling(aLow * bLow);
+	return reduceModRolling(sum);
+}
+
+/**
+ * The MurmurHash3 finalizer. It is a bijection, so distinct polynomials stay distinct, but it spreads them over the
+ * whole 64-bit range that MinHash and the LSH bands expect, rather than the 61 bits below ROLLING_MODULUS.
+ */
+uint64_t finishRollingHash(uint64_t polynomial) { /** Spreads a window's polynomial over all 64 bits, giving the shingle's hash **/
+	polynomial ^= polynomial >> 33;
+	polynomial *= 0xFF51AFD7ED558CCDULL;
+	polynomial ^= polynomial >> 33;
+	polynomial *= 0xC4CEB9FE1A85EC53ULL;
+	polynomial ^= polynomial >> 33;
+	return polynomial;
+}
+
+uint64_t reduceModRolling(uint64_t value) { /** value modulo ROLLING_MODULUS, with no division **/
+	value = (value & ROLLING_MODULUS) + (value >> 61);
+	return (value >= ROLLING_MODULUS) ? value - ROLLING_MODULUS : value;
+}
+
+uint64_t addModRolling(uint64_t a, uint64_t b) { /** (a + b) modulo ROLLING_MODULUS, for a and b below it **/
+	uint64_t sum = a + b;
+	return (sum >= ROLLING_MODULUS) ? sum - ROLLING_MODULUS : sum;
+}
+
+uint64_t subtractModRolling(uint64_t a, uint64_t b) { /** (a - b) modulo ROLLING_MODULUS, for a and b below it **/
+	return (a >= b) ? a - b : a + ROLLING_MODULUS - b;
+}
+
+/**
+ * XXH64 (seed 0), as specified at https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md.
+ * Input is consumed 32 bytes at a time across four lanes, then 8, 4 and 1 bytes at a time; every
+ * step is a multiply and rotate, so there is no division anywhere in the loop.
+ */
+uint64_t hashXxh64(const unsigned char* input, size_t length) {
+	const unsigned char* end = input + length;
+	uint64_t h;
+	
+	if(length >= 32) {
+		uint64_t lane1 = xxh64Prime1 + xxh64Prime2;
+		uint64_t lane2 = xxh64Prime2;
+		uint64_t lane3 = 0;
+		uint64_t lane4 = 0 - xxh64Prime1;
+		const unsigned char* limit = end - 32;
+		do {
+			lane1 = xxh64Round(lane1, readUnaligned64(input));
+			lane2 = xxh64Round(lane2, readUnaligned64(input + 8));
+			lane3 = xxh64Round(lane3, readUnaligned64(input + 16));
+			lane4 = xxh64Round(lane4, readUnaligned64(input + 24));
+			input += 32;
+		} while(input <= limit);
+		
+		h = rotateLeft64(lane1, 1) + rotateLeft64(lane2, 7) + rotateLeft64(lane3, 12) + rotateLeft64(lane4, 18);
+		h = (h ^ xxh64Round(0, lane1)) * xxh64Prime1 + xxh64Prime4;
+		h = (h ^ xxh64Round(0, lane2)) * xxh64Prime1 + xxh64Prime4;
+		h = (h ^ xxh64Round(0, lane3)) * xxh64Prime1 + xxh64Prime4;
+		h = (h ^ xxh64Round(0, lane4)) * xxh64Prime1 + xxh64Prime4;
+	} else {
+		h = xxh64Prime5;
+	}
+	h += (uint64_t)length;
+	
+	while(input + 8 <= end) {
+		h ^= xxh64Round(0, readUnaligned64(input));
+		h = rotateLeft64(h, 27) * xxh64Prime1 + xxh64Prime4;
+		input += 8;
+	}
+	if(input + 4 <= end) {
+		uint32_t word;
+		memcpy(&word, input, 4);
+		h ^= (uint64_t)word * xxh64Prime1;
+		h = rotateLeft64(h, 23) * xxh64Prime2 + xxh64Prime3;
+		input += 4;
+	}
+	while(input < end) {
+		h ^= (uint64_t)(*input) * xxh64Prime5;
+		h = rotateLeft64(h, 11) * xxh64Prime1;
+		input++;
+	}
+	
+	h ^= h >> 33; //Avalanche, so that every input bit affects every output bit
+	h *= xxh64Prime2;
+	h ^= h >> 29;
+	h *= xxh64Prime3;
+	h ^= h >> 32;
+	return h;
+}
+
+uint64_t xxh64Round(uint64_t lane, uint64_t input) { /** Sub-function of hashXxh64, mixes 8 bytes of input into one lane **/
+	lane += input * xxh64Prime2;
+	lane = rotateLeft64(lane, 31);
+	return lane * xxh64Prime1;
+}
+
+uint64_t rotateLeft64(uint64_t value, int bits) {
+	return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t readUnaligned64(const unsigned char* bytes) { /** memcpy() compiles to a single load, without needing bytes to be aligned. XXH64 is specified little-endian, which every target of this code is **/
+	uint64_t value;
+	memcpy(&value, bytes, sizeof(value));
+	return value;
+}
+
+int isShingleFile(const char* fileName) { /** Returns true if fileName begins with SHINGLE_FILE_MAGIC **/
+	char magic[8];
+	FILE* file = fopen(fileName, "rb");
+	int matches = false;
+	
+	if(file == NULL) {
+		return false;
+	}
+	if(fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, SHINGLE_FILE_MAGIC, sizeof(magic)) == 0) {
+		matches = true;
+	}
+	fclose(file);
+	return matches;
+}
+
+/**
+ * The comma-delimited format does not store the shingle size, so it is inferred the same way shingle -convert does:
+ * by counting the words of the first shingle. Only the first shingle is read.
+ */
+uint32_t csvShingleSize(const char* fileName) { /** Words in the first shingle of a comma-delimited shingle file, or 0 if it is empty **/
+	FILE* file = fopen(fileName, "rb");
+	uint32_t shingleSize = 0;
+	int character;
+	
+	if(file == NULL) {
+		return 0;
+	}
+	while((character = fgetc(file)) != EOF && character != ',') {
+		if(shingleSize == 0) {
+			shingleSize = 1;
+		}
+		if(character == ' ') { //Each space within the first shingle separates two words
+			shingleSize++;
+		}
+	}
+	fclose(file);
+	return shingleSize;
+}
+
+/**
+ * Writes a header and the given hashes, which must already be sorted and free of duplicates (see sortUniqueHashes()).
+ */
+void writeShingleFile(const char* fileName, const uint64_t* hashes, uint64_t count, uint32_t shingleSize, uint32_t shingleUnit, uint32_t hashAlgorithm) {
+	FILE* outputFile = beginShingleFile(fileName, shingleSize, shingleUnit, hashAlgorithm);
+	
+	if(fwrite(hashes, sizeof(uint64_t), count, outputFile) != count) {
+		printf("\nERROR: Not all of the shingle hashes were written to file \"%s\"!\n", fileName);
+		fclose(outputFile);
+		exit(1);
+	}
+	finishShingleFile(outputFile, fileName, count);
+}
+
+/**
+ * Writes the ids of a document's shingles in a ShingleDictionary, which must already be sorted and free of duplicates
+ * (see internShingleList()), and already saved in the dictionary the stamp names.
+ */
+void writeShingleIdFile(const char* fileName, const uint32_t* ids, uint64_t count, uint32_t shingleSize, const DictionaryStamp* stamp) { /** Writes a HASH_DICTIONARY file of sorted, distinct ids **/
+	FILE* outputFile = beginShingleFile(fileName, shingleSize, SHINGLE_WORDS, HASH_DICTIONARY);
+	
+	if(fwrite(stamp, sizeof(DictionaryStamp), 1, outputFile) != 1) {
+		printf("\nERROR: The dictionary stamp could not be written to file \"%s\"!\n", fileName);
+		fclose(outputFile);
+		exit(1);
+	}
+	if(fwrite(ids, sizeof(uint32_t), count, outputFile) != count) {
+		printf("\nERROR: Not all of the shingle ids were written to file \"%s\"!\n", fileName);
+		fclose(outputFile);
+		exit(1);
+	}
+	finishShingleFile(outputFile, fileName, count);
+}
+
+/**
+ * For writers that do not know how many hashes there will be until they are done (see shingle's -stream mode).
+ * The hashes written between the two calls must be sorted and free of duplicates.
+ */
+FILE* beginShingleFile(const char* fileName, uint32_t shingleSize, uint32_t shingleUnit, uint32_t hashAlgorithm) { /** Writes a header with a count of 0; the caller then fwrite()s the hashes **/
+	ShingleFileHeader header;
+	FILE* outputFile = NULL;
+	
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SHINGLE_FILE_MAGIC, sizeof(header.magic));
+	header.version = SHINGLE_FILE_VERSION;
+	header.shingleSize = shingleSize;
+	header.shingleUnit = shingleUnit;
+	header.hashAlgorithm = hashAlgorithm;
+	header.count = 0;
+	
+	outputFile = fopen(fileName, "wb");
+	if(outputFile == NULL) {
+		printf("\nERROR: File \"%s\" could not be opened for writing!\n", fileName);
+		exit(1);
+	}
+	if(fwrite(&header, sizeof(header), 1, outputFile) != 1) {
+		printf("\nERROR: The header could not be written to file \"%s\"!\n", fileName);
+		fclose(outputFile);
+		exit(1);
+	}
+	return outputFile;
+}
+
+void finishShingleFile(FILE* outputFile, const char* fileName, uint64_t count) { /** Fills in the final count in the header, and closes the file **/
+	if(fseek(outputFile, (long)offsetof(ShingleFileHeader, count), SEEK_SET) != 0 || fwrite(&count, sizeof(count), 1, outputFile) != 1) {
+		printf("\nERROR: The shingle count could not be written to file \"%s\"!\n", fileName);
+		fclose(outputFile);
+		exit(1);
+	}
+	fclose(outputFile);
+}
+
+/**
+ * Maps a shingle file read-only and checks its header. The hashes are used in place, without being copied.
+ */
+void readShingleFileHeader(const char* fileName, ShingleFileHeader* header) { /** Reads and checks the header alone, without mapping the file **/
+	FILE* file = fopen(fileName, "rb");
+	if(file == NULL) {
+		printf("\nERROR: File \"%s\" not found!\n", fileName);
+		exit(1);
+	}
+	
+	size_t headerRead = fread(header, sizeof(ShingleFileHeader), 1, file);
+	fclose(file);
+	if(headerRead != 1 || memcmp(header->magic, SHINGLE_FILE_MAGIC, sizeof(header->magic)) != 0 || header->version != SHINGLE_FILE_VERSION) {
+		printf("\nERROR: File \"%s\" is not a version %d shingle file!\n", fileName, SHINGLE_FILE_VERSION);
+		exit(1);
+	}
+}
+
+void readDictionaryStamp(const char* fileName, uint64_t count, DictionaryStamp* stamp) { /** Reads the stamp of a HASH_DICTIONARY file holding count ids, and checks its last id against it **/
+	FILE* file = fopen(fileName, "rb");
+	uint32_t lastId = 0;
+	
+	if(file == NULL) {
+		printf("\nERROR: File \"%s\" not found!\n", fileName);
+		exit(1);
+	}
+	if(seekFile(file, sizeof(ShingleFileHeader)) != 0 || fread(stamp, sizeof(DictionaryStamp), 1, file) != 1
+			|| (count > 0 && (seekFile(file, shingleValuesOffset(HASH_DICTIONARY) + (count - 1) * sizeof(uint32_t)) != 0 || fread(&lastId, sizeof(uint32_t), 1, file) != 1))) {
+		printf("\nERROR: Shingle file \"%s\" is truncated!\n", fileName);
+		exit(1);
+	}
+	fclose(file);
+	if(count > 0 && lastId >= stamp->dictionaryCount) { //The ids are sorted, so the last is the largest
+		printf("\nERROR: Shingle file \"%s\" holds ids its dictionary never saved!\n", fileName);
+		exit(1);
+	}
+}
+
+uint64_t shingleValuesOffset(uint32_t hashAlgorithm) { /** Where the hashes (or ids) start in a shingle file **/
+	return sizeof(ShingleFileHeader) + ((hashAlgorithm == HASH_DICTIONARY) ? sizeof(DictionaryStamp) : 0);
+}
+
+MappedShingleFile* openShingleFile(const char* fileName) {
+	MappedShingleFile* file = calloc(1, sizeof(MappedShingleFile));
+	if(file == NULL) {
+		printf("\nERROR: Unable to allocate memory for shingle file \"%s\"!\n", fileName);
+		exit(1);
+	}
+	
+	int status = mapFileReadOnly(fileName, sizeof(ShingleFileHeader), &file->region);
+	if(status == -1) {
+		printf("\nERROR: File \"%s\" not found!\n", fileName);
+		exit(1);
+	} else if(status != 0) {
+		printf("\nERROR: File \"%s\" is too short or could not be mapped into memory!\n", fileName);
+		exit(1);
+	}
+	
+	file->header = file->region.data;
+	file->count = file->header->count;
+	if(memcmp(file->header->magic, SHINGLE_FILE_MAGIC, sizeof(file->header->magic)) != 0 || file->header->version != SHINGLE_FILE_VERSION) {
+		printf("\nERROR: File \"%s\" is not a version %d shingle file!\n", fileName, SHINGLE_FILE_VERSION);
+		exit(1);
+	}
+	uint64_t valuesOffset = shingleValuesOffset(file->header->hashAlgorithm);
+	if(file->region.length < valuesOffset || file->count > (file->region.length - valuesOffset) / shingleValueSize(file->header->hashAlgorithm)) {
+		printf("\nERROR: Shingle file \"%s\" is truncated!\n", fileName);
+		exit(1);
+	}
+	if(file->header->hashAlgorithm == HASH_DICTIONARY) {
+		file->stamp = (const DictionaryStamp*)((const char*)file->region.data + sizeof(ShingleFileHeader));
+		file->ids = (const uint32_t*)((const char*)file->region.data + valuesOffset);
+		if(file->count > 0 && file->ids[file->count - 1] >= file->stamp->dictionaryCount) { //The ids are sorted, so the last is the largest
+			printf("\nERROR: Shingle file \"%s\" holds ids its dictionary never saved!\n", fileName);
+			exit(1);
+		}
+	} else {
+		file->hashes = (const uint64_t*)((const char*)file->region.data + valuesOffset);
+	}
+	
+	return file;
+}
+
+void closeShingleFile(MappedShingleFile* file) {
+	unmapFile(&file->region);
+	free(file);
+}
+
+uint64_t sortUniqueHashes(uint64_t* hashes, uint64_t count) { /** Sorts hashes in place, removes duplicates, and returns the new count **/
+	uint64_t unique = 0;
+	
+	qsort(hashes, count, sizeof(uint64_t), compareHashValues);
+	for(uint64_t i = 0; i < count; i++) { //Once sorted, duplicates are adjacent, so only the first of each run needs to be kept
+		if(unique == 0 || hashes[i] != hashes[unique - 1]) {
+			hashes[unique++] = hashes[i];
+		}
+	}
+	return unique;
+}
+
+int compareHashValues(const void* a, const void* b) { /** Sub-function of sortUniqueHashes, qsort() comparator for uint64_t values **/
+	uint64_t left = *((const uint64_t*)a);
+	uint64_t right = *((const uint64_t*)b);
+	return (left > right) - (left < right);
+}
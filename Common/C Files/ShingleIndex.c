@@ -0,0 +1,340 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "..\Header Files\ShingleIndex.h"
+
+#define true 1
+#define false 0
+
+/**
+ * The next unread hash of one document, while writeShingleIndex() merges every document's set in hash order:
+ */
+typedef struct {
+	uint64_t hash;
+	uint32_t document;
+	uint32_t position; //Index of hash within the document's set
+} MergeHead;
+
+void siftDownMergeHeads(MergeHead* heads, int headCount, int slot); /** Sub-function of writeShingleIndex, restores the heap order below slot **/
+	int isBeforeMergeHead(const MergeHead* a, const MergeHead* b); /** Sub-function of siftDownMergeHeads, orders heads by hash, then by document **/
+void writeIndexArray(FILE* outputFile, const char* fileName, const void* data, size_t elementSize, uint64_t count); /** Sub-function of writeShingleIndex, exits if the array cannot be written in full **/
+void siftDownMatches(IndexMatch* matches, int matchCount, int slot); /** Sub-function of keepTopMatch, restores the heap order below slot, keeping the worst match at the top **/
+	int isWorseMatch(const IndexMatch* a, const IndexMatch* b); /** Sub-function of keepTopMatch, orders matches by similarity, then prefers the lower document number **/
+int compareMatches(const void* a, const void* b); /** Sub-function of sortTopMatches, qsort() comparator putting the best match first **/
+
+/**
+ * Builds an inverted index of the given sets and writes it to fileName. Every set is already sorted, so the postings
+ * are produced in order by merging all of the sets at once through a heap of each set's next hash, with no sorting
+ * and nothing held in memory but the index itself. The documents are numbered in the order they are given.
+ */
+void writeShingleIndex(const char* fileName, int documentCount, const uint64_t* const* sets, const int* setSizes, const char* const* names, uint32_t hashAlgorithm) { /** Each set must be sorted and free of duplicates **/
+	ShingleIndexHeader header;
+	MergeHead* heads = malloc((documentCount > 0 ? documentCount : 1) * sizeof(MergeHead));
+	uint64_t* nameOffsets = malloc((documentCount > 0 ? documentCount : 1) * sizeof(uint64_t));
+	uint32_t* sizes = malloc((documentCount > 0 ? documentCount : 1) * sizeof(uint32_t));
+	uint64_t* terms = NULL;
+	uint64_t* postingStarts = NULL;
+	uint32_t* postings = NULL;
+	uint64_t termCapacity = 1024;
+	uint64_t postingCount = 0;
+	int headCount = 0;
+	int d;
+	
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SHINGLE_INDEX_MAGIC, sizeof(header.magic));
+	header.version = SHINGLE_INDEX_VERSION;
+	header.hashAlgorithm = hashAlgorithm;
+	header.documentCount = (uint64_t)documentCount;
+	for(d = 0; d < documentCount; d++) {
+		nameOffsets[d] = header.namesLength;
+		header.namesLength += strlen(names[d]) + 1;
+		sizes[d] = (uint32_t)setSizes[d];
+		header.postingCount += (uint64_t)setSizes[d];
+		if(setSizes[d] > 0) {
+			heads[headCount].hash = sets[d][0];
+			heads[headCount].document = (uint32_t)d;
+			heads[headCount].position = 0;
+			headCount++;
+		}
+	}
+	terms = malloc(termCapacity * sizeof(uint64_t));
+	postingStarts = malloc((termCapacity + 1) * sizeof(uint64_t));
+	postings = malloc((header.postingCount > 0 ? header.postingCount : 1) * sizeof(uint32_t));
+	if(heads == NULL || nameOffsets == NULL || sizes == NULL || terms == NULL || postingStarts == NULL || postings == NULL) {
+		printf("\nERROR: Unable to allocate memory for the inverted index!\n");
+		exit(1);
+	}
+	
+	for(d = headCount / 2 - 1; d >= 0; d--) {
+		siftDownMergeHeads(heads, headCount, d);
+	}
+	while(headCount > 0) {
+		MergeHead* next = &heads[0];
+		if(header.termCount == 0 || terms[header.termCount - 1] != next->hash) { //The first posting of a new term
+			if(header.termCount == termCapacity) {
+				termCapacity *= 2;
+				terms = realloc(terms, termCapacity * sizeof(uint64_t));
+				postingStarts = realloc(postingStarts, (termCapacity + 1) * sizeof(uint64_t));
+				if(terms == NULL || postingStarts == NULL) {
+					printf("\nERROR: Unable to re-allocate memory for the inverted index!\n");
+					exit(1);
+				}
+			}
+			terms[header.termCount] = next->hash;
+			postingStarts[header.termCount] = postingCount;
+			header.termCount++;
+		}
+		postings[postingCount++] = next->document;
+		
+		if(++next->position < (uint32_t)setSizes[next->document]) { //Move on to the document's next hash, or drop it once it has none
+			next->hash = sets[next->document][next->position];
+		} else {
+			heads[0] = heads[--headCount];
+		}
+		siftDownMergeHeads(heads, headCount, 0);
+	}
+	postingStarts[header.termCount] = postingCount;
+	
+	FILE* outputFile = fopen(fileName, "wb");
+	if(outputFile == NULL) {
+		printf("\nERROR: File \"%s\" could not be opened for writing!\n", fileName);
+		exit(1);
+	}
+	writeIndexArray(outputFile, fileName, &header, sizeof(header), 1);
+	writeIndexArray(outputFile, fileName, terms, sizeof(uint64_t), header.termCount);
+	writeIndexArray(outputFile, fileName, postingStarts, sizeof(uint64_t), header.termCount + 1);
+	writeIndexArray(outputFile, fileName, nameOffsets, sizeof(uint64_t), header.documentCount);
+	writeIndexArray(outputFile, fileName, sizes, sizeof(uint32_t), header.documentCount);
+	writeIndexArray(outputFile, fileName, postings, sizeof(uint32_t), header.postingCount);
+	for(d = 0; d < documentCount; d++) {
+		writeIndexArray(outputFile, fileName, names[d], 1, strlen(names[d]) + 1);
+	}
+	if(fclose(outputFile) != 0) {
+		printf("\nERROR: Not all of the inverted index was written to file \"%s\"!\n", fileName);
+		exit(1);
+	}
+	
+	free(heads);
+	free(nameOffsets);
+	free(sizes);
+	free(terms);
+	free(postingStarts);
+	free(postings);
+}
+
+void siftDownMergeHeads(MergeHead* heads, int headCount, int slot) { /** Sub-function of writeShingleIndex, restores the heap order below slot **/
+	while(true) {
+		int smallest = slot;
+		int left = 2 * slot + 1;
+		int right = left + 1;
+		if(left < headCount && isBeforeMergeHead(&heads[left], &heads[smallest]) == true) {
+			smallest = left;
+		}
+		if(right < headCount && isBeforeMergeHead(&heads[right], &heads[smallest]) == true) {
+			smallest = right;
+		}
+		if(smallest == slot) {
+			return;
+		}
+		MergeHead swap = heads[slot];
+		heads[slot] = heads[smallest];
+		heads[smallest] = swap;
+		slot = smallest;
+	}
+}
+
+int isBeforeMergeHead(const MergeHead* a, const MergeHead* b) { /** Sub-function of siftDownMergeHeads, orders heads by hash, then by document **/
+	if(a->hash != b->hash) {
+		return (a->hash < b->hash) ? true : false;
+	}
+	return (a->document < b->document) ? true : false; //So each term's postings come out in ascending document order
+}
+
+void writeIndexArray(FILE* outputFile, const char* fileName, const void* data, size_t elementSize, uint64_t count) { /** Sub-function of writeShingleIndex, exits if the array cannot be written in full **/
+	if(count > 0 && fwrite(data, elementSize, (size_t)count, outputFile) != count) {
+		printf("\nERROR: Not all of the inverted index was written to file \"%s\"!\n", fileName);
+		fclose(outputFile);
+		exit(1);
+	}
+}
+
+/**
+ * Maps an index read-only and checks that its arrays fill the file exactly. Nothing is copied.
+ */
+MappedShingleIndex* openShingleIndex(const char* fileName) {
+	MappedShingleIndex* index = calloc(1, sizeof(MappedShingleIndex));
+	if(index == NULL) {
+		printf("\nERROR: Unable to allocate memory for inverted index \"%s\"!\n", fileName);
+		exit(1);
+	}
+	
+	int status = mapFileReadOnly(fileName, sizeof(ShingleIndexHeader), &index->region);
+	if(status == -1) {
+		printf("\nERROR: File \"%s\" not found!\n", fileName);
+		exit(1);
+	} else if(status != 0) {
+		printf("\nERROR: File \"%s\" is too short or could not be mapped into memory!\n", fileName);
+		exit(1);
+	}
+	
+	const char* data = index->region.data;
+	index->header = index->region.data;
+	if(memcmp(index->header->magic, SHINGLE_INDEX_MAGIC, sizeof(index->header->magic)) != 0 || index->header->version != SHINGLE_INDEX_VERSION) {
+		printf("\nERROR: File \"%s\" is not a version %d inverted index!\n", fileName, SHINGLE_INDEX_VERSION);
+		exit(1);
+	}
+	uint64_t termCount = index->header->termCount;
+	uint64_t documentCount = index->header->documentCount;
+	uint64_t expectedLength = sizeof(ShingleIndexHeader) + termCount * sizeof(uint64_t) + (termCount + 1) * sizeof(uint64_t) + documentCount * (sizeof(uint64_t) + sizeof(uint32_t))
+			+ index->header->postingCount * sizeof(uint32_t) + index->header->namesLength;
+	if(expectedLength != index->region.length) {
+		printf("\nERROR: Inverted index \"%s\" is truncated or damaged!\n", fileName);
+		exit(1);
+	}
+	
+	index->terms = (const uint64_t*)(data + sizeof(ShingleIndexHeader));
+	index->postingStarts = index->terms + termCount;
+	index->nameOffsets = index->postingStarts + termCount + 1;
+	index->setSizes = (const uint32_t*)(index->nameOffsets + documentCount);
+	index->postings = index->setSizes + documentCount;
+	index->names = (const char*)(index->postings + index->header->postingCount);
+	return index;
+}
+
+void closeShingleIndex(MappedShingleIndex* index) {
+	unmapFile(&index->region);
+	free(index);
+}
+
+const char* indexDocumentName(const MappedShingleIndex* index, uint32_t document) {
+	return index->names + index->nameOffsets[document];
+}
+
+IndexQuery* createIndexQuery(const MappedShingleIndex* index) {
+	uint64_t documentCount = index->header->documentCount;
+	IndexQuery* query = calloc(1, sizeof(IndexQuery));
+	if(query != NULL) {
+		query->sharedCounts = calloc(documentCount > 0 ? documentCount : 1, sizeof(uint32_t));
+		query->touched = malloc((documentCount > 0 ? documentCount : 1) * sizeof(uint32_t));
+	}
+	if(query == NULL || query->sharedCounts == NULL || query->touched == NULL) {
+		printf("\nERROR: Unable to allocate memory for an index query!\n");
+		exit(1);
+	}
+	return query;
+}
+
+void deleteIndexQuery(IndexQuery* query) {
+	free(query->sharedCounts);
+	free(query->touched);
+	free(query);
+}
+
+/**
+ * Finds the topCount documents most similar to a query set, which must be sorted and free of duplicates.
+ * Each query hash is looked up in the terms (searching only past the previous one, since both are sorted), and every
+ * document in its postings gets one more shared hash. The exact similarity of each document that shares any hashes
+ * is then |Q n D| / (|Q| + |D| - |Q n D|), using the set sizes stored in the index, and the best are kept in a heap.
+ * Documents sharing nothing with the query are never returned. Ties are broken in favour of the lower document number.
+ */
+int queryShingleIndex(const MappedShingleIndex* index, IndexQuery* query, const uint64_t* hashes, uint64_t count, int topCount, IndexMatch* matches) { /** Fills in up to topCount matches, most similar first, and returns how many there are **/
+	uint64_t termCount = index->header->termCount;
+	uint64_t low = 0;
+	int matchCount = 0;
+	uint64_t i, p;
+	
+	query->touchedCount = 0;
+	for(i = 0; i < count && low < termCount; i++) {
+		uint64_t high = termCount;
+		while(low < high) { //Binary search for the first term at or after hashes[i]
+			uint64_t middle = low + (high - low) / 2;
+			if(index->terms[middle] < hashes[i]) {
+				low = middle + 1;
+			} else {
+				high = middle;
+			}
+		}
+		if(low == termCount || index->terms[low] != hashes[i]) {
+			continue;
+		}
+		for(p = index->postingStarts[low]; p < index->postingStarts[low + 1]; p++) {
+			uint32_t document = index->postings[p];
+			if(query->sharedCounts[document]++ == 0) {
+				query->touched[query->touchedCount++] = document;
+			}
+		}
+		query->postingsWalked += index->postingStarts[low + 1] - index->postingStarts[low];
+		low++;
+	}
+	
+	for(i = 0; i < query->touchedCount; i++) {
+		IndexMatch candidate;
+		candidate.document = query->touched[i];
+		candidate.shared = query->sharedCounts[candidate.document];
+		candidate.similarity = (double)candidate.shared / (double)(count + index->setSizes[candidate.document] - candidate.shared); //|Q u D| = |Q| + |D| - |Q n D|
+		query->sharedCounts[candidate.document] = 0; //Ready for the next query
+		
+		matchCount = keepTopMatch(matches, matchCount, topCount, &candidate);
+	}
+	
+	sortTopMatches(matches, matchCount);
+	return matchCount;
+}
+
+/**
+ * Keeps the best topCount matches offered so far in a heap with the worst of them at the top, so each offer that is
+ * not kept costs one comparison. sortTopMatches() then puts them in order.
+ */
+int keepTopMatch(IndexMatch* matches, int matchCount, int topCount, const IndexMatch* candidate) { /** Offers a match to the heap of the best topCount found so far, and returns how many it holds **/
+	if(matchCount < topCount) { //Add to the heap, sifting the new match up past any better ones
+		int slot = matchCount++;
+		while(slot > 0 && isWorseMatch(candidate, &matches[(slot - 1) / 2]) == true) {
+			matches[slot] = matches[(slot - 1) / 2];
+			slot = (slot - 1) / 2;
+		}
+		matches[slot] = *candidate;
+	} else if(topCount > 0 && isWorseMatch(&matches[0], candidate) == true) { //Replace the worst match kept so far
+		matches[0] = *candidate;
+		siftDownMatches(matches, matchCount, 0);
+	}
+	return matchCount;
+}
+
+void sortTopMatches(IndexMatch* matches, int matchCount) { /** Orders the matches kept by keepTopMatch() most similar first **/
+	qsort(matches, matchCount, sizeof(IndexMatch), compareMatches);
+}
+
+void siftDownMatches(IndexMatch* matches, int matchCount, int slot) { /** Sub-function of keepTopMatch, restores the heap order below slot, keeping the worst match at the top **/
+	while(true) {
+		int worst = slot;
+		int left = 2 * slot + 1;
+		int right = left + 1;
+		if(left < matchCount && isWorseMatch(&matches[left], &matches[worst]) == true) {
+			worst = left;
+		}
+		if(right < matchCount && isWorseMatch(&matches[right], &matches[worst]) == true) {
+			worst = right;
+		}
+		if(worst == slot) {
+			return;
+		}
+		IndexMatch swap = matches[slot];
+		matches[slot] = matches[worst];
+		matches[worst] = swap;
+		slot = worst;
+	}
+}
+
+int isWorseMatch(const IndexMatch* a, const IndexMatch* b) { /** Sub-function of keepTopMatch, orders matches by similarity, then prefers the lower document number **/
+	if(a->similarity != b->similarity) {
+		return (a->similarity < b->similarity) ? true : false;
+	}
+	return (a->document > b->document) ? true : false;
+}
+
+int compareMatches(const void* a, const void* b) { /** Sub-function of sortTopMatches, qsort() comparator putting the best match first **/
+	if(isWorseMatch(a, b) == true) {
+		return 1;
+	}
+	return (isWorseMatch(b, a) == true) ? -1 : 0;
+}
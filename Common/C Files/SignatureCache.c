@@ -0,0 +1,474 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L //For stat() under -std=c99
+#define _FILE_OFFSET_BITS 64 //So st_size can describe files over 2 GB
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "..\Header Files\SignatureCache.h"
+#include "..\Header Files\Platform.h"
+
+#define true 1
+#define false 0
+#define initialCacheSlots 1024 //Slots in a new cache's lookup table, which doubles whenever it becomes half full
+#define blobCopySize 65536 //Bytes copied at a time while compacting NAME.blobs
+
+void readCacheIndex(SignatureCache* cache); /** Sub-function of openSignatureCache, loads every entry of NAME.idx, or none if it is missing or damaged **/
+void discardCacheEntries(SignatureCache* cache); /** Sub-function of readCacheIndex, empties the cache after a damaged index **/
+int blobFits(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t blobLength); /** Sub-function of readCacheIndex, whether count elements at offset lie within the first blobLength bytes **/
+int* findCacheSlot(SignatureCache* cache, const char* path, uint32_t hashAlgorithm); /** Returns the slot for this path and algorithm: either the one holding its entry, or the empty one it would go in **/
+	uint32_t hashCachePath(const char* path, uint32_t hashAlgorithm); /** Sub-function of findCacheSlot, FNV-1a hash of a path, mixed with the algorithm **/
+void growCacheSlots(SignatureCache* cache); /** Doubles the number of slots, re-inserting every entry **/
+uint64_t appendBlob(SignatureCache* cache, const void* data, uint64_t length); /** Writes data to the end of NAME.blobs, padded to 8 bytes, and returns its offset **/
+uint64_t blobSpan(uint64_t length); /** Bytes that a blob of the given length takes up, once padded **/
+void compactBlobs(SignatureCache* cache); /** Sub-function of closeSignatureCache, rewrites NAME.blobs with only the blobs that entries still refer to **/
+	uint64_t copyBlob(FILE* from, uint64_t offset, uint64_t length, FILE* to, uint64_t* toLength); /** Sub-function of compactBlobs, returns the blob's new offset **/
+char* appendSuffix(const char* name, const char* suffix); /** Returns a new allocation holding name followed by suffix **/
+
+/**
+ * Opens the cache called name, creating its files if they do not exist. An index that is damaged, or that refers to
+ * more of NAME.blobs than there is, is not an error: the cache is just treated as empty, and rebuilt by this run.
+ */
+SignatureCache* openSignatureCache(const char* name) { /** Opens or creates the cache NAME.idx and NAME.blobs **/
+	SignatureCache* cache = calloc(1, sizeof(SignatureCache));
+	struct stat blobStatus;
+	
+	if(cache == NULL) {
+		printf("\nERROR: Unable to allocate memory for the signature cache!\n");
+		exit(1);
+	}
+	cache->indexFileName = appendSuffix(name, ".idx");
+	cache->blobFileName = appendSuffix(name, ".blobs");
+	cache->slotCapacity = initialCacheSlots;
+	cache->slots = malloc(cache->slotCapacity * sizeof(int));
+	if(cache->slots == NULL) {
+		printf("\nERROR: Unable to allocate memory for the signature cache!\n");
+		exit(1);
+	}
+	memset(cache->slots, 0xFF, cache->slotCapacity * sizeof(int)); //Every slot starts as -1
+	
+	readCacheIndex(cache);
+	
+	cache->blobFile = fopen(cache->blobFileName, "r+b");
+	if(cache->blobFile == NULL) {
+		cache->blobFile = fopen(cache->blobFileName, "w+b");
+	}
+	if(cache->blobFile == NULL) {
+		printf("\nERROR: Cache file \"%s\" could not be opened for writing!\n", cache->blobFileName);
+		exit(1);
+	}
+	if(cache->blobLength > 0 && (stat(cache->blobFileName, &blobStatus) != 0 || (uint64_t)blobStatus.st_size < cache->blobLength)) {
+		printf("\nWARNING: Cache file \"%s\" is shorter than its index says, so the cache will be rebuilt.\n", cache->blobFileName);
+		discardCacheEntries(cache);
+	}
+	return cache;
+}
+
+void readCacheIndex(SignatureCache* cache) { /** Sub-function of openSignatureCache, loads every entry of NAME.idx, or none if it is missing or damaged **/
+	SignatureCacheHeader header;
+	FILE* indexFile = fopen(cache->indexFileName, "rb");
+	struct stat indexStatus;
+	uint64_t indexRemaining; //Bytes of NAME.idx not yet read, which no path can be longer than
+	uint64_t e;
+	
+	if(indexFile == NULL) {
+		return; //A new cache
+	}
+	if(fread(&header, sizeof(header), 1, indexFile) != 1 || memcmp(header.magic, SIGNATURE_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != SIGNATURE_CACHE_VERSION) {
+		printf("\nWARNING: \"%s\" is not a version %d cache index, so the cache will be rebuilt.\n", cache->indexFileName, SIGNATURE_CACHE_VERSION);
+		fclose(indexFile);
+		return;
+	}
+	if(stat(cache->indexFileName, &indexStatus) != 0 || (uint64_t)indexStatus.st_size < sizeof(header)) {
+		fclose(indexFile);
+		return;
+	}
+	indexRemaining = (uint64_t)indexStatus.st_size - sizeof(header);
+	
+	cache->blobLength = header.blobLength;
+	for(e = 0; e < header.entryCount; e++) {
+		CacheEntry entry;
+		if(indexRemaining < sizeof(CacheEntryRecord) || fread(&entry.record, sizeof(CacheEntryRecord), 1, indexFile) != 1) {
+			break;
+		}
+		indexRemaining -= sizeof(CacheEntryRecord);
+		if(entry.record.pathLength > indexRemaining) {
+			break; //Damaged, and allocating pathLength + 1 bytes could wrap around
+		}
+		indexRemaining -= entry.record.pathLength;
+		entry.path = malloc(entry.record.pathLength + 1);
+		if(entry.path == NULL) {
+			printf("\nERROR: Unable to allocate memory for the signature cache!\n");
+			exit(1);
+		}
+		if(fread(entry.path, 1, entry.record.pathLength, indexFile) != entry.record.pathLength) {
+			free(entry.path);
+			break;
+		}
+		entry.path[entry.record.pathLength] = '\0';
+		if((entry.record.hashOffset != CACHE_NO_BLOB && blobFits(entry.record.hashOffset, entry.record.hashCount, sizeof(uint64_t), header.blobLength) == false)
+				|| (entry.record.signatureOffset != CACHE_NO_BLOB && blobFits(entry.record.signatureOffset, entry.record.signatureSize, sizeof(uint32_t), header.blobLength) == false)) {
+			free(entry.path);
+			break;
+		}
+		
+		if(cache->entryCount == cache->entryCapacity) {
+			cache->entryCapacity = (cache->entryCapacity > 0) ? cache->entryCapacity * 2 : 1024;
+			cache->entries = realloc(cache->entries, cache->entryCapacity * sizeof(CacheEntry));
+			if(cache->entries == NULL) {
+				printf("\nERROR: Unable to re-allocate memory for the signature cache!\n");
+				exit(1);
+			}
+		}
+		*findCacheSlot(cache, entry.path, entry.record.hashAlgorithm) = cache->entryCount;
+		cache->entries[cache->entryCount++] = entry;
+		if(entry.record.hashOffset != CACHE_NO_BLOB) {
+			cache->liveLength += blobSpan(entry.record.hashCount * sizeof(uint64_t));
+		}
+		if(entry.record.signatureOffset != CACHE_NO_BLOB) {
+			cache->liveLength += blobSpan(entry.record.signatureSize * sizeof(uint32_t));
+		}
+		if((uint32_t)cache->entryCount * 2 > cache->slotCapacity) {
+			growCacheSlots(cache);
+		}
+	}
+	fclose(indexFile);
+	
+	if((uint64_t)cache->entryCount != header.entryCount) {
+		printf("\nWARNING: Cache index \"%s\" is damaged, so the cache will be rebuilt.\n", cache->indexFileName);
+		discardCacheEntries(cache);
+	}
+}
+
+int blobFits(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t blobLength) { /** Sub-function of readCacheIndex, whether count elements at offset lie within the first blobLength bytes **/
+	return offset <= blobLength && count <= (blobLength - offset) / elementSize; //Written so that neither side can overflow
+}
+
+void discardCacheEntries(SignatureCache* cache) { /** Sub-function of readCacheIndex, empties the cache after a damaged index **/
+	int e;
+	for(e = 0; e < cache->entryCount; e++) {
+		free(cache->entries[e].path);
+	}
+	cache->entryCount = 0;
+	cache->blobLength = 0;
+	cache->liveLength = 0;
+	memset(cache->slots, 0xFF, cache->slotCapacity * sizeof(int));
+}
+
+int makeCacheKey(const char* fileName, uint32_t shingleSize, uint32_t hashAlgorithm, CacheKey* key) { /** Fills key in from the file as it is now; returns false if the file cannot be found **/
+	struct stat fileStatus;
+	
+	key->path = absolutePath(fileName); //So the same file is found however it is named on the command line
+	if(key->path == NULL || stat(key->path, &fileStatus) != 0) {
+		free(key->path);
+		key->path = NULL;
+		return false;
+	}
+	key->fileSize = (uint64_t)fileStatus.st_size;
+	key->modifiedTime = (int64_t)fileStatus.st_mtime * 1000000000;
+#if defined(__APPLE__)
+	key->modifiedTime += fileStatus.st_mtimespec.tv_nsec;
+#elif !defined(_WIN32)
+	key->modifiedTime += fileStatus.st_mtim.tv_nsec; //POSIX.1-2008, so a file rewritten within the same second is still seen to have changed
+#endif
+	key->shingleSize = shingleSize;
+	key->hashAlgorithm = hashAlgorithm;
+	return true;
+}
+
+int findCacheEntry(SignatureCache* cache, const CacheKey* key) { /** Returns the index of the entry matching every field of key, or -1 **/
+	int entry = *findCacheSlot(cache, key->path, key->hashAlgorithm);
+	if(entry < 0) {
+		return -1;
+	}
+	
+	const CacheEntryRecord* record = &cache->entries[entry].record;
+	if(record->fileSize != key->fileSize || record->modifiedTime != key->modifiedTime || record->shingleSize != key->shingleSize) {
+		return -1; //The file has changed since it was cached
+	}
+	return entry;
+}
+
+uint64_t* loadCachedHashes(SignatureCache* cache, int entry, uint64_t* count) { /** Returns the entry's hashes in a new allocation, or NULL (a miss) **/
+	uint64_t* hashes = NULL;
+	
+	if(entry >= 0 && cache->entries[entry].record.hashOffset != CACHE_NO_BLOB) {
+		const CacheEntryRecord* record = &cache->entries[entry].record;
+		hashes = malloc((record->hashCount > 0 ? record->hashCount : 1) * sizeof(uint64_t));
+		if(hashes == NULL) {
+			printf("\nERROR: Unable to allocate memory for the hashed n-grams!\n");
+			exit(1);
+		}
+		if(seekFile(cache->blobFile, record->hashOffset) != 0 || fread(hashes, sizeof(uint64_t), record->hashCount, cache->blobFile) != record->hashCount) {
+			free(hashes);
+			hashes = NULL;
+		} else {
+			*count = record->hashCount;
+		}
+	}
+	
+	if(hashes != NULL) {
+		cache->hits++;
+	} else {
+		cache->misses++;
+	}
+	return hashes;
+}
+
+uint32_t* loadCachedSignature(SignatureCache* cache, int entry, int signatureSize) { /** Returns the entry's signature in a new allocation, or NULL (a miss) if it has none of that size **/
+	uint32_t* values = NULL;
+	
+	if(entry >= 0 && cache->entries[entry].record.signatureOffset != CACHE_NO_BLOB && cache->entries[entry].record.signatureSize == (uint32_t)signatureSize) {
+		values = malloc(signatureSize * sizeof(uint32_t));
+		if(values == NULL) {
+			printf("\nERROR: Unable to allocate memory for a MinHash signature!\n");
+			exit(1);
+		}
+		if(seekFile(cache->blobFile, cache->entries[entry].record.signatureOffset) != 0 || fread(values, sizeof(uint32_t), signatureSize, cache->blobFile) != (size_t)signatureSize) {
+			free(values);
+			values = NULL;
+		}
+	}
+	
+	if(values != NULL) {
+		cache->hits++;
+	} else {
+		cache->misses++;
+	}
+	return values;
+}
+
+/**
+ * Records a file's hashes under key, replacing any older entry for the same file and hash algorithm (entries for
+ * other algorithms are kept, so runs with different -hash settings do not evict each other). hashes may be NULL
+ * for a binary shingle file, whose hashes are mapped straight from the file; the entry then only holds a signature.
+ */
+int storeCacheEntry(SignatureCache* cache, const CacheKey* key, const uint64_t* hashes, uint64_t count) { /** Replaces any entry for the same path and algorithm, and returns the new entry's index **/
+	int* slot = findCacheSlot(cache, key->path, key->hashAlgorithm);
+	CacheEntry* entry = NULL;
+	
+	if(*slot >= 0) {
+		entry = &cache->entries[*slot];
+		if(entry->record.hashOffset != CACHE_NO_BLOB) {
+			cache->liveLength -= blobSpan(entry->record.hashCount * sizeof(uint64_t));
+		}
+		if(entry->record.signatureOffset != CACHE_NO_BLOB) {
+			cache->liveLength -= blobSpan(entry->record.signatureSize * sizeof(uint32_t));
+		}
+	} else {
+		if(cache->entryCount == cache->entryCapacity) {
+			cache->entryCapacity = (cache->entryCapacity > 0) ? cache->entryCapacity * 2 : 1024;
+			cache->entries = realloc(cache->entries, cache->entryCapacity * sizeof(CacheEntry));
+			if(cache->entries == NULL) {
+				printf("\nERROR: Unable to re-allocate memory for the signature cache!\n");
+				exit(1);
+			}
+		}
+		*slot = cache->entryCount++;
+		entry = &cache->entries[*slot];
+		entry->path = appendSuffix(key->path, "");
+		entry->record.pathLength = (uint32_t)strlen(key->path);
+	}
+	
+	entry->record.fileSize = key->fileSize;
+	entry->record.modifiedTime = key->modifiedTime;
+	entry->record.shingleSize = key->shingleSize;
+	entry->record.hashAlgorithm = key->hashAlgorithm;
+	entry->record.hashOffset = (hashes != NULL) ? appendBlob(cache, hashes, count * sizeof(uint64_t)) : CACHE_NO_BLOB;
+	entry->record.hashCount = count;
+	entry->record.signatureOffset = CACHE_NO_BLOB;
+	entry->record.signatureSize = 0;
+	
+	int index = (int)(entry - cache->entries);
+	if((uint32_t)cache->entryCount * 2 > cache->slotCapacity) {
+		growCacheSlots(cache);
+	}
+	return index;
+}
+
+void storeCachedSignature(SignatureCache* cache, int entry, const uint32_t* values, int signatureSize) {
+	CacheEntryRecord* record = &cache->entries[entry].record;
+	if(record->signatureOffset != CACHE_NO_BLOB) { //A signature of a different size, which this one replaces
+		cache->liveLength -= blobSpan(record->signatureSize * sizeof(uint32_t));
+	}
+	record->signatureOffset = appendBlob(cache, values, signatureSize * sizeof(uint32_t));
+	record->signatureSize = (uint32_t)signatureSize;
+}
+
+/**
+ * Replaced entries leave their blobs behind in NAME.blobs, so once less than half of it is in use, it is rewritten
+ * with only the live blobs before the index is saved. The index is written last: new blobs only ever go past the end
+ * the old index knows of, so a run that is interrupted before then leaves a cache that is still correct. Compaction
+ * moves blobs, so the old index is deleted before the compacted file replaces the old one.
+ */
+void closeSignatureCache(SignatureCache* cache) { /** Writes the index, compacting NAME.blobs first if most of it is no longer used **/
+	SignatureCacheHeader header;
+	FILE* indexFile = NULL;
+	int e;
+	
+	if(cache->liveLength * 2 < cache->blobLength) {
+		compactBlobs(cache);
+	}
+	if(fclose(cache->blobFile) != 0) {
+		printf("\nERROR: Not all of cache file \"%s\" was written!\n", cache->blobFileName);
+		exit(1);
+	}
+	
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SIGNATURE_CACHE_MAGIC, sizeof(header.magic));
+	header.version = SIGNATURE_CACHE_VERSION;
+	header.entryCount = (uint64_t)cache->entryCount;
+	header.blobLength = cache->blobLength;
+	
+	indexFile = fopen(cache->indexFileName, "wb");
+	if(indexFile == NULL) {
+		printf("\nERROR: Cache file \"%s\" could not be opened for writing!\n", cache->indexFileName);
+		exit(1);
+	}
+	fwrite(&header, sizeof(header), 1, indexFile);
+	for(e = 0; e < cache->entryCount; e++) {
+		fwrite(&cache->entries[e].record, sizeof(CacheEntryRecord), 1, indexFile);
+		fwrite(cache->entries[e].path, 1, cache->entries[e].record.pathLength, indexFile);
+		free(cache->entries[e].path);
+	}
+	if(ferror(indexFile) || fclose(indexFile) != 0) {
+		printf("\nERROR: Not all of cache file \"%s\" was written!\n", cache->indexFileName);
+		exit(1);
+	}
+	
+	free(cache->entries);
+	free(cache->slots);
+	free(cache->indexFileName);
+	free(cache->blobFileName);
+	free(cache);
+}
+
+int* findCacheSlot(SignatureCache* cache, const char* path, uint32_t hashAlgorithm) { /** Returns the slot for this path and algorithm: either the one holding its entry, or the empty one it would go in **/
+	uint32_t mask = cache->slotCapacity - 1;
+	uint32_t slot = hashCachePath(path, hashAlgorithm) & mask;
+	
+	while(cache->slots[slot] >= 0) { //Linear probing, as in shingle's ShingleSet
+		const CacheEntry* entry = &cache->entries[cache->slots[slot]];
+		if(entry->record.hashAlgorithm == hashAlgorithm && strcmp(entry->path, path) == 0) {
+			break;
+		}
+		slot = (slot + 1) & mask;
+	}
+	return &cache->slots[slot];
+}
+
+uint32_t hashCachePath(const char* path, uint32_t hashAlgorithm) { /** Sub-function of findCacheSlot, FNV-1a hash of a path, mixed with the algorithm **/
+	uint32_t h = 2166136261U ^ hashAlgorithm;
+	for(; *path != '\0'; path++) {
+		h ^= (unsigned char)*path;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+void growCacheSlots(SignatureCache* cache) { /** Doubles the number of slots, re-inserting every entry **/
+	int e;
+	
+	cache->slotCapacity *= 2;
+	cache->slots = realloc(cache->slots, cache->slotCapacity * sizeof(int));
+	if(cache->slots == NULL) {
+		printf("\nERROR: Unable to re-allocate memory for the signature cache!\n");
+		exit(1);
+	}
+	memset(cache->slots, 0xFF, cache->slotCapacity * sizeof(int));
+	for(e = 0; e < cache->entryCount; e++) {
+		*findCacheSlot(cache, cache->entries[e].path, cache->entries[e].record.hashAlgorithm) = e;
+	}
+}
+
+uint64_t appendBlob(SignatureCache* cache, const void* data, uint64_t length) { /** Writes data to the end of NAME.blobs, padded to 8 bytes, and returns its offset **/
+	static const char padding[8] = {0};
+	uint64_t offset = cache->blobLength;
+	uint64_t span = blobSpan(length);
+	
+	if(seekFile(cache->blobFile, offset) != 0 || fwrite(data, 1, (size_t)length, cache->blobFile) != length || fwrite(padding, 1, (size_t)(span - length), cache->blobFile) != span - length) {
+		printf("\nERROR: Not all of cache file \"%s\" was written!\n", cache->blobFileName);
+		exit(1);
+	}
+	cache->blobLength += span;
+	cache->liveLength += span;
+	return offset;
+}
+
+uint64_t blobSpan(uint64_t length) { /** Bytes that a blob of the given length takes up, once padded **/
+	return (length + 7) & ~(uint64_t)7;
+}
+
+void compactBlobs(SignatureCache* cache) { /** Sub-function of closeSignatureCache, rewrites NAME.blobs with only the blobs that entries still refer to **/
+	char* compactFileName = appendSuffix(cache->blobFileName, ".tmp");
+	FILE* compactFile = fopen(compactFileName, "wb");
+	uint64_t compactLength = 0;
+	int e;
+	
+	if(compactFile == NULL) {
+		free(compactFileName);
+		return; //Leave the cache as it is; it still works, it is just larger than it needs to be
+	}
+	for(e = 0; e < cache->entryCount; e++) {
+		CacheEntryRecord* record = &cache->entries[e].record;
+		if(record->hashOffset != CACHE_NO_BLOB) {
+			record->hashOffset = copyBlob(cache->blobFile, record->hashOffset, blobSpan(record->hashCount * sizeof(uint64_t)), compactFile, &compactLength);
+		}
+		if(record->signatureOffset != CACHE_NO_BLOB) {
+			record->signatureOffset = copyBlob(cache->blobFile, record->signatureOffset, blobSpan(record->signatureSize * sizeof(uint32_t)), compactFile, &compactLength);
+		}
+	}
+	if(fclose(compactFile) != 0) {
+		printf("\nERROR: Not all of cache file \"%s\" was written!\n", compactFileName);
+		exit(1);
+	}
+	
+	fclose(cache->blobFile);
+	remove(cache->indexFileName); //Its offsets are about to be wrong; without it, an interrupted run just leaves an empty cache
+	remove(cache->blobFileName); //rename() will not replace an existing file on Windows
+	if(rename(compactFileName, cache->blobFileName) != 0) {
+		printf("\nERROR: Cache file \"%s\" could not be replaced!\n", cache->blobFileName);
+		exit(1);
+	}
+	cache->blobFile = fopen(cache->blobFileName, "r+b");
+	if(cache->blobFile == NULL) {
+		printf("\nERROR: Cache file \"%s\" could not be opened for writing!\n", cache->blobFileName);
+		exit(1);
+	}
+	cache->blobLength = compactLength;
+	cache->liveLength = compactLength;
+	free(compactFileName);
+}
+
+uint64_t copyBlob(FILE* from, uint64_t offset, uint64_t length, FILE* to, uint64_t* toLength) { /** Sub-function of compactBlobs, returns the blob's new offset **/
+	char buffer[blobCopySize];
+	uint64_t newOffset = *toLength;
+	
+	if(seekFile(from, offset) != 0) {
+		printf("\nERROR: The signature cache could not be read while compacting it!\n");
+		exit(1);
+	}
+	while(length > 0) {
+		size_t piece = (length < blobCopySize) ? (size_t)length : blobCopySize;
+		if(fread(buffer, 1, piece, from) != piece || fwrite(buffer, 1, piece, to) != piece) {
+			printf("\nERROR: The signature cache could not be copied while compacting it!\n");
+			exit(1);
+		}
+		length -= piece;
+		*toLength += piece;
+	}
+	return newOffset;
+}
+
+char* appendSuffix(const char* name, const char* suffix) { /** Returns a new allocation holding name followed by suffix **/
+	char* result = malloc(strlen(name) + strlen(suffix) + 1);
+	if(result == NULL) {
+		printf("\nERROR: Unable to allocate memory for the signature cache!\n");
+		exit(1);
+	}
+	strcpy(result, name);
+	strcat(result, suffix);
+	return result;
+}
@@ -0,0 +1,391 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "..\Header Files\Similarity.h"
+#include "..\Header Files\SetIntersection.h"
+#include "..\Header Files\Tokenizer.h"
+#include "..\Header Files\Stats.h"
+
+#define true 1
+#define false 0
+#define initialScratchSize 256 //Bytes first given to the buffer each shingle is assembled in; doubled whenever a shingle does not fit
+
+ShingleSet* rollWordShingles(Arena* arena, ShingleSet* set, uint64_t* hashes, const char* text, size_t length, uint32_t shingleSize, const DelimiterSet* delimiters); /** Sub-function of shingleBuffer, hashes HASH_ROLLING shingles without assembling them **/
+int isKnownAlgorithm(uint32_t hashAlgorithm); /** Checked up front, since hashShingleBytes() exits on an unknown algorithm **/
+ShingleSet* finishShingleSet(Arena* arena, ShingleSet* set, uint64_t* hashes, uint64_t count); /** Sorts and de-duplicates hashes, the arena's most recent allocation, and gives back the unused tail **/
+void insertMatch(SetMatch* matches, uint32_t* matchCount, uint32_t topCount, const SetMatch* match); /** Sub-function of findSimilarSets, keeps matches sorted, most similar first **/
+
+/**
+ * Forms every run of shingleSize consecutive words of text, joined by single spaces, and hashes it. The words are
+ * counted first, so the array of hashes is allocated at its final size instead of being grown; only the buffer
+ * each shingle is assembled in is allocated outside the arena, and it is freed before returning. With HASH_ROLLING,
+ * each word is hashed once and the shingles are never assembled, so a shingle costs the same however large it is.
+ */
+ShingleSet* shingleBuffer(Arena* arena, const char* text, size_t length, uint32_t shingleSize, uint32_t hashAlgorithm) { /** Shingles raw text, split into words at SHINGLE_DELIMITERS **/
+	DelimiterSet delimiters;
+	initDelimiterSet(&delimiters, SHINGLE_DELIMITERS);
+	if(shingleSize < 1 || isKnownAlgorithm(hashAlgorithm) == false) {
+		return NULL;
+	}
+	length = textLengthToNul(text, length);
+	
+	uint64_t wordCount = countTokens(&delimiters, text, length);
+	uint64_t shingleCount = (wordCount >= shingleSize) ? wordCount - shingleSize + 1 : 0;
+	
+	ShingleSet* set = arenaAllocate(arena, sizeof(ShingleSet));
+	uint64_t* hashes = (set != NULL) ? arenaAllocate(arena, shingleCount * sizeof(uint64_t)) : NULL;
+	if(hashes != NULL && hashAlgorithm == HASH_ROLLING) {
+		set->shingleSize = shingleSize;
+		set->shingleUnit = SHINGLE_WORDS;
+		set->hashAlgorithm = hashAlgorithm;
+		return rollWordShingles(arena, set, hashes, text, length, shingleSize, &delimiters);
+	}
+	size_t* wordStarts = malloc(shingleSize * sizeof(size_t)); //Ring buffer of the most recent words
+	size_t* wordLengths = malloc(shingleSize * sizeof(size_t));
+	size_t scratchSize = initialScratchSize;
+	char* scratch = malloc(scratchSize);
+	if(hashes == NULL || wordStarts == NULL || wordLengths == NULL || scratch == NULL) {
+		free(wordStarts);
+		free(wordLengths);
+		free(scratch);
+		return NULL;
+	}
+	set->shingleSize = shingleSize;
+	set->shingleUnit = SHINGLE_WORDS;
+	set->hashAlgorithm = hashAlgorithm;
+	
+	Tokenizer tokenizer;
+	size_t start = 0, wordLength = 0;
+	uint64_t count = 0;
+	uint32_t windowStart = 0, windowCount = 0;
+	beginTokens(&tokenizer, &delimiters, text, length);
+	while(nextToken(&tokenizer, &start, &wordLength) == true) {
+		if(windowCount == shingleSize) { //The window is full, so the oldest word drops out
+			wordStarts[windowStart] = start;
+			wordLengths[windowStart] = wordLength;
+			windowStart = (windowStart + 1) % shingleSize;
+		} else {
+			wordStarts[windowCount] = start;
+			wordLengths[windowCount] = wordLength;
+			windowCount++;
+		}
+		if(windowCount < shingleSize) {
+			continue;
+		}
+		
+		size_t shingleLength = shingleSize - 1; //The spaces between the words
+		for(uint32_t j = 0; j < shingleSize; j++) {
+			shingleLength += wordLengths[j];
+		}
+		if(shingleLength > scratchSize) {
+			while(shingleLength > scratchSize) {
+				scratchSize *= 2;
+			}
+			char* grown = realloc(scratch, scratchSize);
+			if(grown == NULL) {
+				free(wordStarts);
+				free(wordLengths);
+				free(scratch);
+				return NULL;
+			}
+			scratch = grown;
+		}
+		size_t filled = 0;
+		for(uint32_t j = 0; j < shingleSize; j++) {
+			uint32_t word = (windowStart + j) % shingleSize;
+			if(j > 0) {
+				scratch[filled++] = ' ';
+			}
+			memcpy(scratch + filled, text + wordStarts[word], wordLengths[word]);
+			filled += wordLengths[word];
+		}
+		hashes[count++] = hashShingleBytes(scratch, filled, hashAlgorithm);
+	}
+	
+	free(wordStarts);
+	free(wordLengths);
+	free(scratch);
+	return finishShingleSet(arena, set, hashes, count);
+}
+
+/**
+ * The text is read as its words joined by single spaces, as word shingles see it, so "a, b" and "a b" give the same
+ * shingles. Each step along it takes the oldest character out of the window's polynomial and adds the new one, in
+ * constant time whatever shingleSize is; the characters in the window are kept in a ring of shingleSize bytes.
+ */
+ShingleSet* shingleCharacters(Arena* arena, const char* text, size_t length, uint32_t shingleSize) { /** Shingles raw text into runs of shingleSize characters, hashed with HASH_ROLLING **/
+	DelimiterSet delimiters;
+	Tokenizer tokenizer;
+	size_t start = 0, wordLength = 0;
+	initDelimiterSet(&delimiters, SHINGLE_DELIMITERS);
+	if(shingleSize < 1) {
+		return NULL;
+	}
+	length = textLengthToNul(text, length);
+	
+	uint64_t characterCount = 0, wordCount = 0;
+	beginTokens(&tokenizer, &delimiters, text, length);
+	while(nextToken(&tokenizer, &start, &wordLength) == true) {
+		characterCount += wordLength;
+		wordCount++;
+	}
+	characterCount += (wordCount > 0) ? wordCount - 1 : 0; //The spaces between the words
+	uint64_t shingleCount = (characterCount >= shingleSize) ? characterCount - shingleSize + 1 : 0;
+	
+	ShingleSet* set = arenaAllocate(arena, sizeof(ShingleSet));
+	uint64_t* hashes = (set != NULL) ? arenaAllocate(arena, shingleCount * sizeof(uint64_t)) : NULL;
+	unsigned char* window = malloc(shingleSize); //Ring buffer of the characters in the current shingle
+	if(hashes == NULL || window == NULL) {
+		free(window);
+		return NULL;
+	}
+	set->shingleSize = shingleSize;
+	set->shingleUnit = SHINGLE_CHARACTERS;
+	set->hashAlgorithm = HASH_ROLLING;
+	
+	uint64_t outgoingPower = 1; //ROLLING_BASE^(shingleSize - 1), the weight of the oldest character
+	for(uint32_t j = 1; j < shingleSize; j++) {
+		outgoingPower = multiplyModRolling(outgoingPower, ROLLING_BASE);
+	}
+	uint64_t polynomial = 0, count = 0;
+	uint32_t windowStart = 0, windowCount = 0;
+	beginTokens(&tokenizer, &delimiters, text, length);
+	for(uint64_t word = 0; nextToken(&tokenizer, &start, &wordLength) == true; word++) {
+		for(size_t i = (word == 0) ? 1 : 0; i <= wordLength; i++) { //Every word but the first is preceded by the space that joins it to the last
+			unsigned char incoming = (i == 0) ? ' ' : (unsigned char)text[start + i - 1];
+			if(windowCount == shingleSize) { //The window is full, so the oldest character drops out
+				polynomial = subtractModRolling(polynomial, multiplyModRolling((uint64_t)window[windowStart] + 1, outgoingPower));
+				window[windowStart] = incoming;
+				windowStart = (windowStart + 1) % shingleSize;
+			} else {
+				window[windowCount++] = incoming;
+			}
+			polynomial = addModRolling(multiplyModRolling(polynomial, ROLLING_BASE), (uint64_t)incoming + 1);
+			if(windowCount == shingleSize) {
+				hashes[count++] = finishRollingHash(polynomial);
+			}
+		}
+	}
+	
+	free(window);
+	return finishShingleSet(arena, set, hashes, count);
+}
+
+/**
+ * Each shingle is a maximal run of characters other than ',' (so empty fields are skipped), hashed where it lies;
+ * the tokenizer finds them with ',' as its only delimiter. A zero byte ends the text, as it did when jaccard split it
+ * with strtok(). The shingle size is taken from the number of words in the first shingle.
+ */
+ShingleSet* parseShingleCsv(Arena* arena, const char* text, size_t length, uint32_t hashAlgorithm) { /** Hashes comma-delimited shingles, as written by "shingle" without -b **/
+	DelimiterSet commas;
+	initDelimiterSet(&commas, ",");
+	if(isKnownAlgorithm(hashAlgorithm) == false) {
+		return NULL;
+	}
+	length = textLengthToNul(text, length);
+	
+	double startTime = statsClock(); //The three passes are timed as jaccard's "tokenize", "hash" and "dedup" stages
+	uint64_t shingleCount = countTokens(&commas, text, length);
+	addStageTime("tokenize", startTime, shingleCount, (uint64_t)length);
+	ShingleSet* set = arenaAllocate(arena, sizeof(ShingleSet));
+	uint64_t* hashes = (set != NULL) ? arenaAllocate(arena, shingleCount * sizeof(uint64_t)) : NULL;
+	if(hashes == NULL) {
+		return NULL;
+	}
+	set->shingleSize = 0;
+	set->shingleUnit = SHINGLE_WORDS;
+	set->hashAlgorithm = hashAlgorithm;
+	
+	Tokenizer tokenizer;
+	size_t start = 0, shingleLength = 0;
+	uint64_t count = 0;
+	startTime = statsClock();
+	beginTokens(&tokenizer, &commas, text, length);
+	while(nextToken(&tokenizer, &start, &shingleLength) == true) {
+		const char* shingle = text + start;
+		if(count == 0) {
+			set->shingleSize = 1;
+			for(size_t j = 0; j < shingleLength; j++) { //Each space within the first shingle separates two words
+				set->shingleSize += (shingle[j] == ' ');
+			}
+		}
+		hashes[count++] = hashShingleBytes(shingle, shingleLength, hashAlgorithm);
+	}
+	addStageTime("hash", startTime, count, 0); //Includes finding each shingle again, which the tokenize pass only counted
+	
+	startTime = statsClock();
+	set = finishShingleSet(arena, set, hashes, count);
+	addStageTime("dedup", startTime, count, count * sizeof(uint64_t));
+	return set;
+}
+
+ShingleSet* makeShingleSet(Arena* arena, const uint64_t* hashes, uint64_t count, uint32_t shingleSize, uint32_t hashAlgorithm) { /** Copies hashes, which may be in any order and repeat **/
+	ShingleSet* set = arenaAllocate(arena, sizeof(ShingleSet));
+	uint64_t* copy = (set != NULL) ? arenaAllocate(arena, count * sizeof(uint64_t)) : NULL;
+	if(copy == NULL) {
+		return NULL;
+	}
+	if(count > 0) {
+		memcpy(copy, hashes, count * sizeof(uint64_t));
+	}
+	set->shingleSize = shingleSize;
+	set->shingleUnit = SHINGLE_WORDS;
+	set->hashAlgorithm = hashAlgorithm;
+	return finishShingleSet(arena, set, copy, count);
+}
+
+/**
+ * The size of the intersection is counted with the fastest kernel this processor supports (see SetIntersection.h),
+ * and the union follows from it, since |A u B| = |A| + |B| - |A n B|.
+ */
+void compareShingleSets(const ShingleSet* a, const ShingleSet* b, SetSimilarity* result) {
+	result->intersection = intersectionCount64(a->hashes, a->count, b->hashes, b->count);
+	result->unionCount = a->count + b->count - result->intersection;
+	result->similarity = (result->unionCount > 0) ? (double)result->intersection / (double)result->unionCount : 0.0;
+}
+
+/**
+ * A pair can be no more similar than the smaller set's size over the larger's, so with a threshold above 0, pairs
+ * whose sizes are too far apart are skipped without being compared. The result is the same as comparing every pair.
+ */
+uint64_t compareAllPairs(const ShingleSet* const* sets, uint32_t count, double threshold, PairCallback callback, void* context) { /** Calls back with every pair i < k at least threshold similar, in (i,k) order; returns the pairs compared **/
+	SetSimilarity result;
+	uint64_t compared = 0;
+	
+	for(uint32_t i = 0; i + 1 < count; i++) {
+		for(uint32_t k = i + 1; k < count; k++) {
+			uint64_t smaller = (sets[i]->count < sets[k]->count) ? sets[i]->count : sets[k]->count;
+			uint64_t larger = sets[i]->count + sets[k]->count - smaller;
+			if(threshold > 0 && (double)smaller < threshold * (double)larger - 1e-9) {
+				continue;
+			}
+			compareShingleSets(sets[i], sets[k], &result);
+			compared++;
+			if(result.similarity >= threshold) {
+				callback(context, i, k, &result);
+			}
+		}
+	}
+	return compared;
+}
+
+/**
+ * Compares query with each of sets, keeping the topCount most similar; ties go to the set found first. Once
+ * topCount matches are held, a set whose size alone keeps it from beating the least similar of them is skipped.
+ */
+uint32_t findSimilarSets(const ShingleSet* query, const ShingleSet* const* sets, uint32_t count, uint32_t topCount, SetMatch* matches) { /** Fills in up to topCount sets, most similar first, and returns how many there are **/
+	SetSimilarity result;
+	SetMatch match;
+	uint32_t matchCount = 0;
+	
+	for(uint32_t s = 0; s < count && topCount > 0; s++) {
+		if(matchCount == topCount) {
+			uint64_t smaller = (query->count < sets[s]->count) ? query->count : sets[s]->count;
+			uint64_t larger = query->count + sets[s]->count - smaller;
+			if(larger == 0 || (double)smaller / (double)larger <= matches[topCount - 1].similarity) {
+				continue;
+			}
+		}
+		compareShingleSets(query, sets[s], &result);
+		match.set = s;
+		match.intersection = result.intersection;
+		match.similarity = result.similarity;
+		insertMatch(matches, &matchCount, topCount, &match);
+	}
+	return matchCount;
+}
+
+size_t textLengthToNul(const char* text, size_t length) { /** The length of text up to its first zero byte, where splitting it with strtok() always stopped **/
+	const char* nul = memchr(text, '\0', length);
+	return (nul != NULL) ? (size_t)(nul - text) : length;
+}
+
+char* readWholeFile(const char* fileName, size_t* length) { /** Returns the contents in a new, null-terminated allocation the caller frees, or NULL if the file cannot be read **/
+	FILE* file = fopen(fileName, "rb");
+	if(file == NULL) {
+		return NULL;
+	}
+	
+	fseek(file, 0, SEEK_END);
+	long fileLength = ftell(file);
+	char* contents = (fileLength >= 0) ? malloc((size_t)fileLength + 1) : NULL;
+	fseek(file, 0, SEEK_SET);
+	if(contents == NULL || fread(contents, 1, (size_t)fileLength, file) != (size_t)fileLength) {
+		free(contents);
+		fclose(file);
+		return NULL;
+	}
+	contents[fileLength] = '\0';
+	fclose(file);
+	
+	*length = (size_t)fileLength;
+	return contents;
+}
+
+/**
+ * Each word is hashed once, as it enters the window, and the window's polynomial is updated by taking the leaving
+ * word's term out, so forming a shingle costs the same however many words it has. Gives the same hashes as
+ * hashShingleBytes() gives for the assembled shingles.
+ */
+ShingleSet* rollWordShingles(Arena* arena, ShingleSet* set, uint64_t* hashes, const char* text, size_t length, uint32_t shingleSize, const DelimiterSet* delimiters) { /** Sub-function of shingleBuffer, hashes HASH_ROLLING shingles without assembling them **/
+	uint64_t* terms = malloc(shingleSize * sizeof(uint64_t)); //Ring buffer of the terms of the most recent words
+	if(terms == NULL) {
+		return NULL;
+	}
+	uint64_t outgoingPower = 1; //ROLLING_BASE^(shingleSize - 1), the weight of the oldest word
+	for(uint32_t j = 1; j < shingleSize; j++) {
+		outgoingPower = multiplyModRolling(outgoingPower, ROLLING_BASE);
+	}
+	
+	Tokenizer tokenizer;
+	size_t start = 0, wordLength = 0;
+	uint64_t polynomial = 0, count = 0;
+	uint32_t windowStart = 0, windowCount = 0;
+	beginTokens(&tokenizer, delimiters, text, length);
+	while(nextToken(&tokenizer, &start, &wordLength) == true) {
+		uint64_t term = rollingWordTerm(text + start, wordLength);
+		if(windowCount == shingleSize) { //The window is full, so the oldest word drops out
+			polynomial = subtractModRolling(polynomial, multiplyModRolling(terms[windowStart], outgoingPower));
+			terms[windowStart] = term;
+			windowStart = (windowStart + 1) % shingleSize;
+		} else {
+			terms[windowCount++] = term;
+		}
+		polynomial = addModRolling(multiplyModRolling(polynomial, ROLLING_BASE), term);
+		if(windowCount == shingleSize) {
+			hashes[count++] = finishRollingHash(polynomial);
+		}
+	}
+	
+	free(terms);
+	return finishShingleSet(arena, set, hashes, count);
+}
+
+int isKnownAlgorithm(uint32_t hashAlgorithm) { /** Checked up front, since hashShingleBytes() exits on an unknown algorithm **/
+	return hashAlgorithm == HASH_LEGACY || hashAlgorithm == HASH_XXH64 || hashAlgorithm == HASH_ROLLING;
+}
+
+ShingleSet* finishShingleSet(Arena* arena, ShingleSet* set, uint64_t* hashes, uint64_t count) { /** Sorts and de-duplicates hashes, the arena's most recent allocation, and gives back the unused tail **/
+	count = sortUniqueHashes(hashes, count);
+	arenaTrim(arena, hashes, count * sizeof(uint64_t));
+	set->hashes = hashes;
+	set->count = count;
+	return set;
+}
+
+void insertMatch(SetMatch* matches, uint32_t* matchCount, uint32_t topCount, const SetMatch* match) { /** Sub-function of findSimilarSets, keeps matches sorted, most similar first **/
+	uint32_t position = *matchCount;
+	while(position > 0 && matches[position - 1].similarity < match->similarity) { //Strictly less, so an equal match stays behind the earlier one
+		position--;
+	}
+	if(position >= topCount) {
+		return;
+	}
+	
+	uint32_t last = (*matchCount < topCount) ? *matchCount : topCount - 1;
+	memmove(matches + position + 1, matches + position, (last - position) * sizeof(SetMatch));
+	matches[position] = *match;
+	if(*matchCount < topCount) {
+		(*matchCount)++;
+	}
+}
@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "..\Header Files\Stats.h"
+#include "..\Header Files\Platform.h"
+
+#define true 1
+#define false 0
+
+typedef struct {
+	const char* name; //Always a string literal, so it is only ever compared and printed
+	double seconds;
+	uint64_t calls;
+	uint64_t items;
+	uint64_t bytes;
+} StageTotals;
+
+typedef struct {
+	const char* name;
+	uint64_t value;
+} Counter;
+
+/**
+ * The registry every program shares. Everything but statsEnabled is guarded by statsLock:
+ */
+int statsEnabled = false;
+pthread_mutex_t statsLock = PTHREAD_MUTEX_INITIALIZER;
+const char* statsProgramName = NULL;
+double statsStartTime = 0.0;
+StageTotals stageTotals[STATS_MAX_STAGES];
+int stageCount = 0;
+Counter counters[STATS_MAX_COUNTERS];
+int counterCount = 0;
+uint64_t allocationCount = 0;
+uint64_t allocationBytes = 0;
+uint64_t latencyBuckets[STATS_HISTOGRAM_BUCKETS];
+uint64_t latencyCount = 0;
+double latencyTotal = 0.0;
+double latencyMax = 0.0;
+
+double bucketBound(int bucket); /** Sub-function of writeStatsReport, the upper bound of the bucket in seconds **/
+void writeSeconds(FILE* output, const char* name, double seconds); /** Sub-function of writeStatsReport, writes "name": seconds **/
+
+void enableStats(const char* programName) {
+	statsProgramName = programName;
+	statsStartTime = wallClockSeconds();
+	statsEnabled = true;
+}
+
+double statsClock() { /** wallClockSeconds() while stats are enabled, or 0 **/
+	return (statsEnabled == true) ? wallClockSeconds() : 0.0;
+}
+
+void addStageTime(const char* stage, double startTime, uint64_t items, uint64_t bytes) { /** Adds the time since startTime (from statsClock()), one call, and the work done, to the named stage **/
+	if(statsEnabled == false) {
+		return;
+	}
+	double seconds = wallClockSeconds() - startTime;
+	
+	pthread_mutex_lock(&statsLock);
+	int s = 0;
+	while(s < stageCount && strcmp(stageTotals[s].name, stage) != 0) {
+		s++;
+	}
+	if(s == stageCount && stageCount < STATS_MAX_STAGES) {
+		memset(&stageTotals[s], 0, sizeof(StageTotals));
+		stageTotals[s].name = stage;
+		stageCount++;
+	}
+	if(s < stageCount) {
+		stageTotals[s].seconds += seconds;
+		stageTotals[s].calls++;
+		stageTotals[s].items += items;
+		stageTotals[s].bytes += bytes;
+	}
+	pthread_mutex_unlock(&statsLock);
+}
+
+void addCounter(const char* counter, uint64_t value) {
+	if(statsEnabled == false) {
+		return;
+	}
+	
+	pthread_mutex_lock(&statsLock);
+	int c = 0;
+	while(c < counterCount && strcmp(counters[c].name, counter) != 0) {
+		c++;
+	}
+	if(c == counterCount && counterCount < STATS_MAX_COUNTERS) {
+		counters[c].name = counter;
+		counters[c].value = 0;
+		counterCount++;
+	}
+	if(c < counterCount) {
+		counters[c].value += value;
+	}
+	pthread_mutex_unlock(&statsLock);
+}
+
+void countAllocation(uint64_t bytes) {
+	if(statsEnabled == false) {
+		return;
+	}
+	pthread_mutex_lock(&statsLock);
+	allocationCount++;
+	allocationBytes += bytes;
+	pthread_mutex_unlock(&statsLock);
+}
+
+/**
+ * Pair latencies are only recorded from the thread that prints the results, but the lock is cheap when uncontended
+ * and keeps this safe to call from anywhere.
+ */
+void recordPairLatency(double seconds) { /** Adds one pair comparison's time to the histogram **/
+	if(statsEnabled == false) {
+		return;
+	}
+	double nanoseconds = seconds * 1e9;
+	int bucket = 0;
+	while(bucket < STATS_HISTOGRAM_BUCKETS - 1 && nanoseconds >= bucketBound(bucket) * 1e9) {
+		bucket++;
+	}
+	
+	pthread_mutex_lock(&statsLock);
+	latencyBuckets[bucket]++;
+	latencyCount++;
+	latencyTotal += seconds;
+	if(seconds > latencyMax) {
+		latencyMax = seconds;
+	}
+	pthread_mutex_unlock(&statsLock);
+}
+
+int writeStatsReport(const char* fileName) { /** Returns 0 on success **/
+	FILE* output = fopen(fileName, "w");
+	if(output == NULL) {
+		return -1;
+	}
+	
+	pthread_mutex_lock(&statsLock);
+	fprintf(output, "{\n");
+	fprintf(output, "  \"program\": \"%s\",\n", statsProgramName != NULL ? statsProgramName : "");
+	fprintf(output, "  \"wallSeconds\": %.6f,\n", wallClockSeconds() - statsStartTime);
+	fprintf(output, "  \"peakResidentBytes\": %llu,\n", (unsigned long long)peakResidentBytes());
+	fprintf(output, "  \"allocations\": {\"count\": %llu, \"bytes\": %llu},\n", (unsigned long long)allocationCount, (unsigned long long)allocationBytes);
+	
+	fprintf(output, "  \"stages\": [\n");
+	for(int s = 0; s < stageCount; s++) {
+		fprintf(output, "    {\"name\": \"%s\", \"seconds\": %.6f, \"calls\": %llu, \"items\": %llu, \"bytes\": %llu}%s\n", stageTotals[s].name, stageTotals[s].seconds, (unsigned long long)stageTotals[s].calls, (unsigned long long)stageTotals[s].items, (unsigned long long)stageTotals[s].bytes, (s + 1 < stageCount) ? "," : "");
+	}
+	fprintf(output, "  ],\n");
+	
+	fprintf(output, "  \"counters\": {");
+	for(int c = 0; c < counterCount; c++) {
+		fprintf(output, "%s\"%s\": %llu", (c > 0) ? ", " : "", counters[c].name, (unsigned long long)counters[c].value);
+	}
+	fprintf(output, "},\n");
+	
+	//Each percentile is the upper bound of the bucket where the running count first reaches it:
+	double percentiles[3] = {0.5, 0.9, 0.99};
+	double percentileSeconds[3] = {0.0, 0.0, 0.0};
+	for(int p = 0; p < 3; p++) {
+		uint64_t running = 0;
+		for(int b = 0; b < STATS_HISTOGRAM_BUCKETS && latencyCount > 0; b++) {
+			running += latencyBuckets[b];
+			if((double)running >= percentiles[p] * latencyCount) {
+				percentileSeconds[p] = bucketBound(b);
+				break;
+			}
+		}
+	}
+	fprintf(output, "  \"pairLatency\": {\"count\": %llu, ", (unsigned long long)latencyCount);
+	writeSeconds(output, "meanSeconds", latencyCount > 0 ? latencyTotal / latencyCount : 0.0);
+	writeSeconds(output, "maxSeconds", latencyMax);
+	writeSeconds(output, "p50Seconds", percentileSeconds[0]);
+	writeSeconds(output, "p90Seconds", percentileSeconds[1]);
+	writeSeconds(output, "p99Seconds", percentileSeconds[2]);
+	fprintf(output, "\"buckets\": [");
+	int listed = 0;
+	for(int b = 0; b < STATS_HISTOGRAM_BUCKETS; b++) {
+		if(latencyBuckets[b] > 0) {
+			fprintf(output, "%s{\"fromNanoseconds\": %.0f, \"toNanoseconds\": %.0f, \"count\": %llu}", (listed++ > 0) ? ", " : "", (b > 0) ? bucketBound(b - 1) * 1e9 : 0.0, bucketBound(b) * 1e9, (unsigned long long)latencyBuckets[b]);
+		}
+	}
+	fprintf(output, "]}\n");
+	fprintf(output, "}\n");
+	pthread_mutex_unlock(&statsLock);
+	
+	return (fclose(output) == 0) ? 0 : -1;
+}
+
+double bucketBound(int bucket) { /** Sub-function of writeStatsReport, the upper bound of the bucket in seconds **/
+	return (double)((uint64_t)2 << bucket) / 1e9;
+}
+
+void writeSeconds(FILE* output, const char* name, double seconds) { /** Sub-function of writeStatsReport, writes "name": seconds **/
+	fprintf(output, "\"%s\": %.9f, ", name, seconds);
+}
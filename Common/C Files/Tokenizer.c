@@ -0,0 +1,296 @@
+#include <stdlib.h>
+#include <string.h>
+#include "..\Header Files\Tokenizer.h"
+#include "..\Header Files\Platform.h"
+
+#define true 1
+#define false 0
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define HAVE_X86_KERNELS
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define TARGET_SSSE3
+		#define TARGET_AVX2
+	#else
+		#define TARGET_SSSE3 __attribute__((target("ssse3")))
+		#define TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+typedef uint64_t (*ClassifyKernel)(const DelimiterSet* set, const char* block, char* folded);
+
+void classifyNextBlock(Tokenizer* tokenizer); /** Sub-function of nextToken, turns the next block's delimiter mask into its token boundaries **/
+	uint64_t classifyAt(const DelimiterSet* set, const char* text, size_t length, size_t offset, char* foldedText); /** Sub-function of classifyNextBlock and countTokens, the delimiter mask of the block at offset, using the selected kernel if it can **/
+	uint64_t classifyScalar(const DelimiterSet* set, const char* block, char* folded); /** Sub-function of classifyAt, the scalar kernel **/
+	uint64_t classifyTail(const DelimiterSet* set, const char* block, size_t length, char* folded); /** Sub-function of classifyAt, classifies the last, partial block; bits past its end are marked as delimiters **/
+int lowestSetBit(uint64_t mask); /** Position of the lowest set bit of a mask that is not 0 **/
+#ifdef HAVE_X86_KERNELS
+	int tokenizerCpuSupports(const char* feature); /** Sub-function of selectTokenizerKernel, asks the processor (and operating system) whether "ssse3" or "avx2" can be used **/
+	uint64_t classifySsse3(const DelimiterSet* set, const char* block, char* folded);
+	uint64_t classifyAvx2(const DelimiterSet* set, const char* block, char* folded);
+#endif
+
+/**
+ * The selected kernel. It is chosen once, before any text is tokenized, and never changes while threads use it:
+ */
+ClassifyKernel classifyBlock = NULL;
+const char* selectedTokenizerName = NULL;
+
+int selectTokenizerKernel(const char* name) { /** "auto", "scalar", "ssse3" or "avx2"; returns false if the name is unknown or the processor lacks the instructions **/
+	int automatic = (strcmp(name, "auto") == 0);
+
+#ifdef HAVE_X86_KERNELS
+	if((automatic || strcmp(name, "avx2") == 0) && tokenizerCpuSupports("avx2")) {
+		classifyBlock = classifyAvx2;
+		selectedTokenizerName = "avx2";
+		return true;
+	}
+	if((automatic || strcmp(name, "ssse3") == 0) && tokenizerCpuSupports("ssse3")) {
+		classifyBlock = classifySsse3;
+		selectedTokenizerName = "ssse3";
+		return true;
+	}
+#endif
+	if(automatic || strcmp(name, "scalar") == 0) {
+		classifyBlock = classifyScalar;
+		selectedTokenizerName = "scalar";
+		return true;
+	}
+	return false;
+}
+
+const char* tokenizerKernelName() {
+	if(selectedTokenizerName == NULL) {
+		selectTokenizerKernel("auto");
+	}
+	return selectedTokenizerName;
+}
+
+/**
+ * Each distinct high nibble among the delimiters gets a bit of its own. highNibbleClasses holds that bit for the
+ * nibble, and lowNibbleClasses, for each low nibble, the bits of every high nibble that makes a delimiter with it,
+ * so the AND of the two lookups is nonzero exactly for the delimiters. There are only 8 bits to give out.
+ */
+void initDelimiterSet(DelimiterSet* set, const char* delimiters) { /** delimiters is a null-terminated string of the bytes that separate tokens **/
+	memset(set, 0, sizeof(DelimiterSet));
+	for(const char* delimiter = delimiters; *delimiter != '\0'; delimiter++) {
+		set->isDelimiter[(unsigned char)*delimiter] = true;
+	}
+	
+	int classCount = 0;
+	set->vectorized = true;
+	for(int high = 0; high < 16; high++) {
+		int used = false;
+		for(int low = 0; low < 16; low++) {
+			used |= set->isDelimiter[high * 16 + low];
+		}
+		if(used == false) {
+			continue;
+		}
+		if(classCount == 8) {
+			set->vectorized = false;
+			break;
+		}
+		set->highNibbleClasses[high] = (uint8_t)(1 << classCount);
+		for(int low = 0; low < 16; low++) {
+			if(set->isDelimiter[high * 16 + low] == true) {
+				set->lowNibbleClasses[low] |= (uint8_t)(1 << classCount);
+			}
+		}
+		classCount++;
+	}
+}
+
+void beginTokens(Tokenizer* tokenizer, const DelimiterSet* delimiters, const char* text, size_t length) {
+	memset(tokenizer, 0, sizeof(Tokenizer));
+	tokenizer->delimiters = delimiters;
+	tokenizer->text = text;
+	tokenizer->length = length;
+	if(classifyBlock == NULL) {
+		selectTokenizerKernel("auto");
+	}
+}
+
+void beginFoldedTokens(Tokenizer* tokenizer, const DelimiterSet* delimiters, char* text, size_t length) { /** As beginTokens(), but each byte is turned to ASCII lower case as it is passed **/
+	beginTokens(tokenizer, delimiters, text, length);
+	tokenizer->foldedText = text;
+}
+
+/**
+ * Each set bit of boundaries alternately starts and ends a token, so the tokens come out of the masks with one
+ * bit scan each, however long they are. A token still open after the last block ends with the text.
+ */
+int nextToken(Tokenizer* tokenizer, size_t* start, size_t* length) { /** Gives the offset and length of the next token, or returns false once there are none left **/
+	while(true) {
+		while(tokenizer->boundaries != 0) {
+			size_t position = tokenizer->blockStart + (size_t)lowestSetBit(tokenizer->boundaries);
+			tokenizer->boundaries &= tokenizer->boundaries - 1;
+			if(tokenizer->inToken == false) {
+				tokenizer->tokenStart = position;
+				tokenizer->inToken = true;
+			} else {
+				tokenizer->inToken = false;
+				*start = tokenizer->tokenStart;
+				*length = position - tokenizer->tokenStart;
+				return true;
+			}
+		}
+		
+		if(tokenizer->nextBlock >= tokenizer->length) {
+			if(tokenizer->inToken == false) {
+				return false;
+			}
+			tokenizer->inToken = false;
+			*start = tokenizer->tokenStart;
+			*length = tokenizer->length - tokenizer->tokenStart;
+			return true;
+		}
+		classifyNextBlock(tokenizer);
+	}
+}
+
+/**
+ * A token starts wherever a non-delimiter follows a delimiter (or the start of the text), so the tokens in each
+ * block are counted from its mask alone, with no loop over the tokens themselves.
+ */
+uint64_t countTokens(const DelimiterSet* delimiters, const char* text, size_t length) {
+	uint64_t count = 0;
+	uint64_t previousInToken = 0;
+	
+	if(classifyBlock == NULL) {
+		selectTokenizerKernel("auto");
+	}
+	for(size_t offset = 0; offset < length; offset += TOKENIZER_BLOCK) {
+		uint64_t inToken = ~classifyAt(delimiters, text, length, offset, NULL);
+		count += countBits(inToken & ~((inToken << 1) | previousInToken));
+		previousInToken = inToken >> 63;
+	}
+	return count;
+}
+
+void classifyNextBlock(Tokenizer* tokenizer) { /** Sub-function of nextToken, turns the next block's delimiter mask into its token boundaries **/
+	uint64_t inToken = ~classifyAt(tokenizer->delimiters, tokenizer->text, tokenizer->length, tokenizer->nextBlock, tokenizer->foldedText);
+	tokenizer->boundaries = inToken ^ ((inToken << 1) | tokenizer->previousInToken); //Set wherever a byte differs from the one before it
+	tokenizer->previousInToken = inToken >> 63;
+	tokenizer->blockStart = tokenizer->nextBlock;
+	tokenizer->nextBlock += TOKENIZER_BLOCK;
+}
+
+uint64_t classifyAt(const DelimiterSet* set, const char* text, size_t length, size_t offset, char* foldedText) { /** Sub-function of classifyNextBlock and countTokens, the delimiter mask of the block at offset, using the selected kernel if it can **/
+	char* folded = (foldedText != NULL) ? foldedText + offset : NULL;
+	if(length - offset < TOKENIZER_BLOCK) {
+		return classifyTail(set, text + offset, length - offset, folded);
+	} else if(set->vectorized == true) {
+		return classifyBlock(set, text + offset, folded);
+	}
+	return classifyScalar(set, text + offset, folded);
+}
+
+uint64_t classifyScalar(const DelimiterSet* set, const char* block, char* folded) { /** Sub-function of classifyAt, the scalar kernel **/
+	return classifyTail(set, block, TOKENIZER_BLOCK, folded);
+}
+
+uint64_t classifyTail(const DelimiterSet* set, const char* block, size_t length, char* folded) { /** Sub-function of classifyAt, classifies the last, partial block; bits past its end are marked as delimiters **/
+	uint64_t delimiters = (length < TOKENIZER_BLOCK) ? ~(uint64_t)0 << length : 0;
+	for(size_t i = 0; i < length; i++) {
+		unsigned char byte = (unsigned char)block[i];
+		delimiters |= (uint64_t)set->isDelimiter[byte] << i;
+		if(folded != NULL && (unsigned)(byte - 'A') < 26u) {
+			folded[i] = (char)(byte + ('a' - 'A'));
+		}
+	}
+	return delimiters;
+}
+
+int lowestSetBit(uint64_t mask) { /** Position of the lowest set bit of a mask that is not 0 **/
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long position;
+	_BitScanForward64(&position, mask);
+	return (int)position;
+#elif defined(__GNUC__)
+	return __builtin_ctzll(mask);
+#else
+	int position = 0;
+	while((mask & 1) == 0) {
+		mask >>= 1;
+		position++;
+	}
+	return position;
+#endif
+}
+
+#ifdef HAVE_X86_KERNELS
+
+int tokenizerCpuSupports(const char* feature) { /** Sub-function of selectTokenizerKernel, asks the processor (and operating system) whether "ssse3" or "avx2" can be used **/
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	if(strcmp(feature, "ssse3") == 0) {
+		return (info[2] & (1 << 9)) != 0;
+	}
+	if((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6) { //The operating system must save the AVX registers on a context switch
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	if(strcmp(feature, "ssse3") == 0) {
+		return __builtin_cpu_supports("ssse3");
+	}
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+/**
+ * Looks up the low and high nibble of 16 bytes at once with PSHUFB; a byte is a delimiter where the two lookups
+ * share a bit. Upper case letters are found by moving 'A' to -128 and comparing below -128 + 26, as SSE only has
+ * signed comparisons, and get 0x20 added.
+ */
+TARGET_SSSE3 uint64_t classifySsse3(const DelimiterSet* set, const char* block, char* folded) {
+	const __m128i lowTable = _mm_loadu_si128((const __m128i*)set->lowNibbleClasses);
+	const __m128i highTable = _mm_loadu_si128((const __m128i*)set->highNibbleClasses);
+	const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+	const __m128i zero = _mm_setzero_si128();
+	uint64_t delimiters = 0;
+	
+	for(int i = 0; i < TOKENIZER_BLOCK; i += 16) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(block + i));
+		__m128i low = _mm_shuffle_epi8(lowTable, _mm_and_si128(bytes, nibbleMask));
+		__m128i high = _mm_shuffle_epi8(highTable, _mm_and_si128(_mm_srli_epi16(bytes, 4), nibbleMask));
+		__m128i notDelimiter = _mm_cmpeq_epi8(_mm_and_si128(low, high), zero);
+		delimiters |= (uint64_t)(~_mm_movemask_epi8(notDelimiter) & 0xFFFF) << i;
+		if(folded != NULL) {
+			__m128i shifted = _mm_add_epi8(bytes, _mm_set1_epi8((char)(0x80 - 'A')));
+			__m128i upper = _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(-128 + 26)));
+			_mm_storeu_si128((__m128i*)(folded + i), _mm_add_epi8(bytes, _mm_and_si128(upper, _mm_set1_epi8('a' - 'A'))));
+		}
+	}
+	return delimiters;
+}
+
+TARGET_AVX2 uint64_t classifyAvx2(const DelimiterSet* set, const char* block, char* folded) {
+	const __m256i lowTable = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)set->lowNibbleClasses)); //VPSHUFB looks up within each 128-bit lane
+	const __m256i highTable = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)set->highNibbleClasses));
+	const __m256i nibbleMask = _mm256_set1_epi8(0x0F);
+	const __m256i zero = _mm256_setzero_si256();
+	uint64_t delimiters = 0;
+	
+	for(int i = 0; i < TOKENIZER_BLOCK; i += 32) {
+		__m256i bytes = _mm256_loadu_si256((const __m256i*)(block + i));
+		__m256i low = _mm256_shuffle_epi8(lowTable, _mm256_and_si256(bytes, nibbleMask));
+		__m256i high = _mm256_shuffle_epi8(highTable, _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibbleMask));
+		__m256i notDelimiter = _mm256_cmpeq_epi8(_mm256_and_si256(low, high), zero);
+		delimiters |= (uint64_t)(~(uint32_t)_mm256_movemask_epi8(notDelimiter)) << i;
+		if(folded != NULL) {
+			__m256i shifted = _mm256_add_epi8(bytes, _mm256_set1_epi8((char)(0x80 - 'A')));
+			__m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(-128 + 26)), shifted);
+			_mm256_storeu_si256((__m256i*)(folded + i), _mm256_add_epi8(bytes, _mm256_and_si256(upper, _mm256_set1_epi8('a' - 'A'))));
+		}
+	}
+	return delimiters;
+}
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A region allocator. Memory is handed out from large blocks by bumping an offset, and is all given back at once by
+ * resetArena() or deleteArena(); nothing allocated from an arena is ever freed on its own. There is no per-allocation
+ * header, so many small arrays cost no more than one large one, and arrays allocated one after another lie next to
+ * each other in memory. An arena is not thread-safe: give each thread its own.
+ */
+#define ARENA_ALIGNMENT 32 //Every allocation starts at a multiple of this many bytes, so it can be read with aligned 256-bit loads
+#define ARENA_DEFAULT_BLOCK_SIZE 1048576 //Bytes per block when createArena() is given 0; a larger allocation gets a block of its own
+
+typedef struct ArenaBlock {
+	struct ArenaBlock* next; //The block that was in use before this one, or NULL
+	unsigned char* data; //ARENA_ALIGNMENT-aligned start of the block's memory
+	size_t used;
+	size_t capacity;
+} ArenaBlock;
+
+typedef struct {
+	ArenaBlock* blocks; //The block allocations are taken from, followed by every earlier one
+	size_t blockSize;
+	uint64_t reservedBytes; //Capacity of every block, which is the memory the arena holds
+} Arena;
+
+Arena* createArena(size_t blockSize); /** Returns NULL if out of memory **/
+void* arenaAllocate(Arena* arena, size_t bytes); /** Returns ARENA_ALIGNMENT-aligned memory, or NULL if out of memory **/
+void arenaTrim(Arena* arena, void* allocation, size_t bytes); /** Shrinks the most recent allocation to bytes, giving the rest back to the arena **/
+void resetArena(Arena* arena); /** Gives back everything allocated, but keeps the current block for reuse **/
+void deleteArena(Arena* arena);
+
+#endif
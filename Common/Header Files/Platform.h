@@ -0,0 +1,32 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * A whole file mapped read-only into memory:
+ */
+typedef struct {
+	void* data; //Start of the mapped region
+	uint64_t length; //In bytes
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#endif
+} MappedRegion;
+
+/**
+ * The few operating-system services that differ between Windows and POSIX, wrapped so the programs can share them.
+ */
+double wallClockSeconds(); /** Seconds on a monotonic clock; only differences between two calls are meaningful **/
+int processorCount(); /** Number of processors available to this process, at least 1 **/
+char* absolutePath(const char* fileName); /** Returns a newly allocated absolute path for fileName, or NULL if it does not exist **/
+int mapFileReadOnly(const char* fileName, uint64_t minimumLength, MappedRegion* region); /** Returns 0 on success, -1 if the file does not exist, or -2 if it is shorter than minimumLength or cannot be mapped **/
+void unmapFile(MappedRegion* region);
+int seekFile(FILE* file, uint64_t offset); /** fseek() from the start of the file, but with a 64-bit offset; returns 0 on success **/
+int makeDirectory(const char* path); /** Creates the directory, unless it already exists; returns 0 on success **/
+uint64_t peakResidentBytes(); /** Most physical memory this process has used at once so far, or 0 if unknown **/
+uint64_t countBits(uint64_t word); /** Number of set bits in word, counted with shifts, masks and one multiply, so it needs no popcnt instruction or compiler builtin **/
+
+#endif
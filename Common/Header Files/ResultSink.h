@@ -0,0 +1,98 @@
+#ifndef RESULT_SINK_H
+#define RESULT_SINK_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/**
+ * Binary result files, written by "jaccard -matrix", "-edges" and "-neighbors" instead of printing each pair as text.
+ *
+ * A file is a ResultFileHeader, followed by every input's file name (null-terminated, in the order they were given,
+ * which is the order documents are numbered in), zero padding up to dataOffset, and then recordCount records:
+ *  - RESULT_MATRIX: one float per pair (i,k) with i < k, in (i,k) order, so pair (i,k) is record
+ *    i * (2 * fileCount - i - 1) / 2 + (k - i - 1). Pairs that were never compared (pruned by -t or -lsh) hold 0
+ *  - RESULT_EDGES: one ResultEdge for each pair whose similarity is above 0 and at least threshold (compared in single
+ *    precision), in the order the pairs were compared
+ *  - RESULT_TOP: topCount ResultNeighbors per document, most similar first, with ties going to the lower document
+ *    number. Only pairs more than 0 similar count, and a document with fewer neighbors than topCount is padded with
+ *    RESULT_NO_DOCUMENT entries of similarity 0
+ * The header is 56 bytes and dataOffset is a multiple of 8, so the records are aligned in a mapped file. Like binary
+ * shingle files, everything is stored in the byte order of the machine that wrote it.
+ */
+#define RESULT_FILE_MAGIC "JRESULTS"
+#define RESULT_FILE_VERSION 1
+#define RESULT_MATRIX 0
+#define RESULT_EDGES 1
+#define RESULT_TOP 2
+#define RESULT_NO_DOCUMENT UINT32_MAX
+
+/**
+ * The pairs handed to the writer thread at once, and the number of such buffers. The thread that adds results only
+ * waits when every buffer is full and still waiting to be written.
+ */
+#define RESULT_BUFFER_RECORDS 65536
+#define RESULT_BUFFER_COUNT 4
+#define RESULT_FILE_BUFFER_SIZE 1048576 //Bytes of stdio buffer given to each result file
+
+typedef struct {
+	char magic[8]; //RESULT_FILE_MAGIC, without a terminating zero
+	uint32_t version;
+	uint32_t kind; //One of RESULT_MATRIX, RESULT_EDGES or RESULT_TOP
+	uint32_t fileCount;
+	uint32_t topCount; //Neighbors per document in a RESULT_TOP file, otherwise 0
+	double threshold; //Lowest similarity in a RESULT_EDGES file, otherwise 0
+	uint64_t namesLength; //In bytes, counting each terminating zero
+	uint64_t dataOffset;
+	uint64_t recordCount;
+} ResultFileHeader;
+
+typedef struct {
+	uint32_t i, k;
+	float similarity;
+} ResultEdge;
+
+typedef struct {
+	uint32_t document;
+	float similarity;
+} ResultNeighbor;
+
+/**
+ * The result files being written by one run. Results are added by a single thread, a buffer at a time, and written
+ * by the sink's own thread, so formatting and writing them never holds up the comparisons.
+ */
+typedef struct {
+	uint32_t fileCount;
+	const char* matrixName; //Each of the three files is NULL if it was not asked for
+	const char* edgesName;
+	const char* topName;
+	FILE* matrixFile;
+	FILE* edgesFile;
+	FILE* topFile;
+	uint64_t matrixOffset; //dataOffset of each file
+	uint64_t edgesOffset;
+	uint64_t topOffset;
+	double edgeThreshold;
+	uint64_t edgeCount;
+	uint32_t topCount;
+	ResultNeighbor* neighbors; //topCount per document, for the top file
+	uint32_t* neighborCounts;
+	float* matrixRun; //Matrix values for consecutive pairs, written with a single fwrite()
+	uint64_t matrixRunStart;
+	uint64_t matrixRunLength;
+	uint64_t matrixEnd; //Records the matrix file has been written up to
+	ResultEdge* buffers[RESULT_BUFFER_COUNT];
+	uint64_t bufferCounts[RESULT_BUFFER_COUNT]; //Records in each full buffer, or 0 while it is free
+	int filling; //The buffer results are being added to
+	uint64_t filled; //Records in it so far
+	int finished; //Set once the last buffer has been handed over
+	pthread_mutex_t lock; //Guards bufferCounts and finished
+	pthread_cond_t changed;
+	pthread_t writer;
+} ResultSink;
+
+ResultSink* openResultSink(char** fileNames, uint32_t fileCount, const char* matrixName, const char* edgesName, double edgeThreshold, const char* topName, uint32_t topCount); /** Any of the three names may be NULL **/
+void addResult(ResultSink* sink, uint32_t i, uint32_t k, double similarity);
+void closeResultSink(ResultSink* sink); /** Writes everything still buffered, and finishes each file **/
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef SERVER_PROTOCOL_H
+#define SERVER_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The binary protocol of the similarity server ("server -socket NAME"), spoken over a local (Unix domain) socket.
+ *
+ * A client sends requests, each a ServerRequest followed by length bytes of payload, and the server answers each with
+ * a ServerResponse followed by length bytes of payload, in the order the requests were sent on that connection. A
+ * client need not wait for one response before sending the next request; the tag of each request is copied into its
+ * response. The requests are:
+ *  - SERVER_ADD: the payload is the text of a document, which the server shingles and keeps. The response gives the
+ *    number the document was given; documents are numbered from 0 in the order they are added, and never reused
+ *  - SERVER_REMOVE: forgets document number document
+ *  - SERVER_COMPARE: gives the exact Jaccard similarity of documents document and other, or, if there is a payload,
+ *    of the text in it and document number document
+ *  - SERVER_TOP: gives the (at most) other documents most similar to the text in the payload, or, if there is none, to
+ *    document number document (leaving that one out). The payload of the response is count IndexMatch records (see
+ *    ShingleIndex.h), most similar first; documents sharing no shingle with the query are never listed
+ *  - SERVER_STATS: the payload of the response is the server's report of its request rates and latencies, as text
+ *  - SERVER_SHUTDOWN: the server answers, then stops once every worker has finished its current batch
+ * A request the server cannot parse closes the connection. Everything is in the byte order of the machine, which is
+ * always the same at both ends of a local socket.
+ */
+#define SERVER_ADD 1 //Request types
+#define SERVER_REMOVE 2
+#define SERVER_COMPARE 3
+#define SERVER_TOP 4
+#define SERVER_STATS 5
+#define SERVER_SHUTDOWN 6
+#define SERVER_REQUEST_TYPES 7 //One more than the last type, for arrays indexed by type
+
+#define SERVER_OK 0 //Response statuses
+#define SERVER_UNKNOWN_DOCUMENT 1 //A document number was never given out, or the document was removed
+#define SERVER_BAD_REQUEST 2 //Unknown type, or a text that could not be shingled
+#define SERVER_FULL 3 //The server could not allocate the memory the request needed
+
+#define SERVER_MAX_PAYLOAD 268435456 //Largest payload the server accepts, in bytes
+
+typedef struct {
+	uint32_t type; //One of the SERVER_ request types
+	uint32_t tag; //Any value, copied into the response
+	uint32_t document;
+	uint32_t other; //SERVER_COMPARE: the second document; SERVER_TOP: the most documents to list
+	uint64_t length; //Bytes of payload that follow
+} ServerRequest;
+
+typedef struct {
+	uint32_t status; //One of the SERVER_ statuses
+	uint32_t tag;
+	uint32_t document; //SERVER_ADD: the new document's number
+	uint32_t count; //SERVER_TOP: IndexMatch records in the payload
+	double similarity; //SERVER_COMPARE
+	uint64_t length; //Bytes of payload that follow
+} ServerResponse;
+
+/**
+ * Local stream sockets, named by a path in the file system. Windows (10 and later) has these too, through Winsock.
+ * Each function returns -1 (or, for those returning a status, a non-zero value) if the operating system refuses.
+ */
+int listenLocalSocket(const char* path); /** Replaces any socket file left at path, and listens there **/
+int acceptLocalSocket(int listener); /** Waits for the next connection to a listening socket **/
+int connectLocalSocket(const char* path);
+int sendAll(int socket, const void* data, size_t length); /** Returns 0 once every byte is sent **/
+int receiveAll(int socket, void* data, size_t length); /** Returns 0 once length bytes are received, or -1 if the connection closes first **/
+long long receiveSome(int socket, void* buffer, size_t capacity); /** Returns the bytes received (at least 1), 0 if the connection closed, or -1 **/
+int waitForSockets(const int* sockets, int count, int milliseconds, int* ready); /** Sets ready[s] to true for each socket with data (or a closed connection) to read, and returns how many are ready, 0 on time out, or -1 **/
+void closeLocalSocket(int socket);
+void removeLocalSocket(const char* path); /** Deletes the socket file a listener leaves behind **/
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef SET_INTERSECTION_H
+#define SET_INTERSECTION_H
+
+#include <stdint.h>
+
+/**
+ * Counts the values two sorted, duplicate-free arrays have in common. This is the innermost step of every exact
+ * comparison, so there are several kernels, and the fastest one the processor supports is chosen at run time:
+ *  - "scalar": a branch-free merge, which works everywhere
+ *  - "sse4": compares blocks of 128 bits of each array against every rotation of the other (SSE4.1)
+ *  - "avx2": the same with blocks of 256 bits (AVX2)
+ * Whichever kernel is selected, arrays of very different lengths are instead intersected by galloping: each value
+ * of the shorter array is found in the longer one with an exponential, then binary search.
+ *
+ * Sets drawn from a small, fixed universe of values can also be held as bitsets, with bit v of word v / 64 set if
+ * the set holds v. Their intersection is then the population count of the AND of the two bitsets, which costs the
+ * same for every pair whatever the values are. The kernel selected above also picks how that is counted: with a
+ * portable bit-twiddling count ("scalar"), the POPCNT instruction where the processor has it ("sse4"), or 256 bits
+ * at a time through a nibble lookup table ("avx2").
+ */
+#define GALLOP_RATIO 32 //Gallop once one array is at least this many times longer than the other
+#define BITSET_WORDS(universe) (((universe) + 63) / 64) //64-bit words in a bitset over values 0 to universe - 1
+
+int selectIntersectionKernel(const char* name); /** "auto", "scalar", "sse4" or "avx2"; returns false if the name is unknown or the processor lacks the instructions **/
+const char* intersectionKernelName(); /** Name of the kernel in use **/
+uint64_t intersectionCount64(const uint64_t* a, uint64_t aCount, const uint64_t* b, uint64_t bCount);
+uint64_t intersectionCount32(const uint32_t* a, uint64_t aCount, const uint32_t* b, uint64_t bCount);
+uint64_t* createBitset(const uint64_t* values, uint64_t count, uint64_t universe); /** Returns a newly allocated bitset holding values, every one of which must be below universe, or NULL if out of memory **/
+uint64_t bitsetIntersectionCount(const uint64_t* a, const uint64_t* b, uint64_t words); /** Values held by both bitsets **/
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef SHARD_FILE_H
+#define SHARD_FILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "Platform.h"
+
+/**
+ * Partial result files, written by each process of a sharded run ("jaccard -shard i/n -partial FILE") and combined
+ * by "jaccard -merge" into the output a single process would have given.
+ *
+ * The pairs a run compares form one sequence: every (i,k) with i < k in (i,k) order, or the candidate pairs of -t or
+ * -lsh, which every shard finds the same way. Shard i of n compares the pairs [firstPair, firstPair + pairCount) of
+ * that sequence, so the shards together cover it exactly once, and their results only need to be put back in shard
+ * order. A file is a ShardFileHeader, followed by every input's file name (null-terminated, in the order they were
+ * given), zero padding up to dataOffset, and then resultCount ShardResults, in the order the pairs were compared.
+ * Everything is stored in the byte order of the machine that wrote it, like binary shingle files.
+ */
+#define SHARD_FILE_MAGIC "JPARTIAL"
+#define SHARD_FILE_VERSION 1
+#define SHARD_EXACT 1 //Flags of a ShardResult
+#define SHARD_ESTIMATE 2
+
+/**
+ * Everything a shard knows that the merged output depends on, besides its results. Every field but shardIndex,
+ * firstPair, pairCount, resultCount and the two offsets must be the same in every shard of a run.
+ */
+typedef struct {
+	char magic[8]; //SHARD_FILE_MAGIC, without a terminating zero
+	uint32_t version;
+	uint32_t shardIndex; //From 1 to shardCount
+	uint32_t shardCount;
+	uint32_t fileCount;
+	uint64_t sequenceLength; //Pairs in the whole sequence the shards share
+	uint64_t firstPair;
+	uint64_t pairCount;
+	int32_t minHashSize; //The comparison options the pairs were compared with
+	int32_t signatureSize;
+	int32_t bands; //LSH bands and rows, or 0
+	int32_t rows;
+	double joinThreshold;
+	double lshThreshold;
+	uint64_t prefixPruned; //Pairs the threshold join's filters removed, out of every pair of files
+	uint64_t sizePruned;
+	uint64_t namesLength; //In bytes, counting each terminating zero
+	uint64_t dataOffset;
+	uint64_t resultCount;
+} ShardFileHeader;
+
+typedef struct {
+	uint32_t i, k;
+	int32_t intersectedSize;
+	int32_t unionedSize;
+	double similarity;
+	double estimatedSimilarity;
+	double seconds; //Time taken to compare the pair, or 0 if the shard recorded no stats
+	uint32_t flags; //SHARD_EXACT and/or SHARD_ESTIMATE, for each of the two similarities that is valid
+	uint32_t reserved; //Always 0
+} ShardResult;
+
+/**
+ * A partial result file mapped read-only into memory. fileNames and results point directly into the mapping.
+ */
+typedef struct {
+	const ShardFileHeader* header;
+	const char** fileNames;
+	const ShardResult* results;
+	MappedRegion region;
+} MappedShardFile;
+
+FILE* beginShardFile(const char* fileName, ShardFileHeader* header, char** fileNames); /** Fills in the magic, version and name fields of header, and writes it and the names; the caller then fwrite()s the results **/
+void finishShardFile(FILE* file, const char* fileName, uint64_t resultCount); /** Fills in the final count in the header, and closes the file **/
+MappedShardFile* openShardFile(const char* fileName);
+void closeShardFile(MappedShardFile* file);
+
+#endif
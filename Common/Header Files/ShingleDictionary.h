@@ -0,0 +1,62 @@
+#ifndef SHINGLE_DICTIONARY_H
+#define SHINGLE_DICTIONARY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/**
+ * Corpus-wide dictionary that gives every distinct shingle a dense 32-bit id: the first shingle interned is 0, the
+ * next new one 1, and so on. Two shingles only share an id if their text is the same, so sets of ids give exact
+ * Jaccard similarities with no hash collisions, in half the space of 64-bit hashes (see HASH_DICTIONARY in
+ * ShingleFile.h).
+ *
+ * A dictionary file is a ShingleDictionaryHeader, then the text of each shingle in id order, each followed by a '\n'
+ * (no shingle holds one, since a newline always separates two words). Shingles are only ever appended, so the ids in
+ * shingle files written against an earlier state of the dictionary stay valid as it grows. It is stored in the byte
+ * order of the machine that wrote it, like binary shingle files.
+ *
+ * Every shingle file of ids records the dictionary's identity and how many shingles it had saved (see DictionaryStamp
+ * in ShingleFile.h), and is only written once the ids it holds have been saved, so a run that fails part way through
+ * never leaves a file holding ids that a later run could give to other shingles.
+ */
+#define SHINGLE_DICTIONARY_MAGIC "JSHDICTN"
+#define SHINGLE_DICTIONARY_VERSION 2 //Version 1 had no identity
+
+typedef struct {
+	char magic[8]; //SHINGLE_DICTIONARY_MAGIC, without a terminating zero
+	uint32_t version;
+	uint32_t reserved; //Always 0
+	uint64_t identity; //Chosen at random when the dictionary is created, and never changed
+	uint64_t shingleCount;
+	uint64_t textLength; //Bytes of shingle text following the header; anything past this was left by a run that did not finish
+} ShingleDictionaryHeader;
+
+/**
+ * An open dictionary. Ids are found through an open-addressing table keyed by the text's hash, which is kept for
+ * every id so that most probes are settled without comparing any text. Interning takes the lock, so any number of
+ * threads can share one dictionary; only one process should update a dictionary file at a time.
+ */
+typedef struct {
+	char* fileName;
+	uint64_t identity;
+	char* text; //The text of every shingle, in id order, each followed by a '\n'
+	uint64_t textLength;
+	uint64_t textCapacity;
+	uint64_t* offsets; //Position of each id's text in text, followed by textLength, so an id's text ends where the next one's starts
+	uint32_t* hashes; //Hash of each id's text
+	uint32_t count;
+	uint32_t capacity; //Ids that offsets and hashes have room for
+	uint32_t* slots; //Id + 1, or 0 for an empty slot
+	uint32_t slotCapacity; //Always a power of two
+	uint32_t savedCount; //Ids already in the file; the rest are appended by saveShingleDictionary()
+	uint64_t savedLength;
+	pthread_mutex_t lock; //Guards everything above while shingles are interned
+} ShingleDictionary;
+
+ShingleDictionary* openShingleDictionary(const char* fileName); /** Loads the dictionary, or starts an empty one if the file does not exist yet **/
+uint32_t* internShingleList(ShingleDictionary* dictionary, const char* text, size_t length, uint64_t* count); /** Returns the sorted, distinct ids of the comma-delimited shingles in text, in a new allocation, giving any new shingle the next free id **/
+uint32_t saveShingleDictionary(ShingleDictionary* dictionary); /** Appends the shingles interned since the file was last saved, then updates its header; returns how many shingles are now saved **/
+void closeShingleDictionary(ShingleDictionary* dictionary);
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef SHINGLE_FILE_H
+#define SHINGLE_FILE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "Platform.h"
+
+/**
+ * Binary shingle set format, written by shingle (-b) and read in place by jaccard.
+ *
+ * A file is a ShingleFileHeader followed immediately by (count) 64-bit shingle hashes,
+ * sorted in ascending order with no duplicates (or, for HASH_DICTIONARY, a DictionaryStamp and then 32-bit ids).
+ * All fields are stored in the byte order of the machine that wrote the file
+ * (little-endian on every platform we build for). The header is 32 bytes, so the
+ * hashes are 8-byte aligned in a mapped file.
+ */
+#define SHINGLE_FILE_MAGIC "JSHINGLE"
+#define SHINGLE_FILE_VERSION 1
+
+/**
+ * Hash algorithms that can be recorded in a shingle file, and selected in either program with "-hash NAME":
+ */
+#define HASH_LEGACY 0 //"legacy": the original polynomial string hash, reduced modulo 104729. Reproduces results from before -hash existed
+#define HASH_XXH64 1 //"xxh64": XXH64 with a seed of 0, a fast 64-bit hash that reads 8 bytes per step. The default
+#define HASH_ROLLING 2 //"rolling": a polynomial over the words (or characters) of a shingle, which slides along a text in O(1) per step, so shingles are never assembled as strings
+#define HASH_DICTIONARY 3 //"dictionary": not a hash, but each shingle's id in a ShingleDictionary, so no two shingles ever collide. Written by shingle -dict, and never chosen with -hash
+#define HASH_DEFAULT HASH_XXH64
+
+/**
+ * The rolling hash of a shingle of n terms t[0..n-1] is finishRollingHash() of the sum of t[j] * ROLLING_BASE^(n-1-j),
+ * modulo the Mersenne prime ROLLING_MODULUS. A word's term is its XXH64 hash reduced modulo ROLLING_MODULUS, and a
+ * character's term is its byte value plus 1. Moving the window one term along takes off the oldest term times
+ * ROLLING_BASE^(n-1), multiplies by ROLLING_BASE and adds the new term, however long the shingle is.
+ */
+#define ROLLING_MODULUS 0x1FFFFFFFFFFFFFFFULL //2^61 - 1, so reducing a product needs shifts and adds rather than a division
+#define ROLLING_BASE 0x0A3B5C7D9E1F2437ULL
+
+/**
+ * What the shingleSize of a shingle file counts. Character shingles are only made with HASH_ROLLING:
+ */
+#define SHINGLE_WORDS 0 //Each shingle is shingleSize consecutive words
+#define SHINGLE_CHARACTERS 1 //Each shingle is shingleSize consecutive characters, with every run of delimiters read as one space
+
+typedef struct {
+	char magic[8]; //SHINGLE_FILE_MAGIC, without a terminating zero
+	uint32_t version;
+	uint32_t shingleSize; //Words per shingle, or 0 if unknown (e.g. converted from a .csv file)
+	uint32_t hashAlgorithm; //One of the HASH_ constants
+	uint32_t shingleUnit; //SHINGLE_WORDS or SHINGLE_CHARACTERS; files from before character shingles always hold 0 here
+	uint64_t count; //Number of hashes following the header
+} ShingleFileHeader;
+
+/**
+ * Names the ShingleDictionary that the ids of a HASH_DICTIONARY file were given from, which the ids are only
+ * meaningful alongside. It lies between the header and the ids, and keeps them 8-byte aligned.
+ */
+typedef struct {
+	uint64_t dictionaryIdentity; //The identity in the dictionary's header, so files from different dictionaries are never compared
+	uint64_t dictionaryCount; //Shingles the dictionary had saved when the file was written; every id in the file is below this
+} DictionaryStamp;
+
+/**
+ * A shingle file mapped read-only into memory. hashes (or ids) points directly into the mapping.
+ */
+typedef struct {
+	const ShingleFileHeader* header;
+	const DictionaryStamp* stamp; //The stamp of a HASH_DICTIONARY file, otherwise NULL
+	const uint64_t* hashes; //NULL for a HASH_DICTIONARY file
+	const uint32_t* ids; //The ids of a HASH_DICTIONARY file, otherwise NULL
+	uint64_t count;
+	MappedRegion region;
+} MappedShingleFile;
+
+uint64_t hashShingleText(const char* text, uint32_t hashAlgorithm); /** Hashes a null-terminated shingle **/
+uint64_t hashShingleBytes(const char* text, size_t length, uint32_t hashAlgorithm); /** Hashes a shingle of the given length, which need not be null-terminated **/
+uint64_t rollingWordTerm(const char* word, size_t length); /** A word's term in a HASH_ROLLING polynomial **/
+uint64_t reduceModRolling(uint64_t value); /** value modulo ROLLING_MODULUS, with no division **/
+uint64_t addModRolling(uint64_t a, uint64_t b); /** (a + b) modulo ROLLING_MODULUS, for a and b below it **/
+uint64_t subtractModRolling(uint64_t a, uint64_t b); /** (a - b) modulo ROLLING_MODULUS, for a and b below it **/
+uint64_t multiplyModRolling(uint64_t a, uint64_t b); /** (a * b) modulo ROLLING_MODULUS, for a and b below it **/
+uint64_t finishRollingHash(uint64_t polynomial); /** Spreads a window's polynomial over all 64 bits, giving the shingle's hash **/
+int parseHashAlgorithm(const char* name); /** Returns the HASH_ constant with the given name, or -1 if there is none **/
+const char* hashAlgorithmName(uint32_t hashAlgorithm);
+uint64_t hashUniverseSize(uint32_t hashAlgorithm); /** Number of distinct values the algorithm can produce, or 0 if it can produce any 64-bit value **/
+size_t shingleValueSize(uint32_t hashAlgorithm); /** Bytes each value takes in a shingle file: 4 for the ids of HASH_DICTIONARY, otherwise 8 **/
+int isShingleFile(const char* fileName); /** Returns true if fileName begins with SHINGLE_FILE_MAGIC **/
+uint32_t csvShingleSize(const char* fileName); /** Words in the first shingle of a comma-delimited shingle file, or 0 if it is empty **/
+void writeShingleFile(const char* fileName, const uint64_t* hashes, uint64_t count, uint32_t shingleSize, uint32_t shingleUnit, uint32_t hashAlgorithm);
+void writeShingleIdFile(const char* fileName, const uint32_t* ids, uint64_t count, uint32_t shingleSize, const DictionaryStamp* stamp); /** Writes a HASH_DICTIONARY file of sorted, distinct ids **/
+FILE* beginShingleFile(const char* fileName, uint32_t shingleSize, uint32_t shingleUnit, uint32_t hashAlgorithm); /** Writes a header with a count of 0; the caller then fwrite()s the hashes **/
+void finishShingleFile(FILE* outputFile, const char* fileName, uint64_t count); /** Fills in the final count in the header, and closes the file **/
+void readShingleFileHeader(const char* fileName, ShingleFileHeader* header); /** Reads and checks the header alone, without mapping the file **/
+void readDictionaryStamp(const char* fileName, uint64_t count, DictionaryStamp* stamp); /** Reads the stamp of a HASH_DICTIONARY file holding count ids, and checks its last id against it **/
+uint64_t shingleValuesOffset(uint32_t hashAlgorithm); /** Where the hashes (or ids) start in a shingle file **/
+MappedShingleFile* openShingleFile(const char* fileName);
+void closeShingleFile(MappedShingleFile* file);
+uint64_t sortUniqueHashes(uint64_t* hashes, uint64_t count); /** Sorts hashes in place, removes duplicates, and returns the new count **/
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef SHINGLE_INDEX_H
+#define SHINGLE_INDEX_H
+
+#include <stdint.h>
+#include "Platform.h"
+
+/**
+ * Inverted index over a corpus of shingle sets, written by "jaccard -index" and mapped read-only by "jaccard -query".
+ *
+ * A file is a ShingleIndexHeader followed by these arrays, in this order and with no padding between them:
+ *  - uint64_t terms[termCount]: every distinct shingle hash in the corpus, in ascending order
+ *  - uint64_t postingStarts[termCount + 1]: the postings of terms[t] are postings[postingStarts[t]] up to postings[postingStarts[t + 1]]
+ *  - uint64_t nameOffsets[documentCount]: where each document's name starts in names
+ *  - uint32_t setSizes[documentCount]: the number of distinct hashes in each document
+ *  - uint32_t postings[postingCount]: document numbers, ascending within each term
+ *  - char names[namesLength]: each document's file name, null-terminated
+ * The header is 48 bytes, so every array is aligned to the size of its elements in a mapped file.
+ * Like binary shingle files, everything is stored in the byte order of the machine that wrote it.
+ */
+#define SHINGLE_INDEX_MAGIC "JSHINDEX"
+#define SHINGLE_INDEX_VERSION 1
+
+typedef struct {
+	char magic[8]; //SHINGLE_INDEX_MAGIC, without a terminating zero
+	uint32_t version;
+	uint32_t hashAlgorithm; //One of the HASH_ constants from ShingleFile.h
+	uint64_t documentCount;
+	uint64_t termCount;
+	uint64_t postingCount; //The sum of every setSizes[d]
+	uint64_t namesLength; //In bytes, counting each terminating zero
+} ShingleIndexHeader;
+
+/**
+ * An index mapped read-only into memory. Every array points directly into the mapping.
+ */
+typedef struct {
+	const ShingleIndexHeader* header;
+	const uint64_t* terms;
+	const uint64_t* postingStarts;
+	const uint64_t* nameOffsets;
+	const uint32_t* setSizes;
+	const uint32_t* postings;
+	const char* names;
+	MappedRegion region;
+} MappedShingleIndex;
+
+/**
+ * Per-query working memory: a count of shared hashes for every document, and the documents whose count is not 0.
+ * Only the touched documents are visited and reset afterwards, so a query costs time in proportion to the postings
+ * it walks, not to the size of the corpus. One IndexQuery can be reused for any number of queries, by one thread at a time.
+ */
+typedef struct {
+	uint32_t* sharedCounts;
+	uint32_t* touched;
+	uint64_t touchedCount;
+	uint64_t postingsWalked; //Running total over every query made with this IndexQuery
+} IndexQuery;
+
+typedef struct {
+	uint32_t document;
+	uint32_t shared; //Number of hashes the document has in common with the query
+	double similarity; //Exact Jaccard similarity of the document and the query
+} IndexMatch;
+
+void writeShingleIndex(const char* fileName, int documentCount, const uint64_t* const* sets, const int* setSizes, const char* const* names, uint32_t hashAlgorithm); /** Each set must be sorted and free of duplicates **/
+MappedShingleIndex* openShingleIndex(const char* fileName);
+void closeShingleIndex(MappedShingleIndex* index);
+const char* indexDocumentName(const MappedShingleIndex* index, uint32_t document);
+IndexQuery* createIndexQuery(const MappedShingleIndex* index);
+void deleteIndexQuery(IndexQuery* query);
+int queryShingleIndex(const MappedShingleIndex* index, IndexQuery* query, const uint64_t* hashes, uint64_t count, int topCount, IndexMatch* matches); /** Fills in up to topCount matches, most similar first, and returns how many there are **/
+int keepTopMatch(IndexMatch* matches, int matchCount, int topCount, const IndexMatch* candidate); /** Offers a match to the heap of the best topCount found so far, and returns how many it holds **/
+void sortTopMatches(IndexMatch* matches, int matchCount); /** Orders the matches kept by keepTopMatch() most similar first **/
+
+#endif
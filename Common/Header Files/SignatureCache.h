@@ -0,0 +1,85 @@
+#ifndef SIGNATURE_CACHE_H
+#define SIGNATURE_CACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * Persistent cache of the hashed shingle sets and MinHash signatures that jaccard computes for its input files,
+ * so that files which have not changed since an earlier run do not need to be read, tokenized and hashed again.
+ *
+ * A cache named NAME is two files:
+ *  - NAME.idx: a SignatureCacheHeader, then (entryCount) entries, each a CacheEntryRecord followed by its path
+ *    (pathLength bytes, without a terminating zero). It is small, and rewritten in full when the cache is closed.
+ *  - NAME.blobs: the hash arrays and signatures themselves, appended one after another at 8-byte aligned offsets.
+ * Both are stored in the byte order of the machine that wrote them, like binary shingle files.
+ */
+#define SIGNATURE_CACHE_MAGIC "JSHCACHE"
+#define SIGNATURE_CACHE_VERSION 2 //Version 1 recorded modification times in whole seconds
+#define CACHE_NO_BLOB UINT64_MAX //Offset recorded when an entry holds no hashes, or no signature
+
+typedef struct {
+	char magic[8]; //SIGNATURE_CACHE_MAGIC, without a terminating zero
+	uint32_t version;
+	uint32_t reserved; //Always 0
+	uint64_t entryCount;
+	uint64_t blobLength; //Bytes of NAME.blobs in use; anything past this was left by a run that did not finish
+} SignatureCacheHeader;
+
+/**
+ * What an entry is keyed by. An entry is only used if every field matches the input file as it is now:
+ */
+typedef struct {
+	char* path; //Absolute path of the input file, allocated by makeCacheKey(); free() it once done with the key
+	uint64_t fileSize;
+	int64_t modifiedTime; //Nanoseconds since the epoch, in whole seconds where the file system keeps no finer time
+	uint32_t shingleSize; //Words per shingle, or 0 if unknown
+	uint32_t hashAlgorithm; //One of the HASH_ constants from ShingleFile.h
+} CacheKey;
+
+typedef struct {
+	uint64_t fileSize;
+	int64_t modifiedTime;
+	uint32_t shingleSize;
+	uint32_t hashAlgorithm;
+	uint64_t hashOffset; //Position of the sorted hashes in NAME.blobs, or CACHE_NO_BLOB for binary shingle files, which are mapped instead
+	uint64_t hashCount;
+	uint64_t signatureOffset; //Position of the MinHash signature in NAME.blobs, or CACHE_NO_BLOB if none has been stored
+	uint32_t signatureSize;
+	uint32_t pathLength;
+} CacheEntryRecord;
+
+typedef struct {
+	CacheEntryRecord record;
+	char* path;
+} CacheEntry;
+
+/**
+ * An open cache. Entries are found through an open-addressing table of entry indices, keyed by path and hash
+ * algorithm, so each lookup takes constant time however many files the cache holds.
+ */
+typedef struct {
+	char* indexFileName;
+	char* blobFileName;
+	FILE* blobFile;
+	uint64_t blobLength;
+	uint64_t liveLength; //Bytes of NAME.blobs still referred to by an entry; the rest was left behind by replaced entries
+	CacheEntry* entries;
+	int entryCount;
+	int entryCapacity;
+	int* slots; //Entry index, or -1 for an empty slot
+	uint32_t slotCapacity; //Always a power of two
+	int hits; //Hash sets and signatures loaded from the cache
+	int misses; //Hash sets and signatures that had to be computed
+} SignatureCache;
+
+SignatureCache* openSignatureCache(const char* name); /** Opens or creates the cache NAME.idx and NAME.blobs **/
+int makeCacheKey(const char* fileName, uint32_t shingleSize, uint32_t hashAlgorithm, CacheKey* key); /** Fills key in from the file as it is now; returns false if the file cannot be found **/
+int findCacheEntry(SignatureCache* cache, const CacheKey* key); /** Returns the index of the entry matching every field of key, or -1 **/
+uint64_t* loadCachedHashes(SignatureCache* cache, int entry, uint64_t* count); /** Returns the entry's hashes in a new allocation, or NULL (a miss) **/
+uint32_t* loadCachedSignature(SignatureCache* cache, int entry, int signatureSize); /** Returns the entry's signature in a new allocation, or NULL (a miss) if it has none of that size **/
+int storeCacheEntry(SignatureCache* cache, const CacheKey* key, const uint64_t* hashes, uint64_t count); /** Replaces any entry for the same path and algorithm, and returns the new entry's index **/
+void storeCachedSignature(SignatureCache* cache, int entry, const uint32_t* values, int signatureSize);
+void closeSignatureCache(SignatureCache* cache); /** Writes the index, compacting NAME.blobs first if most of it is no longer used **/
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef SIMILARITY_H
+#define SIMILARITY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Arena.h"
+#include "ShingleFile.h"
+
+/**
+ * The similarity library: shingling, hashing and comparing documents in-process, with no files in between. Both
+ * programs are built on it, and Library/CompileLibrary.bat builds it on its own for other programs to link.
+ *
+ * A ShingleSet is a document reduced to the sorted, distinct hashes of its shingles. It and its hashes are one flat
+ * array each, allocated from an Arena the caller owns, so a set costs two allocations however many shingles it has,
+ * and a whole corpus is freed by deleting its arena. Sets built with the same shingle size and hash algorithm give
+ * exactly the same hashes as "shingle -b" and "jaccard", so they can be compared with sets from binary shingle files.
+ *
+ * Nothing here prints or exits: a function that cannot finish returns NULL (or 0 sets), and the arena keeps anything
+ * it had already allocated until it is reset. Functions may be called from several threads at once, as long as no
+ * two threads use the same arena.
+ */
+#define SHINGLE_DELIMITERS " .,\"\n\r()" //Characters that separate the words of a text
+
+typedef struct {
+	const uint64_t* hashes; //Sorted ascending, with no duplicates
+	uint64_t count;
+	uint32_t shingleSize; //Words (or characters) per shingle, or 0 if unknown
+	uint32_t shingleUnit; //SHINGLE_WORDS or SHINGLE_CHARACTERS, from ShingleFile.h
+	uint32_t hashAlgorithm; //One of the HASH_ constants from ShingleFile.h
+} ShingleSet;
+
+typedef struct {
+	uint64_t intersection; //Hashes in both sets
+	uint64_t unionCount; //Hashes in either set
+	double similarity; //intersection / unionCount, or 0 if both sets are empty
+} SetSimilarity;
+
+typedef struct {
+	uint32_t set; //Position of the matching set in the array that was searched
+	uint64_t intersection;
+	double similarity;
+} SetMatch;
+
+typedef void (*PairCallback)(void* context, uint32_t i, uint32_t k, const SetSimilarity* result); /** Receives each pair found by compareAllPairs() **/
+
+ShingleSet* shingleBuffer(Arena* arena, const char* text, size_t length, uint32_t shingleSize, uint32_t hashAlgorithm); /** Shingles raw text, split into words at SHINGLE_DELIMITERS **/
+ShingleSet* shingleCharacters(Arena* arena, const char* text, size_t length, uint32_t shingleSize); /** Shingles raw text into runs of shingleSize characters, hashed with HASH_ROLLING **/
+ShingleSet* parseShingleCsv(Arena* arena, const char* text, size_t length, uint32_t hashAlgorithm); /** Hashes comma-delimited shingles, as written by "shingle" without -b **/
+ShingleSet* makeShingleSet(Arena* arena, const uint64_t* hashes, uint64_t count, uint32_t shingleSize, uint32_t hashAlgorithm); /** Copies hashes, which may be in any order and repeat **/
+void compareShingleSets(const ShingleSet* a, const ShingleSet* b, SetSimilarity* result);
+uint64_t compareAllPairs(const ShingleSet* const* sets, uint32_t count, double threshold, PairCallback callback, void* context); /** Calls back with every pair i < k at least threshold similar, in (i,k) order; returns the pairs compared **/
+uint32_t findSimilarSets(const ShingleSet* query, const ShingleSet* const* sets, uint32_t count, uint32_t topCount, SetMatch* matches); /** Fills in up to topCount sets, most similar first, and returns how many there are **/
+size_t textLengthToNul(const char* text, size_t length); /** The length of text up to its first zero byte, where splitting it with strtok() always stopped **/
+char* readWholeFile(const char* fileName, size_t* length); /** Returns the contents in a new, null-terminated allocation the caller frees, or NULL if the file cannot be read **/
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+
+/**
+ * Run statistics for the "-stats FILE" flag of both programs: the time spent in each stage (read, tokenize, shingle,
+ * hash, dedup, compare, output, ...), the work each stage did, named counters, the allocations made for file data,
+ * the peak resident memory, and a histogram of how long each pair comparison took.
+ *
+ * Nothing is recorded until enableStats() is called. Until then statsClock() returns 0 without reading the clock,
+ * and every other call returns at once, so code can be instrumented unconditionally. The only cost left in a loop
+ * over pairs is testing statsEnabled, which stays false. Stages and counters may be updated from any thread.
+ *
+ * writeStatsReport() writes one JSON object:
+ *  - "program", "wallSeconds" (since enableStats()), "peakResidentBytes" (0 if the platform cannot tell)
+ *  - "allocations": {"count", "bytes"}
+ *  - "stages": [{"name", "seconds", "calls", "items", "bytes"}], in the order the stages were first used. A stage
+ *    timed on several threads at once sums its time over the threads, so it can exceed "wallSeconds"
+ *  - "counters": {"NAME": value, ...}
+ *  - "pairLatency": {"count", "meanSeconds", "maxSeconds", "p50Seconds", "p90Seconds", "p99Seconds", "buckets"}. Each
+ *    bucket is {"fromNanoseconds", "toNanoseconds", "count"}, with bounds at powers of 2, and only buckets holding at
+ *    least one pair are listed; the percentiles are the upper bound of the bucket they fall in, so within a factor of 2
+ */
+#define STATS_MAX_STAGES 32
+#define STATS_MAX_COUNTERS 32
+#define STATS_HISTOGRAM_BUCKETS 48 //Bucket b holds latencies of 2^b up to 2^(b+1) nanoseconds; bucket 0 also holds anything shorter
+
+extern int statsEnabled; //True once enableStats() has been called; test it before timing anything per pair
+
+void enableStats(const char* programName);
+double statsClock(); /** wallClockSeconds() while stats are enabled, or 0 **/
+void addStageTime(const char* stage, double startTime, uint64_t items, uint64_t bytes); /** Adds the time since startTime (from statsClock()), one call, and the work done, to the named stage **/
+void addCounter(const char* counter, uint64_t value);
+void countAllocation(uint64_t bytes);
+void recordPairLatency(double seconds); /** Adds one pair comparison's time to the histogram **/
+int writeStatsReport(const char* fileName); /** Returns 0 on success **/
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Splits text into tokens: maximal runs of bytes that are not in a set of delimiters, the same tokens strtok() would
+ * give. Unlike strtok(), it keeps its state in a Tokenizer the caller owns, so any number can run at once on any
+ * threads, and it never writes to the text unless asked to fold it to lower case.
+ *
+ * Text is classified TOKENIZER_BLOCK bytes at a time into a mask with a bit set for each delimiter, and the tokens
+ * are read from where that mask changes. The classification is a lookup of each byte's low and high nibble, ANDed
+ * together, so SIMD shuffles can do it for 16 or 32 bytes at once. The fastest kernel the processor supports is
+ * chosen at run time, as in SetIntersection.h:
+ *  - "scalar": a table lookup per byte, which works everywhere and for any delimiter set
+ *  - "ssse3": 16 bytes per shuffle (SSSE3)
+ *  - "avx2": 32 bytes per shuffle (AVX2)
+ * The nibble lookup can only tell apart delimiters with at most 8 distinct high nibbles (every printable ASCII set
+ * qualifies); for a set with more, every kernel falls back to the scalar one. ASCII case folding, if asked for,
+ * happens in the same pass, and only to bytes the tokenizer has already reached.
+ */
+#define TOKENIZER_BLOCK 64 //Bytes classified at a time, one bit each of a 64-bit mask
+
+typedef struct {
+	uint8_t isDelimiter[256];
+	uint8_t lowNibbleClasses[16]; //A byte is a delimiter if these two, looked up by its low and high nibble, share a bit
+	uint8_t highNibbleClasses[16];
+	int vectorized; //The nibble tables describe the set exactly, so the SIMD kernels can be used
+} DelimiterSet;
+
+typedef struct {
+	const DelimiterSet* delimiters;
+	const char* text;
+	char* foldedText; //The same as text when folding to lower case, otherwise NULL
+	size_t length;
+	size_t blockStart; //Offset of the block that boundaries belongs to
+	size_t nextBlock; //Offset of the next block to classify
+	uint64_t boundaries; //Positions in the block, not yet reported, where a token starts or ends
+	uint64_t previousInToken; //1 if the last byte of the previous block was part of a token
+	int inToken; //A token has started, but its end has not been reached
+	size_t tokenStart;
+} Tokenizer;
+
+int selectTokenizerKernel(const char* name); /** "auto", "scalar", "ssse3" or "avx2"; returns false if the name is unknown or the processor lacks the instructions **/
+const char* tokenizerKernelName(); /** Name of the kernel in use **/
+void initDelimiterSet(DelimiterSet* set, const char* delimiters); /** delimiters is a null-terminated string of the bytes that separate tokens **/
+void beginTokens(Tokenizer* tokenizer, const DelimiterSet* delimiters, const char* text, size_t length);
+void beginFoldedTokens(Tokenizer* tokenizer, const DelimiterSet* delimiters, char* text, size_t length); /** As beginTokens(), but each byte is turned to ASCII lower case as it is passed **/
+int nextToken(Tokenizer* tokenizer, size_t* start, size_t* length); /** Gives the offset and length of the next token, or returns false once there are none left **/
+uint64_t countTokens(const DelimiterSet* delimiters, const char* text, size_t length);
+
+#endif
@@ -2,22 +2,253 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdarg.h>
-#include "..\..\List-Library\Header Files\List.h"
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
+#include "..\..\Common\Header Files\ShingleFile.h"
+#include "..\..\Common\Header Files\SignatureCache.h"
+#include "..\..\Common\Header Files\ShingleIndex.h"
+#include "..\..\Common\Header Files\SetIntersection.h"
+#include "..\..\Common\Header Files\Stats.h"
+#include "..\..\Common\Header Files\Similarity.h"
+#include "..\..\Common\Header Files\ResultSink.h"
+#include "..\..\Common\Header Files\ShardFile.h"
 
 #define true 1
 #define false 0
-#define tblSize 104729L
+#define defaultLshSignatureSize 128 //Used by -lsh when -minhash does not set a signature size
+#define rememberedBucketSize 64 //LSH buckets of at least this many files are remembered, so a later band's bucket holding exactly the same files is not expanded again
+#define maxPairsPerTask 4096 //Upper bound on the pairs handed to a worker thread at once
+#define tasksAheadPerWorker 4 //How far, in tasks per worker, the workers may run ahead of the task being printed
+#define defaultTopCount 10 //Documents listed for each -query input when -top is not given
+#define maxPairsPerBatch 1048576 //Pairs of a block pair gathered at once in -mem mode, before they are compared
+#define pairCostOverhead 64 //Estimated cost of comparing a pair beyond reading its sets or signatures, in values read, used to cut -shard shares
+#define bitsetMinimumDensity 0.3 //A set is also held as a bitset once it has this many values per 64-bit word of the bitset; intersecting two such sets as bitsets is faster than merging them
 
-int hash(void* v, unsigned int length);
-int hashString(char *text);
-void interpretConsoleFlags(int argc, char* argv[], List* inputFileNames);
-char* readTextFile(const char* fileName);
-List* tokenizeString(char* inputString, const char* delimiters);
-void printDebug(char* debugText, ...); /**Wraps printf(), calling it only if global variable debugFlag is true**/
-List* hashList(List* itemList);
-List* unionLists(List* list1, List* list2);
-List* intersectLists(List* list1, List* list2);
-void removeDuplicates(List* inputList);
+/**
+ * The hashed shingles of a single file, stored once as a contiguous, sorted array with no duplicates.
+ * Keeping the values sorted lets the size of an intersection be found with a single merge pass.
+ * For binary shingle files, values points straight into the mapped file; for .csv files, into the ShingleSet the
+ * similarity library parsed the file into.
+ */
+typedef struct {
+	const uint64_t* values; //NULL for a set of dictionary ids, until widenHashSet() gives it the ids as 64-bit values
+	const uint32_t* ids; //The set's shingle ids if it is from a HASH_DICTIONARY file, which are compared in place of values; otherwise NULL
+	int size;
+	uint32_t hashAlgorithm; //One of the HASH_ constants from ShingleFile.h
+	MappedShingleFile* source; //The mapped file values (or ids) points into, or NULL if it is not from a binary shingle file
+	int ownsValues; //True if values was allocated for this set alone (by the signature cache or widenHashSet()), and is freed with it
+	uint64_t* bits; //The same values as a bitset over the hash universe, or NULL if the set is only held as an array
+} HashSet;
+
+/**
+ * A fixed-size MinHash signature of a HashSet. Slot j holds the minimum, over every hash in the set,
+ * of the j-th of (size) independent mixing functions. Two signatures agree in a given slot with a
+ * probability equal to the Jaccard similarity of the sets they were computed from.
+ */
+typedef struct {
+	uint32_t* values;
+	int size;
+} MinHashSignature;
+
+/**
+ * Settings read from the command-line flags:
+ */
+typedef struct {
+	int minHashSize; //Number of values per MinHash signature, or 0 to compare the full sets exactly
+	int showExact; //In MinHash mode, also compute the exact similarity and print it beside each estimate
+	double lshThreshold; //Target similarity for the LSH candidate stage, or 0 to compare every pair
+	int threadCount; //Number of worker threads comparing pairs
+	int hashAlgorithm; //HASH_ constant that .csv inputs are hashed with, or -1 to match the binary inputs
+	char* cacheName; //Signature cache that unchanged inputs are loaded from and new ones saved to, or NULL for none
+	char* indexName; //Inverted index to build from the inputs instead of comparing them, or NULL
+	char* queryIndexName; //Inverted index to look each input up in instead of comparing them, or NULL
+	int topCount; //Most similar documents listed for each input in query mode
+	double joinThreshold; //Only pairs at least this similar are found and printed by the exact threshold join, or 0 to print every pair
+	int useBitsets; //Hold dense sets as bitsets as well, when their hashes come from a small enough universe
+	char* statsName; //File that stage timings and counters are written to as JSON, or NULL to record none
+	uint64_t memoryBudget; //Bytes of hashes -mem holds in memory at once, or 0 to load every set
+	char* matrixName; //Binary result files the similarities are written to instead of being printed, or NULL for each one not wanted
+	char* edgesName;
+	char* neighborsName;
+	ResultSink* sink; //Opened from the three names above, or NULL to print every pair as text
+	int shardIndex; //This process's shard of the pairs, from 1 to shardCount
+	int shardCount; //Processes the pairs are shared between, or 0 to compare them all here
+	char* partialName; //Partial result file a shard writes its results to instead of printing them
+	FILE* partialFile; //Opened from partialName while the shard compares its pairs
+	int mergeInputs; //The inputs are the partial result files of every shard, to be merged instead of compared
+} JaccardOptions;
+
+/**
+ * Everything loaded for the input files, indexed by the position of each file in fileNames:
+ */
+typedef struct {
+	char** fileNames;
+	HashSet** hashes; //Array of HashSet*
+	MinHashSignature** signatures; //Array of MinHashSignature*, or NULL when no signatures were computed
+	int fileCount;
+	uint64_t bitsetWords; //Length of every HashSet's bits, or 0 if no set has them
+} Corpus;
+
+/**
+ * The outcome of comparing files i and k. The fields that are not needed by the active mode are left at zero.
+ */
+typedef struct {
+	int i, k;
+	int intersectedSize;
+	int unionedSize;
+	double similarity; //Exact Jaccard similarity, valid when hasExact is true
+	double estimatedSimilarity; //MinHash estimate, valid when hasEstimate is true
+	int hasExact;
+	int hasEstimate;
+	double seconds; //Time taken to compare the pair, only measured when stats are enabled
+} PairResult;
+
+/**
+ * Running totals over every pair that has been printed:
+ */
+typedef struct {
+	long long pairCount;
+	double totalError; //Sum and maximum of |estimate - exact|, over the pairs that have both
+	double maxError;
+	long long errorCount;
+	long long aboveThreshold; //Pairs whose exact similarity reached options.lshThreshold or options.joinThreshold
+} ComparisonTotals;
+
+/**
+ * How many pairs each stage of the exact threshold join removed, out of every pair of files:
+ */
+typedef struct {
+	long long prefixPruned; //Pairs whose prefixes share no hash, which therefore cannot reach the threshold
+	long long sizePruned; //Pairs that shared a prefix hash, but whose set sizes are too different to reach the threshold
+} JoinStatistics;
+
+/**
+ * The estimated cost of every pair up to each position of the sequence of pairs, which -shard cuts into equal shares.
+ * A pair costs pairCost, plus the set-dependent cost of each of its sets: the set's size if the sets are intersected,
+ * or 0 if only their signatures are compared.
+ */
+typedef struct {
+	uint64_t* candidateCosts; //Cost of the candidate pairs before each position, or NULL when every pair is compared
+	uint64_t* setCosts; //Set-dependent cost of sets j to fileCount - 1 together, for every j from 0 to fileCount
+	uint64_t* rowCosts; //Cost of every pair before row i of the (i,k) order
+	int fileCount;
+	uint64_t pairCost;
+} PairCosts;
+
+/**
+ * The inputs in -mem mode. Every set's hashes stay on disk, in its binary shingle file or in the spill file the .csv
+ * inputs are parsed into, and only the sets of the two blocks in the slots are in memory; the HashSet of any other
+ * set has NULL values.
+ */
+typedef struct {
+	Corpus corpus;
+	HashSet* sets; //The HashSet of every input, which corpus.hashes points to
+	uint64_t* offsets; //Where each set's hashes start, in its binary shingle file or the spill file
+	int* spilled; //True for each set parsed from a .csv file into the spill file
+	FILE* spillFile;
+	int* blockStarts; //First set of each block, followed by corpus.fileCount
+	int blockCount;
+	Arena* slots[2]; //Memory for the sets of the two loaded blocks
+	int slotBlocks[2]; //Block loaded in each slot, or -1
+	uint64_t* batch; //Packed (i,k) pairs of the current block pair, waiting to be compared
+	long long batchCount;
+	uint64_t storedBytes; //Size of every set's hashes, which is all that reading each set once would take
+	uint64_t bytesRead;
+	long long blockLoads;
+} BlockedCorpus;
+
+/**
+ * A contiguous run of pairs, in the order they are printed, compared by one worker thread.
+ * The worker allocates results and fills it in; the main thread prints and frees it once done is set.
+ */
+typedef struct {
+	long long firstPair;
+	long long pairCount;
+	PairResult* results;
+	int done;
+} PairTask;
+
+/**
+ * The tasks still owned by one worker. Tasks are dealt round-robin, so this worker owns task
+ * (owner + workerCount * j) for every front <= j < back. The owner takes from the front, so all workers
+ * move through the output order together; idle workers steal from the back of another worker's queue, or from its
+ * front when the back lies beyond the tasks that may be taken yet.
+ */
+typedef struct {
+	pthread_mutex_t lock;
+	long long front;
+	long long back;
+} TaskQueue;
+
+/**
+ * State shared by the main thread and every worker during a parallel comparison:
+ */
+typedef struct {
+	const Corpus* corpus;
+	const JaccardOptions* options;
+	const uint64_t* candidates; //Packed (i,k) pairs to compare, or NULL to compare every pair of files
+	PairTask* tasks;
+	long long taskCount;
+	TaskQueue* queues;
+	int workerCount;
+	pthread_mutex_t doneLock; //Guards every task's done flag, and takeLimit
+	pthread_cond_t taskDone;
+	long long takeLimit; //Tasks from here on are not taken until more are printed, so the results waiting to be printed stay bounded
+	pthread_cond_t limitMoved; //Signalled when takeLimit grows
+} PairScheduler;
+
+typedef struct {
+	PairScheduler* scheduler;
+	int id;
+} WorkerContext;
+
+void interpretConsoleFlags(int argc, char* argv[], char** inputFileNames, int* inputFileCount, JaccardOptions* options);
+char* readTextFile(const char* fileName, size_t* textLength);
+void printDebug(const char* debugText, ...); /**Wraps printf(), calling it only if global variable debugFlag is true**/
+HashSet* createHashSet(const uint64_t* values, int size, uint32_t hashAlgorithm, int ownsValues); /** Wraps an array of sorted, distinct hashes, which the HashSet frees if ownsValues is true **/
+HashSet* mapHashSet(const char* fileName);
+void checkDictionaryStamp(const char* fileName, const DictionaryStamp* stamp, const char** firstFileName, uint64_t* firstIdentity); /** Exits if the file's ids are from a different dictionary than the first file of ids **/
+void widenHashSet(HashSet* set); /** Gives a set of dictionary ids the same ids as 64-bit values, for the modes that hash or index them **/
+int intersectionSize(const HashSet* set1, const HashSet* set2);
+void deleteHashSet(HashSet* set);
+void addBitsets(Corpus* corpus);
+MinHashSignature* computeSignature(const HashSet* set, int signatureSize);
+	uint32_t mixHash(uint64_t value, uint64_t seed); /** Sub-function of computeSignature, one of the independent hash functions, selected by seed **/
+double estimateSimilarity(const MinHashSignature* signature1, const MinHashSignature* signature2);
+void deleteSignature(MinHashSignature* signature);
+void comparePair(const Corpus* corpus, int i, int k, const JaccardOptions* options, PairResult* result);
+void printPairResult(const Corpus* corpus, const PairResult* result, const JaccardOptions* options, ComparisonTotals* totals);
+void chooseBands(int signatureSize, double threshold, int* bands, int* rows);
+void printRunSummary(const ShardFileHeader* run, JaccardOptions* options, const ComparisonTotals* totals); /** Prints the summary of the threshold join or LSH, and of the MinHash error, and closes the result files **/
+long long compareSequence(const Corpus* corpus, const uint64_t* candidates, long long sequenceLength, JaccardOptions* options, ComparisonTotals* totals, ShardFileHeader* run); /** Compares the sequence of pairs, or with -shard this shard's share of it, and returns how many pairs were compared **/
+	double findShardRange(const Corpus* corpus, const uint64_t* candidates, long long sequenceLength, const JaccardOptions* options, long long* firstPair, long long* pairCount); /** Sub-function of compareSequence, cuts the shard's share of the pairs by their estimated cost **/
+	uint64_t costBeforePair(const PairCosts* costs, long long pair); /** Sub-function of findShardRange **/
+void writePartialResult(const JaccardOptions* options, const PairResult* result); /** Sub-function of printPairResult, records a shard's result in its partial result file **/
+void mergePartialFiles(char** partialNames, int partialCount, JaccardOptions* options);
+void comparePairsInParallel(const Corpus* corpus, const uint64_t* candidates, long long firstPair, long long pairTotal, const JaccardOptions* options, ComparisonTotals* totals);
+	void* runPairWorker(void* context); /** Sub-function of comparePairsInParallel, the body of each worker thread **/
+	int takeTask(PairScheduler* scheduler, int id, long long* task); /** Sub-function of runPairWorker, pops from its own queue or steals from another, waiting while every task left is beyond takeLimit **/
+		int takeTaskBelow(PairScheduler* scheduler, int id, long long limit, long long* task, int* remaining); /** Sub-function of takeTask, one pass over the queues **/
+	void pairFromIndex(long long index, int fileCount, int* i, int* k); /** Sub-function of runPairWorker, maps a position in the (i,k) order to its files **/
+void buildIndex(const Corpus* corpus, const char* indexName, uint32_t hashAlgorithm);
+void queryIndex(const Corpus* corpus, const MappedShingleIndex* index, int topCount);
+uint64_t* findCandidatePairs(const Corpus* corpus, int bands, int rows, long long* candidateCount);
+	uint64_t hashBand(const uint32_t* values, int rows, int band); /** Sub-function of findCandidatePairs, combines one band of a signature into a bucket key **/
+	uint64_t fingerprintBucket(const uint64_t* entries, int entryCount); /** Sub-function of findCandidatePairs, combines the files of one bucket into a key that names exactly that set of files **/
+	long long mergeCandidates(uint64_t** candidates, long long count, long long* capacity, const uint64_t* bandPairs, long long bandCount); /** Sub-function of findCandidatePairs, merges one band's sorted pairs into the sorted candidates without repeats, and returns the new count **/
+	int compareBucketEntries(const void* a, const void* b); /** Sub-function of findCandidatePairs, qsort() comparator ordering bucket entries by key **/
+	int compareCandidates(const void* a, const void* b); /** Sub-function of findCandidatePairs, qsort() comparator for packed (i,k) pairs **/
+uint64_t* findJoinCandidates(const Corpus* corpus, double threshold, long long* candidateCount, JoinStatistics* statistics);
+	uint32_t** rankHashes(const Corpus* corpus); /** Sub-function of findJoinCandidates, replaces each set's hashes by their rank in the global order, rarest first **/
+	int compareRanks(const void* a, const void* b); /** Sub-function of rankHashes, qsort() comparator for uint32_t ranks **/
+void compareInBlocks(char** fileNames, int fileCount, JaccardOptions* options);
+	void stageSets(BlockedCorpus* blocked, JaccardOptions* options); /** Sub-function of compareInBlocks, finds every set on disk, spilling the .csv inputs' hashes to a temporary file **/
+	void planBlocks(BlockedCorpus* blocked, uint64_t blockBudget); /** Sub-function of compareInBlocks, cuts the sets into blocks of consecutive files **/
+	void loadBlock(BlockedCorpus* blocked, int block, int keepBlock); /** Sub-function of compareInBlocks, reads a block into whichever slot does not hold keepBlock **/
+	void compareBlockPair(BlockedCorpus* blocked, int a, int b, const JaccardOptions* options, ComparisonTotals* totals, long long* comparedPairs, long long* sizePruned); /** Sub-function of compareInBlocks **/
+	void compareBatch(BlockedCorpus* blocked, const JaccardOptions* options, ComparisonTotals* totals); /** Sub-function of compareBlockPair **/
+uint64_t parseByteCount(const char* text); /** Sub-function of interpretConsoleFlags, reads a number of bytes with an optional K, M or G suffix, or returns 0 if it is not one **/
 
 /**
  * Declare any (absolutely necessary) global variables:
@@ -26,96 +257,302 @@ int debugFlag = false;
 
 int main(int argc, char* argv[]) {
 	/**Read the input file names from the arguments:**/
-	List* inputFileNames = createList(ARRAY_LIST);
-	interpretConsoleFlags(argc, argv, inputFileNames);
+	char** inputFileNames = malloc(argc * sizeof(char*)); //Every argument but the program name could be a file name
+	int inputFileCount = 0;
+	JaccardOptions options = {0, false, 0.0, 1, -1, NULL, NULL, NULL, defaultTopCount, 0.0, true, NULL, 0, NULL, NULL, NULL, NULL, 0, 0, NULL, NULL, false};
+	if(inputFileNames == NULL) {
+		printf("\nERROR: Unable to allocate memory for the input file names!\n");
+		exit(1);
+	}
+	interpretConsoleFlags(argc, argv, inputFileNames, &inputFileCount, &options);
+	if(options.statsName != NULL) {
+		enableStats("jaccard");
+	}
+	printDebug("\nIntersecting sets with the %s kernel.\n", intersectionKernelName()); //Also settles the kernel before any worker thread starts
+	
+	/**With -merge, the inputs are the partial result files of a sharded run, which are combined instead of compared:**/
+	if(options.mergeInputs == true) {
+		mergePartialFiles(inputFileNames, inputFileCount, &options);
+		free(inputFileNames);
+		if(options.statsName != NULL && writeStatsReport(options.statsName) != 0) {
+			printf("\nERROR: Unable to write the statistics to \"%s\"!\n", options.statsName);
+			exit(1);
+		}
+		return 0;
+	}
+	
+	if(options.matrixName != NULL || options.edgesName != NULL || options.neighborsName != NULL) {
+		double edgeThreshold = (options.joinThreshold > 0) ? options.joinThreshold : options.lshThreshold;
+		options.sink = openResultSink(inputFileNames, (uint32_t)inputFileCount, options.matrixName, options.edgesName, edgeThreshold, options.neighborsName, (uint32_t)options.topCount);
+	}
+	
+	/**With -mem, the sets are left on disk and compared a block at a time, instead of all being loaded below:**/
+	if(options.memoryBudget > 0) {
+		compareInBlocks(inputFileNames, inputFileCount, &options);
+		if(options.sink != NULL) {
+			closeResultSink(options.sink);
+		}
+		free(inputFileNames);
+		if(options.statsName != NULL && writeStatsReport(options.statsName) != 0) {
+			printf("\nERROR: Unable to write the statistics to \"%s\"!\n", options.statsName);
+			exit(1);
+		}
+		return 0;
+	}
 	
-	/**Load the text content corresponding to the read file names:**/
-	List** inputFileText = malloc(listSize(inputFileNames) * sizeof(List*)); //Array of List*
-	for(int i = 0; i < listSize(inputFileNames); i++) {
-		inputFileText[i] = tokenizeString(readTextFile(getFromList(inputFileNames, i)), ",");
+	/**In query mode, the inputs are hashed to match the index, unless -hash was given:**/
+	MappedShingleIndex* queriedIndex = NULL;
+	if(options.queryIndexName != NULL) {
+		queriedIndex = openShingleIndex(options.queryIndexName);
+		if(options.hashAlgorithm < 0) {
+			options.hashAlgorithm = (int)queriedIndex->header->hashAlgorithm;
+		}
 	}
 	
-	/**File and gram information**/
+	/**Map the hashes of each binary shingle file in place (.csv files are left NULL for now, and read below):**/
+	HashSet** inputFileHashes = calloc(inputFileCount > 0 ? inputFileCount : 1, sizeof(HashSet*)); //Array of HashSet*
+	if(inputFileHashes == NULL) {
+		printf("\nERROR: Unable to allocate memory for the hashed n-grams!\n");
+		exit(1);
+	}
 	printDebug("\nInput file names are:\n");
-	for(int i = 0; i < listSize(inputFileNames); i++) {
-		printDebug("   %s\n", getFromList(inputFileNames, i));
+	for(int i = 0; i < inputFileCount; i++) {
+		printDebug("   %s\n", inputFileNames[i]);
 	}
 	printDebug("\n");
-	for(int i = 0; i < listSize(inputFileNames); i++) {
-		printDebug("There are %d n-grams in file \"%s\"\n", listSize(inputFileText[i]), getFromList(inputFileNames, i));
+	const char* firstIdFileName = NULL; //The first input holding dictionary ids, which every other one must share a dictionary with
+	uint64_t dictionaryIdentity = 0;
+	for(int i = 0; i < inputFileCount; i++) {
+		if(isShingleFile(inputFileNames[i]) == true) {
+			printDebug("Mapping binary shingle file \"%s\"\n", inputFileNames[i]);
+			double startTime = statsClock();
+			inputFileHashes[i] = mapHashSet(inputFileNames[i]);
+			addStageTime("map", startTime, 1, (uint64_t)inputFileHashes[i]->size * shingleValueSize(inputFileHashes[i]->hashAlgorithm));
+			printDebug("  Successfully mapped.\n");
+			if(inputFileHashes[i]->source->stamp != NULL) {
+				checkDictionaryStamp(inputFileNames[i], inputFileHashes[i]->source->stamp, &firstIdFileName, &dictionaryIdentity);
+			}
+			if(options.hashAlgorithm < 0) { //Without -hash, .csv inputs are hashed to match the first binary input
+				options.hashAlgorithm = (int)inputFileHashes[i]->hashAlgorithm;
+			}
+		}
+	}
+	if(options.hashAlgorithm < 0) {
+		options.hashAlgorithm = HASH_DEFAULT;
 	}
 	
-	/**Replace each List in inputFileText with its hashed version:**/
-	printDebug("\n");
-	List* temp = NULL;
-	for(int i = 0; i < listSize(inputFileNames); i++) {
-		printDebug("Hashing contents of \"%s\"\n", getFromList(inputFileNames, i));
-		temp = hashList(inputFileText[i]);
-		deleteList(inputFileText[i]);
-		inputFileText[i] = temp;
-		printDebug("  Successfully hashed.\n");
-	}
-	
-	/**Generate an Intersection and Union list between each pair of files, and find the Jaccard similarity for each:**/
-	List* intersectedList = NULL;
-	List* unionedList = NULL;
-	double listSimilarity = 0.0;
-	for(int i = 0; i < listSize(inputFileNames) - 1; i++) {
-		for(int k = i + 1; k < listSize(inputFileNames); k++) {
-			unionedList = unionLists(inputFileText[i], inputFileText[k]);
-			intersectedList = intersectLists(inputFileText[i], inputFileText[k]);
-			
-			listSimilarity = (double)listSize(intersectedList) / (double)listSize(unionedList);
-			printf("\nComparing files \"%s\" and \"%s\":\n", getFromList(inputFileNames, i), getFromList(inputFileNames, k));
-			printDebug("  The intersection results in %d n-grams\n", listSize(intersectedList));
-			printDebug("  The union results in %d n-grams\n", listSize(unionedList));
-			printf("  Files \"%s\" and \"%s\" are %.2f%% similar.\n", getFromList(inputFileNames, i), getFromList(inputFileNames, k), listSimilarity * 100);
+	/**With -cache, find each input's entry from an earlier run, if the file has not changed since. Binary inputs are only cached for their signatures, since their hashes are already mapped in place:**/
+	SignatureCache* cache = NULL;
+	CacheKey* cacheKeys = NULL; //Array of CacheKey, with a NULL path for any file that could not be keyed
+	int* cacheEntries = NULL; //Index of each input's entry in the cache, or -1 if it has none yet
+	if(options.cacheName != NULL) {
+		cache = openSignatureCache(options.cacheName);
+		cacheKeys = calloc(inputFileCount > 0 ? inputFileCount : 1, sizeof(CacheKey));
+		cacheEntries = malloc((inputFileCount > 0 ? inputFileCount : 1) * sizeof(int));
+		if(cacheKeys == NULL || cacheEntries == NULL) {
+			printf("\nERROR: Unable to allocate memory for the signature cache!\n");
+			exit(1);
+		}
+		for(int i = 0; i < inputFileCount; i++) {
+			uint32_t shingleSize = (inputFileHashes[i] != NULL) ? inputFileHashes[i]->source->header->shingleSize : csvShingleSize(inputFileNames[i]);
+			uint32_t hashAlgorithm = (inputFileHashes[i] != NULL) ? inputFileHashes[i]->hashAlgorithm : (uint32_t)options.hashAlgorithm;
+			cacheEntries[i] = -1;
+			if(makeCacheKey(inputFileNames[i], shingleSize, hashAlgorithm, &cacheKeys[i]) == true) {
+				cacheEntries[i] = findCacheEntry(cache, &cacheKeys[i]);
+			}
+		}
+	}
+	
+	/**Load the hashes of each .csv file from the cache, or else read it and have the similarity library reduce its n-grams to a sorted set of their hashes:**/
+	Arena* shingleArena = createArena(0); //Holds the hashes of every .csv file that is not loaded from the cache
+	if(shingleArena == NULL) {
+		printf("\nERROR: Unable to allocate memory for the hashed n-grams!\n");
+		exit(1);
+	}
+	for(int i = 0; i < inputFileCount; i++) {
+		if(inputFileHashes[i] != NULL) {
+			continue;
+		}
+		uint64_t cachedCount = 0;
+		uint64_t* cachedHashes = (cache != NULL) ? loadCachedHashes(cache, cacheEntries[i], &cachedCount) : NULL;
+		if(cachedHashes != NULL) {
+			printDebug("Loaded the hashes of \"%s\" from the cache\n", inputFileNames[i]);
+			inputFileHashes[i] = createHashSet(cachedHashes, (int)cachedCount, (uint32_t)options.hashAlgorithm, true);
+			continue;
+		}
+		
+		size_t textLength = 0;
+		char* inputFileText = readTextFile(inputFileNames[i], &textLength);
+		if(options.hashAlgorithm == HASH_DICTIONARY) { //There is no dictionary to look the shingles up in
+			printf("\nERROR: \"%s\" is a .csv file, which cannot be compared with dictionary ids; convert it with \"shingle -convert -dict\" first!\n", inputFileNames[i]);
+			exit(1);
+		}
+		printDebug("Hashing contents of \"%s\"\n", inputFileNames[i]);
+		ShingleSet* shingles = parseShingleCsv(shingleArena, inputFileText, textLength, (uint32_t)options.hashAlgorithm);
+		if(shingles == NULL) {
+			printf("\nERROR: Unable to allocate memory for the hashed n-grams!\n");
+			exit(1);
+		}
+		free(inputFileText);
+		inputFileHashes[i] = createHashSet(shingles->hashes, (int)shingles->count, (uint32_t)options.hashAlgorithm, false);
+		printDebug("  Successfully hashed %d distinct n-grams.\n", inputFileHashes[i]->size);
+		if(cache != NULL && cacheKeys[i].path != NULL) {
+			cacheEntries[i] = storeCacheEntry(cache, &cacheKeys[i], inputFileHashes[i]->values, (uint64_t)inputFileHashes[i]->size);
+		}
+	}
+	for(int i = 0; i < inputFileCount && queriedIndex != NULL; i++) {
+		if(inputFileHashes[i]->hashAlgorithm != queriedIndex->header->hashAlgorithm) {
+			printf("\nWARNING: \"%s\" and index \"%s\" were hashed with different algorithms, so their similarities will be meaningless!\n", inputFileNames[i], options.queryIndexName);
+		}
+	}
+	for(int i = 1; i < inputFileCount; i++) {
+		if(inputFileHashes[i]->hashAlgorithm != inputFileHashes[0]->hashAlgorithm) {
+			printf("\nWARNING: \"%s\" and \"%s\" were hashed with different algorithms, so their similarity will be meaningless!\n", inputFileNames[0], inputFileNames[i]);
+		}
+	}
+	
+	/**In MinHash and LSH modes, reduce each HashSet to a fixed-size signature:**/
+	Corpus corpus = {inputFileNames, inputFileHashes, NULL, inputFileCount, 0};
+	int signatureSize = options.minHashSize;
+	if(options.lshThreshold > 0 && signatureSize == 0) {
+		signatureSize = defaultLshSignatureSize;
+	}
+	if(signatureSize > 0 || options.indexName != NULL || queriedIndex != NULL || options.joinThreshold > 0) { //Sets of ids are only compared as they are; everything else works on 64-bit values
+		for(int i = 0; i < inputFileCount; i++) {
+			widenHashSet(inputFileHashes[i]);
+		}
+	}
+	if(signatureSize > 0) {
+		corpus.signatures = malloc(corpus.fileCount * sizeof(MinHashSignature*));
+		for(int i = 0; i < corpus.fileCount; i++) {
+			uint32_t* cachedValues = (cache != NULL) ? loadCachedSignature(cache, cacheEntries[i], signatureSize) : NULL;
+			if(cachedValues != NULL) {
+				printDebug("Loaded the MinHash signature of \"%s\" from the cache\n", inputFileNames[i]);
+				corpus.signatures[i] = malloc(sizeof(MinHashSignature));
+				if(corpus.signatures[i] == NULL) {
+					printf("\nERROR: Unable to allocate memory for a MinHash signature!\n");
+					exit(1);
+				}
+				corpus.signatures[i]->values = cachedValues;
+				corpus.signatures[i]->size = signatureSize;
+				continue;
+			}
 			
-			deleteList(unionedList);
-			deleteList(intersectedList);
+			printDebug("Computing a %d-value MinHash signature for \"%s\"\n", signatureSize, inputFileNames[i]);
+			double startTime = statsClock();
+			corpus.signatures[i] = computeSignature(inputFileHashes[i], signatureSize);
+			addStageTime("signature", startTime, 1, (uint64_t)inputFileHashes[i]->size * sizeof(uint64_t));
+			if(cache != NULL && cacheKeys[i].path != NULL) {
+				if(cacheEntries[i] < 0) { //A binary input seen for the first time
+					cacheEntries[i] = storeCacheEntry(cache, &cacheKeys[i], NULL, (uint64_t)inputFileHashes[i]->size);
+				}
+				storeCachedSignature(cache, cacheEntries[i], corpus.signatures[i]->values, signatureSize);
+			}
 		}
 	}
 	
-	printDebug("\nFreeing memory...\n");
+	/**Everything the cache can hold has now been loaded or computed, so save it before the (possibly long) comparisons begin:**/
+	int cacheHits = 0, cacheMisses = 0;
+	if(cache != NULL) {
+		cacheHits = cache->hits;
+		cacheMisses = cache->misses;
+		addCounter("cacheHits", (uint64_t)cacheHits);
+		addCounter("cacheMisses", (uint64_t)cacheMisses);
+		closeSignatureCache(cache);
+		for(int i = 0; i < inputFileCount; i++) {
+			free(cacheKeys[i].path);
+		}
+		free(cacheKeys);
+		free(cacheEntries);
+	}
 	
-	for(int i = 0; i < listSize(inputFileNames); i++) {
-		free(inputFileText[i]);
+	/**Pairs of dense sets from a small hash universe are compared faster as bitsets:**/
+	if(options.useBitsets == true && options.indexName == NULL && queriedIndex == NULL) {
+		double startTime = statsClock();
+		addBitsets(&corpus);
+		addStageTime("bitsets", startTime, (uint64_t)corpus.fileCount, 0);
 	}
-	free(inputFileText);
-	deleteList(inputFileNames);
-	printDebug("  Memory freed successfully.\n");
 	
-	return 0;
-}
-
-/**
- * Expanded version of the hash function. Hashes the number of bytes specified,
- * starting at address v. Used for hashing generic data other than strings.
- */
-int hash(void* v, unsigned int length) {
-	int h = 0, a = 31, count = 0;
-	if(v == NULL) {
-		printf("\nWARNING: Tried to hash a NULL pointer!\n");
-		return 0;
+	/**Compare each pair of files (or, in LSH mode, each candidate pair) and print their Jaccard similarity. In index and query modes, build or search an inverted index instead:**/
+	ComparisonTotals totals = {0, 0.0, 0.0, 0, 0};
+	ShardFileHeader run; //Describes the pairs compared, for the summary and any partial result file
+	long long comparedPairs = 0;
+	memset(&run, 0, sizeof(ShardFileHeader));
+	run.fileCount = (uint32_t)corpus.fileCount;
+	run.minHashSize = options.minHashSize;
+	run.signatureSize = signatureSize;
+	run.joinThreshold = options.joinThreshold;
+	run.lshThreshold = options.lshThreshold;
+	double compareStartTime = statsClock();
+	if(options.indexName != NULL) {
+		buildIndex(&corpus, options.indexName, (uint32_t)options.hashAlgorithm);
+		addStageTime("index", compareStartTime, (uint64_t)corpus.fileCount, 0);
+	} else if(queriedIndex != NULL) {
+		queryIndex(&corpus, queriedIndex, options.topCount);
+		closeShingleIndex(queriedIndex);
+		addStageTime("query", compareStartTime, (uint64_t)corpus.fileCount, 0);
+	} else if(options.joinThreshold > 0) {
+		JoinStatistics statistics = {0, 0};
+		long long candidateCount = 0;
+		
+		uint64_t* candidates = findJoinCandidates(&corpus, options.joinThreshold, &candidateCount, &statistics);
+		addStageTime("candidates", compareStartTime, (uint64_t)candidateCount, 0);
+		addCounter("prefixPruned", (uint64_t)statistics.prefixPruned);
+		addCounter("sizePruned", (uint64_t)statistics.sizePruned);
+		run.prefixPruned = (uint64_t)statistics.prefixPruned;
+		run.sizePruned = (uint64_t)statistics.sizePruned;
+		compareStartTime = statsClock();
+		comparedPairs = compareSequence(&corpus, candidates, candidateCount, &options, &totals, &run);
+		free(candidates);
+	} else if(options.lshThreshold > 0) {
+		int bands = 0, rows = 0;
+		long long candidateCount = 0;
+		
+		chooseBands(signatureSize, options.lshThreshold, &bands, &rows);
+		uint64_t* candidates = findCandidatePairs(&corpus, bands, rows, &candidateCount);
+		addStageTime("candidates", compareStartTime, (uint64_t)candidateCount, 0);
+		run.bands = bands;
+		run.rows = rows;
+		compareStartTime = statsClock();
+		comparedPairs = compareSequence(&corpus, candidates, candidateCount, &options, &totals, &run);
+		free(candidates);
+	} else {
+		comparedPairs = compareSequence(&corpus, NULL, (long long)corpus.fileCount * (corpus.fileCount - 1) / 2, &options, &totals, &run);
+	}
+	if(options.indexName == NULL && queriedIndex == NULL) {
+		addStageTime("compare", compareStartTime, (uint64_t)comparedPairs, 0);
+		addCounter("pairsCompared", (uint64_t)comparedPairs);
+		addCounter("pairsPrinted", (uint64_t)totals.pairCount);
 	}
+	if(options.shardCount == 0) { //A shard's summary is only printed once every shard is merged
+		printRunSummary(&run, &options, &totals);
+	}
+	if(options.cacheName != NULL) {
+		printf("\nSignature cache \"%s\": %d hits (loaded), %d misses (computed and saved).\n", options.cacheName, cacheHits, cacheMisses);
+	}
+	
+	printDebug("\nFreeing memory...\n");
 	
-	while(count < length) {
-		h = (a * h + *((char*)v)) % tblSize;
-		v++;
-		count++;
+	for(int i = 0; i < inputFileCount; i++) {
+		deleteHashSet(inputFileHashes[i]);
+		if(corpus.signatures != NULL) {
+			deleteSignature(corpus.signatures[i]);
+		}
 	}
-	return h;
-}
-
-int hashString(char *text) {
-	int h, a = 31;
-	for (h = 0; *text != '\0'; text++) {
-		h = (a * h + *text) % tblSize;
+	free(inputFileHashes);
+	free(corpus.signatures);
+	deleteArena(shingleArena);
+	free(inputFileNames);
+	printDebug("  Memory freed successfully.\n");
+	
+	if(options.statsName != NULL && writeStatsReport(options.statsName) != 0) {
+		printf("\nERROR: Unable to write the statistics to \"%s\"!\n", options.statsName);
+		exit(1);
 	}
-	return h;
+	return 0;
 }
 
-void interpretConsoleFlags(int argc, char* argv[], List* inputFileNames) {
+void interpretConsoleFlags(int argc, char* argv[], char** inputFileNames, int* inputFileCount, JaccardOptions* options) {
 	if(argc > 1) {
 		int gatheringInput = true; //If true, all subsequent unrecognized (not a flag) arguments are assumed to be input file names
 		for(int i = 1; i < argc; i++) {
@@ -127,164 +564,1658 @@ void interpretConsoleFlags(int argc, char* argv[], List* inputFileNames) {
 			} else if(strcmp(argv[i], "-d") == 0) { //If the user enabled the verbose debug messages
 				debugFlag = true;
 				gatheringInput = false;
+			} else if(strcmp(argv[i], "-minhash") == 0) { //Estimate each similarity from signatures of the given size
+				if(i + 1 >= argc || atoi(argv[i + 1]) < 1) {
+					printf("\nERROR: You must enter a MinHash signature size of at least 1!\n");
+					exit(1);
+				}
+				options->minHashSize = atoi(argv[++i]);
+				gatheringInput = false;
+			} else if(strcmp(argv[i], "-lsh") == 0) { //Only compare the pairs that LSH finds likely to reach the given similarity
+				if(i + 1 >= argc || atof(argv[i + 1]) <= 0.0 || atof(argv[i + 1]) > 1.0) {
+					printf("\nERROR: You must enter an LSH threshold greater than 0 and at most 1!\n");
+					exit(1);
+				}
+				options->lshThreshold = atof(argv[++i]);
+				gatheringInput = false;
+			} else if(strcmp(argv[i], "-t") == 0) { //Only find and print the pairs at least as similar as the given threshold
+				if(i + 1 >= argc || atof(argv[i + 1]) <= 0.0 || atof(argv[i + 1]) > 1.0) {
+					printf("\nERROR: You must enter a similarity threshold greater than 0 and at most 1!\n");
+					exit(1);
+				}
+				options->joinThreshold = atof(argv[++i]);
+				gatheringInput = false;
+			} else if(strcmp(argv[i], "-kernel") == 0) { //Intersect sets with the given kernel, instead of the fastest one available
+				if(i + 1 >= argc || !selectIntersectionKernel(argv[i + 1])) {
+					printf("\nERROR: The intersection kernel must be \"auto\", \"scalar\", \"sse4\" or \"avx2\", and supported by this processor!\n");
+					exit(1);
+				}
+				i++;
+				gatheringInput = false;
+			} else if(strcmp(argv[i], "-sets") == 0) { //Choose how sets are held for comparison
+				if(i + 1 < argc && strcmp(argv[i + 1], "auto") == 0) {
+					options->useBitsets = true;
+				} else if(i + 1 < argc && strcmp(argv[i + 1], "array") == 0) {
+					options->useBitsets = false;
+				} else {
+					printf("\nERROR: The set representation must be either \"auto\" or \"array\"!\n");
+					exit(1);
+				}
+				i++;
+				gatheringInput = false;
+			} else if(strcmp(argv[i], "-j") == 0) { //Compare pairs on the given number of worker threads
+				if(i + 1 >= argc || atoi(argv[i + 1]) < 1) {
+					printf("\nERROR: You must enter a thread count of at least 1!\n");
+					exit(1);
+				}
+				options->threadCount = atoi(argv[++i]);
+				gatheringInput = false;
+			} else if(strcmp(argv[i], "-hash") == 0) { //Hash .csv inputs with the given algorithm
+				options->hashAlgorithm = (i + 1 < argc) ? parseHashAlgorithm(argv[++i]) : -1;
+				if(options->hashAlgorithm < 0) {
+					printf("\nERROR: The hash algorithm must be \"xxh64\", \"rolling\" or \"legacy\"!\n");
+					exit(1);
+				}
+				gatheringInput = false;
+			} else if(strcmp(argv[i], "-cache") == 0) { //Load unchanged inputs from, and save new ones to, the given signature cache
+				if(i + 1 >= argc) {
+					printf("\nERROR: You must enter a name for the signature cache!\n");
+					exit(1);
+				}
+				options->cacheName = argv[++i];
+				gatheringInput = false;
+			} else if(strcmp(argv[i], "-index") == 0) { //Build an inverted index of the inputs, with the given name
+				if(i + 1 >= argc) {
+					printf("\nERROR: You must enter a name for the index!\n");
+					exit(1);
+				}
+				options->indexName = argv[++i];
+				gatheringInput = false;
+			} else if(strcmp(argv[i], "-query") == 0) { //Find the documents in the given index that are most similar to each input
+				if(i + 1 >= argc) {
+					printf("\nERROR: You must enter the name of the index to query!\n");
+					exit(1);
+				}
+				options->queryIndexName = argv[++i];
+				gatheringInput = false;
+			} else if(strcmp(argv[i], "-top") == 0) { //List the given number of documents for each query
+				if(i + 1 >= argc || atoi(argv[i + 1]) < 1) {
+					printf("\nERROR: You must list at least 1 document per query!\n");
+					exit(1);
+				}
+				options->topCount = atoi(argv[++i]);
+				gatheringInput = false;
+			} else if(strcmp(argv[i], "-stats") == 0) { //Write the time spent in each stage, and other counters, to the given JSON file
+				if(i + 1 >= argc) {
+					printf("\nERROR: You must enter a name for the statistics file!\n");
+					exit(1);
+				}
+				options->statsName = argv[++i];
+				gatheringInput = false;
+			} else if(strcmp(argv[i], "-mem") == 0) { //Hold at most the given number of bytes of hashes in memory, reading the rest from disk as needed
+				if(i + 1 >= argc || parseByteCount(argv[i + 1]) < 1024) {
+					printf("\nERROR: You must enter a memory budget of at least 1K (e.g. 512M or 4G)!\n");
+					exit(1);
+				}
+				options->memoryBudget = parseByteCount(argv[++i]);
+				gatheringInput = false;
+			} else if(strcmp(argv[i], "-matrix") == 0) { //Write every similarity to the given file, as a binary upper-triangular matrix
+				if(i + 1 >= argc) {
+					printf("\nERROR: You must enter a name for the matrix file!\n");
+					exit(1);
+				}
+				options->matrixName = argv[++i];
+				gatheringInput = false;
+			} else if(strcmp(argv[i], "-edges") == 0) { //Write the pairs that reach the -t or -lsh threshold (or any similarity above 0) to the given file
+				if(i + 1 >= argc) {
+					printf("\nERROR: You must enter a name for the edge list file!\n");
+					exit(1);
+				}
+				options->edgesName = argv[++i];
+				gatheringInput = false;
+			} else if(strcmp(argv[i], "-neighbors") == 0) { //Write the -top most similar files to each file to the given file
+				if(i + 1 >= argc) {
+					printf("\nERROR: You must enter a name for the nearest neighbors file!\n");
+					exit(1);
+				}
+				options->neighborsName = argv[++i];
+				gatheringInput = false;
+			} else if(strcmp(argv[i], "-shard") == 0) { //Only compare shard i of n of the pairs, writing the results to the -partial file
+				int shardIndex = 0, shardCount = 0;
+				char extra = 0;
+				if(i + 1 >= argc || sscanf(argv[i + 1], "%d/%d%c", &shardIndex, &shardCount, &extra) != 2 || shardIndex < 1 || shardIndex > shardCount) {
+					printf("\nERROR: You must enter the shard as i/n, where n is the number of shards and i is from 1 to n!\n");
+					exit(1);
+				}
+				options->shardIndex = shardIndex;
+				options->shardCount = shardCount;
+				i++;
+				gatheringInput = false;
+			} else if(strcmp(argv[i], "-partial") == 0) { //Write this shard's results to the given file, for -merge
+				if(i + 1 >= argc) {
+					printf("\nERROR: You must enter a name for the partial result file!\n");
+					exit(1);
+				}
+				options->partialName = argv[++i];
+				gatheringInput = false;
+			} else if(strcmp(argv[i], "-merge") == 0) { //The following arguments are the partial result files of every shard, to be merged
+				options->mergeInputs = true;
+				gatheringInput = true;
+			} else if(strcmp(argv[i], "-exact") == 0) { //Print the exact similarity beside each MinHash estimate
+				options->showExact = true;
+				gatheringInput = false;
 			} else if(gatheringInput == true) {
-				addToList(inputFileNames, argv[i]);
+				inputFileNames[(*inputFileCount)++] = argv[i];
 			}
 		}
 	}
-}
-
-char* readTextFile(const char* fileName) {
-	FILE* textFile = NULL;
-	int fileLength = 0; //In bytes
-	char* textBuffer = NULL;
 	
-	textFile = fopen(fileName, "rb");
-	if (textFile == NULL) {
-		printf("\nERROR: File \"%s\" not found!\n", fileName);
+	if((options->indexName != NULL || options->queryIndexName != NULL) && (options->minHashSize > 0 || options->lshThreshold > 0)) {
+		printf("\nERROR: -index and -query always compute exact similarities, so they cannot be used with -minhash or -lsh!\n");
 		exit(1);
 	}
+	if(options->joinThreshold > 0 && (options->minHashSize > 0 || options->lshThreshold > 0 || options->indexName != NULL || options->queryIndexName != NULL)) {
+		printf("\nERROR: -t finds every pair above the threshold exactly, so it cannot be used with -minhash, -lsh, -index or -query!\n");
+		exit(1);
+	}
+	if(options->indexName != NULL && options->queryIndexName != NULL) {
+		printf("\nERROR: -index and -query cannot be used together!\n");
+		exit(1);
+	}
+	if((options->matrixName != NULL || options->edgesName != NULL || options->neighborsName != NULL) && (options->indexName != NULL || options->queryIndexName != NULL)) {
+		printf("\nERROR: -matrix, -edges and -neighbors write the similarities of pairs of inputs, so they cannot be used with -index or -query!\n");
+		exit(1);
+	}
+	if(options->memoryBudget > 0 && (options->minHashSize > 0 || options->lshThreshold > 0 || options->indexName != NULL || options->queryIndexName != NULL || options->cacheName != NULL)) {
+		printf("\nERROR: -mem compares the full sets of every pair from disk, so it cannot be used with -minhash, -lsh, -index, -query or -cache!\n");
+		exit(1);
+	}
+	if((options->shardCount > 0) != (options->partialName != NULL)) {
+		printf("\nERROR: -shard and -partial must be used together!\n");
+		exit(1);
+	}
+	if(options->shardCount > 0 && (options->memoryBudget > 0 || options->indexName != NULL || options->queryIndexName != NULL || options->mergeInputs == true)) {
+		printf("\nERROR: -shard cannot be used with -mem, -index, -query or -merge!\n");
+		exit(1);
+	}
+	if(options->shardCount > 0 && (options->matrixName != NULL || options->edgesName != NULL || options->neighborsName != NULL)) {
+		printf("\nERROR: A shard only writes its partial result file; give -matrix, -edges and -neighbors to -merge instead!\n");
+		exit(1);
+	}
+	if(options->mergeInputs == true && (options->minHashSize > 0 || options->showExact == true || options->lshThreshold > 0 || options->joinThreshold > 0 || options->indexName != NULL || options->queryIndexName != NULL || options->memoryBudget > 0 || options->cacheName != NULL || options->hashAlgorithm >= 0)) {
+		printf("\nERROR: -merge takes the comparison options from the partial result files, so it cannot be used with -minhash, -exact, -lsh, -t, -index, -query, -mem, -cache or -hash!\n");
+		exit(1);
+	}
+}
+
+uint64_t parseByteCount(const char* text) { /** Sub-function of interpretConsoleFlags, reads a number of bytes with an optional K, M or G suffix, or returns 0 if it is not one **/
+	char* end = NULL;
+	double value = strtod(text, &end);
+	double unit = 1.0;
 	
-	fseek(textFile, 0, SEEK_END); //Set the file position indicator to the end of the file
-	fileLength = ftell(textFile); //get the value of the file position indicator, which now represents the length of the file
-	
+	if(*end == 'K' || *end == 'k') {
+		unit = 1024.0;
+	} else if(*end == 'M' || *end == 'm') {
+		unit = 1024.0 * 1024.0;
+	} else if(*end == 'G' || *end == 'g') {
+		unit = 1024.0 * 1024.0 * 1024.0;
+	}
+	if(unit > 1.0) {
+		end++;
+	}
+	if(end == text || *end != '\0' || !(value > 0) || value * unit >= 18446744073709551615.0) {
+		return 0;
+	}
+	return (uint64_t)(value * unit);
+}
+
+char* readTextFile(const char* fileName, size_t* textLength) {
+	double startTime = statsClock();
 	printDebug("\n >Reading from file \"%s\"\n", fileName); //<DEBUG>
-	printDebug("The file is %d bytes long.\n", fileLength); //<DEBUG>
 	
-	textBuffer = malloc(fileLength * sizeof(char) + 1); //Allocate enough buffer space for the text file, plus a terminating zero
-	if (textBuffer == NULL) {
-		fclose(textFile);
+	char* textBuffer = readWholeFile(fileName, textLength);
+	if(textBuffer == NULL) {
+		printf("\nERROR: File \"%s\" not found!\n", fileName);
 		exit(1);
 	}
+	countAllocation((uint64_t)*textLength + 1);
+	addStageTime("read", startTime, 1, (uint64_t)*textLength);
 	
-	fseek(textFile, 0, SEEK_SET); //Set the file position indicator back to the beginning of the file
-	fread(textBuffer, sizeof(char), fileLength, textFile);
-	textBuffer[fileLength] = '\0';
-	
-	fclose(textFile);
+	printDebug("The file is %d bytes long.\n", (int)*textLength); //<DEBUG>
 	printDebug("File \"%s\" read successfully.\n", fileName);
-	
 	return textBuffer;
 }
 
-List* tokenizeString(char* inputString, const char* delimiters) {
-	List* outputStorage = createList(ARRAY_LIST);
-	char* temp = strtok(inputString, delimiters); //strtok returns a pointer to a position *INSIDE* inputString! Not a new copy!
-	char* tempCopy = malloc(sizeof(char) * strlen(temp) + 1); //Therefore, we need to make a new copy if we want to treat inputString as immutable
-	strcpy(tempCopy, temp);
-	addToList(outputStorage, tempCopy);
-	
-	while((temp = strtok(NULL, delimiters)) != NULL) {
-		tempCopy = malloc(sizeof(char) * strlen(temp) + 1);
-		strcpy(tempCopy, temp);
-		addToList(outputStorage, tempCopy);
-	}
-	return outputStorage;
-}
-
-void printDebug(char* debugText, ...) { /**Wraps printf(), calling it only if global variable debugFlag is true**/
+void printDebug(const char* debugText, ...) { /**Wraps printf(), calling it only if global variable debugFlag is true**/
 	if(debugFlag == true) {
 		va_list args; //Set up our variable argument's data structure
 		va_start(args, debugText); //The variable argument "starts" right after our last finite argument, which is *debugText
-		
-		char* character = "%";
-		
-		char* subString = NULL;
-		char* position = debugText; //This variable will point to characters in the middle of debugText, serving as the start of any remaining unprocessed text
-		int subStrLength = 0;
-		
-		while(position[0] != '\0') {
-			//Get the length of the string preceding the character '%' if there is one, else the total length remaining:
-			subStrLength = strcspn(position, character);
-			
-			//Copy the contents of the sub-string we just found into a buffer, which will be printed later
-			subString = malloc(sizeof(char) * subStrLength + 1);
-			strncpy(subString, position, subStrLength);
-			subString[subStrLength] = '\0';
-			
-			//Point position to the first character after the sub-string we just found:
-			position += subStrLength;
-			
-			printf(subString);
-			
-			//If a print directive is present, determine its type, print the appropriate variable argument, and consume the directive:
-			if(position[0] == '%') { 
-				if(position[1] == 'c') {
-					printf("%c", va_arg(args, unsigned int)); //For %c
-					position += 2;
-				} else if(position[1] == 's') {
-					printf("%s", va_arg(args, unsigned int)); //For %s
-					position += 2;
-				} else if(position[1] == 'd') {
-					printf("%d", va_arg(args, signed int*)); //For %d
-					position += 2;
-				} else if(position[1] == 'p') {
-					printf("%p", va_arg(args, void*)); //For %p
-					position += 2;
-				} else {//This accounts for an edge case where a string contains a % with no valid following type character
-					position++; //Skip the lone %
-				}
-			}
-		}
-		
+		vprintf(debugText, args);
 		va_end(args); //Clean up the variable argument's data structure
 	}
 }
 
-List* hashList(List* itemList) {
-	List* hashedList = createList(ARRAY_LIST);
-	int* hashValue = NULL;
-	for(int i = 0; i < listSize(itemList); i++) {
-		//We cannot store the returned value of hashString() directly, because it has no memory address (it's in a CPU register)
-		hashValue = malloc(sizeof(int));
-		*hashValue = hashString(getFromList(itemList, i)); //Copy the value from the register to a newly-created location on the heap
-		addToList(hashedList, hashValue);
+HashSet* createHashSet(const uint64_t* values, int size, uint32_t hashAlgorithm, int ownsValues) { /** Wraps an array of sorted, distinct hashes, which the HashSet frees if ownsValues is true **/
+	HashSet* hashedSet = malloc(sizeof(HashSet));
+	if(hashedSet == NULL) {
+		printf("\nERROR: Unable to allocate memory for the hashed n-grams!\n");
+		exit(1);
+	}
+	
+	hashedSet->values = values;
+	hashedSet->ids = NULL;
+	hashedSet->size = size;
+	hashedSet->hashAlgorithm = hashAlgorithm;
+	hashedSet->source = NULL;
+	hashedSet->ownsValues = ownsValues;
+	hashedSet->bits = NULL;
+	return hashedSet;
+}
+
+/**
+ * Wraps a binary shingle file in a HashSet. The file is mapped into memory and its hashes are used
+ * where they lie, so nothing is parsed or copied; pages are only read in as the comparisons touch them.
+ */
+HashSet* mapHashSet(const char* fileName) {
+	HashSet* mappedSet = malloc(sizeof(HashSet));
+	if(mappedSet == NULL) {
+		printf("\nERROR: Unable to allocate memory for the hashed n-grams!\n");
+		exit(1);
+	}
+	
+	mappedSet->source = openShingleFile(fileName);
+	mappedSet->ownsValues = false;
+	mappedSet->bits = NULL;
+	mappedSet->values = mappedSet->source->hashes;
+	mappedSet->ids = mappedSet->source->ids;
+	mappedSet->size = (int)mappedSet->source->count;
+	mappedSet->hashAlgorithm = mappedSet->source->header->hashAlgorithm;
+	printDebug("  The file holds %d hashed n-grams.\n", mappedSet->size);
+	return mappedSet;
+}
+
+/**
+ * Ids from two dictionaries mean different shingles, so any similarity between their files would be meaningless.
+ */
+void checkDictionaryStamp(const char* fileName, const DictionaryStamp* stamp, const char** firstFileName, uint64_t* firstIdentity) { /** Exits if the file's ids are from a different dictionary than the first file of ids **/
+	if(*firstFileName == NULL) {
+		*firstFileName = fileName;
+		*firstIdentity = stamp->dictionaryIdentity;
+	} else if(stamp->dictionaryIdentity != *firstIdentity) {
+		printf("\nERROR: \"%s\" and \"%s\" hold ids from different shingle dictionaries, so they cannot be compared!\n", *firstFileName, fileName);
+		exit(1);
 	}
-	return hashedList;
 }
 
-List* unionLists(List* list1, List* list2) {
-	List* unionedList = createList(ARRAY_LIST);
-	for(int i = 0; i < listSize(list1); i++) { //Add all elements in list1 to unionedList
-		int* temp = malloc(sizeof(int));
-		*temp = *((int*)getFromList(list1, i));
-		addToList(unionedList, temp);
+/**
+ * Ids are widened in order, so the values stay sorted and distinct. A set that is not made of ids is left as it is.
+ */
+void widenHashSet(HashSet* set) { /** Gives a set of dictionary ids the same ids as 64-bit values, for the modes that hash or index them **/
+	if(set->ids == NULL || set->values != NULL) {
+		return;
+	}
+	uint64_t* values = malloc((set->size > 0 ? set->size : 1) * sizeof(uint64_t));
+	if(values == NULL) {
+		printf("\nERROR: Unable to allocate memory for the hashed n-grams!\n");
+		exit(1);
 	}
-	for(int i = 0; i < listSize(list2); i++) { //Add all elements in list2 to unionedList
-		int* temp = malloc(sizeof(int));
-		*temp = *((int*)getFromList(list2, i));
-		addToList(unionedList, temp);
+	for(int j = 0; j < set->size; j++) {
+		values[j] = set->ids[j];
 	}
-	removeDuplicates(unionedList); //Remove any duplicates that were likely introduced
-	return unionedList;
+	set->values = values;
+	set->ownsValues = true;
 }
 
-List* intersectLists(List* list1, List* list2) {
-	List* intersectedList = createList(ARRAY_LIST);
-	for(int i = 0; i < listSize(list1); i++) { //For each element in the first list:
-		for(int k = 0; k < listSize(list2); k++) { //Compare it to each element in the second list:
-			if(*((int*)getFromList(list1, i)) == *((int*)getFromList(list2, k))) { //If a match is found, add it to intersectedList (including duplicates)
-				int* temp = malloc(sizeof(int));
-				*temp = *((int*)getFromList(list1, i));
-				addToList(intersectedList, temp);
-			}
+/**
+ * Counts the hashes common to both sets, with the fastest kernel this processor supports (see SetIntersection.h).
+ * Both sets must be sorted and free of duplicates, as every HashSet is. Two sets of dictionary ids are intersected as
+ * 32-bit ids, which is twice as many per vector; a set of ids and a set of hashes have nothing meaningful in common.
+ */
+int intersectionSize(const HashSet* set1, const HashSet* set2) {
+	if(set1->ids != NULL && set2->ids != NULL) {
+		return (int)intersectionCount32(set1->ids, (uint64_t)set1->size, set2->ids, (uint64_t)set2->size);
+	} else if(set1->values == NULL || set2->values == NULL) {
+		return 0;
+	}
+	return (int)intersectionCount64(set1->values, (uint64_t)set1->size, set2->values, (uint64_t)set2->size);
+}
+
+void deleteHashSet(HashSet* set) {
+	if(set->ownsValues == true) {
+		free((void*)set->values);
+	}
+	if(set->source != NULL) {
+		closeShingleFile(set->source);
+	}
+	free(set->bits);
+	free(set);
+}
+
+/**
+ * When every set was hashed with an algorithm that only produces a small, fixed range of values (the legacy hash's
+ * 104729), gives each set dense enough to benefit a bitset over that range as well. A pair of sets that both have
+ * one is intersected with an AND and population count over the bitsets, whose cost is the same for every pair;
+ * any other pair is merged as arrays as before. A set that holds a value outside the range keeps only its array.
+ */
+void addBitsets(Corpus* corpus) {
+	uint64_t universe = (corpus->fileCount > 0) ? hashUniverseSize(corpus->hashes[0]->hashAlgorithm) : 0;
+	for(int i = 1; i < corpus->fileCount; i++) {
+		if(corpus->hashes[i]->hashAlgorithm != corpus->hashes[0]->hashAlgorithm) {
+			universe = 0;
+		}
+	}
+	if(universe == 0) {
+		return;
+	}
+	
+	int bitsetCount = 0;
+	uint64_t words = BITSET_WORDS(universe);
+	for(int i = 0; i < corpus->fileCount; i++) {
+		HashSet* set = corpus->hashes[i];
+		if(set->size == 0 || set->size < bitsetMinimumDensity * words || set->values[set->size - 1] >= universe) {
+			continue;
+		}
+		set->bits = createBitset(set->values, (uint64_t)set->size, universe);
+		if(set->bits == NULL) {
+			printf("\nERROR: Unable to allocate memory for the bitsets!\n");
+			exit(1);
 		}
+		bitsetCount++;
 	}
-	removeDuplicates(intersectedList);
-	return intersectedList;
+	corpus->bitsetWords = words;
+	printDebug("\n%d of the sets are also held as %d-word bitsets.\n", bitsetCount, (int)words);
 }
 
-void removeDuplicates(List* inputList) {
-	int* currentItem = NULL;
-	int i, k;
+/**
+ * Builds a MinHash signature of the given size from a HashSet. Each hash in the set is passed through
+ * every one of the signatureSize mixing functions, and the smallest output of each function is kept.
+ * The seeds are fixed, so signatures computed by separate runs can be compared with each other.
+ */
+MinHashSignature* computeSignature(const HashSet* set, int signatureSize) {
+	MinHashSignature* signature = malloc(sizeof(MinHashSignature));
+	uint64_t* seeds = malloc(signatureSize * sizeof(uint64_t));
+	uint64_t seed = 0;
+	
+	signature->values = malloc(signatureSize * sizeof(uint32_t));
+	if(seeds == NULL || signature->values == NULL) {
+		printf("\nERROR: Unable to allocate memory for a MinHash signature!\n");
+		exit(1);
+	}
+	signature->size = signatureSize;
 	
-	for(i = 0; i < listSize(inputList); i++) {
-		currentItem = getFromList(inputList, i);
-		for(k = i + 1; k < listSize(inputList); k++) { //Iterate through every element after currentItem
-			if(*currentItem == *((int*)getFromList(inputList, k))) { //If an element is found that is identical to currentItem, it needs to be removed
-				removeFromList(inputList, k);
-				k--; //The contents of the list have shifted left, re-check this index
+	for(int j = 0; j < signatureSize; j++) {
+		seed += 0x9E3779B97F4A7C15ULL; //Weyl sequence, gives every hash function a distinct, well-spread seed
+		seeds[j] = seed;
+		signature->values[j] = UINT32_MAX;
+	}
+	
+	for(int i = 0; i < set->size; i++) {
+		for(int j = 0; j < signatureSize; j++) {
+			uint32_t mixed = mixHash(set->values[i], seeds[j]);
+			if(mixed < signature->values[j]) {
+				signature->values[j] = mixed;
 			}
 		}
 	}
+	
+	free(seeds);
+	return signature;
+}
+
+uint32_t mixHash(uint64_t value, uint64_t seed) { /** Sub-function of computeSignature, one of the independent hash functions, selected by seed **/
+	//The splitmix64 finalizer: every input bit affects every output bit, so each seed behaves like an independent permutation
+	uint64_t z = value + seed;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	z = z ^ (z >> 31);
+	return (uint32_t)(z >> 32);
+}
+
+/**
+ * The fraction of slots in which two signatures of the same size agree, which estimates their Jaccard similarity.
+ * The standard error of the estimate is about sqrt(J * (1 - J) / size), regardless of how large the sets are.
+ */
+double estimateSimilarity(const MinHashSignature* signature1, const MinHashSignature* signature2) {
+	int matches = 0;
+	for(int j = 0; j < signature1->size; j++) {
+		matches += (signature1->values[j] == signature2->values[j]);
+	}
+	return (double)matches / (double)signature1->size;
+}
+
+void deleteSignature(MinHashSignature* signature) {
+	free(signature->values);
+	free(signature);
+}
+
+/**
+ * Compares files i and k. In MinHash mode the signatures are compared, and the full sets are only
+ * intersected if -exact was given. In every other mode (including LSH) the exact similarity is computed.
+ */
+void comparePair(const Corpus* corpus, int i, int k, const JaccardOptions* options, PairResult* result) {
+	double startTime = (statsEnabled == true) ? statsClock() : 0.0;
+	memset(result, 0, sizeof(PairResult));
+	result->i = i;
+	result->k = k;
+	
+	int estimating = (options->minHashSize > 0 && options->lshThreshold == 0);
+	if(estimating == true) {
+		result->estimatedSimilarity = estimateSimilarity(corpus->signatures[i], corpus->signatures[k]);
+		result->hasEstimate = true;
+	}
+	
+	if(estimating == false || options->showExact == true) {
+		if(corpus->hashes[i]->bits != NULL && corpus->hashes[k]->bits != NULL) {
+			result->intersectedSize = (int)bitsetIntersectionCount(corpus->hashes[i]->bits, corpus->hashes[k]->bits, corpus->bitsetWords);
+		} else {
+			result->intersectedSize = intersectionSize(corpus->hashes[i], corpus->hashes[k]);
+		}
+		result->unionedSize = corpus->hashes[i]->size + corpus->hashes[k]->size - result->intersectedSize; //|A u B| = |A| + |B| - |A n B|
+		result->similarity = (double)result->intersectedSize / (double)result->unionedSize;
+		result->hasExact = true;
+	}
+	if(statsEnabled == true) {
+		result->seconds = statsClock() - startTime;
+	}
+}
+
+void printPairResult(const Corpus* corpus, const PairResult* result, const JaccardOptions* options, ComparisonTotals* totals) {
+	char* name1 = corpus->fileNames[result->i];
+	char* name2 = corpus->fileNames[result->k];
+	double startTime = 0.0;
+	
+	if(statsEnabled == true) { //Recorded here, on the main thread, so the worker threads never contend for the histogram
+		recordPairLatency(result->seconds);
+		startTime = statsClock();
+	}
+	if(options->joinThreshold > 0) { //The threshold join only prints the pairs that reach the threshold
+		if(!(result->similarity >= options->joinThreshold)) {
+			return;
+		}
+		totals->aboveThreshold++;
+	}
+	
+	totals->pairCount++;
+	if(options->partialFile != NULL) { //A shard only records its results, which -merge prints (or writes to the result files) in order later
+		writePartialResult(options, result);
+		addStageTime("output", startTime, 1, 0);
+		return;
+	}
+	if(options->sink != NULL) { //Written out by the sink's own thread instead of printed
+		addResult(options->sink, (uint32_t)result->i, (uint32_t)result->k, (result->hasExact == true) ? result->similarity : result->estimatedSimilarity);
+	} else {
+		printf("\nComparing files \"%s\" and \"%s\":\n", name1, name2);
+	}
+	
+	if(result->hasEstimate == true && options->sink == NULL) {
+		printf("  Files \"%s\" and \"%s\" are an estimated %.2f%% similar.\n", name1, name2, result->estimatedSimilarity * 100);
+	}
+	if(result->hasExact == true) {
+		printDebug("  The intersection results in %d n-grams\n", result->intersectedSize);
+		printDebug("  The union results in %d n-grams\n", result->unionedSize);
+		if(result->hasEstimate == true) {
+			double error = fabs(result->estimatedSimilarity - result->similarity);
+			if(options->sink == NULL) {
+				printf("  Their exact similarity is %.2f%% (estimate is off by %+.2f%%).\n", result->similarity * 100, (result->estimatedSimilarity - result->similarity) * 100);
+			}
+			totals->totalError += error;
+			totals->errorCount++;
+			if(error > totals->maxError) {
+				totals->maxError = error;
+			}
+		} else if(options->sink == NULL) {
+			printf("  Files \"%s\" and \"%s\" are %.2f%% similar.\n", name1, name2, result->similarity * 100);
+		}
+		if(options->lshThreshold > 0 && result->similarity >= options->lshThreshold) {
+			totals->aboveThreshold++;
+		}
+	}
+	addStageTime("output", startTime, 1, 0);
+}
+
+void writePartialResult(const JaccardOptions* options, const PairResult* result) { /** Sub-function of printPairResult, records a shard's result in its partial result file **/
+	ShardResult record;
+	memset(&record, 0, sizeof(ShardResult));
+	record.i = (uint32_t)result->i;
+	record.k = (uint32_t)result->k;
+	record.intersectedSize = result->intersectedSize;
+	record.unionedSize = result->unionedSize;
+	record.similarity = result->similarity;
+	record.estimatedSimilarity = result->estimatedSimilarity;
+	record.seconds = result->seconds;
+	record.flags = ((result->hasExact == true) ? SHARD_EXACT : 0) | ((result->hasEstimate == true) ? SHARD_ESTIMATE : 0);
+	if(fwrite(&record, sizeof(ShardResult), 1, options->partialFile) != 1) {
+		printf("\nERROR: Unable to write to partial result file \"%s\"!\n", options->partialName);
+		exit(1);
+	}
+}
+
+void printRunSummary(const ShardFileHeader* run, JaccardOptions* options, const ComparisonTotals* totals) { /** Prints the summary of the threshold join or LSH, and of the MinHash error, and closes the result files **/
+	long long totalPairs = (long long)run->fileCount * ((long long)run->fileCount - 1) / 2;
+	long long candidateCount = (long long)run->sequenceLength;
+	
+	if(run->joinThreshold > 0) {
+		printf("\nThe threshold join verified %lld of %lld total pairs exactly (%lld pruned, %.2f%%).\n", candidateCount, totalPairs, totalPairs - candidateCount, totalPairs > 0 ? (double)(totalPairs - candidateCount) / totalPairs * 100 : 0.0);
+		printf("  %lld pairs were pruned by the prefix filter, and %lld more by the size filter.\n", (long long)run->prefixPruned, (long long)run->sizePruned);
+		printf("  %lld pairs are at least %.2f%% similar.\n", totals->aboveThreshold, run->joinThreshold * 100);
+	} else if(run->lshThreshold > 0) {
+		printf("\nLSH used %d bands of %d rows (signature size %d, approximate threshold %.2f%%).\n", run->bands, run->rows, run->signatureSize, pow(1.0 / run->bands, 1.0 / run->rows) * 100);
+		printf("  %lld candidate pairs were compared out of %lld total pairs (%lld pruned, %.2f%%).\n", candidateCount, totalPairs, totalPairs - candidateCount, totalPairs > 0 ? (double)(totalPairs - candidateCount) / totalPairs * 100 : 0.0);
+		printf("  %lld candidate pairs are at least %.2f%% similar.\n", totals->aboveThreshold, run->lshThreshold * 100);
+	}
+	if(options->sink != NULL) {
+		double startTime = statsClock();
+		closeResultSink(options->sink);
+		options->sink = NULL;
+		addStageTime("close", startTime, 1, 0);
+		printf("\nWrote the similarities of %lld pairs to the result files.\n", totals->pairCount);
+	}
+	
+	if(totals->errorCount > 0) {
+		printf("\nMinHash error over %lld pairs (K = %d): mean %.2f%%, max %.2f%%\n", totals->errorCount, run->minHashSize, totals->totalError / totals->errorCount * 100, totals->maxError * 100);
+	}
+}
+
+/**
+ * Compares the sequence of pairs: those in candidates, or every (i,k) with i < k in (i,k) order if candidates is
+ * NULL. With -shard, only this shard's share of the sequence is compared, and its results are written to the -partial
+ * file (described by run) instead of being printed.
+ */
+long long compareSequence(const Corpus* corpus, const uint64_t* candidates, long long sequenceLength, JaccardOptions* options, ComparisonTotals* totals, ShardFileHeader* run) { /** Compares the sequence of pairs, or with -shard this shard's share of it, and returns how many pairs were compared **/
+	long long firstPair = 0, pairCount = sequenceLength;
+	double share = 1.0;
+	PairResult result;
+	
+	run->sequenceLength = (uint64_t)sequenceLength;
+	if(options->shardCount > 0) {
+		share = findShardRange(corpus, candidates, sequenceLength, options, &firstPair, &pairCount);
+		run->shardIndex = (uint32_t)options->shardIndex;
+		run->shardCount = (uint32_t)options->shardCount;
+		run->firstPair = (uint64_t)firstPair;
+		run->pairCount = (uint64_t)pairCount;
+		options->partialFile = beginShardFile(options->partialName, run, corpus->fileNames);
+	}
+	
+	if(options->threadCount > 1) {
+		comparePairsInParallel(corpus, candidates, firstPair, pairCount, options, totals);
+	} else if(candidates != NULL) {
+		for(long long c = firstPair; c < firstPair + pairCount; c++) {
+			comparePair(corpus, (int)(candidates[c] >> 32), (int)(candidates[c] & 0xFFFFFFFFU), options, &result);
+			printPairResult(corpus, &result, options, totals);
+		}
+	} else if(pairCount > 0) {
+		int i = 0, k = 0;
+		pairFromIndex(firstPair, corpus->fileCount, &i, &k);
+		for(long long p = 0; p < pairCount; p++) {
+			comparePair(corpus, i, k, options, &result);
+			printPairResult(corpus, &result, options, totals);
+			k++; //Step to the next pair in (i,k) order
+			if(k == corpus->fileCount) {
+				i++;
+				k = i + 1;
+			}
+		}
+	}
+	
+	if(options->partialFile != NULL) {
+		finishShardFile(options->partialFile, options->partialName, (uint64_t)totals->pairCount);
+		options->partialFile = NULL;
+		printf("\nShard %d of %d compared pairs %lld to %lld of %lld (%.2f%% of their estimated cost), and wrote %lld results to \"%s\".\n", options->shardIndex, options->shardCount, firstPair, firstPair + pairCount, sequenceLength, share * 100, totals->pairCount, options->partialName);
+	}
+	return pairCount;
+}
+
+/**
+ * Finds the pairs [*firstPair, *firstPair + *pairCount) that make up shard options->shardIndex of the sequence, cut
+ * so that every shard's pairs have about the same estimated cost: shards of pairs of large files get fewer of them.
+ * The costs only depend on the inputs and options, so every shard cuts the sequence in the same places, and the
+ * shards cover it exactly once. Returns the fraction of the total cost that is this shard's.
+ */
+double findShardRange(const Corpus* corpus, const uint64_t* candidates, long long sequenceLength, const JaccardOptions* options, long long* firstPair, long long* pairCount) { /** Sub-function of compareSequence, cuts the shard's share of the pairs by their estimated cost **/
+	int estimating = (options->minHashSize > 0 && options->lshThreshold == 0);
+	int intersecting = (estimating == false || options->showExact == true);
+	PairCosts costs = {NULL, NULL, NULL, corpus->fileCount, pairCostOverhead + ((estimating == true) ? (uint64_t)options->minHashSize : 0)};
+	int fileCount = corpus->fileCount;
+	
+	costs.setCosts = calloc((size_t)fileCount + 1, sizeof(uint64_t));
+	costs.rowCosts = calloc((fileCount > 0) ? (size_t)fileCount : 1, sizeof(uint64_t));
+	if(candidates != NULL) {
+		costs.candidateCosts = malloc(((size_t)sequenceLength + 1) * sizeof(uint64_t));
+	}
+	if(costs.setCosts == NULL || costs.rowCosts == NULL || (candidates != NULL && costs.candidateCosts == NULL)) {
+		printf("\nERROR: Unable to allocate memory for the shard's share of the pairs!\n");
+		exit(1);
+	}
+	for(int j = fileCount - 1; j >= 0; j--) {
+		costs.setCosts[j] = costs.setCosts[j + 1] + ((intersecting == true) ? (uint64_t)corpus->hashes[j]->size : 0);
+	}
+	for(int i = 1; i < fileCount; i++) { //Row i - 1 holds the pairs (i - 1, k) for every k from i on
+		uint64_t setCost = costs.setCosts[i - 1] - costs.setCosts[i];
+		costs.rowCosts[i] = costs.rowCosts[i - 1] + (uint64_t)(fileCount - i) * (setCost + costs.pairCost) + costs.setCosts[i];
+	}
+	if(candidates != NULL) {
+		costs.candidateCosts[0] = 0;
+		for(long long c = 0; c < sequenceLength; c++) {
+			int i = (int)(candidates[c] >> 32), k = (int)(candidates[c] & 0xFFFFFFFFU);
+			costs.candidateCosts[c + 1] = costs.candidateCosts[c] + (costs.setCosts[i] - costs.setCosts[i + 1]) + (costs.setCosts[k] - costs.setCosts[k + 1]) + costs.pairCost;
+		}
+	}
+	
+	uint64_t totalCost = costBeforePair(&costs, sequenceLength);
+	long long bounds[2];
+	for(int b = 0; b < 2; b++) { //The shard starts at the first pair with at least (shardIndex - 1) / shardCount of the total cost before it, and ends where the next shard starts
+		uint64_t shards = (uint64_t)options->shardCount, before = (uint64_t)(options->shardIndex - 1 + b);
+		uint64_t target = totalCost / shards * before + totalCost % shards * before / shards; //totalCost * before / shards, without overflowing
+		long long low = 0, high = sequenceLength;
+		while(low < high) {
+			long long middle = low + (high - low) / 2;
+			if(costBeforePair(&costs, middle) >= target) {
+				high = middle;
+			} else {
+				low = middle + 1;
+			}
+		}
+		bounds[b] = low;
+	}
+	*firstPair = bounds[0];
+	*pairCount = bounds[1] - bounds[0];
+	double share = (totalCost > 0) ? (double)(costBeforePair(&costs, bounds[1]) - costBeforePair(&costs, bounds[0])) / (double)totalCost : 1.0;
+	
+	free(costs.candidateCosts);
+	free(costs.setCosts);
+	free(costs.rowCosts);
+	return share;
+}
+
+uint64_t costBeforePair(const PairCosts* costs, long long pair) { /** Sub-function of findShardRange **/
+	if(costs->candidateCosts != NULL) {
+		return costs->candidateCosts[pair];
+	}
+	if(costs->fileCount < 2) {
+		return 0;
+	}
+	if(pair >= (long long)costs->fileCount * (costs->fileCount - 1) / 2) {
+		return costs->rowCosts[costs->fileCount - 1];
+	}
+	
+	int i = 0, k = 0;
+	pairFromIndex(pair, costs->fileCount, &i, &k);
+	uint64_t setCost = costs->setCosts[i] - costs->setCosts[i + 1];
+	return costs->rowCosts[i] + (uint64_t)(k - i - 1) * (setCost + costs->pairCost) + (costs->setCosts[i + 1] - costs->setCosts[k]); //Row i's pairs (i, i+1) ... (i, k-1)
+}
+
+/**
+ * Combines the partial result files of every shard of a run into the output the run would have given as a single
+ * process. The shards' pairs follow one another in the order they would have been compared in, so their results are
+ * simply printed (or written to the result files) shard by shard.
+ */
+void mergePartialFiles(char** partialNames, int partialCount, JaccardOptions* options) {
+	double startTime = statsClock();
+	if(partialCount < 1) {
+		printf("\nERROR: You must enter the partial result file of every shard to merge!\n");
+		exit(1);
+	}
+	MappedShardFile** shards = calloc((size_t)partialCount, sizeof(MappedShardFile*)); //Indexed by shardIndex - 1
+	if(shards == NULL) {
+		printf("\nERROR: Unable to allocate memory for the partial result files!\n");
+		exit(1);
+	}
+	for(int p = 0; p < partialCount; p++) {
+		MappedShardFile* shard = openShardFile(partialNames[p]);
+		if(shard->header->shardCount != (uint32_t)partialCount) {
+			printf("\nERROR: \"%s\" is one of %u shards, but %d partial result files were given!\n", partialNames[p], shard->header->shardCount, partialCount);
+			exit(1);
+		}
+		if(shard->header->shardIndex < 1 || shard->header->shardIndex > shard->header->shardCount || shards[shard->header->shardIndex - 1] != NULL) {
+			printf("\nERROR: \"%s\" is shard %u, which was already given!\n", partialNames[p], shard->header->shardIndex);
+			exit(1);
+		}
+		shards[shard->header->shardIndex - 1] = shard;
+	}
+	
+	/**Every shard must be of the same run, and together they must cover its pairs exactly once:**/
+	const ShardFileHeader* run = shards[0]->header;
+	uint64_t nextPair = 0;
+	for(int s = 0; s < partialCount; s++) {
+		const ShardFileHeader* header = shards[s]->header;
+		if(header->fileCount != run->fileCount || header->namesLength != run->namesLength || memcmp(header + 1, run + 1, (size_t)run->namesLength) != 0 || header->sequenceLength != run->sequenceLength || header->minHashSize != run->minHashSize || header->signatureSize != run->signatureSize || header->bands != run->bands || header->rows != run->rows || header->joinThreshold != run->joinThreshold || header->lshThreshold != run->lshThreshold || header->prefixPruned != run->prefixPruned || header->sizePruned != run->sizePruned) {
+			printf("\nERROR: Shards %u and %u were not compared with the same inputs and options!\n", run->shardIndex, header->shardIndex);
+			exit(1);
+		}
+		if(header->firstPair != nextPair) {
+			printf("\nERROR: Shard %u does not start where shard %u ends!\n", header->shardIndex, header->shardIndex - 1);
+			exit(1);
+		}
+		nextPair += header->pairCount;
+	}
+	if(nextPair != run->sequenceLength) {
+		printf("\nERROR: The shards only cover %llu of the run's %llu pairs!\n", (unsigned long long)nextPair, (unsigned long long)run->sequenceLength);
+		exit(1);
+	}
+	
+	/**Replay the results with the options they were compared with:**/
+	Corpus corpus = {(char**)shards[0]->fileNames, NULL, NULL, (int)run->fileCount, 0};
+	ComparisonTotals totals = {0, 0.0, 0.0, 0, 0};
+	options->minHashSize = run->minHashSize;
+	options->joinThreshold = run->joinThreshold;
+	options->lshThreshold = run->lshThreshold;
+	if(options->matrixName != NULL || options->edgesName != NULL || options->neighborsName != NULL) {
+		double edgeThreshold = (options->joinThreshold > 0) ? options->joinThreshold : options->lshThreshold;
+		options->sink = openResultSink(corpus.fileNames, run->fileCount, options->matrixName, options->edgesName, edgeThreshold, options->neighborsName, (uint32_t)options->topCount);
+	}
+	for(int s = 0; s < partialCount; s++) {
+		for(uint64_t r = 0; r < shards[s]->header->resultCount; r++) {
+			const ShardResult* record = &shards[s]->results[r];
+			PairResult result = {(int)record->i, (int)record->k, record->intersectedSize, record->unionedSize, record->similarity, record->estimatedSimilarity, (record->flags & SHARD_EXACT) != 0, (record->flags & SHARD_ESTIMATE) != 0, record->seconds};
+			if(record->i >= record->k || record->k >= run->fileCount) {
+				printf("\nERROR: The partial result file of shard %d is damaged!\n", s + 1);
+				exit(1);
+			}
+			printPairResult(&corpus, &result, options, &totals);
+		}
+	}
+	addStageTime("merge", startTime, (uint64_t)partialCount, 0);
+	addCounter("pairsCompared", run->sequenceLength);
+	addCounter("pairsPrinted", (uint64_t)totals.pairCount);
+	
+	printRunSummary(run, options, &totals);
+	for(int s = 0; s < partialCount; s++) {
+		closeShardFile(shards[s]);
+	}
+	free(shards);
+}
+
+/**
+ * Compares pairTotal pairs on options->threadCount worker threads, while the calling thread prints the results.
+ * The pairs are those in candidates, or every (i,k) with i < k if candidates is NULL, from position firstPair on. Pair costs vary with file
+ * size, so the pairs are cut into many small tasks that idle workers can steal, rather than one range per thread.
+ * Results are printed strictly in task order, so the output is identical to the single-threaded loop. No task more
+ * than tasksAheadPerWorker tasks per worker past the one being printed is started, so however slowly the output is
+ * read, only that many tasks' results are ever held at once.
+ */
+void comparePairsInParallel(const Corpus* corpus, const uint64_t* candidates, long long firstPair, long long pairTotal, const JaccardOptions* options, ComparisonTotals* totals) {
+	PairScheduler scheduler;
+	int workerCount = options->threadCount;
+	long long pairsPerTask = pairTotal / ((long long)workerCount * 64); //Enough tasks per worker for stealing to even out the load
+	if(pairsPerTask < 1) {
+		pairsPerTask = 1;
+	} else if(pairsPerTask > maxPairsPerTask) {
+		pairsPerTask = maxPairsPerTask;
+	}
+	
+	scheduler.corpus = corpus;
+	scheduler.options = options;
+	scheduler.candidates = candidates;
+	scheduler.workerCount = workerCount;
+	scheduler.taskCount = (pairTotal + pairsPerTask - 1) / pairsPerTask;
+	scheduler.tasks = calloc(scheduler.taskCount > 0 ? scheduler.taskCount : 1, sizeof(PairTask));
+	scheduler.queues = malloc(workerCount * sizeof(TaskQueue));
+	pthread_t* threads = malloc(workerCount * sizeof(pthread_t));
+	WorkerContext* contexts = malloc(workerCount * sizeof(WorkerContext));
+	if(scheduler.tasks == NULL || scheduler.queues == NULL || threads == NULL || contexts == NULL) {
+		printf("\nERROR: Unable to allocate memory for the worker threads!\n");
+		exit(1);
+	}
+	pthread_mutex_init(&scheduler.doneLock, NULL);
+	pthread_cond_init(&scheduler.taskDone, NULL);
+	pthread_cond_init(&scheduler.limitMoved, NULL);
+	scheduler.takeLimit = (long long)workerCount * tasksAheadPerWorker;
+	
+	for(long long t = 0; t < scheduler.taskCount; t++) {
+		scheduler.tasks[t].firstPair = firstPair + t * pairsPerTask;
+		scheduler.tasks[t].pairCount = (t * pairsPerTask + pairsPerTask <= pairTotal) ? pairsPerTask : pairTotal - t * pairsPerTask;
+	}
+	for(int w = 0; w < workerCount; w++) {
+		pthread_mutex_init(&scheduler.queues[w].lock, NULL);
+		scheduler.queues[w].front = 0;
+		scheduler.queues[w].back = (scheduler.taskCount - w + workerCount - 1) / workerCount; //Number of tasks t < taskCount with t % workerCount == w
+		contexts[w].scheduler = &scheduler;
+		contexts[w].id = w;
+	}
+	for(int w = 0; w < workerCount; w++) {
+		if(pthread_create(&threads[w], NULL, runPairWorker, &contexts[w]) != 0) {
+			printf("\nERROR: Unable to start worker thread %d!\n", w);
+			exit(1);
+		}
+	}
+	
+	for(long long t = 0; t < scheduler.taskCount; t++) { //Print each task's results as soon as it and every task before it are done
+		pthread_mutex_lock(&scheduler.doneLock);
+		while(scheduler.tasks[t].done == false) {
+			pthread_cond_wait(&scheduler.taskDone, &scheduler.doneLock);
+		}
+		pthread_mutex_unlock(&scheduler.doneLock);
+		
+		for(long long p = 0; p < scheduler.tasks[t].pairCount; p++) {
+			printPairResult(corpus, &scheduler.tasks[t].results[p], options, totals);
+		}
+		free(scheduler.tasks[t].results);
+		scheduler.tasks[t].results = NULL;
+		
+		pthread_mutex_lock(&scheduler.doneLock); //One more task may now be started
+		scheduler.takeLimit++;
+		pthread_cond_broadcast(&scheduler.limitMoved);
+		pthread_mutex_unlock(&scheduler.doneLock);
+	}
+	
+	for(int w = 0; w < workerCount; w++) {
+		pthread_join(threads[w], NULL);
+	}
+	for(int w = 0; w < workerCount; w++) { //Only once every worker has stopped, since one still looking for work may lock any queue
+		pthread_mutex_destroy(&scheduler.queues[w].lock);
+	}
+	pthread_mutex_destroy(&scheduler.doneLock);
+	pthread_cond_destroy(&scheduler.taskDone);
+	pthread_cond_destroy(&scheduler.limitMoved);
+	free(contexts);
+	free(threads);
+	free(scheduler.queues);
+	free(scheduler.tasks);
+}
+
+void* runPairWorker(void* context) { /** Sub-function of comparePairsInParallel, the body of each worker thread **/
+	WorkerContext* worker = context;
+	PairScheduler* scheduler = worker->scheduler;
+	long long t = 0;
+	int i = 0, k = 0;
+	
+	while(takeTask(scheduler, worker->id, &t) == true) {
+		PairTask* task = &scheduler->tasks[t];
+		PairResult* results = malloc(task->pairCount * sizeof(PairResult)); //This worker's buffer for the task, handed to the main thread once done
+		if(results == NULL) {
+			printf("\nERROR: Unable to allocate memory for a worker's results!\n");
+			exit(1);
+		}
+		
+		if(scheduler->candidates == NULL) {
+			pairFromIndex(task->firstPair, scheduler->corpus->fileCount, &i, &k);
+		}
+		for(long long p = 0; p < task->pairCount; p++) {
+			if(scheduler->candidates != NULL) {
+				uint64_t pair = scheduler->candidates[task->firstPair + p];
+				i = (int)(pair >> 32);
+				k = (int)(pair & 0xFFFFFFFFU);
+			}
+			comparePair(scheduler->corpus, i, k, scheduler->options, &results[p]);
+			if(scheduler->candidates == NULL) { //Step to the next pair in (i,k) order
+				k++;
+				if(k == scheduler->corpus->fileCount) {
+					i++;
+					k = i + 1;
+				}
+			}
+		}
+		
+		pthread_mutex_lock(&scheduler->doneLock);
+		task->results = results;
+		task->done = true;
+		pthread_cond_broadcast(&scheduler->taskDone);
+		pthread_mutex_unlock(&scheduler->doneLock);
+	}
+	
+	return NULL;
+}
+
+/**
+ * The task the main thread waits for next is always done, being run, or at the front of a queue, and below takeLimit;
+ * so a worker that finds nothing below takeLimit can wait for the limit to move without the two waiting on each other.
+ */
+int takeTask(PairScheduler* scheduler, int id, long long* task) { /** Sub-function of runPairWorker, pops from its own queue or steals from another, waiting while every task left is beyond takeLimit **/
+	int remaining = false;
+	pthread_mutex_lock(&scheduler->doneLock);
+	long long limit = scheduler->takeLimit;
+	pthread_mutex_unlock(&scheduler->doneLock);
+	
+	while(takeTaskBelow(scheduler, id, limit, task, &remaining) == false) {
+		if(remaining == false) {
+			return false; //Every queue is empty, so no new tasks can appear
+		}
+		pthread_mutex_lock(&scheduler->doneLock); //Every task left is beyond the limit, so wait for it to move
+		while(scheduler->takeLimit == limit) {
+			pthread_cond_wait(&scheduler->limitMoved, &scheduler->doneLock);
+		}
+		limit = scheduler->takeLimit;
+		pthread_mutex_unlock(&scheduler->doneLock);
+	}
+	return true;
+}
+
+int takeTaskBelow(PairScheduler* scheduler, int id, long long limit, long long* task, int* remaining) { /** Sub-function of takeTask, one pass over the queues **/
+	*remaining = false;
+	for(int attempt = 0; attempt < scheduler->workerCount; attempt++) {
+		int victim = (id + attempt) % scheduler->workerCount; //Attempt 0 is this worker's own queue
+		TaskQueue* queue = &scheduler->queues[victim];
+		int found = false;
+		
+		pthread_mutex_lock(&queue->lock);
+		if(queue->front < queue->back) {
+			long long front = victim + (long long)scheduler->workerCount * queue->front;
+			long long back = victim + (long long)scheduler->workerCount * (queue->back - 1);
+			if(victim != id && back < limit) {
+				*task = back;
+				queue->back--;
+				found = true;
+			} else if(front < limit) {
+				*task = front;
+				queue->front++;
+				found = true;
+			}
+			*remaining = true;
+		}
+		pthread_mutex_unlock(&queue->lock);
+		
+		if(found == true) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void pairFromIndex(long long index, int fileCount, int* i, int* k) { /** Sub-function of runPairWorker, maps a position in the (i,k) order to its files **/
+	//Row i holds the (fileCount - 1 - i) pairs (i, i+1) ... (i, fileCount-1), and begins at index i * (2 * fileCount - i - 1) / 2
+	int low = 0, high = fileCount - 2;
+	while(low < high) { //Find the last row that begins at or before index
+		int middle = (low + high + 1) / 2;
+		if((long long)middle * (2LL * fileCount - middle - 1) / 2 <= index) {
+			low = middle;
+		} else {
+			high = middle - 1;
+		}
+	}
+	*i = low;
+	*k = low + 1 + (int)(index - (long long)low * (2LL * fileCount - low - 1) / 2);
+}
+
+/**
+ * Writes an inverted index of every input to indexName, to be searched later with -query. The documents are
+ * numbered, and named in the index, in the order the files were given.
+ */
+void buildIndex(const Corpus* corpus, const char* indexName, uint32_t hashAlgorithm) {
+	const uint64_t** sets = malloc((corpus->fileCount > 0 ? corpus->fileCount : 1) * sizeof(uint64_t*));
+	int* setSizes = malloc((corpus->fileCount > 0 ? corpus->fileCount : 1) * sizeof(int));
+	const char** names = malloc((corpus->fileCount > 0 ? corpus->fileCount : 1) * sizeof(char*));
+	if(sets == NULL || setSizes == NULL || names == NULL) {
+		printf("\nERROR: Unable to allocate memory for the inverted index!\n");
+		exit(1);
+	}
+	for(int i = 0; i < corpus->fileCount; i++) {
+		sets[i] = corpus->hashes[i]->values;
+		setSizes[i] = corpus->hashes[i]->size;
+		names[i] = corpus->fileNames[i];
+	}
+	
+	writeShingleIndex(indexName, corpus->fileCount, sets, setSizes, names, hashAlgorithm);
+	MappedShingleIndex* index = openShingleIndex(indexName);
+	printf("Indexed %d files into \"%s\": %llu distinct n-grams, %llu postings.\n", corpus->fileCount, indexName, (unsigned long long)index->header->termCount, (unsigned long long)index->header->postingCount);
+	closeShingleIndex(index);
+	
+	free(sets);
+	free(setSizes);
+	free(names);
+}
+
+/**
+ * Looks every input up in an index, printing the topCount most similar indexed documents with their exact similarity,
+ * then the rate at which the queries were answered. Only the lookups themselves are timed.
+ */
+void queryIndex(const Corpus* corpus, const MappedShingleIndex* index, int topCount) {
+	IndexQuery* query = createIndexQuery(index);
+	IndexMatch* matches = malloc(topCount * sizeof(IndexMatch));
+	double queryTime = 0.0;
+	if(matches == NULL) {
+		printf("\nERROR: Unable to allocate memory for the query results!\n");
+		exit(1);
+	}
+	
+	for(int i = 0; i < corpus->fileCount; i++) {
+		const HashSet* set = corpus->hashes[i];
+		double startTime = wallClockSeconds();
+		int matchCount = queryShingleIndex(index, query, set->values, (uint64_t)set->size, topCount, matches);
+		queryTime += wallClockSeconds() - startTime;
+		
+		printf("\nThe indexed files most similar to \"%s\" (%d n-grams) are:\n", corpus->fileNames[i], set->size);
+		for(int m = 0; m < matchCount; m++) {
+			printf("  %d. \"%s\" is %.2f%% similar (%u shared n-grams).\n", m + 1, indexDocumentName(index, matches[m].document), matches[m].similarity * 100, matches[m].shared);
+		}
+		if(matchCount == 0) {
+			printf("  None; no indexed file shares any n-grams with it.\n");
+		}
+	}
+	
+	if(queryTime <= 0.0) {
+		queryTime = 1e-9; //Guards the rate below against queries too quick for the clock to measure
+	}
+	printf("\nAnswered %d queries against %llu indexed files in %.3f seconds: %.1f queries/s, %.1f postings walked per query.\n", corpus->fileCount, (unsigned long long)index->header->documentCount, queryTime, corpus->fileCount / queryTime, corpus->fileCount > 0 ? (double)query->postingsWalked / corpus->fileCount : 0.0);
+	
+	free(matches);
+	deleteIndexQuery(query);
+}
+
+/**
+ * Picks the number of bands and rows per band for LSH. A pair whose similarity is s becomes a candidate with
+ * probability 1 - (1 - s^rows)^bands, an S-curve whose steepest point is near (1 / bands)^(1 / rows).
+ * The split whose steepest point lies closest to the requested threshold is chosen, using at most signatureSize values.
+ */
+void chooseBands(int signatureSize, double threshold, int* bands, int* rows) {
+	double bestDistance = 2.0;
+	for(int r = 1; r <= signatureSize; r++) {
+		int b = signatureSize / r;
+		double distance = fabs(pow(1.0 / b, 1.0 / r) - threshold);
+		if(distance < bestDistance) {
+			bestDistance = distance;
+			*bands = b;
+			*rows = r;
+		}
+	}
+}
+
+/**
+ * Hashes every band of every signature into a bucket key, and returns each pair of files that shares at least one
+ * bucket in any band, packed as (i << 32 | k) with i < k. The returned array is sorted and has no duplicates.
+ * A file is in one bucket per band, so a band's pairs have no repeats; they are sorted and merged into the pairs of
+ * the bands before, so memory grows with the distinct candidates rather than with the bands times every bucket's
+ * pairs. Near-duplicates share a bucket in most bands, so a bucket of at least rememberedBucketSize files that holds
+ * exactly the files of one expanded in an earlier band is skipped, as its pairs are all candidates already. Files
+ * with no shingles are left out: their signatures all land in the same bucket, but they are similar to nothing.
+ */
+uint64_t* findCandidatePairs(const Corpus* corpus, int bands, int rows, long long* candidateCount) {
+	uint64_t* bucketEntries = malloc((corpus->fileCount > 0 ? corpus->fileCount : 1) * 2 * sizeof(uint64_t)); //(key, file) pairs for a single band
+	long long capacity = 1024, bandCapacity = 1024, rememberedCapacity = 64;
+	long long count = 0, rememberedCount = 0;
+	uint64_t* candidates = malloc(capacity * sizeof(uint64_t));
+	uint64_t* bandPairs = malloc(bandCapacity * sizeof(uint64_t));
+	uint64_t* remembered = malloc(rememberedCapacity * sizeof(uint64_t)); //Fingerprints of the large buckets expanded so far, sorted after each band
+	if(bucketEntries == NULL || candidates == NULL || bandPairs == NULL || remembered == NULL) {
+		printf("\nERROR: Unable to allocate memory for the LSH buckets!\n");
+		exit(1);
+	}
+	
+	for(int band = 0; band < bands; band++) {
+		int entryCount = 0;
+		for(int i = 0; i < corpus->fileCount; i++) {
+			if(corpus->hashes[i]->size == 0) {
+				continue;
+			}
+			bucketEntries[entryCount * 2] = hashBand(corpus->signatures[i]->values + band * rows, rows, band);
+			bucketEntries[entryCount * 2 + 1] = (uint64_t)i;
+			entryCount++;
+		}
+		qsort(bucketEntries, entryCount, 2 * sizeof(uint64_t), compareBucketEntries); //Files in the same bucket are now adjacent, in ascending order
+		
+		long long bandCount = 0;
+		long long sortedRemembered = rememberedCount; //Only the fingerprints of earlier bands are sorted, and searched
+		for(int start = 0; start < entryCount; ) {
+			int end = start + 1;
+			while(end < entryCount && bucketEntries[end * 2] == bucketEntries[start * 2]) {
+				end++;
+			}
+			if(end - start >= rememberedBucketSize) {
+				uint64_t fingerprint = fingerprintBucket(bucketEntries + start * 2, end - start);
+				if(bsearch(&fingerprint, remembered, sortedRemembered, sizeof(uint64_t), compareCandidates) != NULL) {
+					start = end;
+					continue;
+				}
+				if(rememberedCount == rememberedCapacity) {
+					rememberedCapacity *= 2;
+					remembered = realloc(remembered, rememberedCapacity * sizeof(uint64_t));
+					if(remembered == NULL) {
+						printf("\nERROR: Unable to re-allocate memory for the LSH buckets!\n");
+						exit(1);
+					}
+				}
+				remembered[rememberedCount++] = fingerprint;
+			}
+			
+			long long bucketPairs = (long long)(end - start) * (end - start - 1) / 2;
+			if(bandCount + bucketPairs > bandCapacity) {
+				while(bandCount + bucketPairs > bandCapacity) {
+					bandCapacity *= 2;
+				}
+				bandPairs = realloc(bandPairs, bandCapacity * sizeof(uint64_t));
+				if(bandPairs == NULL) {
+					printf("\nERROR: Unable to re-allocate memory for the LSH candidate pairs!\n");
+					exit(1);
+				}
+			}
+			for(int a = start; a < end - 1; a++) { //Every pair of files within one bucket is a candidate
+				for(int b = a + 1; b < end; b++) {
+					bandPairs[bandCount++] = (bucketEntries[a * 2 + 1] << 32) | bucketEntries[b * 2 + 1];
+				}
+			}
+			start = end;
+		}
+		qsort(remembered, rememberedCount, sizeof(uint64_t), compareCandidates);
+		
+		qsort(bandPairs, bandCount, sizeof(uint64_t), compareCandidates);
+		count = mergeCandidates(&candidates, count, &capacity, bandPairs, bandCount);
+	}
+	free(bucketEntries);
+	free(bandPairs);
+	free(remembered);
+	
+	*candidateCount = count;
+	return candidates;
+}
+
+uint64_t hashBand(const uint32_t* values, int rows, int band) { /** Sub-function of findCandidatePairs, combines one band of a signature into a bucket key **/
+	uint64_t h = 14695981039346656037ULL ^ (uint64_t)band; //64-bit FNV-1a over the band's values, seeded by the band number
+	for(int r = 0; r < rows; r++) {
+		h ^= values[r];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+uint64_t fingerprintBucket(const uint64_t* entries, int entryCount) { /** Sub-function of findCandidatePairs, combines the files of one bucket into a key that names exactly that set of files **/
+	uint64_t h = 14695981039346656037ULL ^ (uint64_t)entryCount; //64-bit FNV-1a over the files, seeded by their number
+	for(int e = 0; e < entryCount; e++) {
+		h ^= entries[e * 2 + 1];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+long long mergeCandidates(uint64_t** candidates, long long count, long long* capacity, const uint64_t* bandPairs, long long bandCount) { /** Sub-function of findCandidatePairs, merges one band's sorted pairs into the sorted candidates without repeats, and returns the new count **/
+	if(count + bandCount > *capacity) {
+		while(count + bandCount > *capacity) {
+			*capacity *= 2;
+		}
+		*candidates = realloc(*candidates, *capacity * sizeof(uint64_t));
+		if(*candidates == NULL) {
+			printf("\nERROR: Unable to re-allocate memory for the LSH candidate pairs!\n");
+			exit(1);
+		}
+	}
+	
+	/**Merge from the back, so the candidates can be merged in place, then drop the pairs held in both:**/
+	uint64_t* merged = *candidates;
+	long long a = count - 1, b = bandCount - 1, write = count + bandCount - 1;
+	while(b >= 0) {
+		merged[write--] = (a >= 0 && merged[a] > bandPairs[b]) ? merged[a--] : bandPairs[b--];
+	}
+	long long unique = 0;
+	for(long long c = 0; c < count + bandCount; c++) {
+		if(unique == 0 || merged[c] != merged[unique - 1]) {
+			merged[unique++] = merged[c];
+		}
+	}
+	return unique;
+}
+
+int compareBucketEntries(const void* a, const void* b) { /** Sub-function of findCandidatePairs, qsort() comparator ordering bucket entries by key **/
+	const uint64_t* left = a;
+	const uint64_t* right = b;
+	if(left[0] != right[0]) {
+		return (left[0] > right[0]) - (left[0] < right[0]);
+	}
+	return (left[1] > right[1]) - (left[1] < right[1]); //Ties are ordered by file, so i < k holds within each bucket
+}
+
+int compareCandidates(const void* a, const void* b) { /** Sub-function of findCandidatePairs, qsort() comparator for packed (i,k) pairs **/
+	uint64_t left = *((const uint64_t*)a);
+	uint64_t right = *((const uint64_t*)b);
+	return (left > right) - (left < right);
+}
+
+/**
+ * Finds every pair of files that could be at least threshold similar, using the size and prefix filters of
+ * set-similarity joins, and returns them packed as (i << 32 | k) with i < k, sorted and without repeats.
+ *
+ * Each set's hashes are ranked by how many files contain them, rarest first. If J(x, y) >= threshold then x and y
+ * share at least ceil(threshold * |x|) hashes, so the first |x| - ceil(threshold * |x|) + 1 hashes of x in rank order
+ * (its prefix) must hold one of them, and likewise for y: a pair whose prefixes share nothing cannot reach the
+ * threshold. Files are visited from smallest to largest; each looks its prefix hashes up in an index of the prefixes
+ * of the files visited before it, and is then added to that index. Rare hashes come first in every prefix, so most
+ * of the lists looked at are short. A file y found this way is only kept if |y| >= threshold * |x|, since J(x, y) is
+ * at most |y| / |x|. Both bounds are loosened by a tiny margin, so rounding can only ever add candidates, never lose
+ * one; every candidate is compared exactly afterwards, so the output is the same as comparing every pair.
+ */
+uint64_t* findJoinCandidates(const Corpus* corpus, double threshold, long long* candidateCount, JoinStatistics* statistics) {
+	int fileCount = corpus->fileCount;
+	uint32_t** ranks = rankHashes(corpus); //Each file's set, as ascending ranks
+	int* prefixLengths = malloc((fileCount > 0 ? fileCount : 1) * sizeof(int));
+	uint64_t* visitOrder = malloc((fileCount > 0 ? fileCount : 1) * sizeof(uint64_t)); //(size << 32 | file), smallest first
+	int* lastSeen = malloc((fileCount > 0 ? fileCount : 1) * sizeof(int)); //The visit, plus one, in which each file was last found as a candidate
+	uint32_t rankCount = 0;
+	long long capacity = 1024;
+	long long count = 0;
+	long long prefixShared = 0; //Pairs whose prefixes share at least one hash
+	uint64_t* candidates = malloc(capacity * sizeof(uint64_t));
+	if(prefixLengths == NULL || visitOrder == NULL || lastSeen == NULL || candidates == NULL) {
+		printf("\nERROR: Unable to allocate memory for the threshold join!\n");
+		exit(1);
+	}
+	
+	for(int i = 0; i < fileCount; i++) {
+		int size = corpus->hashes[i]->size;
+		int overlap = (int)ceil(threshold * size - 1e-9); //The fewest shared hashes that let a file this size reach the threshold
+		prefixLengths[i] = (overlap > 0) ? size - overlap + 1 : size;
+		visitOrder[i] = ((uint64_t)size << 32) | (uint64_t)i;
+		lastSeen[i] = 0;
+		for(int j = 0; j < size; j++) {
+			if(ranks[i][j] + 1 > rankCount) {
+				rankCount = ranks[i][j] + 1;
+			}
+		}
+	}
+	qsort(visitOrder, fileCount, sizeof(uint64_t), compareCandidates);
+	
+	//The prefix index lists, for each rank, the files visited so far whose prefix holds it. Every prefix is known up front, so all the lists are laid out in one block:
+	uint64_t* listStarts = calloc((size_t)rankCount + 1, sizeof(uint64_t));
+	uint32_t* listLengths = calloc(rankCount > 0 ? rankCount : 1, sizeof(uint32_t));
+	if(listStarts == NULL || listLengths == NULL) {
+		printf("\nERROR: Unable to allocate memory for the threshold join!\n");
+		exit(1);
+	}
+	for(int i = 0; i < fileCount; i++) {
+		for(int j = 0; j < prefixLengths[i]; j++) {
+			listStarts[ranks[i][j] + 1]++;
+		}
+	}
+	for(uint32_t r = 0; r < rankCount; r++) {
+		listStarts[r + 1] += listStarts[r];
+	}
+	uint32_t* lists = malloc((listStarts[rankCount] > 0 ? listStarts[rankCount] : 1) * sizeof(uint32_t));
+	if(lists == NULL) {
+		printf("\nERROR: Unable to allocate memory for the threshold join!\n");
+		exit(1);
+	}
+	
+	for(int v = 0; v < fileCount; v++) {
+		int x = (int)(visitOrder[v] & 0xFFFFFFFFU);
+		double smallestPartner = threshold * corpus->hashes[x]->size - 1e-9;
+		
+		for(int j = 0; j < prefixLengths[x]; j++) {
+			uint32_t rank = ranks[x][j];
+			for(uint32_t p = 0; p < listLengths[rank]; p++) {
+				int y = (int)lists[listStarts[rank] + p];
+				if(lastSeen[y] == v + 1) {
+					continue; //Already found through an earlier prefix hash
+				}
+				lastSeen[y] = v + 1;
+				prefixShared++;
+				if(corpus->hashes[y]->size < smallestPartner) {
+					statistics->sizePruned++;
+					continue;
+				}
+				
+				if(count == capacity) {
+					capacity *= 2;
+					candidates = realloc(candidates, capacity * sizeof(uint64_t));
+					if(candidates == NULL) {
+						printf("\nERROR: Unable to re-allocate memory for the threshold join candidates!\n");
+						exit(1);
+					}
+				}
+				candidates[count++] = (x < y) ? ((uint64_t)x << 32 | (uint64_t)y) : ((uint64_t)y << 32 | (uint64_t)x);
+			}
+		}
+		for(int j = 0; j < prefixLengths[x]; j++) { //Only now add x, so it is never found as its own candidate
+			uint32_t rank = ranks[x][j];
+			lists[listStarts[rank] + listLengths[rank]++] = (uint32_t)x;
+		}
+	}
+	qsort(candidates, count, sizeof(uint64_t), compareCandidates); //Each pair is found at most once, when its later-visited file looks it up
+	
+	statistics->prefixPruned = (long long)fileCount * (fileCount - 1) / 2 - prefixShared;
+	*candidateCount = count;
+	for(int i = 0; i < fileCount; i++) {
+		free(ranks[i]);
+	}
+	free(ranks);
+	free(prefixLengths);
+	free(visitOrder);
+	free(lastSeen);
+	free(listStarts);
+	free(listLengths);
+	free(lists);
+	return candidates;
+}
+
+/**
+ * Counts how many files contain each distinct hash, orders the distinct hashes by that count (ties by hash value),
+ * and returns a newly allocated copy of every file's set with each hash replaced by its position in that order.
+ * Each copy is sorted, so it starts with the hashes that the fewest other files contain.
+ */
+uint32_t** rankHashes(const Corpus* corpus) { /** Sub-function of findJoinCandidates, replaces each set's hashes by their rank in the global order, rarest first **/
+	uint64_t total = 0;
+	uint64_t distinct = 0;
+	for(int i = 0; i < corpus->fileCount; i++) {
+		total += (uint64_t)corpus->hashes[i]->size;
+	}
+	uint64_t* terms = malloc((total > 0 ? total : 1) * sizeof(uint64_t)); //Every hash of every file, then each distinct hash once
+	uint64_t* order = malloc((total > 0 ? total : 1) * sizeof(uint64_t)); //(file count << 32 | term), for each distinct hash
+	uint32_t** ranks = malloc((corpus->fileCount > 0 ? corpus->fileCount : 1) * sizeof(uint32_t*));
+	if(terms == NULL || order == NULL || ranks == NULL) {
+		printf("\nERROR: Unable to allocate memory for the threshold join!\n");
+		exit(1);
+	}
+	
+	total = 0;
+	for(int i = 0; i < corpus->fileCount; i++) {
+		memcpy(terms + total, corpus->hashes[i]->values, corpus->hashes[i]->size * sizeof(uint64_t));
+		total += (uint64_t)corpus->hashes[i]->size;
+	}
+	qsort(terms, total, sizeof(uint64_t), compareCandidates);
+	for(uint64_t t = 0; t < total; ) { //Each set holds a hash at most once, so the length of its run is the number of files containing it
+		uint64_t end = t + 1;
+		while(end < total && terms[end] == terms[t]) {
+			end++;
+		}
+		order[distinct] = ((end - t) << 32) | distinct;
+		terms[distinct++] = terms[t];
+		t = end;
+	}
+	qsort(order, distinct, sizeof(uint64_t), compareCandidates);
+	uint32_t* rankOfTerm = malloc((distinct > 0 ? distinct : 1) * sizeof(uint32_t));
+	if(rankOfTerm == NULL) {
+		printf("\nERROR: Unable to allocate memory for the threshold join!\n");
+		exit(1);
+	}
+	for(uint64_t r = 0; r < distinct; r++) {
+		rankOfTerm[order[r] & 0xFFFFFFFFU] = (uint32_t)r;
+	}
+	
+	for(int i = 0; i < corpus->fileCount; i++) {
+		const HashSet* set = corpus->hashes[i];
+		uint64_t low = 0;
+		ranks[i] = malloc((set->size > 0 ? set->size : 1) * sizeof(uint32_t));
+		if(ranks[i] == NULL) {
+			printf("\nERROR: Unable to allocate memory for the threshold join!\n");
+			exit(1);
+		}
+		for(int j = 0; j < set->size; j++) { //Both arrays are sorted by hash, so each search starts where the last one ended
+			uint64_t high = distinct;
+			while(low < high) {
+				uint64_t middle = low + (high - low) / 2;
+				if(terms[middle] < set->values[j]) {
+					low = middle + 1;
+				} else {
+					high = middle;
+				}
+			}
+			ranks[i][j] = rankOfTerm[low];
+		}
+		qsort(ranks[i], set->size, sizeof(uint32_t), compareRanks);
+	}
+	
+	free(terms);
+	free(order);
+	free(rankOfTerm);
+	return ranks;
+}
+
+int compareRanks(const void* a, const void* b) { /** Sub-function of rankHashes, qsort() comparator for uint32_t ranks **/
+	uint32_t left = *((const uint32_t*)a);
+	uint32_t right = *((const uint32_t*)b);
+	return (left > right) - (left < right);
+}
+
+/**
+ * The -mem mode: compares every pair of files (with -t, every pair the size filter cannot rule out) while holding no
+ * more than options->memoryBudget bytes of hashes in memory. The sets are cut into blocks of consecutive files, each
+ * at most half the budget, and the pairs between two blocks are compared while both are loaded; row a of block pairs
+ * is (a,a) ... (a,blockCount-1). Every other row is walked backwards, so the block loaded last in one row begins the
+ * next, and in all about blockCount * blockCount / 2 blocks are read. Pairs are printed one block pair at a time,
+ * rather than in (i,k) order.
+ */
+void compareInBlocks(char** fileNames, int fileCount, JaccardOptions* options) {
+	BlockedCorpus blocked;
+	ComparisonTotals totals = {0, 0.0, 0.0, 0, 0};
+	long long comparedPairs = 0, sizePruned = 0;
+	long long totalPairs = (long long)fileCount * (fileCount - 1) / 2;
+	uint64_t blockBudget = options->memoryBudget / 2;
+	
+	memset(&blocked, 0, sizeof(BlockedCorpus));
+	blocked.corpus.fileNames = fileNames;
+	blocked.corpus.fileCount = fileCount;
+	blocked.sets = calloc(fileCount > 0 ? fileCount : 1, sizeof(HashSet));
+	blocked.corpus.hashes = malloc((fileCount > 0 ? fileCount : 1) * sizeof(HashSet*));
+	blocked.offsets = calloc(fileCount > 0 ? fileCount : 1, sizeof(uint64_t));
+	blocked.spilled = calloc(fileCount > 0 ? fileCount : 1, sizeof(int));
+	blocked.blockStarts = malloc((fileCount + 1) * sizeof(int));
+	blocked.batch = malloc(maxPairsPerBatch * sizeof(uint64_t));
+	blocked.slots[0] = createArena((size_t)blockBudget);
+	blocked.slots[1] = createArena((size_t)blockBudget);
+	if(blocked.sets == NULL || blocked.corpus.hashes == NULL || blocked.offsets == NULL || blocked.spilled == NULL || blocked.blockStarts == NULL || blocked.batch == NULL || blocked.slots[0] == NULL || blocked.slots[1] == NULL) {
+		printf("\nERROR: Unable to allocate memory for the blocked comparison!\n");
+		exit(1);
+	}
+	blocked.slotBlocks[0] = -1;
+	blocked.slotBlocks[1] = -1;
+	for(int i = 0; i < fileCount; i++) {
+		blocked.corpus.hashes[i] = &blocked.sets[i];
+	}
+	
+	stageSets(&blocked, options);
+	planBlocks(&blocked, blockBudget);
+	
+	double startTime = statsClock();
+	for(int a = 0; a < blocked.blockCount; a++) {
+		for(int step = 0; step < blocked.blockCount - a; step++) {
+			int b = (a % 2 == 0) ? a + step : blocked.blockCount - 1 - step;
+			compareBlockPair(&blocked, a, b, options, &totals, &comparedPairs, &sizePruned);
+		}
+	}
+	addStageTime("compare", startTime, (uint64_t)comparedPairs, blocked.bytesRead);
+	addCounter("pairsCompared", (uint64_t)comparedPairs);
+	addCounter("pairsPrinted", (uint64_t)totals.pairCount);
+	addCounter("sizePruned", (uint64_t)sizePruned);
+	addCounter("blockLoads", (uint64_t)blocked.blockLoads);
+	addCounter("bytesRead", blocked.bytesRead);
+	addCounter("minimumBytesRead", blocked.storedBytes);
+	
+	if(options->joinThreshold > 0) {
+		printf("\nThe blocked comparison verified %lld of %lld total pairs exactly (%lld pruned by the size filter).\n", comparedPairs, totalPairs, sizePruned);
+		printf("  %lld pairs are at least %.2f%% similar.\n", totals.aboveThreshold, options->joinThreshold * 100);
+	}
+	printf("\nCompared %d files in %d blocks of at most %.1f MB: read %.1f MB of hashes in %lld block loads, %.2f times the %.1f MB it takes to read every set once.\n", fileCount, blocked.blockCount, blockBudget / 1048576.0, blocked.bytesRead / 1048576.0, blocked.blockLoads, blocked.storedBytes > 0 ? (double)blocked.bytesRead / blocked.storedBytes : 1.0, blocked.storedBytes / 1048576.0);
+	
+	if(blocked.spillFile != NULL) {
+		fclose(blocked.spillFile);
+	}
+	deleteArena(blocked.slots[0]);
+	deleteArena(blocked.slots[1]);
+	free(blocked.batch);
+	free(blocked.blockStarts);
+	free(blocked.spilled);
+	free(blocked.offsets);
+	free(blocked.corpus.hashes);
+	free(blocked.sets);
+}
+
+/**
+ * Only the header of each binary shingle file is read now. Each .csv file is read and hashed on its own, and its
+ * hashes are appended to a temporary spill file in the same compact form, so memory use while staging is bounded by
+ * the largest single input rather than the corpus.
+ */
+void stageSets(BlockedCorpus* blocked, JaccardOptions* options) { /** Sub-function of compareInBlocks, finds every set on disk, spilling the .csv inputs' hashes to a temporary file **/
+	Corpus* corpus = &blocked->corpus;
+	ShingleFileHeader header;
+	DictionaryStamp stamp;
+	const char* firstIdFileName = NULL;
+	uint64_t dictionaryIdentity = 0;
+	
+	for(int i = 0; i < corpus->fileCount; i++) {
+		if(isShingleFile(corpus->fileNames[i]) == true) {
+			readShingleFileHeader(corpus->fileNames[i], &header);
+			if(header.hashAlgorithm == HASH_DICTIONARY) {
+				readDictionaryStamp(corpus->fileNames[i], header.count, &stamp);
+				checkDictionaryStamp(corpus->fileNames[i], &stamp, &firstIdFileName, &dictionaryIdentity);
+			}
+			blocked->sets[i].size = (int)header.count;
+			blocked->sets[i].hashAlgorithm = header.hashAlgorithm;
+			blocked->offsets[i] = shingleValuesOffset(header.hashAlgorithm);
+			if(options->hashAlgorithm < 0) { //Without -hash, .csv inputs are hashed to match the first binary input
+				options->hashAlgorithm = (int)header.hashAlgorithm;
+			}
+		} else {
+			blocked->spilled[i] = true;
+		}
+	}
+	if(options->hashAlgorithm < 0) {
+		options->hashAlgorithm = HASH_DEFAULT;
+	}
+	
+	Arena* shingleArena = createArena(0);
+	uint64_t spillLength = 0;
+	if(shingleArena == NULL) {
+		printf("\nERROR: Unable to allocate memory for the hashed n-grams!\n");
+		exit(1);
+	}
+	for(int i = 0; i < corpus->fileCount; i++) {
+		if(blocked->spilled[i] == false) {
+			continue;
+		}
+		if(blocked->spillFile == NULL) {
+			blocked->spillFile = tmpfile();
+			if(blocked->spillFile == NULL) {
+				printf("\nERROR: Unable to create a temporary file for the hashed n-grams!\n");
+				exit(1);
+			}
+		}
+		
+		size_t textLength = 0;
+		char* inputFileText = readTextFile(corpus->fileNames[i], &textLength);
+		if(options->hashAlgorithm == HASH_DICTIONARY) {
+			printf("\nERROR: \"%s\" is a .csv file, which cannot be compared with dictionary ids; convert it with \"shingle -convert -dict\" first!\n", corpus->fileNames[i]);
+			exit(1);
+		}
+		ShingleSet* shingles = parseShingleCsv(shingleArena, inputFileText, textLength, (uint32_t)options->hashAlgorithm);
+		if(shingles == NULL) {
+			printf("\nERROR: Unable to allocate memory for the hashed n-grams!\n");
+			exit(1);
+		}
+		free(inputFileText);
+		
+		double startTime = statsClock();
+		if(fwrite(shingles->hashes, sizeof(uint64_t), shingles->count, blocked->spillFile) != shingles->count) {
+			printf("\nERROR: Unable to write the hashed n-grams of \"%s\" to a temporary file!\n", corpus->fileNames[i]);
+			exit(1);
+		}
+		addStageTime("spill", startTime, 1, shingles->count * sizeof(uint64_t));
+		blocked->sets[i].size = (int)shingles->count;
+		blocked->sets[i].hashAlgorithm = (uint32_t)options->hashAlgorithm;
+		blocked->offsets[i] = spillLength;
+		spillLength += shingles->count * sizeof(uint64_t);
+		printDebug("  Spilled %d distinct n-grams of \"%s\".\n", blocked->sets[i].size, corpus->fileNames[i]);
+		resetArena(shingleArena);
+	}
+	deleteArena(shingleArena);
+	if(blocked->spillFile != NULL && fflush(blocked->spillFile) != 0) {
+		printf("\nERROR: Unable to write the hashed n-grams to a temporary file!\n");
+		exit(1);
+	}
+	
+	for(int i = 0; i < corpus->fileCount; i++) {
+		blocked->storedBytes += (uint64_t)blocked->sets[i].size * shingleValueSize(blocked->sets[i].hashAlgorithm);
+		if(i > 0 && blocked->sets[i].hashAlgorithm != blocked->sets[0].hashAlgorithm) {
+			printf("\nWARNING: \"%s\" and \"%s\" were hashed with different algorithms, so their similarity will be meaningless!\n", corpus->fileNames[0], corpus->fileNames[i]);
+		}
+	}
+}
+
+void planBlocks(BlockedCorpus* blocked, uint64_t blockBudget) { /** Sub-function of compareInBlocks, cuts the sets into blocks of consecutive files **/
+	uint64_t blockBytes = 0;
+	
+	blocked->blockCount = 0;
+	for(int i = 0; i < blocked->corpus.fileCount; i++) {
+		uint64_t bytes = ((uint64_t)blocked->sets[i].size * shingleValueSize(blocked->sets[i].hashAlgorithm) + ARENA_ALIGNMENT - 1) & ~(uint64_t)(ARENA_ALIGNMENT - 1); //As allocated from a slot's arena
+		if(bytes > blockBudget) {
+			printf("\nWARNING: \"%s\" alone holds %.1f MB of hashes, more than half the memory budget, so its block will exceed the budget!\n", blocked->corpus.fileNames[i], bytes / 1048576.0);
+		}
+		if(i == 0 || blockBytes + bytes > blockBudget) {
+			blocked->blockStarts[blocked->blockCount++] = i;
+			blockBytes = 0;
+		}
+		blockBytes += bytes;
+	}
+	blocked->blockStarts[blocked->blockCount] = blocked->corpus.fileCount;
+	printDebug("\nThe sets were cut into %d blocks of at most %.1f MB each.\n", blocked->blockCount, blockBudget / 1048576.0);
+}
+
+void loadBlock(BlockedCorpus* blocked, int block, int keepBlock) { /** Sub-function of compareInBlocks, reads a block into whichever slot does not hold keepBlock **/
+	if(blocked->slotBlocks[0] == block || blocked->slotBlocks[1] == block) {
+		return;
+	}
+	int slot = (blocked->slotBlocks[0] == keepBlock) ? 1 : 0;
+	double startTime = statsClock();
+	uint64_t bytesBefore = blocked->bytesRead;
+	
+	if(blocked->slotBlocks[slot] >= 0) { //Evict the block already in the slot
+		for(int i = blocked->blockStarts[blocked->slotBlocks[slot]]; i < blocked->blockStarts[blocked->slotBlocks[slot] + 1]; i++) {
+			blocked->sets[i].values = NULL;
+			blocked->sets[i].ids = NULL;
+		}
+		resetArena(blocked->slots[slot]);
+	}
+	printDebug("Loading block %d (files %d to %d) into slot %d\n", block, blocked->blockStarts[block], blocked->blockStarts[block + 1] - 1, slot);
+	
+	for(int i = blocked->blockStarts[block]; i < blocked->blockStarts[block + 1]; i++) {
+		HashSet* set = &blocked->sets[i];
+		size_t valueSize = shingleValueSize(set->hashAlgorithm); //Dictionary ids are read as the 32-bit values they are stored as
+		void* values = arenaAllocate(blocked->slots[slot], (size_t)set->size * valueSize);
+		FILE* file = (blocked->spilled[i] == true) ? blocked->spillFile : fopen(blocked->corpus.fileNames[i], "rb");
+		if(values == NULL) {
+			printf("\nERROR: Unable to allocate memory for block %d!\n", block);
+			exit(1);
+		}
+		if(file == NULL || seekFile(file, blocked->offsets[i]) != 0 || fread(values, valueSize, (size_t)set->size, file) != (size_t)set->size) {
+			printf("\nERROR: Unable to read the hashed n-grams of \"%s\"!\n", blocked->corpus.fileNames[i]);
+			exit(1);
+		}
+		if(blocked->spilled[i] == false) {
+			fclose(file);
+		}
+		if(set->hashAlgorithm == HASH_DICTIONARY) {
+			set->ids = values;
+		} else {
+			set->values = values;
+		}
+		blocked->bytesRead += (uint64_t)set->size * valueSize;
+	}
+	
+	blocked->slotBlocks[slot] = block;
+	blocked->blockLoads++;
+	addStageTime("load", startTime, (uint64_t)(blocked->blockStarts[block + 1] - blocked->blockStarts[block]), blocked->bytesRead - bytesBefore);
+}
+
+void compareBlockPair(BlockedCorpus* blocked, int a, int b, const JaccardOptions* options, ComparisonTotals* totals, long long* comparedPairs, long long* sizePruned) { /** Sub-function of compareInBlocks **/
+	const HashSet* sets = blocked->sets;
+	
+	loadBlock(blocked, a, b);
+	loadBlock(blocked, b, a);
+	for(int i = blocked->blockStarts[a]; i < blocked->blockStarts[a + 1]; i++) {
+		int firstK = (a == b) ? i + 1 : blocked->blockStarts[b];
+		for(int k = firstK; k < blocked->blockStarts[b + 1]; k++) {
+			if(options->joinThreshold > 0) { //A pair can be no more similar than the smaller set's size over the larger's
+				int smaller = (sets[i].size < sets[k].size) ? sets[i].size : sets[k].size;
+				int larger = sets[i].size + sets[k].size - smaller;
+				if(smaller < options->joinThreshold * larger - 1e-9) {
+					(*sizePruned)++;
+					continue;
+				}
+			}
+			blocked->batch[blocked->batchCount++] = ((uint64_t)i << 32) | (uint64_t)k;
+			(*comparedPairs)++;
+			if(blocked->batchCount == maxPairsPerBatch) {
+				compareBatch(blocked, options, totals);
+			}
+		}
+	}
+	compareBatch(blocked, options, totals);
+}
+
+void compareBatch(BlockedCorpus* blocked, const JaccardOptions* options, ComparisonTotals* totals) { /** Sub-function of compareBlockPair **/
+	PairResult result;
+	
+	if(options->threadCount > 1) {
+		comparePairsInParallel(&blocked->corpus, blocked->batch, 0, blocked->batchCount, options, totals);
+	} else {
+		for(long long c = 0; c < blocked->batchCount; c++) {
+			comparePair(&blocked->corpus, (int)(blocked->batch[c] >> 32), (int)(blocked->batch[c] & 0xFFFFFFFFU), options, &result);
+			printPairResult(&blocked->corpus, &result, options, totals);
+		}
+	}
+	blocked->batchCount = 0;
 }
@@ -1,3 +1,15 @@
+if not exist "Object Files" mkdir "Object Files"
 gcc -std=c99 -c "C Files\jaccard.c" -o "Object Files\jaccard.o"
+gcc -std=c99 -c "..\Common\C Files\ShingleFile.c" -o "Object Files\ShingleFile.o"
+gcc -std=c99 -c "..\Common\C Files\SignatureCache.c" -o "Object Files\SignatureCache.o"
+gcc -std=c99 -c "..\Common\C Files\ShingleIndex.c" -o "Object Files\ShingleIndex.o"
+gcc -std=c99 -c "..\Common\C Files\Platform.c" -o "Object Files\Platform.o"
+gcc -std=c99 -c "..\Common\C Files\Stats.c" -o "Object Files\Stats.o"
+gcc -std=c99 -c "..\Common\C Files\SetIntersection.c" -o "Object Files\SetIntersection.o"
+gcc -std=c99 -c "..\Common\C Files\Arena.c" -o "Object Files\Arena.o"
+gcc -std=c99 -c "..\Common\C Files\Similarity.c" -o "Object Files\Similarity.o"
+gcc -std=c99 -c "..\Common\C Files\ResultSink.c" -o "Object Files\ResultSink.o"
+gcc -std=c99 -c "..\Common\C Files\Tokenizer.c" -o "Object Files\Tokenizer.o"
+gcc -std=c99 -c "..\Common\C Files\ShardFile.c" -o "Object Files\ShardFile.o"
 
-gcc -std=c99 "Object Files\jaccard.o" "..\List-Library\Object Files\List.o" -o jaccard
\ No newline at end of file
+gcc -std=c99 "Object Files\jaccard.o" "Object Files\ShingleFile.o" "Object Files\SignatureCache.o" "Object Files\ShingleIndex.o" "Object Files\Platform.o" "Object Files\SetIntersection.o" "Object Files\Stats.o" "Object Files\Arena.o" "Object Files\Similarity.o" "Object Files\ResultSink.o" "Object Files\Tokenizer.o" "Object Files\ShardFile.o" -o jaccard -lpthread
\ No newline at end of file
@@ -0,0 +1,11 @@
+if not exist "Object Files" mkdir "Object Files"
+gcc -std=c99 -O2 -c "..\Common\C Files\Similarity.c" -o "Object Files\Similarity.o"
+gcc -std=c99 -O2 -c "..\Common\C Files\Arena.c" -o "Object Files\Arena.o"
+gcc -std=c99 -O2 -c "..\Common\C Files\ShingleFile.c" -o "Object Files\ShingleFile.o"
+gcc -std=c99 -O2 -c "..\Common\C Files\SetIntersection.c" -o "Object Files\SetIntersection.o"
+gcc -std=c99 -O2 -c "..\Common\C Files\Platform.c" -o "Object Files\Platform.o"
+gcc -std=c99 -O2 -c "..\Common\C Files\Tokenizer.c" -o "Object Files\Tokenizer.o"
+gcc -std=c99 -O2 -c "..\Common\C Files\Stats.c" -o "Object Files\Stats.o"
+
+gcc -shared "Object Files\Similarity.o" "Object Files\Arena.o" "Object Files\ShingleFile.o" "Object Files\SetIntersection.o" "Object Files\Platform.o" "Object Files\Tokenizer.o" "Object Files\Stats.o" -o similarity.dll -lpthread
+ar rcs libsimilarity.a "Object Files\Similarity.o" "Object Files\Arena.o" "Object Files\ShingleFile.o" "Object Files\SetIntersection.o" "Object Files\Platform.o" "Object Files\Tokenizer.o" "Object Files\Stats.o"
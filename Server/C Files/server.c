@@ -0,0 +1,1066 @@
+#ifndef _WIN32
+#define _XOPEN_SOURCE 700 //For pthread_rwlock_t and SIGPIPE under -std=c99
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <signal.h>
+#include <pthread.h>
+#include "..\..\Common\Header Files\ShingleFile.h"
+#include "..\..\Common\Header Files\ShingleIndex.h"
+#include "..\..\Common\Header Files\SetIntersection.h"
+#include "..\..\Common\Header Files\Similarity.h"
+#include "..\..\Common\Header Files\ServerProtocol.h"
+
+#define true 1
+#define false 0
+#define defaultShingleSize 2 //The same as shingle's
+#define defaultBatchSize 256 //Most requests a worker takes from its connections at once, when -batch is not given
+#define pollMilliseconds 20 //Longest a worker waits for requests before picking up connections accepted in the meantime
+#define latencyWindow 65536 //Latest requests of each type that the latency percentiles are taken over
+#define receiveChunk 65536 //Bytes of room made in a connection's input buffer for each read
+#define initialPostingCapacity 4 //Documents a term's posting list has room for when the term is first seen
+#define reportLength 4096 //Bytes the text of a report can take
+
+/**
+ * Settings read from the command-line flags:
+ */
+typedef struct {
+	char* socketName; //Path the server listens at
+	int threadCount; //Worker threads serving the connections
+	int shingleSize; //Words per shingle of the texts sent to the server, or -1 to match the binary inputs
+	int hashAlgorithm; //HASH_ constant the texts are hashed with, or -1 to match the binary inputs
+	int batchSize; //Most requests a worker takes at once
+} ServerOptions;
+
+/**
+ * A document held by the server: the sorted, distinct hashes of its shingles.
+ */
+typedef struct {
+	uint64_t* hashes; //NULL once the document is removed
+	uint32_t size;
+	int live;
+} ResidentDocument;
+
+typedef struct {
+	uint32_t* documents; //Every live document holding the term, in no particular order
+	uint32_t count;
+	uint32_t capacity; //0 for a slot no term has taken
+} PostingList;
+
+/**
+ * Every document, and an inverted index over them that is updated as documents come and go. Any number of workers
+ * may read it at once (to compare documents or find the most similar ones), while adding or removing a document
+ * takes it for one worker alone. A term keeps its slot once some document has held it, even if its list empties.
+ */
+typedef struct {
+	ResidentDocument* documents; //Indexed by document number
+	uint32_t documentCount; //Documents ever added, so also the next document's number
+	uint32_t documentCapacity;
+	uint32_t liveCount;
+	uint64_t* terms; //Open-addressing table of every hash a document has held, keyed by the hash
+	PostingList* postings; //The documents holding each term
+	uint64_t termCount;
+	uint64_t termCapacity; //Always a power of two, or 0 before the first term
+	pthread_rwlock_t lock;
+} ResidentIndex;
+
+/**
+ * A client connection. One worker serves it for its whole life, so its requests are answered in the order they came.
+ */
+typedef struct {
+	int socket;
+	char* input; //Bytes received, of which those from inputStart on are not yet taken into a batch
+	size_t inputStart;
+	size_t inputLength; //Bytes from inputStart on
+	size_t inputCapacity;
+	double* arrivalTimes; //When each whole request not yet taken into a batch finished arriving, oldest first from arrivalStart
+	int arrivalStart;
+	int arrivalCount;
+	int arrivalCapacity;
+	size_t stampedLength; //Bytes from inputStart on that make up the requests timed in arrivalTimes
+	char* output; //Responses of the current batch, sent together once it is done
+	size_t outputLength;
+	size_t outputCapacity;
+	double sentTime; //When the responses of the current batch were sent
+	int failed; //Closed by the client, or sent something that is not a request: dropped after this batch
+} Connection;
+
+/**
+ * A request taken into a batch. Its text is shingled before the index is locked, so the lock is only held for the
+ * index work itself.
+ */
+typedef struct {
+	Connection* connection;
+	ServerRequest request;
+	const char* payload; //Points into the connection's input buffer
+	const ShingleSet* shingles; //The payload's shingles, or NULL if it has none or they could not be made
+	uint64_t* ownedHashes; //SERVER_ADD: a copy of the shingles' hashes for the index to keep
+	double receivedTime; //When the last byte of the request arrived
+} PendingRequest;
+
+/**
+ * Requests served so far, and how long the latest took from arriving to their response being sent:
+ */
+typedef struct {
+	pthread_mutex_t lock;
+	double startTime;
+	uint64_t counts[SERVER_REQUEST_TYPES]; //Requests of each type; 0 counts those of no known type
+	double* latencies[SERVER_REQUEST_TYPES]; //Ring of the latest latencyWindow latencies of each type, in seconds
+	uint64_t batchCount;
+} ServerStatistics;
+
+struct ServerState;
+
+typedef struct {
+	int id;
+	struct ServerState* state;
+	pthread_t thread;
+	pthread_mutex_t lock; //Guards incoming, which the main thread adds accepted connections to
+	pthread_cond_t arrived; //Signalled when a connection is added to incoming, or the server stops
+	Connection** incoming;
+	int incomingCount;
+	int incomingCapacity;
+	Connection** connections; //The connections this worker serves
+	int connectionCount;
+	int connectionCapacity;
+	int nextConnection; //Where the next batch starts taking requests, so every connection gets its turn
+	int* sockets; //Scratch for waitForSockets(), connectionCapacity long
+	int* ready;
+	PendingRequest* batch; //options->batchSize long
+	Arena* arena; //Holds the shingles of the current batch
+	uint32_t* sharedCounts; //Per-document scratch for finding the most similar documents, scratchCapacity long
+	uint32_t* touched;
+	uint32_t scratchCapacity;
+	IndexMatch* matches;
+	uint32_t matchCapacity;
+} ServerWorker;
+
+typedef struct ServerState {
+	const ServerOptions* options;
+	ResidentIndex index;
+	ServerStatistics statistics;
+	ServerWorker* workers;
+} ServerState;
+
+void interpretConsoleFlags(int argc, char* argv[], char** inputFileNames, int* inputFileCount, ServerOptions* options);
+void printDebug(const char* debugText, ...); /**Wraps printf(), calling it only if global variable debugFlag is true**/
+void requestStop(int signalNumber); /** Signal handler for Ctrl-C, which stops the server like SERVER_SHUTDOWN **/
+void loadDocuments(char** fileNames, int fileCount, ServerState* state);
+uint32_t addDocument(ResidentIndex* index, uint64_t* hashes, uint32_t size); /** Takes over hashes, which must be sorted and distinct, and returns the new document's number **/
+	PostingList* addTerm(ResidentIndex* index, uint64_t hash); /** Sub-function of addDocument, finds the term's posting list, making it if it is new **/
+	void growTermTable(ResidentIndex* index); /** Sub-function of addTerm, doubles the number of slots **/
+	uint64_t termSlot(uint64_t hash, uint64_t capacity); /** Sub-function of addTerm and findPostings, the slot a term's probe starts at **/
+PostingList* findPostings(const ResidentIndex* index, uint64_t hash); /** Returns NULL if no document has held the term **/
+uint32_t removeDocument(ResidentIndex* index, uint32_t document); /** Returns SERVER_OK, or SERVER_UNKNOWN_DOCUMENT **/
+void assignConnection(ServerWorker* worker, int socket);
+void* runServerWorker(void* argument);
+	int receiveRequests(Connection* connection); /** Sub-function of runServerWorker, reads what the connection has sent, and returns false if it is closed or sent something that is not a request **/
+	size_t wholeRequestLength(const Connection* connection, size_t offset); /** Sub-function of receiveRequests, the length of the request at offset from inputStart if all of it has arrived, otherwise 0 **/
+	int takeBatch(ServerWorker* worker, int* moreWaiting); /** Sub-function of runServerWorker, takes every whole request received (up to the batch size), and returns how many **/
+	void serveBatch(ServerWorker* worker, int requestCount); /** Sub-function of runServerWorker **/
+	int changesIndex(const PendingRequest* pending); /** Sub-function of serveBatch **/
+	void answerRequest(ServerWorker* worker, PendingRequest* pending); /** Sub-function of serveBatch, runs with the index locked **/
+	int findTopMatches(ServerWorker* worker, const uint64_t* hashes, uint64_t count, uint32_t topCount, uint32_t skipDocument); /** Sub-function of answerRequest, fills in worker->matches and returns how many there are, or -1 if out of memory **/
+	int appendResponse(Connection* connection, const ServerResponse* response, const void* payload); /** Sub-function of answerRequest, returns false if out of memory **/
+	void recordBatch(ServerState* state, const PendingRequest* batch, int requestCount); /** Sub-function of runServerWorker, adds the batch's latencies to the statistics **/
+	void dropConnection(ServerWorker* worker, int c); /** Sub-function of runServerWorker **/
+	void deleteConnection(Connection* connection);
+char* formatServerReport(ServerState* state, size_t* length); /** Returns a new allocation holding the request rates and latencies, as text **/
+	int compareLatencies(const void* a, const void* b); /** Sub-function of formatServerReport, qsort() comparator for latencies **/
+
+/**
+ * Declare any (absolutely necessary) global variables:
+ */
+int debugFlag = false;
+volatile sig_atomic_t stopRequested = false; //Set by SERVER_SHUTDOWN or Ctrl-C; every thread checks it between batches
+
+int main(int argc, char* argv[]) {
+	/**Read the options, and the names of any files to load before listening:**/
+	char** inputFileNames = malloc(argc * sizeof(char*)); //Every argument but the program name could be a file name
+	int inputFileCount = 0;
+	ServerOptions options = {NULL, processorCount(), -1, -1, defaultBatchSize};
+	ServerState state;
+	if(inputFileNames == NULL) {
+		printf("\nERROR: Unable to allocate memory for the input file names!\n");
+		exit(1);
+	}
+	interpretConsoleFlags(argc, argv, inputFileNames, &inputFileCount, &options);
+	memset(&state, 0, sizeof(ServerState));
+	state.options = &options;
+	pthread_rwlock_init(&state.index.lock, NULL);
+	pthread_mutex_init(&state.statistics.lock, NULL);
+	for(int t = 0; t < SERVER_REQUEST_TYPES; t++) {
+		state.statistics.latencies[t] = malloc(latencyWindow * sizeof(double));
+		if(state.statistics.latencies[t] == NULL) {
+			printf("\nERROR: Unable to allocate memory for the server's statistics!\n");
+			exit(1);
+		}
+	}
+	
+	/**Load the starting corpus, which also settles the shingle size and hash algorithm if -s and -hash were not given:**/
+	loadDocuments(inputFileNames, inputFileCount, &state);
+	if(options.shingleSize < 0) {
+		options.shingleSize = defaultShingleSize;
+	}
+	if(options.hashAlgorithm < 0) {
+		options.hashAlgorithm = HASH_DEFAULT;
+	}
+	free(inputFileNames);
+	
+	/**Listen, and start the workers, which serve every connection from here on:**/
+	int listener = listenLocalSocket(options.socketName);
+	if(listener < 0) {
+		printf("\nERROR: Unable to listen at \"%s\"!\n", options.socketName);
+		exit(1);
+	}
+	signal(SIGINT, requestStop);
+#ifndef _WIN32
+	signal(SIGPIPE, SIG_IGN); //A client that hangs up early only fails its own connection
+#endif
+	state.workers = calloc(options.threadCount, sizeof(ServerWorker));
+	if(state.workers == NULL) {
+		printf("\nERROR: Unable to allocate memory for the worker threads!\n");
+		exit(1);
+	}
+	for(int w = 0; w < options.threadCount; w++) {
+		ServerWorker* worker = &state.workers[w];
+		worker->id = w;
+		worker->state = &state;
+		worker->batch = malloc(options.batchSize * sizeof(PendingRequest));
+		worker->arena = createArena(0);
+		if(worker->batch == NULL || worker->arena == NULL) {
+			printf("\nERROR: Unable to allocate memory for the worker threads!\n");
+			exit(1);
+		}
+		pthread_mutex_init(&worker->lock, NULL);
+		pthread_cond_init(&worker->arrived, NULL);
+	}
+	state.statistics.startTime = wallClockSeconds();
+	for(int w = 0; w < options.threadCount; w++) {
+		if(pthread_create(&state.workers[w].thread, NULL, runServerWorker, &state.workers[w]) != 0) {
+			printf("\nERROR: Unable to start worker thread %d!\n", w);
+			exit(1);
+		}
+	}
+	printf("Listening at \"%s\" with %d worker thread%s, holding %u documents (shingles of %d words, hashed with %s).\n", options.socketName, options.threadCount, (options.threadCount == 1) ? "" : "s", state.index.liveCount, options.shingleSize, hashAlgorithmName((uint32_t)options.hashAlgorithm));
+	fflush(stdout);
+	
+	/**Hand each new connection to the workers in turn, until SERVER_SHUTDOWN or Ctrl-C:**/
+	int nextWorker = 0;
+	while(stopRequested == false) {
+		int ready = false;
+		if(waitForSockets(&listener, 1, pollMilliseconds, &ready) > 0 && ready == true) {
+			int socket = acceptLocalSocket(listener);
+			if(socket >= 0) {
+				assignConnection(&state.workers[nextWorker], socket);
+				nextWorker = (nextWorker + 1) % options.threadCount;
+			}
+		}
+	}
+	
+	printDebug("\nStopping...\n");
+	for(int w = 0; w < options.threadCount; w++) {
+		pthread_mutex_lock(&state.workers[w].lock);
+		pthread_cond_signal(&state.workers[w].arrived);
+		pthread_mutex_unlock(&state.workers[w].lock);
+	}
+	for(int w = 0; w < options.threadCount; w++) {
+		pthread_join(state.workers[w].thread, NULL);
+	}
+	closeLocalSocket(listener);
+	removeLocalSocket(options.socketName);
+	
+	size_t reportLengthUsed = 0;
+	char* report = formatServerReport(&state, &reportLengthUsed);
+	printf("\n%s", report);
+	free(report);
+	
+	printDebug("\nFreeing memory...\n");
+	for(int w = 0; w < options.threadCount; w++) {
+		ServerWorker* worker = &state.workers[w];
+		for(int c = 0; c < worker->incomingCount; c++) { //Accepted after the worker stopped
+			deleteConnection(worker->incoming[c]);
+		}
+		pthread_mutex_destroy(&worker->lock);
+		pthread_cond_destroy(&worker->arrived);
+		free(worker->incoming);
+		free(worker->connections);
+		free(worker->sockets);
+		free(worker->ready);
+		free(worker->batch);
+		deleteArena(worker->arena);
+		free(worker->sharedCounts);
+		free(worker->touched);
+		free(worker->matches);
+	}
+	free(state.workers);
+	for(uint32_t d = 0; d < state.index.documentCount; d++) {
+		free(state.index.documents[d].hashes);
+	}
+	for(uint64_t slot = 0; slot < state.index.termCapacity; slot++) {
+		free(state.index.postings[slot].documents);
+	}
+	free(state.index.documents);
+	free(state.index.terms);
+	free(state.index.postings);
+	pthread_rwlock_destroy(&state.index.lock);
+	for(int t = 0; t < SERVER_REQUEST_TYPES; t++) {
+		free(state.statistics.latencies[t]);
+	}
+	pthread_mutex_destroy(&state.statistics.lock);
+	printDebug("  Memory freed successfully.\n");
+	return 0;
+}
+
+void interpretConsoleFlags(int argc, char* argv[], char** inputFileNames, int* inputFileCount, ServerOptions* options) {
+	int gatheringInput = true; //If true, all subsequent unrecognized (not a flag) arguments are assumed to be input file names
+	for(int i = 1; i < argc; i++) {
+		if(strcmp(argv[i], "-i") == 0) { //Start reading a stream of file names, stopping at the next argument flag
+			gatheringInput = true;
+		} else if(strcmp(argv[i], "-d") == 0) { //If the user enabled the verbose debug messages
+			debugFlag = true;
+			gatheringInput = false;
+		} else if(strcmp(argv[i], "-socket") == 0) { //Listen at the given path
+			if(i + 1 >= argc) {
+				printf("\nERROR: You must enter a path for the server's socket!\n");
+				exit(1);
+			}
+			options->socketName = argv[++i];
+			gatheringInput = false;
+		} else if(strcmp(argv[i], "-j") == 0) { //Serve the connections on the given number of worker threads
+			if(i + 1 >= argc || atoi(argv[i + 1]) < 1) {
+				printf("\nERROR: You must enter a thread count of at least 1!\n");
+				exit(1);
+			}
+			options->threadCount = atoi(argv[++i]);
+			gatheringInput = false;
+		} else if(strcmp(argv[i], "-s") == 0) { //Words per shingle of the texts sent to the server
+			if(i + 1 >= argc || atoi(argv[i + 1]) < 1) {
+				printf("\nERROR: You must enter a shingle size of at least 1!\n");
+				exit(1);
+			}
+			options->shingleSize = atoi(argv[++i]);
+			gatheringInput = false;
+		} else if(strcmp(argv[i], "-hash") == 0) { //Hash the texts sent to the server with the given algorithm
+			options->hashAlgorithm = (i + 1 < argc) ? parseHashAlgorithm(argv[++i]) : -1;
+			if(options->hashAlgorithm < 0) {
+				printf("\nERROR: The hash algorithm must be \"xxh64\", \"rolling\" or \"legacy\"!\n");
+				exit(1);
+			}
+			gatheringInput = false;
+		} else if(strcmp(argv[i], "-batch") == 0) { //Take at most the given number of requests into a batch
+			if(i + 1 >= argc || atoi(argv[i + 1]) < 1) {
+				printf("\nERROR: You must enter a batch size of at least 1!\n");
+				exit(1);
+			}
+			options->batchSize = atoi(argv[++i]);
+			gatheringInput = false;
+		} else if(gatheringInput == true) {
+			inputFileNames[(*inputFileCount)++] = argv[i];
+		}
+	}
+	
+	if(options->socketName == NULL) {
+		printf("\nERROR: You must give the path to listen at with -socket!\n");
+		exit(1);
+	}
+}
+
+void printDebug(const char* debugText, ...) { /**Wraps printf(), calling it only if global variable debugFlag is true**/
+	if(debugFlag == true) {
+		va_list args; //Set up our variable argument's data structure
+		va_start(args, debugText); //The variable argument "starts" right after our last finite argument, which is *debugText
+		vprintf(debugText, args);
+		va_end(args); //Clean up the variable argument's data structure
+	}
+}
+
+void requestStop(int signalNumber) { /** Signal handler for Ctrl-C, which stops the server like SERVER_SHUTDOWN **/
+	(void)signalNumber;
+	stopRequested = true;
+}
+
+/**
+ * Adds each input file to the index, numbered from 0 in the order given. Binary shingle files are read as they are,
+ * and .csv files are hashed like jaccard hashes them; every file must be made the way the texts sent later are
+ * shingled (words, of the same shingle size, and the same hash algorithm), or they could never match.
+ */
+void loadDocuments(char** fileNames, int fileCount, ServerState* state) {
+	ServerOptions* options = (ServerOptions*)state->options;
+	Arena* arena = createArena(0);
+	if(arena == NULL) {
+		printf("\nERROR: Unable to allocate memory for the hashed n-grams!\n");
+		exit(1);
+	}
+	
+	for(int f = 0; f < fileCount; f++) {
+		const uint64_t* hashes = NULL;
+		uint64_t count = 0;
+		uint32_t hashAlgorithm = 0;
+		MappedShingleFile* mapped = NULL;
+		if(isShingleFile(fileNames[f]) == true) {
+			mapped = openShingleFile(fileNames[f]);
+			hashes = mapped->hashes;
+			count = mapped->header->count;
+			hashAlgorithm = mapped->header->hashAlgorithm;
+			if(hashAlgorithm == HASH_DICTIONARY) {
+				printf("\nERROR: \"%s\" holds dictionary ids, which the texts sent to the server cannot be matched with!\n", fileNames[f]);
+				exit(1);
+			}
+			if(options->hashAlgorithm < 0) { //Without -hash, texts are hashed to match the first binary input
+				options->hashAlgorithm = (int)hashAlgorithm;
+			}
+			if(options->shingleSize < 0 && mapped->header->shingleSize > 0) { //And likewise without -s
+				options->shingleSize = (int)mapped->header->shingleSize;
+			}
+			if(mapped->header->shingleUnit != SHINGLE_WORDS || (mapped->header->shingleSize > 0 && (int)mapped->header->shingleSize != options->shingleSize)) {
+				printf("\nERROR: \"%s\" holds shingles of %u %s, but the server makes shingles of %d words!\n", fileNames[f], mapped->header->shingleSize, (mapped->header->shingleUnit == SHINGLE_WORDS) ? "words" : "characters", (options->shingleSize > 0) ? options->shingleSize : defaultShingleSize);
+				exit(1);
+			}
+		} else {
+			size_t textLength = 0;
+			char* text = readWholeFile(fileNames[f], &textLength);
+			if(text == NULL) {
+				printf("\nERROR: File \"%s\" not found!\n", fileNames[f]);
+				exit(1);
+			}
+			if(options->hashAlgorithm < 0) {
+				options->hashAlgorithm = HASH_DEFAULT;
+			}
+			hashAlgorithm = (uint32_t)options->hashAlgorithm;
+			ShingleSet* shingles = parseShingleCsv(arena, text, textLength, hashAlgorithm);
+			free(text);
+			if(shingles == NULL) {
+				printf("\nERROR: Unable to allocate memory for the hashed n-grams!\n");
+				exit(1);
+			}
+			hashes = shingles->hashes;
+			count = shingles->count;
+		}
+		if(hashAlgorithm != (uint32_t)options->hashAlgorithm) {
+			printf("\nERROR: \"%s\" was hashed with %s, but the server hashes with %s!\n", fileNames[f], hashAlgorithmName(hashAlgorithm), hashAlgorithmName((uint32_t)options->hashAlgorithm));
+			exit(1);
+		}
+		
+		uint64_t* copy = malloc((count > 0 ? count : 1) * sizeof(uint64_t));
+		if(copy == NULL) {
+			printf("\nERROR: Unable to allocate memory for the hashed n-grams!\n");
+			exit(1);
+		}
+		memcpy(copy, hashes, count * sizeof(uint64_t));
+		uint32_t document = addDocument(&state->index, copy, (uint32_t)count);
+		printDebug("Loaded \"%s\" as document %u (%llu n-grams)\n", fileNames[f], document, (unsigned long long)count);
+		if(mapped != NULL) {
+			closeShingleFile(mapped);
+		}
+		resetArena(arena);
+	}
+	deleteArena(arena);
+}
+
+uint32_t addDocument(ResidentIndex* index, uint64_t* hashes, uint32_t size) { /** Takes over hashes, which must be sorted and distinct, and returns the new document's number **/
+	if(index->documentCount == index->documentCapacity) {
+		index->documentCapacity = (index->documentCapacity > 0) ? index->documentCapacity * 2 : 1024;
+		index->documents = realloc(index->documents, index->documentCapacity * sizeof(ResidentDocument));
+		if(index->documents == NULL) {
+			printf("\nERROR: Unable to re-allocate memory for the documents!\n");
+			exit(1);
+		}
+	}
+	uint32_t document = index->documentCount++;
+	index->documents[document].hashes = hashes;
+	index->documents[document].size = size;
+	index->documents[document].live = true;
+	index->liveCount++;
+	
+	for(uint32_t h = 0; h < size; h++) {
+		PostingList* list = addTerm(index, hashes[h]);
+		if(list->count == list->capacity) {
+			list->capacity *= 2;
+			list->documents = realloc(list->documents, list->capacity * sizeof(uint32_t));
+			if(list->documents == NULL) {
+				printf("\nERROR: Unable to re-allocate memory for the inverted index!\n");
+				exit(1);
+			}
+		}
+		list->documents[list->count++] = document;
+	}
+	return document;
+}
+
+PostingList* addTerm(ResidentIndex* index, uint64_t hash) { /** Sub-function of addDocument, finds the term's posting list, making it if it is new **/
+	if((index->termCount + 1) * 2 > index->termCapacity) { //Kept at most half full, so probes stay short
+		growTermTable(index);
+	}
+	uint64_t slot = termSlot(hash, index->termCapacity);
+	while(index->postings[slot].capacity != 0) {
+		if(index->terms[slot] == hash) {
+			return &index->postings[slot];
+		}
+		slot = (slot + 1) & (index->termCapacity - 1);
+	}
+	
+	index->terms[slot] = hash;
+	index->postings[slot].documents = malloc(initialPostingCapacity * sizeof(uint32_t));
+	index->postings[slot].count = 0;
+	index->postings[slot].capacity = initialPostingCapacity;
+	if(index->postings[slot].documents == NULL) {
+		printf("\nERROR: Unable to allocate memory for the inverted index!\n");
+		exit(1);
+	}
+	index->termCount++;
+	return &index->postings[slot];
+}
+
+void growTermTable(ResidentIndex* index) { /** Sub-function of addTerm, doubles the number of slots **/
+	uint64_t capacity = (index->termCapacity > 0) ? index->termCapacity * 2 : 65536;
+	uint64_t* terms = malloc(capacity * sizeof(uint64_t));
+	PostingList* postings = calloc(capacity, sizeof(PostingList));
+	if(terms == NULL || postings == NULL) {
+		printf("\nERROR: Unable to allocate memory for the inverted index!\n");
+		exit(1);
+	}
+	
+	for(uint64_t old = 0; old < index->termCapacity; old++) {
+		if(index->postings[old].capacity == 0) {
+			continue;
+		}
+		uint64_t slot = termSlot(index->terms[old], capacity);
+		while(postings[slot].capacity != 0) {
+			slot = (slot + 1) & (capacity - 1);
+		}
+		terms[slot] = index->terms[old];
+		postings[slot] = index->postings[old];
+	}
+	free(index->terms);
+	free(index->postings);
+	index->terms = terms;
+	index->postings = postings;
+	index->termCapacity = capacity;
+}
+
+uint64_t termSlot(uint64_t hash, uint64_t capacity) { /** Sub-function of addTerm and findPostings, the slot a term's probe starts at **/
+	hash ^= hash >> 29; //"legacy" hashes are small numbers, so spread them over the whole table first
+	hash *= 0xBF58476D1CE4E5B9ULL;
+	return (hash ^ (hash >> 32)) & (capacity - 1);
+}
+
+PostingList* findPostings(const ResidentIndex* index, uint64_t hash) { /** Returns NULL if no document has held the term **/
+	if(index->termCapacity == 0) {
+		return NULL;
+	}
+	uint64_t slot = termSlot(hash, index->termCapacity);
+	while(index->postings[slot].capacity != 0) {
+		if(index->terms[slot] == hash) {
+			return &index->postings[slot];
+		}
+		slot = (slot + 1) & (index->termCapacity - 1);
+	}
+	return NULL;
+}
+
+uint32_t removeDocument(ResidentIndex* index, uint32_t document) { /** Returns SERVER_OK, or SERVER_UNKNOWN_DOCUMENT **/
+	if(document >= index->documentCount || index->documents[document].live == false) {
+		return SERVER_UNKNOWN_DOCUMENT;
+	}
+	ResidentDocument* removed = &index->documents[document];
+	for(uint32_t h = 0; h < removed->size; h++) {
+		PostingList* list = findPostings(index, removed->hashes[h]);
+		for(uint32_t p = 0; list != NULL && p < list->count; p++) {
+			if(list->documents[p] == document) { //Order within a list does not matter, so the last one takes its place
+				list->documents[p] = list->documents[--list->count];
+				break;
+			}
+		}
+	}
+	free(removed->hashes);
+	removed->hashes = NULL;
+	removed->size = 0;
+	removed->live = false;
+	index->liveCount--;
+	return SERVER_OK;
+}
+
+void assignConnection(ServerWorker* worker, int socket) {
+	Connection* connection = calloc(1, sizeof(Connection));
+	if(connection == NULL) {
+		closeLocalSocket(socket); //The client sees the connection close, and the server carries on
+		return;
+	}
+	connection->socket = socket;
+	
+	pthread_mutex_lock(&worker->lock);
+	if(worker->incomingCount == worker->incomingCapacity) {
+		int capacity = (worker->incomingCapacity > 0) ? worker->incomingCapacity * 2 : 16;
+		Connection** incoming = realloc(worker->incoming, capacity * sizeof(Connection*));
+		if(incoming == NULL) {
+			pthread_mutex_unlock(&worker->lock);
+			deleteConnection(connection);
+			return;
+		}
+		worker->incoming = incoming;
+		worker->incomingCapacity = capacity;
+	}
+	worker->incoming[worker->incomingCount++] = connection;
+	pthread_cond_signal(&worker->arrived);
+	pthread_mutex_unlock(&worker->lock);
+	printDebug("Connection accepted by worker %d\n", worker->id);
+}
+
+/**
+ * The body of each worker thread. It waits for any of its connections to send something, reads whatever each has
+ * sent, takes every whole request into one batch and serves it, then sends each connection all of its responses at
+ * once. Under load many requests arrive while a batch is served, so the next batch is larger, and the cost of
+ * waiting, locking the index and sending is shared by more requests.
+ */
+void* runServerWorker(void* argument) {
+	ServerWorker* worker = argument;
+	ServerState* state = worker->state;
+	int moreWaiting = false; //The last batch left whole requests behind, so the next one should not wait
+	
+	while(stopRequested == false) {
+		/**Pick up the connections accepted since the last batch, sleeping while there are none to serve:**/
+		pthread_mutex_lock(&worker->lock);
+		while(worker->incomingCount == 0 && worker->connectionCount == 0 && stopRequested == false) {
+			pthread_cond_wait(&worker->arrived, &worker->lock);
+		}
+		for(int c = 0; c < worker->incomingCount; c++) {
+			if(worker->connectionCount == worker->connectionCapacity) {
+				int capacity = (worker->connectionCapacity > 0) ? worker->connectionCapacity * 2 : 16;
+				worker->connections = realloc(worker->connections, capacity * sizeof(Connection*));
+				worker->sockets = realloc(worker->sockets, capacity * sizeof(int));
+				worker->ready = realloc(worker->ready, capacity * sizeof(int));
+				if(worker->connections == NULL || worker->sockets == NULL || worker->ready == NULL) {
+					printf("\nERROR: Unable to re-allocate memory for the connections!\n");
+					exit(1);
+				}
+				worker->connectionCapacity = capacity;
+			}
+			worker->connections[worker->connectionCount++] = worker->incoming[c];
+		}
+		worker->incomingCount = 0;
+		pthread_mutex_unlock(&worker->lock);
+		if(stopRequested == true) {
+			break;
+		}
+		
+		/**Read whatever has arrived, and serve every whole request as one batch:**/
+		for(int c = 0; c < worker->connectionCount; c++) {
+			worker->sockets[c] = worker->connections[c]->socket;
+		}
+		if(waitForSockets(worker->sockets, worker->connectionCount, (moreWaiting == true) ? 0 : pollMilliseconds, worker->ready) < 0) {
+			continue; //Interrupted by a signal
+		}
+		for(int c = 0; c < worker->connectionCount; c++) {
+			if(worker->ready[c] == true && receiveRequests(worker->connections[c]) == false) {
+				worker->connections[c]->failed = true;
+			}
+		}
+		int requestCount = takeBatch(worker, &moreWaiting);
+		if(requestCount > 0) {
+			serveBatch(worker, requestCount);
+			for(int c = 0; c < worker->connectionCount; c++) {
+				Connection* connection = worker->connections[c];
+				if(connection->outputLength > 0 && connection->failed == false && sendAll(connection->socket, connection->output, connection->outputLength) != 0) {
+					connection->failed = true;
+				}
+				connection->outputLength = 0;
+				connection->sentTime = wallClockSeconds();
+			}
+			recordBatch(state, worker->batch, requestCount);
+		}
+		for(int c = worker->connectionCount - 1; c >= 0; c--) {
+			if(worker->connections[c]->failed == true) {
+				dropConnection(worker, c);
+			}
+		}
+	}
+	
+	for(int c = worker->connectionCount - 1; c >= 0; c--) {
+		dropConnection(worker, c);
+	}
+	return NULL;
+}
+
+int receiveRequests(Connection* connection) { /** Sub-function of runServerWorker, reads what the connection has sent, and returns false if it is closed or sent something that is not a request **/
+	if(connection->inputStart > 0) { //Every request before inputStart has been served, so its bytes can go
+		memmove(connection->input, connection->input + connection->inputStart, connection->inputLength);
+		connection->inputStart = 0;
+	}
+	if(connection->arrivalStart > 0) { //Likewise the arrival times of those requests
+		memmove(connection->arrivalTimes, connection->arrivalTimes + connection->arrivalStart, connection->arrivalCount * sizeof(double));
+		connection->arrivalStart = 0;
+	}
+	
+	size_t wanted = connection->inputLength + receiveChunk;
+	if(connection->inputLength >= sizeof(ServerRequest)) { //Make room for the whole of a large request at once
+		ServerRequest request;
+		memcpy(&request, connection->input, sizeof(ServerRequest));
+		if(request.length > SERVER_MAX_PAYLOAD) {
+			return false;
+		}
+		if(sizeof(ServerRequest) + (size_t)request.length > wanted) {
+			wanted = sizeof(ServerRequest) + (size_t)request.length;
+		}
+	}
+	if(wanted > connection->inputCapacity) {
+		size_t capacity = (connection->inputCapacity > 0) ? connection->inputCapacity : receiveChunk;
+		while(capacity < wanted) {
+			capacity *= 2;
+		}
+		char* input = realloc(connection->input, capacity);
+		if(input == NULL) {
+			return false;
+		}
+		connection->input = input;
+		connection->inputCapacity = capacity;
+	}
+	
+	long long received = receiveSome(connection->socket, connection->input + connection->inputLength, connection->inputCapacity - connection->inputLength);
+	double arrivedTime = wallClockSeconds();
+	if(received <= 0) {
+		return false;
+	}
+	connection->inputLength += (size_t)received;
+	
+	/**Every request these bytes completed arrived now, however long it then waits behind the batches before it:**/
+	size_t requestLength = 0;
+	while((requestLength = wholeRequestLength(connection, connection->stampedLength)) > 0) {
+		if(connection->arrivalCount == connection->arrivalCapacity) {
+			int capacity = (connection->arrivalCapacity > 0) ? connection->arrivalCapacity * 2 : 16;
+			double* arrivalTimes = realloc(connection->arrivalTimes, capacity * sizeof(double));
+			if(arrivalTimes == NULL) {
+				return false;
+			}
+			connection->arrivalTimes = arrivalTimes;
+			connection->arrivalCapacity = capacity;
+		}
+		connection->arrivalTimes[connection->arrivalCount++] = arrivedTime;
+		connection->stampedLength += requestLength;
+	}
+	return true;
+}
+
+size_t wholeRequestLength(const Connection* connection, size_t offset) { /** Sub-function of receiveRequests, the length of the request at offset from inputStart if all of it has arrived, otherwise 0 **/
+	ServerRequest request;
+	if(connection->inputLength - offset < sizeof(ServerRequest)) {
+		return 0;
+	}
+	memcpy(&request, connection->input + connection->inputStart + offset, sizeof(ServerRequest)); //The buffer holds requests back to back, so this one may not be aligned
+	return (request.length <= SERVER_MAX_PAYLOAD && connection->inputLength - offset - sizeof(ServerRequest) >= request.length) ? sizeof(ServerRequest) + (size_t)request.length : 0;
+}
+
+int takeBatch(ServerWorker* worker, int* moreWaiting) { /** Sub-function of runServerWorker, takes every whole request received (up to the batch size), and returns how many **/
+	int requestCount = 0;
+	int batchSize = worker->state->options->batchSize;
+	
+	*moreWaiting = false;
+	for(int n = 0; n < worker->connectionCount; n++) {
+		Connection* connection = worker->connections[(worker->nextConnection + n) % worker->connectionCount];
+		while(connection->failed == false && connection->arrivalCount > 0) { //Each request with an arrival time is whole
+			if(requestCount == batchSize) {
+				*moreWaiting = true;
+				worker->nextConnection = (worker->nextConnection + n) % worker->connectionCount; //The next batch starts here
+				return requestCount;
+			}
+			PendingRequest* pending = &worker->batch[requestCount++];
+			memset(pending, 0, sizeof(PendingRequest));
+			pending->connection = connection;
+			memcpy(&pending->request, connection->input + connection->inputStart, sizeof(ServerRequest));
+			pending->payload = connection->input + connection->inputStart + sizeof(ServerRequest);
+			pending->receivedTime = connection->arrivalTimes[connection->arrivalStart++];
+			connection->arrivalCount--;
+			connection->inputStart += sizeof(ServerRequest) + (size_t)pending->request.length;
+			connection->inputLength -= sizeof(ServerRequest) + (size_t)pending->request.length;
+			connection->stampedLength -= sizeof(ServerRequest) + (size_t)pending->request.length;
+		}
+	}
+	if(worker->connectionCount > 0) {
+		worker->nextConnection = (worker->nextConnection + 1) % worker->connectionCount;
+	}
+	return requestCount;
+}
+
+/**
+ * Serves a batch in the order it was taken. The texts are shingled first, with nothing locked; then each run of
+ * requests that only read the index is served under one shared lock, and each run that changes it under one
+ * exclusive lock, so a batch of lookups costs a single lock acquisition.
+ */
+void serveBatch(ServerWorker* worker, int requestCount) {
+	const ServerOptions* options = worker->state->options;
+	ResidentIndex* index = &worker->state->index;
+	
+	for(int r = 0; r < requestCount; r++) {
+		PendingRequest* pending = &worker->batch[r];
+		uint32_t type = pending->request.type;
+		if(type == SERVER_ADD || ((type == SERVER_COMPARE || type == SERVER_TOP) && pending->request.length > 0)) {
+			pending->shingles = shingleBuffer(worker->arena, pending->payload, (size_t)pending->request.length, (uint32_t)options->shingleSize, (uint32_t)options->hashAlgorithm);
+		}
+		if(type == SERVER_ADD && pending->shingles != NULL) {
+			pending->ownedHashes = malloc((pending->shingles->count > 0 ? pending->shingles->count : 1) * sizeof(uint64_t));
+			if(pending->ownedHashes != NULL) {
+				memcpy(pending->ownedHashes, pending->shingles->hashes, pending->shingles->count * sizeof(uint64_t));
+			}
+		}
+	}
+	
+	for(int r = 0; r < requestCount; ) {
+		int writing = changesIndex(&worker->batch[r]);
+		int end = r + 1;
+		while(end < requestCount && changesIndex(&worker->batch[end]) == writing) {
+			end++;
+		}
+		if(writing == true) {
+			pthread_rwlock_wrlock(&index->lock);
+		} else {
+			pthread_rwlock_rdlock(&index->lock);
+		}
+		for(; r < end; r++) {
+			answerRequest(worker, &worker->batch[r]);
+		}
+		pthread_rwlock_unlock(&index->lock);
+	}
+	resetArena(worker->arena);
+}
+
+int changesIndex(const PendingRequest* pending) { /** Sub-function of serveBatch **/
+	return (pending->request.type == SERVER_ADD || pending->request.type == SERVER_REMOVE) ? true : false;
+}
+
+void answerRequest(ServerWorker* worker, PendingRequest* pending) { /** Sub-function of serveBatch, runs with the index locked **/
+	ResidentIndex* index = &worker->state->index;
+	const ServerRequest* request = &pending->request;
+	ServerResponse response;
+	const void* payload = NULL;
+	char* report = NULL;
+	memset(&response, 0, sizeof(ServerResponse));
+	response.status = SERVER_OK;
+	response.tag = request->tag;
+	
+	int hasText = (request->length > 0) ? true : false;
+	int knownDocument = (request->document < index->documentCount && index->documents[request->document].live == true) ? true : false;
+	if(request->type == SERVER_ADD) {
+		if(pending->ownedHashes == NULL) {
+			response.status = SERVER_FULL;
+		} else {
+			response.document = addDocument(index, pending->ownedHashes, (uint32_t)pending->shingles->count);
+			pending->ownedHashes = NULL;
+		}
+	} else if(request->type == SERVER_REMOVE) {
+		response.status = removeDocument(index, request->document);
+	} else if(request->type == SERVER_COMPARE || request->type == SERVER_TOP) {
+		const uint64_t* hashes = NULL;
+		uint64_t count = 0;
+		if(hasText == true && pending->shingles == NULL) {
+			response.status = SERVER_FULL;
+		} else if(hasText == true) {
+			hashes = pending->shingles->hashes;
+			count = pending->shingles->count;
+		} else if(knownDocument == false) {
+			response.status = SERVER_UNKNOWN_DOCUMENT;
+		} else {
+			hashes = index->documents[request->document].hashes;
+			count = index->documents[request->document].size;
+		}
+		
+		if(response.status == SERVER_OK && request->type == SERVER_COMPARE) {
+			const ResidentDocument* other = (hasText == true) ? &index->documents[request->document] : &index->documents[request->other];
+			if((hasText == true && knownDocument == false) || (hasText == false && (request->other >= index->documentCount || other->live == false))) {
+				response.status = SERVER_UNKNOWN_DOCUMENT;
+			} else {
+				uint64_t shared = intersectionCount64(hashes, count, other->hashes, other->size);
+				uint64_t unionCount = count + other->size - shared; //|A u B| = |A| + |B| - |A n B|
+				response.similarity = (unionCount > 0) ? (double)shared / (double)unionCount : 0.0;
+			}
+		} else if(response.status == SERVER_OK) {
+			int matchCount = findTopMatches(worker, hashes, count, request->other, (hasText == true) ? UINT32_MAX : request->document);
+			if(matchCount < 0) {
+				response.status = SERVER_FULL;
+			} else {
+				response.count = (uint32_t)matchCount;
+				response.length = (uint64_t)matchCount * sizeof(IndexMatch);
+				payload = worker->matches;
+			}
+		}
+	} else if(request->type == SERVER_STATS) {
+		size_t length = 0;
+		report = formatServerReport(worker->state, &length);
+		if(report == NULL) {
+			response.status = SERVER_FULL;
+		} else {
+			response.length = (uint64_t)length;
+			payload = report;
+		}
+	} else if(request->type == SERVER_SHUTDOWN) {
+		stopRequested = true;
+	} else {
+		response.status = SERVER_BAD_REQUEST;
+	}
+	
+	free(pending->ownedHashes); //Only left if the request failed
+	pending->ownedHashes = NULL;
+	if(appendResponse(pending->connection, &response, payload) == false) {
+		pending->connection->failed = true;
+	}
+	free(report);
+}
+
+/**
+ * Finds the documents sharing the most of their shingles with the given hashes, leaving out skipDocument, by walking
+ * the posting list of each hash and counting how often each document turns up. Only the documents that turn up are
+ * visited afterwards, as in queryShingleIndex().
+ */
+int findTopMatches(ServerWorker* worker, const uint64_t* hashes, uint64_t count, uint32_t topCount, uint32_t skipDocument) { /** Sub-function of answerRequest, fills in worker->matches and returns how many there are, or -1 if out of memory **/
+	const ResidentIndex* index = &worker->state->index;
+	if(worker->scratchCapacity < index->documentCount) {
+		uint32_t capacity = index->documentCount + index->documentCount / 2 + 1024;
+		free(worker->sharedCounts);
+		free(worker->touched);
+		worker->sharedCounts = calloc(capacity, sizeof(uint32_t));
+		worker->touched = malloc(capacity * sizeof(uint32_t));
+		worker->scratchCapacity = (worker->sharedCounts != NULL && worker->touched != NULL) ? capacity : 0;
+		if(worker->scratchCapacity == 0) {
+			return -1;
+		}
+	}
+	
+	uint32_t touchedCount = 0;
+	for(uint64_t h = 0; h < count; h++) {
+		const PostingList* list = findPostings(index, hashes[h]);
+		for(uint32_t p = 0; list != NULL && p < list->count; p++) {
+			uint32_t document = list->documents[p];
+			if(worker->sharedCounts[document]++ == 0) {
+				worker->touched[touchedCount++] = document;
+			}
+		}
+	}
+	
+	if(topCount > touchedCount) {
+		topCount = touchedCount;
+	}
+	if(topCount > worker->matchCapacity) {
+		free(worker->matches);
+		worker->matches = malloc(topCount * sizeof(IndexMatch));
+		worker->matchCapacity = (worker->matches != NULL) ? topCount : 0;
+	}
+	int matchCount = 0;
+	for(uint32_t t = 0; t < touchedCount; t++) {
+		IndexMatch candidate;
+		candidate.document = worker->touched[t];
+		candidate.shared = worker->sharedCounts[candidate.document];
+		candidate.similarity = (double)candidate.shared / (double)(count + index->documents[candidate.document].size - candidate.shared); //|Q u D| = |Q| + |D| - |Q n D|
+		worker->sharedCounts[candidate.document] = 0; //Ready for the next query
+		if(candidate.document != skipDocument && worker->matchCapacity >= topCount) {
+			matchCount = keepTopMatch(worker->matches, matchCount, (int)topCount, &candidate);
+		}
+	}
+	if(worker->matchCapacity < topCount) {
+		return -1;
+	}
+	sortTopMatches(worker->matches, matchCount);
+	return matchCount;
+}
+
+int appendResponse(Connection* connection, const ServerResponse* response, const void* payload) { /** Sub-function of answerRequest, returns false if out of memory **/
+	size_t needed = connection->outputLength + sizeof(ServerResponse) + (size_t)response->length;
+	if(needed > connection->outputCapacity) {
+		size_t capacity = (connection->outputCapacity > 0) ? connection->outputCapacity : receiveChunk;
+		while(capacity < needed) {
+			capacity *= 2;
+		}
+		char* output = realloc(connection->output, capacity);
+		if(output == NULL) {
+			return false;
+		}
+		connection->output = output;
+		connection->outputCapacity = capacity;
+	}
+	memcpy(connection->output + connection->outputLength, response, sizeof(ServerResponse));
+	if(response->length > 0) {
+		memcpy(connection->output + connection->outputLength + sizeof(ServerResponse), payload, (size_t)response->length);
+	}
+	connection->outputLength = needed;
+	return true;
+}
+
+void recordBatch(ServerState* state, const PendingRequest* batch, int requestCount) { /** Sub-function of runServerWorker, adds the batch's latencies to the statistics **/
+	ServerStatistics* statistics = &state->statistics;
+	pthread_mutex_lock(&statistics->lock);
+	for(int r = 0; r < requestCount; r++) {
+		uint32_t type = (batch[r].request.type < SERVER_REQUEST_TYPES) ? batch[r].request.type : 0;
+		statistics->latencies[type][statistics->counts[type] % latencyWindow] = batch[r].connection->sentTime - batch[r].receivedTime;
+		statistics->counts[type]++;
+	}
+	statistics->batchCount++;
+	pthread_mutex_unlock(&statistics->lock);
+}
+
+void dropConnection(ServerWorker* worker, int c) { /** Sub-function of runServerWorker **/
+	deleteConnection(worker->connections[c]);
+	worker->connections[c] = worker->connections[--worker->connectionCount];
+	worker->nextConnection = 0;
+	printDebug("Connection closed by worker %d\n", worker->id);
+}
+
+void deleteConnection(Connection* connection) {
+	closeLocalSocket(connection->socket);
+	free(connection->input);
+	free(connection->arrivalTimes);
+	free(connection->output);
+	free(connection);
+}
+
+/**
+ * The report printed when the server stops, and sent in answer to SERVER_STATS: the requests served per second since
+ * the server started, the mean batch size, and for each type of request its count, rate, and median and 99th
+ * percentile latency (from its last byte arriving to its response being sent) over the latest latencyWindow of them.
+ */
+char* formatServerReport(ServerState* state, size_t* length) { /** Returns a new allocation holding the request rates and latencies, as text **/
+	static const char* typeNames[SERVER_REQUEST_TYPES] = {"unknown", "add", "remove", "compare", "top", "stats", "shutdown"};
+	ServerStatistics* statistics = &state->statistics;
+	char* report = malloc(reportLength);
+	double* sorted = malloc(latencyWindow * sizeof(double));
+	if(report == NULL || sorted == NULL) {
+		free(report);
+		free(sorted);
+		return NULL;
+	}
+	
+	pthread_mutex_lock(&statistics->lock);
+	double seconds = wallClockSeconds() - statistics->startTime;
+	uint64_t total = 0;
+	for(int t = 0; t < SERVER_REQUEST_TYPES; t++) {
+		total += statistics->counts[t];
+	}
+	if(seconds <= 0.0) {
+		seconds = 1e-9; //Guards the rates below against a report made as soon as the server starts
+	}
+	size_t used = (size_t)snprintf(report, reportLength, "Served %llu requests in %.2f seconds (%.1f per second), %.1f to a batch on average; %u documents are held.\n", (unsigned long long)total, seconds, total / seconds, (statistics->batchCount > 0) ? (double)total / statistics->batchCount : 0.0, state->index.liveCount);
+	for(int t = 0; t < SERVER_REQUEST_TYPES; t++) {
+		uint64_t count = statistics->counts[t];
+		if(count == 0) {
+			continue;
+		}
+		uint64_t kept = (count < latencyWindow) ? count : latencyWindow;
+		memcpy(sorted, statistics->latencies[t], kept * sizeof(double));
+		qsort(sorted, kept, sizeof(double), compareLatencies);
+		double median = sorted[(kept * 50 + 99) / 100 - 1]; //Nearest rank: the smallest latency at least that share of the requests did not exceed
+		double tail = sorted[(kept * 99 + 99) / 100 - 1];
+		used += (size_t)snprintf(report + used, reportLength - used, "  %-8s %llu requests (%.1f per second), latency p50 %.3f ms, p99 %.3f ms\n", typeNames[t], (unsigned long long)count, count / seconds, median * 1000, tail * 1000);
+	}
+	pthread_mutex_unlock(&statistics->lock);
+	
+	free(sorted);
+	*length = used;
+	return report;
+}
+
+int compareLatencies(const void* a, const void* b) { /** Sub-function of formatServerReport, qsort() comparator for latencies **/
+	double left = *((const double*)a);
+	double right = *((const double*)b);
+	return (left > right) - (left < right);
+}
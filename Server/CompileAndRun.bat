@@ -0,0 +1,13 @@
+if not exist "Object Files" mkdir "Object Files"
+gcc -std=c99 -c "C Files\server.c" -o "Object Files\server.o"
+gcc -std=c99 -c "..\Common\C Files\ShingleFile.c" -o "Object Files\ShingleFile.o"
+gcc -std=c99 -c "..\Common\C Files\Platform.c" -o "Object Files\Platform.o"
+gcc -std=c99 -c "..\Common\C Files\SetIntersection.c" -o "Object Files\SetIntersection.o"
+gcc -std=c99 -c "..\Common\C Files\Arena.c" -o "Object Files\Arena.o"
+gcc -std=c99 -c "..\Common\C Files\Similarity.c" -o "Object Files\Similarity.o"
+gcc -std=c99 -c "..\Common\C Files\Tokenizer.c" -o "Object Files\Tokenizer.o"
+gcc -std=c99 -c "..\Common\C Files\Stats.c" -o "Object Files\Stats.o"
+gcc -std=c99 -c "..\Common\C Files\ShingleIndex.c" -o "Object Files\ShingleIndex.o"
+gcc -std=c99 -c "..\Common\C Files\ServerProtocol.c" -o "Object Files\ServerProtocol.o"
+
+gcc -std=c99 "Object Files\server.o" "Object Files\ShingleFile.o" "Object Files\Platform.o" "Object Files\SetIntersection.o" "Object Files\Arena.o" "Object Files\Similarity.o" "Object Files\Tokenizer.o" "Object Files\Stats.o" "Object Files\ShingleIndex.o" "Object Files\ServerProtocol.o" -o server -lpthread -lws2_32
\ No newline at end of file
@@ -2,7 +2,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
-#include "..\..\List-Library\Header Files\List.h"
+#include <stdint.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "..\..\Common\Header Files\ShingleFile.h"
+#include "..\..\Common\Header Files\Platform.h"
+#include "..\..\Common\Header Files\Stats.h"
+#include "..\..\Common\Header Files\Similarity.h"
+#include "..\..\Common\Header Files\Tokenizer.h"
+#include "..\..\Common\Header Files\ShingleDictionary.h"
 
 /**
  * Define all constants:
@@ -14,19 +23,144 @@
 #define defaultInputFile "input.txt"
 #define defaultOutputFile "output.txt"
 
+#define streamChunkSize 65536 //Bytes read from the input at a time in -stream mode
+#define hashRunCapacity 4194304 //Hashes held in memory (32 MB) before -stream -b spills a sorted run to a temporary file
+#define maxMergeFanIn 64 //Most runs merged at once; whenever this many of a level are spilled, they are merged into one run of the next level
+#define initialTableCapacity 1024 //Slots in a new ShingleTable, which doubles whenever it becomes half full
+
+/**
+ * Settings read from the command-line flags:
+ */
+typedef struct {
+	char* inputFileName;
+	char* outputFileName;
+	int shingleSize;
+	int binaryOutput; //Write a binary shingle file rather than comma-delimited text
+	int convertInput; //The input is a comma-delimited shingle file to convert to a binary one
+	int streamInput; //Shingle the input in fixed-size chunks, in constant memory
+	int characterShingles; //Shingles are runs of shingleSize characters rather than words, hashed with HASH_ROLLING
+	uint32_t hashAlgorithm; //One of the HASH_ constants from ShingleFile.h, used for binary output
+	char* dictionaryName; //Dictionary that -b and -convert give each shingle an id from, writing ids rather than hashes, or NULL to hash the shingles
+	ShingleDictionary* dictionary; //Opened from dictionaryName, and shared by every batch worker
+	char* batchSource; //Directory, wildcard pattern or manifest naming many input files, or NULL to shingle just inputFileName
+	char* outputDirectory; //Where batch outputs are written, or NULL to write each beside its input
+	int threadCount; //Worker threads for a batch, or 0 for one per processor
+	char* statsFileName; //File that stage timings and counters are written to as JSON, or NULL to record none
+} ShingleOptions;
+
+/**
+ * A word of the input text, viewed in place: it is never copied out of the buffer the text was read into.
+ */
+typedef struct {
+	const char* start;
+	size_t length;
+} WordView;
+
+/**
+ * A growable block of text, which shingles are written into one after another.
+ */
+typedef struct {
+	char* data;
+	size_t length;
+	size_t capacity;
+} TextBuffer;
+
+/**
+ * Open-addressing hash set of the shingles already written to a TextBuffer, used to remove duplicate shingles
+ * in the same pass that forms them. Each slot refers to a shingle by its position in the buffer, so the table
+ * stays valid when the buffer is re-allocated, and the shingles never need a copy of their own.
+ */
+typedef struct {
+	size_t offset; //Position of the shingle in the TextBuffer
+	uint32_t length; //0 marks an empty slot, since no shingle is empty
+	uint32_t hash;
+} ShingleSlot;
+
+typedef struct {
+	ShingleSlot* slots;
+	uint32_t capacity; //Always a power of two, so that a bit mask can be used in place of a modulo
+	uint32_t count;
+} ShingleTable;
+
+/**
+ * Sorted runs of shingle hashes, used by -stream -b to sort and de-duplicate more hashes than fit in memory.
+ * Hashes collect in buffer; each time it fills up, it is sorted, de-duplicated and spilled to a temporary file.
+ * Runs are merged maxMergeFanIn at a time as they pile up, so only a few temporary files are ever open at once.
+ */
+typedef struct {
+	uint64_t* buffer;
+	size_t count;
+	FILE** runFiles;
+	int* runLevels; //Times each run has been merged into; never increases along runFiles
+	int runCount;
+	int spilledCount; //Runs spilled in all, however many have since been merged together
+} HashRuns;
+
+/**
+ * State of the -stream shingler: the most recent shingleSize words, and where finished shingles go.
+ */
+typedef struct {
+	char** window; //Ring buffer of the most recent words, each in its own reusable buffer
+	size_t* windowCapacities;
+	int windowStart; //Index of the oldest word in window
+	int windowCount;
+	int shingleSize;
+	char* shingle; //Scratch buffer that each shingle is assembled in
+	size_t shingleCapacity;
+	FILE* outputFile; //Comma-delimited output, or NULL when the shingles are hashed into runs instead
+	HashRuns* runs;
+	uint32_t hashAlgorithm;
+	uint64_t shingleCount;
+} ShingleStream;
+
+/**
+ * A batch of files being shingled by -batch, shared by the worker threads. Each worker claims the next
+ * unclaimed file until none remain, so a few large files cannot leave the other workers idle for long.
+ */
+typedef struct {
+	const ShingleOptions* options;
+	char** inputFileNames;
+	char** outputFileNames;
+	int fileCount;
+	int nextFile; //Index of the next file to be claimed
+	uint64_t totalBytes; //Input bytes processed, added to by each worker as it finishes
+	pthread_mutex_t lock; //Guards nextFile and totalBytes
+} ShingleBatch;
+
 /**
  * Prototype all functions:
  */
-void interpretConsoleFlags(int argc, char* argv[], char** inputFileName, char** outputFileName, int* shingleSize);
-void printDebug(char* debugText, ...); /**Wraps printf(), calling it only if global variable debugFlag is true **/
+void interpretConsoleFlags(int argc, char* argv[], ShingleOptions* options);
+void printDebug(const char* debugText, ...); /**Wraps printf(), calling it only if global variable debugFlag is true **/
 void printHelpText();
-char* readTextFile(const char* fileName);
-List* tokenizeString(char* inputString, const char* delimiters);
-List* computeShingles(List* inputList, int groupSize);
-void removeDuplicates(List* inputList);
-char* commaDelimitArray(List* inputList);
-	int computeSizeOfContents(List* inputList); /** Sub-function of commaDelimitArray to get the number of bytes used by all strings in a given List (minus null-terminators) **/
-void writeTextFile(const char* fileName, char* text);
+void processFile(const ShingleOptions* options);
+void shingleBatch(const ShingleOptions* options);
+	void* runBatchWorker(void* argument); /** Sub-function of shingleBatch, the body of each worker thread **/
+	void checkBatchOutputNames(const ShingleBatch* batch); /** Sub-function of shingleBatch, exits if two inputs (e.g. "a.txt" and "a.md") would be written to the same output **/
+int listBatchInputs(const char* source, char*** fileNames);
+	void listDirectory(const char* directory, const char* pattern, char*** fileNames, int* count, int* capacity); /** Sub-function of listBatchInputs, adds the regular files in directory whose names match pattern (all of them if pattern is NULL) **/
+	void addFileName(char*** fileNames, int* count, int* capacity, const char* directory, const char* name); /** Sub-function of listBatchInputs, appends directory/name (or just name if directory is NULL) **/
+	int matchesPattern(const char* pattern, const char* name); /** Sub-function of listBatchInputs, returns true if name matches a pattern where '*' is any run of characters and '?' any one character **/
+const char* lastPathSeparator(const char* path); /** Returns the last '/' or '\' in path, or NULL if there is none **/
+int compareFileNames(const void* a, const void* b); /** qsort() comparator for char* file names **/
+char* batchOutputName(const char* inputFileName, const char* outputDirectory, int binaryOutput);
+char* readTextFile(const char* fileName, size_t* textLength);
+uint64_t shingleText(const char* text, size_t textLength, int shingleSize, TextBuffer* output); /** Returns the number of distinct shingles written **/
+	int addToShingleTable(ShingleTable* table, const TextBuffer* buffer, size_t offset, size_t length); /** Sub-function of shingleText, returns true if the shingle was not already in the table **/
+	void growShingleTable(ShingleTable* table); /** Sub-function of addToShingleTable, doubles the number of slots **/
+	uint32_t hashShingle(const char* shingle, size_t length); /** Sub-function of addToShingleTable, FNV-1a hash of a shingle **/
+	void appendText(TextBuffer* buffer, const char* text, size_t length); /** Sub-function of shingleText, appends to a TextBuffer, growing it as needed **/
+void writeTextFile(const char* fileName, const char* text, size_t textLength);
+void convertCsvFile(const char* inputFileName, const char* outputFileName, uint32_t hashAlgorithm, ShingleDictionary* dictionary);
+void writeIdFile(ShingleDictionary* dictionary, const char* text, size_t textLength, const char* outputFileName, uint32_t shingleSize); /** Interns the comma-delimited shingles in text, and writes their ids to a binary shingle file **/
+void streamShingles(const ShingleOptions* options);
+	void pushStreamWord(ShingleStream* stream, const char* word, size_t length); /** Sub-function of streamShingles, slides the window forward by one word and emits the shingle it completes **/
+	void reserveBuffer(char** buffer, size_t* capacity, size_t needed); /** Sub-function of streamShingles, grows a reusable char buffer to at least needed bytes **/
+	void addToHashRuns(HashRuns* runs, uint64_t hash);
+	void spillHashRun(HashRuns* runs); /** Sub-function of addToHashRuns, writes the buffered hashes to a new temporary file as one sorted run **/
+	void collapseHashRuns(HashRuns* runs, int count); /** Merges the last count runs into one new run **/
+	uint64_t mergeHashRuns(HashRuns* runs, FILE* outputFile); /** Sub-function of streamShingles, writes the union of every run in order, returning its size **/
+		uint64_t mergeRunFiles(FILE** runFiles, int runCount, uint64_t* buffer, FILE* outputFile); /** Sub-function of mergeHashRuns and collapseHashRuns, writes the union of the runs in order and closes them, returning its size **/
 
 /**
  * Declare any (absolutely necessary) global variables:
@@ -37,63 +171,153 @@ int main(int argc, char* argv[]) {
 	/**
 	 * Declare all variables and assign them their default values:
 	 */
-	char* inputFileName = defaultInputFile;
-	char* outputFileName = defaultOutputFile;
-	
-	char* rawText = NULL;
-	char* delimitedText = NULL;
-	List* tokenList = NULL;
-	List* shingleList = NULL;
-	
-	int shingleSize = defaultShingleSize;
-	int i;
+	ShingleOptions options = {defaultInputFile, defaultOutputFile, defaultShingleSize, false, false, false, false, HASH_DEFAULT, NULL, NULL, NULL, NULL, 0, NULL};
 	
 	/**
 	 * Interpret optional command-line flags, modifying the relevant variables as appropriate:
 	 */
-	interpretConsoleFlags(argc, argv, &inputFileName, &outputFileName, &shingleSize);
+	interpretConsoleFlags(argc, argv, &options);
+	if(options.statsFileName != NULL) {
+		enableStats("shingle");
+	}
 	
 	printDebug("\n >Debug flag is set, program will print additional debug information.\n");
 	
 	/**
-	 * Read the text file into rawText:
+	 * With -dict, every input's shingles are interned into the one dictionary, which is saved before each file of ids is written:
 	 */
-	printDebug("\n >Opening File \"%s\"...\n", inputFileName);
-	rawText = readTextFile(inputFileName);
-	printDebug("\n >The text contained in the text file is:\n");
-	printDebug("%s\n", rawText);
+	uint32_t openedShingles = 0;
+	if(options.dictionaryName != NULL) {
+		options.dictionary = openShingleDictionary(options.dictionaryName);
+		openedShingles = options.dictionary->count;
+		printDebug("\n >Dictionary \"%s\" holds %u shingles.\n", options.dictionaryName, options.dictionary->count);
+	}
 	
 	/**
-	 * Tokenize rawText and store it in the List named tokenList:
+	 * In batch mode, every file named by the batch source is processed on a pool of worker threads, exactly as a single input would be:
 	 */
-	printDebug("\n >Tokenizing the text read from file...\n");
-	tokenList = tokenizeString(rawText, " .,\"\n\r()");
-	printDebug("Done.\n");
+	if(options.batchSource != NULL) {
+		shingleBatch(&options);
+	} else {
+		processFile(&options);
+	}
+	
+	if(options.dictionary != NULL) {
+		double startTime = statsClock();
+		addCounter("newShingles", (uint64_t)(options.dictionary->count - openedShingles));
+		saveShingleDictionary(options.dictionary);
+		addStageTime("dictionary", startTime, 1, 0);
+		printDebug("\n >Dictionary \"%s\" now holds %u shingles.\n", options.dictionaryName, options.dictionary->count);
+		closeShingleDictionary(options.dictionary);
+	}
+	
+	if(options.statsFileName != NULL && writeStatsReport(options.statsFileName) != 0) {
+		printf("\nERROR: Unable to write the statistics to \"%s\"!\n", options.statsFileName);
+		exit(1);
+	}
+	
+	printDebug("\nPROGRAM COMPLETE\n\n");
+	
+	return 0;
+}
+
+/**
+ * Shingles options->inputFileName into options->outputFileName, in whichever mode the options select.
+ */
+void processFile(const ShingleOptions* options) {
+	char* rawText = NULL;
+	size_t rawLength = 0;
+	TextBuffer delimitedText = {NULL, 0, 0};
+	Arena* arena = NULL; //Holds the hashed shingles for a binary shingle file
+	ShingleSet* shingles = NULL;
+	uint64_t shingleCount = 0; //Distinct shingles written as comma-delimited text
+	double startTime = 0.0;
+	
+	const char* inputFileName = options->inputFileName;
+	const char* outputFileName = options->outputFileName;
+	int shingleSize = options->shingleSize;
 	
 	/**
-	 * Compute the shingles from tokenList and store them in the List named shingleList:
+	 * In conversion mode, the input is an existing comma-delimited shingle file rather than raw text:
 	 */
-	printDebug("\n >Shingle-izing the tokens, using a shingle size of %d...\n", shingleSize);
-	shingleList = computeShingles(tokenList, shingleSize);
-	printDebug("Done.\n");
+	if(options->convertInput == true) {
+		printDebug("\n >Converting comma-delimited shingle file \"%s\" to binary shingle file \"%s\"...\n", inputFileName, outputFileName);
+		startTime = statsClock();
+		convertCsvFile(inputFileName, outputFileName, options->hashAlgorithm, options->dictionary);
+		addStageTime("convert", startTime, 1, 0);
+		printDebug("Done.\n");
+		return;
+	}
 	
 	/**
-	 * Remove and duplicate shingles:
+	 * In streaming mode, the input is read, shingled and written a chunk at a time, and none of the steps below are used:
 	 */
-	printDebug("\n >Removing any duplicate shingles...\n");
-	removeDuplicates(shingleList);
-	printDebug("Done.\n");
+	if(options->streamInput == true) {
+		printDebug("\n >Streaming shingles from File \"%s\" to File \"%s\", using a shingle size of %d...\n", inputFileName, outputFileName, shingleSize);
+		startTime = statsClock();
+		streamShingles(options);
+		addStageTime("stream", startTime, 1, 0);
+		printDebug("Done.\n");
+		return;
+	}
+	
+	/**
+	 * Read the text file into rawText:
+	 */
+	printDebug("\n >Opening File \"%s\"...\n", inputFileName);
+	rawText = readTextFile(inputFileName, &rawLength);
+	printDebug("\n >The text contained in the text file is:\n");
+	printDebug("%s\n", rawText);
 	
 	/**
-	 * Write out all the shingles stored in shingleList to a comma-delimited text file:
+	 * Split rawText into words and form the shingles. For a binary shingle file they are hashed, sorted and de-duplicated
+	 * by the similarity library; otherwise they are written straight into delimitedText, removing duplicates in the same pass
+	 * (which is also where they are interned from with -dict):
 	 */
-	printDebug("\n >Writing comma-delimited text to File \"%s\"...\n", outputFileName);
-	delimitedText = commaDelimitArray(shingleList);
-	writeTextFile(outputFileName, delimitedText);
+	printDebug("\n >Shingle-izing the text, using a shingle size of %d...\n", shingleSize);
+	startTime = statsClock();
+	if(options->binaryOutput == true && options->dictionary == NULL) {
+		arena = createArena(0);
+		if(arena != NULL && options->characterShingles == true) {
+			shingles = shingleCharacters(arena, rawText, rawLength, (uint32_t)shingleSize);
+		} else {
+			shingles = (arena != NULL) ? shingleBuffer(arena, rawText, rawLength, (uint32_t)shingleSize, options->hashAlgorithm) : NULL;
+		}
+		if(shingles == NULL) {
+			printf("\nERROR: Unable to allocate memory for the shingle hashes!\n");
+			exit(1);
+		}
+		countAllocation(arena->reservedBytes);
+		addCounter("distinctHashes", shingles->count);
+	} else {
+		shingleCount = shingleText(rawText, rawLength, shingleSize, &delimitedText);
+	}
+	addStageTime("shingle", startTime, (shingles != NULL) ? shingles->count : shingleCount, (uint64_t)rawLength); //Tokenizing, forming and hashing the shingles are one pass, so they are timed together
 	printDebug("Done.\n");
 	
-	printDebug("\n >The comma-delimited text is:\n");
-	printDebug("%s\n", delimitedText);
+	/**
+	 * Write out the shingles, either as their sorted hashes in a binary shingle file, or as comma-delimited text:
+	 */
+	if(options->dictionary != NULL) {
+		printDebug("\n >Writing shingle ids to binary File \"%s\"...\n", outputFileName);
+		writeIdFile(options->dictionary, delimitedText.data, delimitedText.length, outputFileName, (uint32_t)shingleSize);
+		printDebug("Done.\n");
+	} else if(options->binaryOutput == true) {
+		printDebug("\n >Writing hashed shingles to binary File \"%s\"...\n", outputFileName);
+		startTime = statsClock();
+		writeShingleFile(outputFileName, shingles->hashes, shingles->count, shingleSize, shingles->shingleUnit, options->hashAlgorithm);
+		addStageTime("write", startTime, 1, shingles->count * sizeof(uint64_t));
+		printDebug("Done.\n");
+	} else {
+		printDebug("\n >Writing comma-delimited text to File \"%s\"...\n", outputFileName);
+		startTime = statsClock();
+		writeTextFile(outputFileName, delimitedText.data, delimitedText.length);
+		addStageTime("write", startTime, 1, (uint64_t)delimitedText.length);
+		printDebug("Done.\n");
+		
+		printDebug("\n >The comma-delimited text is:\n");
+		printDebug("%s\n", delimitedText.data);
+	}
 	
 	/**
 	 * Free all memory allocated with malloc():
@@ -101,88 +325,387 @@ int main(int argc, char* argv[]) {
 	printDebug("\n >Freeing program memory...\n");
 	free(rawText);
 	rawText = NULL;
-	free(delimitedText);
-	delimitedText = NULL;
-	deleteList(tokenList);
-	tokenList = NULL;
-	deleteList(shingleList);
-	shingleList = NULL;
+	free(delimitedText.data);
+	delimitedText.data = NULL;
+	deleteArena(arena);
+	arena = NULL;
 	printDebug("Memory freed successfully.\n");
+}
+
+/**
+ * Shingles every file named by options->batchSource, which is a directory (every regular file in it), a wildcard
+ * pattern such as "texts\*.txt" (matched against the file names in its directory), or otherwise a manifest file
+ * listing one input file per line. Each output is named after its input, with the extension replaced by ".csv"
+ * (or ".bin" with -b or -convert), and written to options->outputDirectory or, if that is NULL, beside its input.
+ * The files are shared out among options->threadCount worker threads (one per processor if 0), and each is
+ * processed exactly as a single input with the same flags would be.
+ */
+void shingleBatch(const ShingleOptions* options) {
+	ShingleBatch batch;
+	pthread_t* workers = NULL;
+	int threadCount = (options->threadCount > 0) ? options->threadCount : processorCount();
+	double startTime = 0.0, elapsedTime = 0.0;
+	int i;
 	
-	printDebug("\nPROGRAM COMPLETE\n\n");
+	memset(&batch, 0, sizeof(batch));
+	batch.options = options;
+	batch.fileCount = listBatchInputs(options->batchSource, &batch.inputFileNames);
+	if(batch.fileCount == 0) {
+		printf("\nERROR: No input files were found for batch \"%s\"!\n", options->batchSource);
+		exit(1);
+	}
+	batch.outputFileNames = malloc(batch.fileCount * sizeof(char*));
+	if(batch.outputFileNames == NULL) {
+		printf("\nERROR: Unable to allocate memory for the batch file names!\n");
+		exit(1);
+	}
+	for(i = 0; i < batch.fileCount; i++) {
+		batch.outputFileNames[i] = batchOutputName(batch.inputFileNames[i], options->outputDirectory, options->binaryOutput == true || options->convertInput == true);
+		if(strcmp(batch.outputFileNames[i], batch.inputFileNames[i]) == 0) {
+			printf("\nERROR: The output for \"%s\" would overwrite it; use -outdir to write the outputs elsewhere!\n", batch.inputFileNames[i]);
+			exit(1);
+		}
+	}
+	checkBatchOutputNames(&batch);
+	if(threadCount > batch.fileCount) {
+		threadCount = batch.fileCount;
+	}
+	printDebug("\n >Shingling a batch of %d files on %d threads...\n", batch.fileCount, threadCount);
 	
-	return 0;
+	pthread_mutex_init(&batch.lock, NULL);
+	workers = malloc(threadCount * sizeof(pthread_t));
+	if(workers == NULL) {
+		printf("\nERROR: Unable to allocate memory for the worker threads!\n");
+		exit(1);
+	}
+	startTime = wallClockSeconds();
+	for(i = 0; i < threadCount; i++) {
+		if(pthread_create(&workers[i], NULL, runBatchWorker, &batch) != 0) {
+			printf("\nERROR: Unable to start worker thread %d!\n", i);
+			exit(1);
+		}
+	}
+	for(i = 0; i < threadCount; i++) {
+		pthread_join(workers[i], NULL);
+	}
+	elapsedTime = wallClockSeconds() - startTime;
+	pthread_mutex_destroy(&batch.lock);
+	
+	if(elapsedTime <= 0.0) {
+		elapsedTime = 1e-9; //Guards the rates below against a batch too small for the clock to measure
+	}
+	printf("Shingled %d files (%.2f MB) in %.3f seconds on %d thread%s: %.1f files/s, %.2f MB/s\n", batch.fileCount, batch.totalBytes / 1e6, elapsedTime, threadCount, (threadCount == 1) ? "" : "s", batch.fileCount / elapsedTime, batch.totalBytes / 1e6 / elapsedTime);
+	
+	for(i = 0; i < batch.fileCount; i++) {
+		free(batch.inputFileNames[i]);
+		free(batch.outputFileNames[i]);
+	}
+	free(batch.inputFileNames);
+	free(batch.outputFileNames);
+	free(workers);
+}
+
+void* runBatchWorker(void* argument) { /** Sub-function of shingleBatch, the body of each worker thread **/
+	ShingleBatch* batch = argument;
+	ShingleOptions fileOptions = *batch->options;
+	struct stat fileInfo;
+	uint64_t bytesRead = 0;
+	int file;
+	
+	while(true) {
+		pthread_mutex_lock(&batch->lock);
+		file = batch->nextFile++;
+		pthread_mutex_unlock(&batch->lock);
+		if(file >= batch->fileCount) {
+			break;
+		}
+		
+		fileOptions.inputFileName = batch->inputFileNames[file];
+		fileOptions.outputFileName = batch->outputFileNames[file];
+		if(stat(fileOptions.inputFileName, &fileInfo) == 0) {
+			bytesRead += (uint64_t)fileInfo.st_size;
+		}
+		processFile(&fileOptions);
+	}
+	
+	pthread_mutex_lock(&batch->lock);
+	batch->totalBytes += bytesRead;
+	pthread_mutex_unlock(&batch->lock);
+	return NULL;
 }
 
-void interpretConsoleFlags(int argc, char* argv[], char** inputFileName, char** outputFileName, int* shingleSize) {
+/**
+ * Fills *fileNames with a newly allocated array of the input files named by source (see shingleBatch()),
+ * each in its own allocation, and returns how many there are. Files found in a directory are sorted by name.
+ */
+int listBatchInputs(const char* source, char*** fileNames) {
+	struct stat sourceInfo;
+	int count = 0, capacity = 0;
+	
+	*fileNames = NULL;
+	if(stat(source, &sourceInfo) == 0 && S_ISDIR(sourceInfo.st_mode)) {
+		listDirectory(source, NULL, fileNames, &count, &capacity);
+	} else if(strpbrk(source, "*?") != NULL) {
+		const char* separator = lastPathSeparator(source);
+		if(separator == NULL) {
+			listDirectory(".", source, fileNames, &count, &capacity);
+		} else {
+			size_t directoryLength = (size_t)(separator - source);
+			char* directory = malloc(directoryLength + 2);
+			if(directory == NULL) {
+				printf("\nERROR: Unable to allocate memory for the batch file names!\n");
+				exit(1);
+			}
+			memcpy(directory, source, directoryLength);
+			directory[directoryLength] = '\0';
+			if(directoryLength == 0) { //The pattern is in the root directory
+				strcpy(directory, "/");
+			}
+			listDirectory(directory, separator + 1, fileNames, &count, &capacity);
+			free(directory);
+		}
+	} else {
+		size_t manifestLength = 0;
+		char* manifest = readTextFile(source, &manifestLength);
+		char* line = manifest;
+		while(*line != '\0') {
+			char* lineEnd = line + strcspn(line, "\r\n");
+			char lineTerminator = *lineEnd;
+			*lineEnd = '\0';
+			if(*line != '\0') { //Blank lines are skipped
+				addFileName(fileNames, &count, &capacity, NULL, line);
+			}
+			if(lineTerminator == '\0') {
+				break;
+			}
+			line = lineEnd + 1;
+		}
+		free(manifest);
+	}
+	return count;
+}
+
+void listDirectory(const char* directory, const char* pattern, char*** fileNames, int* count, int* capacity) { /** Sub-function of listBatchInputs, adds the regular files in directory whose names match pattern (all of them if pattern is NULL) **/
+	DIR* listing = opendir(directory);
+	struct dirent* entry = NULL;
+	struct stat entryInfo;
+	int firstFile = *count;
+	
+	if(listing == NULL) {
+		printf("\nERROR: Directory \"%s\" not found!\n", directory);
+		exit(1);
+	}
+	while((entry = readdir(listing)) != NULL) {
+		if(pattern != NULL && matchesPattern(pattern, entry->d_name) == false) {
+			continue;
+		}
+		addFileName(fileNames, count, capacity, directory, entry->d_name);
+		if(stat((*fileNames)[*count - 1], &entryInfo) != 0 || S_ISREG(entryInfo.st_mode) == false) { //Skip ".", ".." and any sub-directories
+			free((*fileNames)[--(*count)]);
+		}
+	}
+	closedir(listing);
+	
+	qsort(*fileNames + firstFile, *count - firstFile, sizeof(char*), compareFileNames); //readdir() returns the files in no particular order
+}
+
+void addFileName(char*** fileNames, int* count, int* capacity, const char* directory, const char* name) { /** Sub-function of listBatchInputs, appends directory/name (or just name if directory is NULL) **/
+	size_t directoryLength = (directory != NULL) ? strlen(directory) : 0;
+	size_t nameLength = strlen(name);
+	char* fileName = malloc(directoryLength + nameLength + 2);
+	
+	if(*count == *capacity) {
+		*capacity = (*capacity > 0) ? *capacity * 2 : 64;
+		*fileNames = realloc(*fileNames, *capacity * sizeof(char*));
+	}
+	if(fileName == NULL || *fileNames == NULL) {
+		printf("\nERROR: Unable to allocate memory for the batch file names!\n");
+		exit(1);
+	}
+	memcpy(fileName, directory, directoryLength);
+	if(directoryLength > 0 && directory[directoryLength - 1] != '/' && directory[directoryLength - 1] != '\\') {
+		fileName[directoryLength++] = '/'; //Accepted as a separator on Windows too
+	}
+	memcpy(fileName + directoryLength, name, nameLength + 1);
+	(*fileNames)[(*count)++] = fileName;
+}
+
+int matchesPattern(const char* pattern, const char* name) { /** Sub-function of listBatchInputs, returns true if name matches a pattern where '*' is any run of characters and '?' any one character **/
+	const char* starPattern = NULL; //Position just after the most recent '*', and the part of name it has been matched against so far
+	const char* starName = NULL;
+	
+	while(*name != '\0') {
+		if(*pattern == '*') {
+			starPattern = ++pattern;
+			starName = name;
+		} else if(*pattern == '?' || *pattern == *name) {
+			pattern++;
+			name++;
+		} else if(starPattern != NULL) { //Backtrack, letting the most recent '*' absorb one more character
+			pattern = starPattern;
+			name = ++starName;
+		} else {
+			return false;
+		}
+	}
+	while(*pattern == '*') {
+		pattern++;
+	}
+	return (*pattern == '\0') ? true : false;
+}
+
+const char* lastPathSeparator(const char* path) { /** Returns the last '/' or '\' in path, or NULL if there is none **/
+	const char* forward = strrchr(path, '/');
+	const char* backward = strrchr(path, '\\');
+	return (forward > backward) ? forward : backward;
+}
+
+int compareFileNames(const void* a, const void* b) { /** qsort() comparator for char* file names **/
+	return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/**
+ * Returns a newly allocated output file name for inputFileName: its base name with the extension replaced by
+ * ".bin" if binaryOutput is true or ".csv" otherwise, in outputDirectory or, if that is NULL, the input's own directory.
+ */
+char* batchOutputName(const char* inputFileName, const char* outputDirectory, int binaryOutput) {
+	const char* separator = lastPathSeparator(inputFileName);
+	const char* baseName = (separator != NULL) ? separator + 1 : inputFileName;
+	const char* extension = strrchr(baseName, '.');
+	size_t baseLength = (extension != NULL && extension != baseName) ? (size_t)(extension - baseName) : strlen(baseName); //A leading '.' does not start an extension
+	size_t directoryLength = 0;
+	char* outputFileName = NULL;
+	
+	if(outputDirectory == NULL) {
+		outputDirectory = inputFileName;
+		directoryLength = (size_t)(baseName - inputFileName); //Includes the separator, if there is one
+	} else {
+		directoryLength = strlen(outputDirectory);
+	}
+	outputFileName = malloc(directoryLength + baseLength + 6);
+	if(outputFileName == NULL) {
+		printf("\nERROR: Unable to allocate memory for the batch file names!\n");
+		exit(1);
+	}
+	memcpy(outputFileName, outputDirectory, directoryLength);
+	if(directoryLength > 0 && outputFileName[directoryLength - 1] != '/' && outputFileName[directoryLength - 1] != '\\') {
+		outputFileName[directoryLength++] = '/';
+	}
+	memcpy(outputFileName + directoryLength, baseName, baseLength);
+	strcpy(outputFileName + directoryLength + baseLength, (binaryOutput == true) ? ".bin" : ".csv");
+	return outputFileName;
+}
+
+void checkBatchOutputNames(const ShingleBatch* batch) { /** Sub-function of shingleBatch, exits if two inputs (e.g. "a.txt" and "a.md") would be written to the same output **/
+	char** sortedNames = malloc(batch->fileCount * sizeof(char*));
+	int i;
+	
+	if(sortedNames == NULL) {
+		printf("\nERROR: Unable to allocate memory for the batch file names!\n");
+		exit(1);
+	}
+	memcpy(sortedNames, batch->outputFileNames, batch->fileCount * sizeof(char*));
+	qsort(sortedNames, batch->fileCount, sizeof(char*), compareFileNames);
+	for(i = 1; i < batch->fileCount; i++) {
+		if(strcmp(sortedNames[i - 1], sortedNames[i]) == 0) {
+			printf("\nERROR: More than one input file would be written to \"%s\"!\n", sortedNames[i]);
+			exit(1);
+		}
+	}
+	free(sortedNames);
+}
+
+void interpretConsoleFlags(int argc, char* argv[], ShingleOptions* options) {
 	if(argc > 1) { //If the user entered any of the optional flags
+		int hashChosen = false;
 		int i;
 		for(i = 1; i < argc; i++) {
 			if(strcmp(argv[i], "-help") == 0) {
 				printHelpText();
 				exit(0);
 			} else if(strcmp(argv[i], "-i") == 0) { //If the user manually specified an input file name
-				*inputFileName = argv[i + 1];
+				options->inputFileName = argv[i + 1];
 			} else if(strcmp(argv[i], "-o") == 0) { //If the user manually specified an output file name
-				*outputFileName = argv[i + 1];
+				options->outputFileName = argv[i + 1];
 			} else if(strcmp(argv[i], "-s") == 0) { //If the user manually specified the shingle size to use
-				*shingleSize = atoi(argv[i + 1]);
-				if(*shingleSize < 1) {
+				options->shingleSize = atoi(argv[i + 1]);
+				if(options->shingleSize < 1) {
 					printf("\nERROR: You must enter a shingle size of at least 1!\n");
 					exit(1);
 				}
+			} else if(strcmp(argv[i], "-b") == 0) { //If the user wants a binary shingle file instead of comma-delimited text
+				options->binaryOutput = true;
+			} else if(strcmp(argv[i], "-convert") == 0) { //If the input is a comma-delimited shingle file to be converted to a binary one
+				options->convertInput = true;
+			} else if(strcmp(argv[i], "-stream") == 0) { //If the input should be shingled a chunk at a time, in constant memory
+				options->streamInput = true;
+			} else if(strcmp(argv[i], "-chars") == 0) { //If -s counts characters rather than words
+				options->characterShingles = true;
+			} else if(strcmp(argv[i], "-batch") == 0) { //If the user wants to shingle every file in a directory, matching a pattern, or listed in a manifest
+				options->batchSource = argv[i + 1];
+			} else if(strcmp(argv[i], "-outdir") == 0) { //If the user chose where batch outputs are written
+				options->outputDirectory = argv[i + 1];
+			} else if(strcmp(argv[i], "-j") == 0) { //If the user chose how many worker threads a batch uses
+				options->threadCount = (i + 1 < argc) ? atoi(argv[i + 1]) : 0;
+				if(options->threadCount < 1) {
+					printf("\nERROR: You must enter a thread count of at least 1!\n");
+					exit(1);
+				}
+			} else if(strcmp(argv[i], "-hash") == 0) { //If the user chose the algorithm that shingles are hashed with
+				int hashAlgorithm = (i + 1 < argc) ? parseHashAlgorithm(argv[i + 1]) : -1;
+				if(hashAlgorithm < 0) {
+					printf("\nERROR: The hash algorithm must be \"xxh64\", \"rolling\" or \"legacy\"!\n");
+					exit(1);
+				}
+				options->hashAlgorithm = (uint32_t)hashAlgorithm;
+				hashChosen = true;
+			} else if(strcmp(argv[i], "-dict") == 0) { //If the user wants shingles given ids from a dictionary rather than hashed
+				if(i + 1 >= argc) {
+					printf("\nERROR: You must enter a name for the dictionary file!\n");
+					exit(1);
+				}
+				options->dictionaryName = argv[i + 1];
+			} else if(strcmp(argv[i], "-stats") == 0) { //If the user wants the time spent in each stage written to a JSON file
+				if(i + 1 >= argc) {
+					printf("\nERROR: You must enter a name for the statistics file!\n");
+					exit(1);
+				}
+				options->statsFileName = argv[i + 1];
 			} else if(strcmp(argv[i], "-d") == 0) { //If the user enabled the verbose debug messages
 				debugFlag = true;
 			}
 		}
+		
+		if(options->characterShingles == true) { //Character shingles are only ever hashed, with the one algorithm that can roll over them
+			if(options->binaryOutput == false || options->convertInput == true || options->streamInput == true) {
+				printf("\nERROR: -chars can only be used with -b, and not with -convert or -stream!\n");
+				exit(1);
+			}
+			if(hashChosen == true && options->hashAlgorithm != HASH_ROLLING) {
+				printf("\nERROR: -chars can only be used with the \"rolling\" hash algorithm!\n");
+				exit(1);
+			}
+			options->hashAlgorithm = HASH_ROLLING;
+		}
+		if(options->dictionaryName != NULL) { //Ids are given to whole shingles, so they are formed as text, the way -b -stream and -chars never do
+			if((options->binaryOutput == false && options->convertInput == false) || options->streamInput == true || options->characterShingles == true) {
+				printf("\nERROR: -dict can only be used with -b or -convert, and not with -stream or -chars!\n");
+				exit(1);
+			}
+			if(hashChosen == true) {
+				printf("\nERROR: -dict cannot be used with -hash, since the shingles are given ids rather than hashed!\n");
+				exit(1);
+			}
+			options->hashAlgorithm = HASH_DICTIONARY;
+		}
 	}
 }
 
-void printDebug(char* debugText, ...) { /**Wraps printf(), calling it only if global variable debugFlag is true **/
+void printDebug(const char* debugText, ...) { /**Wraps printf(), calling it only if global variable debugFlag is true **/
 	if(debugFlag == true) {
 		va_list args; //Set up our variable argument's data structure
 		va_start(args, debugText); //The variable argument "starts" right after our last finite argument, which is *debugText
-		
-		char* character = "%";
-		
-		char* subString = NULL;
-		char* position = debugText; //This variable will point to characters in the middle of debugText, serving as the start of any remaining unprocessed text
-		int subStrLength = 0;
-		
-		while(position[0] != '\0') {
-			//Get the length of the string preceding the character '%' if there is one, else the total length remaining:
-			subStrLength = strcspn(position, character);
-			
-			//Copy the contents of the sub-string we just found into a buffer, which will be printed later
-			subString = malloc(sizeof(char) * subStrLength + 1);
-			strncpy(subString, position, subStrLength);
-			subString[subStrLength] = '\0';
-			
-			//Point position to the first character after the sub-string we just found:
-			position += subStrLength;
-			
-			printf(subString);
-			
-			//If a print directive is present, determine its type, print the appropriate variable argument, and consume the directive:
-			if(position[0] == '%') { 
-				if(position[1] == 'c') {
-					printf("%c", va_arg(args, unsigned int)); //For %c
-					position += 2;
-				} else if(position[1] == 's') {
-					printf("%s", va_arg(args, unsigned int)); //For %s
-					position += 2;
-				} else if(position[1] == 'd') {
-					printf("%d", va_arg(args, signed int*)); //For %d
-					position += 2;
-				} else if(position[1] == 'p') {
-					printf("%p", va_arg(args, void*)); //For %p
-					position += 2;
-				} else {//This accounts for an edge case where a string contains a % with no valid following type character
-					position++; //Skip the lone %
-				}
-			}
-		}
-		
+		vprintf(debugText, args);
 		va_end(args); //Clean up the variable argument's data structure
 	}
 }
@@ -201,128 +724,219 @@ void printHelpText() {
 	printf("\n-o\tSpecifies the name of the file to be read as OUTPUT and written to. The default is \"output.txt\"\n");
 	printf("\tUsage:\t\"project1 -o filename.txt\"\n");
 	
-	printf("\n-s\tSets the size, in words, of each shingle outputted by the program.\n");
+	printf("\n-s\tSets the size, in words (or characters, with -chars), of each shingle outputted by the program.\n");
 	printf("\tUsage:\t\"project1 -s 5\"\n");
 	
+	printf("\n-b\tWrites the sorted hashes of the shingles to a binary shingle file, which jaccard can read without parsing it.\n");
+	printf("\tUsage:\t\"project1 -b\"\n");
+	
+	printf("\n-chars\tMakes each shingle a run of characters rather than words, with each run of delimiters read as one space.\n");
+	printf("\tThe shingles are hashed with \"rolling\", which takes the same time per character however large -s is. Needs -b.\n");
+	printf("\tUsage:\t\"project1 -b -chars -s 9\"\n");
+	
+	printf("\n-convert\tTreats the INPUT file as an existing comma-delimited shingle file, and converts it to a binary shingle file.\n");
+	printf("\tBinary files only hold hashes, so they cannot be converted back to text.\n");
+	printf("\tUsage:\t\"project1 -convert -i shingles.csv -o shingles.bin\"\n");
+	
+	printf("\n-stream\tReads the INPUT file a chunk at a time and writes each shingle as soon as it is formed, so memory use stays\n");
+	printf("\tthe same however large the INPUT is. Duplicate shingles are kept in comma-delimited output (jaccard ignores them);\n");
+	printf("\twith -b they are removed by sorting the hashes in runs on disk.\n");
+	printf("\tUsage:\t\"project1 -stream -i huge.txt -o shingles.csv\"\n");
+	
+	printf("\n-hash\tChooses the algorithm that -b and -convert hash shingles with, which is recorded in the binary shingle file.\n");
+	printf("\t\"xxh64\" (the default) is a fast 64-bit hash. \"legacy\" is the original hash, which only has 104729 possible\n");
+	printf("\tvalues, so unrelated shingles often collide; use it only to reproduce older results. \"rolling\" hashes each word\n");
+	printf("\tonce and slides a polynomial over them, so -b never assembles the shingles and large -s costs no more.\n");
+	printf("\tUsage:\t\"project1 -b -hash legacy\"\n");
+	
+	printf("\n-dict\tGives each shingle an id from a dictionary file shared by the whole corpus, and writes the sorted ids to the\n");
+	printf("\tbinary shingle file in place of hashes. Ids never collide, so jaccard's similarities are exact, and take half the\n");
+	printf("\tspace of hashes. The dictionary is created if it does not exist, and new shingles are appended to it, so files\n");
+	printf("\twritten against it earlier stay valid. Each file records which dictionary it was written against, and jaccard\n");
+	printf("\trefuses to compare files from different dictionaries. Needs -b or -convert.\n");
+	printf("\tUsage:\t\"project1 -b -dict corpus.dict\"\n");
+	
+	printf("\n-batch\tShingles many files in one run, on a pool of worker threads, in place of -i and -o. The files are named by\n");
+	printf("\ta directory (every file in it), a quoted wildcard pattern, or otherwise a manifest file listing one file per line.\n");
+	printf("\tEach output is named after its input with the extension replaced by .csv (or .bin with -b or -convert).\n");
+	printf("\tAll other flags apply to every file. The number of files and megabytes per second is printed at the end.\n");
+	printf("\tUsage:\t\"project1 -batch \"texts/*.txt\" -outdir shingles -b -j 8\"\n");
+	
+	printf("\n-outdir\tSpecifies the directory -batch writes its outputs to. By default each output is written beside its input.\n");
+	printf("\tUsage:\t\"project1 -batch manifest.txt -outdir shingles\"\n");
+	
+	printf("\n-j\tSets the number of worker threads -batch uses. The default is one per processor.\n");
+	printf("\tUsage:\t\"project1 -batch texts -j 4\"\n");
+	
+	printf("\n-stats\tWrites the time spent reading, shingling, de-duplicating and writing, the allocations made for file data,\n");
+	printf("\tand the peak memory use, to a JSON file. Nothing is measured without it.\n");
+	printf("\tUsage:\t\"project1 -b -stats stats.json\"\n");
+	
 	printf("\n-d\tPrints out additional debug information as the program runs (a LOT of it).\n");
 	printf("\tUsage:\t\"project1 -d\"\n");
 }
 
-char* readTextFile(const char* fileName) {
-	FILE* textFile = NULL;
-	int fileLength = 0; //In bytes
-	char* textBuffer = NULL;
-	
-	textFile = fopen(fileName, "rb");
-	if (textFile == NULL) {
-		printf("\nERROR: File \"%s\" not found!\n", fileName);
-		exit(1);
-	}
-	
-	fseek(textFile, 0, SEEK_END); //Set the file position indicator to the end of the file
-	fileLength = ftell(textFile); //get the value of the file position indicator, which now represents the length of the file
-	
+char* readTextFile(const char* fileName, size_t* textLength) {
+	double startTime = statsClock();
 	printDebug("\n >Reading from file...\n"); //<DEBUG>
-	printDebug("The file is %d bytes long.\n", fileLength); //<DEBUG>
 	
-	textBuffer = malloc(fileLength * sizeof(char) + 1); //Allocate enough buffer space for the text file, plus a terminating zero
-	if (textBuffer == NULL) {
-		fclose(textFile);
+	char* textBuffer = readWholeFile(fileName, textLength);
+	if(textBuffer == NULL) {
+		printf("\nERROR: File \"%s\" not found!\n", fileName);
 		exit(1);
 	}
+	countAllocation((uint64_t)*textLength + 1);
+	addStageTime("read", startTime, 1, (uint64_t)*textLength);
+	*textLength = textLengthToNul(textBuffer, *textLength); //A zero byte ends the text, as it did when words were split with strtok()
 	
-	fseek(textFile, 0, SEEK_SET); //Set the file position indicator back to the beginning of the file
-	fread(textBuffer, sizeof(char), fileLength, textFile);
-	textBuffer[fileLength] = '\0';
-	
-	fclose(textFile);
+	printDebug("The file is %d bytes long.\n", (int)*textLength); //<DEBUG>
 	printDebug("File \"%s\" read successfully.\n", fileName);
-	
 	return textBuffer;
 }
 
-List* tokenizeString(char* inputString, const char* delimiters) {
-	List* outputStorage = createList(ARRAY_LIST);
-	char* temp = strtok(inputString, delimiters); //strtok returns a pointer to a position *INSIDE* inputString! Not a new copy!
-	char* tempCopy = malloc(sizeof(char) * strlen(temp) + 1); //Therefore, we need to make a new copy if we want to treat inputString as immutable
-	strcpy(tempCopy, temp);
-	addToList(outputStorage, tempCopy);
+/**
+ * The whole shingling pipeline in a single pass over text. Words are found by the tokenizer, which classifies the
+ * text against SHINGLE_DELIMITERS a block at a time (giving exactly the words strtok() would), and are kept as
+ * views into text rather than copied.
+ * Once shingleSize words have been seen, each new word completes a shingle, which is written straight into output
+ * with its words separated by spaces and comma-separated from the one before. If the ShingleTable shows it was
+ * already written, output is simply cut back to where it was, so only first occurrences remain, in their original
+ * order. Binary shingle files are hashed by shingleBuffer() in the similarity library instead, which splits words the same way.
+ */
+uint64_t shingleText(const char* text, size_t textLength, int shingleSize, TextBuffer* output) { /** Returns the number of distinct shingles written **/
+	DelimiterSet delimiters;
+	Tokenizer tokenizer;
+	WordView* window = malloc(shingleSize * sizeof(WordView)); //Ring buffer of the most recent words
+	WordView word;
+	ShingleTable seenShingles = {NULL, 0, 0};
+	size_t wordStart = 0;
+	size_t rollback = 0;
+	size_t shingleStart = 0;
+	int windowStart = 0; //Index of the oldest word in window
+	int windowCount = 0;
+	int j;
 	
-	while((temp = strtok(NULL, delimiters)) != NULL) {
-		tempCopy = malloc(sizeof(char) * strlen(temp) + 1);
-		strcpy(tempCopy, temp);
-		addToList(outputStorage, tempCopy);
+	initDelimiterSet(&delimiters, SHINGLE_DELIMITERS);
+	beginTokens(&tokenizer, &delimiters, text, textLength);
+	seenShingles.capacity = initialTableCapacity;
+	seenShingles.slots = calloc(seenShingles.capacity, sizeof(ShingleSlot));
+	appendText(output, "", 0); //Makes sure output has a buffer (and a terminating zero) even if there are no shingles
+	if(window == NULL || seenShingles.slots == NULL) {
+		printf("\nERROR: Unable to allocate memory for shingling the text!\n");
+		exit(1);
 	}
-	return outputStorage;
-}
-
-List* computeShingles(List* inputList, int groupSize) {
-	List* output = createList(ARRAY_LIST);
-	char* shingle = NULL;
-	int i, j, strSize;
 	
-	for(i = 0; i < listSize(inputList) - (groupSize - 1); i++) { //The final grouping will *begin* at element number [numItems - (groupSize - 1)]
-		strSize = 0;
-		for(j = 0; j < groupSize; j++) { //Calculate the size of the new String we will need
-			strSize += strlen(getFromList(inputList, i + j)); 
-		}
-		strSize += groupSize + 1; //Make the size larger to accommodate for spaces between words and a terminating zero
+	while(nextToken(&tokenizer, &wordStart, &word.length) == true) {
+		word.start = text + wordStart;
 		
-		shingle = calloc(strSize, sizeof(char));
+		if(windowCount == shingleSize) { //The window is full, so the oldest word drops out
+			window[windowStart] = word;
+			windowStart = (windowStart + 1) % shingleSize;
+		} else {
+			window[windowCount++] = word;
+		}
+		if(windowCount < shingleSize) {
+			continue;
+		}
 		
-		for(j = 0; j < groupSize; j++) { //Append our words to form the shingle, adding spaces after each word
-			strcat(shingle, (char*)getFromList(inputList, i + j));
-			strcat(shingle, " ");
+		rollback = output->length; //Where output is cut back to if this shingle is not kept
+		if(output->length > 0) {
+			appendText(output, ",", 1);
 		}
-		shingle[strSize - 2] = '\0'; //Replace the final space with a terminating zero
+		shingleStart = output->length;
+		for(j = 0; j < shingleSize; j++) {
+			const WordView* windowWord = &window[(windowStart + j) % shingleSize];
+			if(j > 0) {
+				appendText(output, " ", 1);
+			}
+			appendText(output, windowWord->start, windowWord->length);
+		}
+		output->data[output->length] = '\0';
 		
-		addToList(output, shingle);
+		if(addToShingleTable(&seenShingles, output, shingleStart, output->length - shingleStart) == false) {
+			output->length = rollback;
+		}
 	}
+	output->data[output->length] = '\0';
 	
-	return output;
+	free(seenShingles.slots);
+	free(window);
+	return seenShingles.count;
 }
 
-void removeDuplicates(List* inputList) {
-	char* currentItem = NULL;
-	int i, k;
+int addToShingleTable(ShingleTable* table, const TextBuffer* buffer, size_t offset, size_t length) { /** Sub-function of shingleText, returns true if the shingle was not already in the table **/
+	uint32_t hash = hashShingle(buffer->data + offset, length);
+	uint32_t mask = table->capacity - 1;
+	uint32_t slot = hash & mask;
 	
-	for(i = 0; i < listSize(inputList); i++) {
-		currentItem = getFromList(inputList, i);
-		for(k = i + 1; k < listSize(inputList); k++) { //Iterate through every element after currentItem
-			if(strcmp(currentItem, getFromList(inputList, k)) == 0) { //If an element is found that is identical to currentItem, it needs to be removed
-				removeFromList(inputList, k);
-				k--; //The contents of the list have shifted left, re-check this index
-			}
+	while(table->slots[slot].length != 0) { //Linear probing: walk forward until we find either the shingle or an empty slot
+		if(table->slots[slot].hash == hash && table->slots[slot].length == length && memcmp(buffer->data + table->slots[slot].offset, buffer->data + offset, length) == 0) {
+			return false;
 		}
+		slot = (slot + 1) & mask;
 	}
+	
+	table->slots[slot].offset = offset;
+	table->slots[slot].length = (uint32_t)length;
+	table->slots[slot].hash = hash;
+	table->count++;
+	if(table->count * 2 > table->capacity) { //Keep the load factor at or below 50%, so probe sequences stay short
+		growShingleTable(table);
+	}
+	return true;
 }
 
-char* commaDelimitArray(List* inputList) {
-	int strSize = computeSizeOfContents(inputList) + listSize(inputList) + 1; //Allocate enough space to hold all the items, as well as a comma for each, plus the null-terminator
-	char* delimitedString = calloc(strSize, sizeof(char));
-	int i;
+void growShingleTable(ShingleTable* table) { /** Sub-function of addToShingleTable, doubles the number of slots **/
+	ShingleSlot* oldSlots = table->slots;
+	uint32_t oldCapacity = table->capacity;
+	uint32_t i, slot;
 	
-	for(i = 0; i < listSize(inputList); i++) {
-		strcat(delimitedString, (char*)getFromList(inputList, i));
-		strcat(delimitedString, ",");
+	table->capacity *= 2;
+	table->slots = calloc(table->capacity, sizeof(ShingleSlot));
+	if(table->slots == NULL) {
+		printf("\nERROR: Unable to re-allocate memory for the shingle table!\n");
+		exit(1);
 	}
-	delimitedString[strSize - 2] = '\0';
-	
-	return delimitedString;
+	for(i = 0; i < oldCapacity; i++) { //Re-insert every shingle, reusing its stored hash
+		if(oldSlots[i].length != 0) {
+			slot = oldSlots[i].hash & (table->capacity - 1);
+			while(table->slots[slot].length != 0) {
+				slot = (slot + 1) & (table->capacity - 1);
+			}
+			table->slots[slot] = oldSlots[i];
+		}
+	}
+	free(oldSlots);
 }
 
-int computeSizeOfContents(List* inputList) { /** Sub-function of commaDelimitArray to get the number of bytes used by all strings in a given List (minus null-terminators) **/
-	int size = 0;
-	int i;
-	for(i = 0; i < listSize(inputList); i++) {
-		size += strlen((char*)getFromList(inputList, i));
+uint32_t hashShingle(const char* shingle, size_t length) { /** Sub-function of addToShingleTable, FNV-1a hash of a shingle **/
+	uint32_t h = 2166136261U;
+	size_t i;
+	for(i = 0; i < length; i++) {
+		h ^= (unsigned char)shingle[i];
+		h *= 16777619U;
 	}
-	return size;
+	return h;
 }
 
-void writeTextFile(const char* fileName, char* text) {
+void appendText(TextBuffer* buffer, const char* text, size_t length) { /** Sub-function of shingleText, appends to a TextBuffer, growing it as needed **/
+	if(buffer->length + length + 1 > buffer->capacity) { //Always leave room for a terminating zero
+		buffer->capacity = (buffer->capacity > 0) ? buffer->capacity : 4096;
+		while(buffer->length + length + 1 > buffer->capacity) {
+			buffer->capacity *= 2;
+		}
+		buffer->data = realloc(buffer->data, buffer->capacity);
+		if(buffer->data == NULL) {
+			printf("\nERROR: Unable to re-allocate memory for the shingle text!\n");
+			exit(1);
+		}
+	}
+	memcpy(buffer->data + buffer->length, text, length);
+	buffer->length += length;
+}
+
+void writeTextFile(const char* fileName, const char* text, size_t textLength) {
 	FILE* outputFile = NULL;
-	int i;
 	
 	outputFile = fopen(fileName, "wb"); //Open the file for [w]riting in [b]inary mode (creating it if it doesn't yet exist)
 	if(outputFile == NULL) { //If for some reason opening the file fails, exit immediately with a failure
@@ -332,12 +946,7 @@ void writeTextFile(const char* fileName, char* text) {
 		printDebug("File opened successfully.\n");
 	}
 	
-	for(i = 0; text[i] != '\0'; i++) {
-		fputc(text[i], outputFile);
-	}
-	
-
-	if (ftell(outputFile) != strlen(text)) { //If not all of the text was written to the file, an error has occurred
+	if(fwrite(text, sizeof(char), textLength, outputFile) != textLength) { //If not all of the text was written to the file, an error has occurred
 		printf("\nERROR: Not all characters were written to file!");
 		fclose(outputFile);
 		exit(1);
@@ -346,4 +955,347 @@ void writeTextFile(const char* fileName, char* text) {
 	}
 	
 	fclose(outputFile);
-}
\ No newline at end of file
+}
+
+/**
+ * Converts a comma-delimited shingle file (as written by this program without -b) into a binary shingle file.
+ * The shingle size is not stored in the text format, so it is inferred from the number of words in the first shingle.
+ */
+void convertCsvFile(const char* inputFileName, const char* outputFileName, uint32_t hashAlgorithm, ShingleDictionary* dictionary) {
+	size_t textLength = 0;
+	char* rawText = readTextFile(inputFileName, &textLength);
+	
+	if(dictionary != NULL) {
+		writeIdFile(dictionary, rawText, textLength, outputFileName, csvShingleSize(inputFileName));
+		free(rawText);
+		return;
+	}
+	
+	Arena* arena = createArena(0);
+	ShingleSet* shingles = (arena != NULL) ? parseShingleCsv(arena, rawText, textLength, hashAlgorithm) : NULL;
+	
+	if(shingles == NULL) {
+		printf("\nERROR: Unable to allocate memory for the shingle hashes!\n");
+		exit(1);
+	}
+	writeShingleFile(outputFileName, shingles->hashes, shingles->count, shingles->shingleSize, shingles->shingleUnit, hashAlgorithm);
+	deleteArena(arena);
+	free(rawText);
+}
+
+void writeIdFile(ShingleDictionary* dictionary, const char* text, size_t textLength, const char* outputFileName, uint32_t shingleSize) { /** Interns the comma-delimited shingles in text, and writes their ids to a binary shingle file **/
+	DictionaryStamp stamp;
+	uint64_t idCount = 0;
+	double startTime = statsClock();
+	uint32_t* ids = internShingleList(dictionary, text, textLength, &idCount);
+	
+	addStageTime("intern", startTime, idCount, (uint64_t)textLength);
+	addCounter("distinctIds", idCount);
+	startTime = statsClock();
+	stamp.dictionaryIdentity = dictionary->identity;
+	stamp.dictionaryCount = saveShingleDictionary(dictionary); //Before the file, so it never holds an id that a failed run did not save
+	addStageTime("dictionary", startTime, 1, 0);
+	startTime = statsClock();
+	writeShingleIdFile(outputFileName, ids, idCount, shingleSize, &stamp);
+	addStageTime("write", startTime, 1, idCount * sizeof(uint32_t));
+	free(ids);
+}
+
+/**
+ * Shingles the input file without ever holding more than a chunk of it in memory. Words are split on the same
+ * delimiters as shingleText(), a word cut off at the end of a chunk is carried over into the next one, and each
+ * shingle is written out as soon as its last word is read. Comma-delimited output keeps duplicate shingles, since
+ * removing them would mean remembering every shingle; binary output is de-duplicated through sorted runs on disk.
+ */
+void streamShingles(const ShingleOptions* options) {
+	ShingleStream stream;
+	DelimiterSet delimiters;
+	Tokenizer tokenizer;
+	char* chunk = malloc(streamChunkSize);
+	char* word = NULL; //The word currently being read, which may span several chunks
+	size_t wordCapacity = 0;
+	size_t wordLength = 0;
+	size_t bytesRead = 0;
+	uint64_t totalBytes = 0;
+	int reachedNul = false; //Everything after a zero byte is ignored
+	FILE* inputFile = NULL;
+	int i;
+	
+	memset(&stream, 0, sizeof(stream));
+	stream.shingleSize = options->shingleSize;
+	stream.hashAlgorithm = options->hashAlgorithm;
+	stream.window = calloc(options->shingleSize, sizeof(char*));
+	stream.windowCapacities = calloc(options->shingleSize, sizeof(size_t));
+	if(chunk == NULL || stream.window == NULL || stream.windowCapacities == NULL) {
+		printf("\nERROR: Unable to allocate memory for the shingle stream!\n");
+		exit(1);
+	}
+	initDelimiterSet(&delimiters, SHINGLE_DELIMITERS);
+	
+	inputFile = fopen(options->inputFileName, "rb");
+	if(inputFile == NULL) {
+		printf("\nERROR: File \"%s\" not found!\n", options->inputFileName);
+		exit(1);
+	}
+	if(options->binaryOutput == true) {
+		stream.runs = calloc(1, sizeof(HashRuns));
+		stream.runs->buffer = malloc(hashRunCapacity * sizeof(uint64_t));
+		if(stream.runs->buffer == NULL) {
+			printf("\nERROR: Unable to allocate memory for the shingle hashes!\n");
+			exit(1);
+		}
+	} else {
+		stream.outputFile = fopen(options->outputFileName, "wb");
+		if(stream.outputFile == NULL) {
+			printf("\nERROR: File \"%s\" not found!\n", options->outputFileName);
+			exit(1);
+		}
+		setvbuf(stream.outputFile, NULL, _IOFBF, streamChunkSize);
+	}
+	
+	while(reachedNul == false && (bytesRead = fread(chunk, 1, streamChunkSize, inputFile)) > 0) {
+		size_t start = 0, length = 0;
+		totalBytes += bytesRead;
+		if(textLengthToNul(chunk, bytesRead) < bytesRead) { //A zero byte ends the text, as in readTextFile()
+			bytesRead = textLengthToNul(chunk, bytesRead);
+			reachedNul = true;
+		}
+		if(wordLength > 0 && delimiters.isDelimiter[(unsigned char)chunk[0]] == true) { //A delimiter ends the word carried over from the previous chunk
+			pushStreamWord(&stream, word, wordLength);
+			wordLength = 0;
+		}
+		beginTokens(&tokenizer, &delimiters, chunk, bytesRead);
+		while(nextToken(&tokenizer, &start, &length) == true) {
+			if(wordLength == 0 && start + length < bytesRead) { //The whole word is in this chunk, so it is used where it lies
+				pushStreamWord(&stream, chunk + start, length);
+				continue;
+			}
+			reserveBuffer(&word, &wordCapacity, wordLength + length + 1); //Append this piece of the word to whatever was carried over from the previous chunk
+			memcpy(word + wordLength, chunk + start, length);
+			wordLength += length;
+			if(start + length < bytesRead) { //A delimiter ends the word, rather than the end of the chunk
+				pushStreamWord(&stream, word, wordLength);
+				wordLength = 0;
+			}
+		}
+	}
+	if(wordLength > 0) { //The final word is ended by the end of the file
+		pushStreamWord(&stream, word, wordLength);
+	}
+	fclose(inputFile);
+	
+	if(stream.runs != NULL) {
+		FILE* outputFile = beginShingleFile(options->outputFileName, options->shingleSize, SHINGLE_WORDS, options->hashAlgorithm);
+		uint64_t hashCount = mergeHashRuns(stream.runs, outputFile);
+		finishShingleFile(outputFile, options->outputFileName, hashCount);
+		printDebug("Wrote %d distinct shingle hashes from %d sorted runs.\n", (int)hashCount, stream.runs->spilledCount);
+		free(stream.runs->buffer);
+		free(stream.runs->runFiles);
+		free(stream.runs->runLevels);
+		free(stream.runs);
+	} else {
+		if(fclose(stream.outputFile) != 0) {
+			printf("\nERROR: Not all characters were written to file!");
+			exit(1);
+		}
+	}
+	printDebug("Read %d KB and formed %d shingles.\n", (int)(totalBytes / 1024), (int)stream.shingleCount);
+	
+	for(i = 0; i < options->shingleSize; i++) {
+		free(stream.window[i]);
+	}
+	free(stream.window);
+	free(stream.windowCapacities);
+	free(stream.shingle);
+	free(word);
+	free(chunk);
+}
+
+void pushStreamWord(ShingleStream* stream, const char* word, size_t length) { /** Sub-function of streamShingles, slides the window forward by one word and emits the shingle it completes **/
+	int slot = (stream->windowStart + stream->windowCount) % stream->shingleSize;
+	size_t shingleLength = 0;
+	int j;
+	
+	if(stream->windowCount == stream->shingleSize) { //The window is full, so the oldest word drops out
+		slot = stream->windowStart;
+		stream->windowStart = (stream->windowStart + 1) % stream->shingleSize;
+	} else {
+		stream->windowCount++;
+	}
+	reserveBuffer(&stream->window[slot], &stream->windowCapacities[slot], length + 1);
+	memcpy(stream->window[slot], word, length);
+	stream->window[slot][length] = '\0';
+	
+	if(stream->windowCount < stream->shingleSize) {
+		return;
+	}
+	
+	for(j = 0; j < stream->shingleSize; j++) { //Join the words in the window with spaces, exactly as shingleText() does
+		const char* windowWord = stream->window[(stream->windowStart + j) % stream->shingleSize];
+		size_t windowWordLength = strlen(windowWord);
+		reserveBuffer(&stream->shingle, &stream->shingleCapacity, shingleLength + windowWordLength + 2);
+		memcpy(stream->shingle + shingleLength, windowWord, windowWordLength);
+		shingleLength += windowWordLength;
+		stream->shingle[shingleLength++] = ' ';
+	}
+	stream->shingle[shingleLength - 1] = '\0'; //Replace the final space with a terminating zero
+	
+	if(stream->runs != NULL) {
+		addToHashRuns(stream->runs, hashShingleBytes(stream->shingle, shingleLength - 1, stream->hashAlgorithm));
+	} else {
+		if(stream->shingleCount > 0) {
+			fputc(',', stream->outputFile);
+		}
+		fwrite(stream->shingle, 1, shingleLength - 1, stream->outputFile);
+	}
+	stream->shingleCount++;
+}
+
+void reserveBuffer(char** buffer, size_t* capacity, size_t needed) { /** Sub-function of streamShingles, grows a reusable char buffer to at least needed bytes **/
+	if(*capacity >= needed) {
+		return;
+	}
+	*capacity = (*capacity > 0) ? *capacity : 64;
+	while(*capacity < needed) {
+		*capacity *= 2;
+	}
+	*buffer = realloc(*buffer, *capacity);
+	if(*buffer == NULL) {
+		printf("\nERROR: Unable to re-allocate memory for a word buffer!\n");
+		exit(1);
+	}
+}
+
+void addToHashRuns(HashRuns* runs, uint64_t hash) {
+	if(runs->count == hashRunCapacity) {
+		spillHashRun(runs);
+	}
+	runs->buffer[runs->count++] = hash;
+}
+
+void spillHashRun(HashRuns* runs) { /** Sub-function of addToHashRuns, writes the buffered hashes to a new temporary file as one sorted run **/
+	uint64_t unique = sortUniqueHashes(runs->buffer, runs->count);
+	FILE* runFile = tmpfile();
+	
+	runs->runFiles = realloc(runs->runFiles, (runs->runCount + 1) * sizeof(FILE*));
+	runs->runLevels = realloc(runs->runLevels, (runs->runCount + 1) * sizeof(int));
+	if(runFile == NULL || runs->runFiles == NULL || runs->runLevels == NULL) {
+		printf("\nERROR: Unable to create a temporary file for sorting the shingle hashes!\n");
+		exit(1);
+	}
+	if(fwrite(runs->buffer, sizeof(uint64_t), unique, runFile) != unique) {
+		printf("\nERROR: Not all of the shingle hashes were written to a temporary file!\n");
+		exit(1);
+	}
+	rewind(runFile);
+	runs->runFiles[runs->runCount] = runFile;
+	runs->runLevels[runs->runCount++] = 0;
+	runs->spilledCount++;
+	runs->count = 0;
+	
+	//Levels never increase along the runs, so the last maxMergeFanIn are all of one level if the first and last are:
+	while(runs->runCount >= maxMergeFanIn && runs->runLevels[runs->runCount - maxMergeFanIn] == runs->runLevels[runs->runCount - 1]) {
+		collapseHashRuns(runs, maxMergeFanIn);
+	}
+}
+
+/**
+ * Only called while the buffer is empty, since the merge borrows it. The new run takes the place of the first of the
+ * runs it replaces, one level above the highest of them.
+ */
+void collapseHashRuns(HashRuns* runs, int count) { /** Merges the last count runs into one new run **/
+	int first = runs->runCount - count;
+	FILE* mergedFile = tmpfile();
+	
+	if(mergedFile == NULL) {
+		printf("\nERROR: Unable to create a temporary file for sorting the shingle hashes!\n");
+		exit(1);
+	}
+	mergeRunFiles(runs->runFiles + first, count, runs->buffer, mergedFile);
+	rewind(mergedFile);
+	runs->runFiles[first] = mergedFile;
+	runs->runLevels[first]++;
+	runs->runCount = first + 1;
+}
+
+/**
+ * Writes the sorted union of every run to outputFile, and returns how many hashes that was. When nothing was spilled,
+ * the buffer is simply sorted and written; otherwise the last partial run is spilled too, the runs are merged down
+ * to at most maxMergeFanIn, and those are merged into outputFile.
+ */
+uint64_t mergeHashRuns(HashRuns* runs, FILE* outputFile) { /** Sub-function of streamShingles, writes the union of every run in order, returning its size **/
+	uint64_t written = 0;
+	
+	if(runs->runCount == 0) {
+		written = sortUniqueHashes(runs->buffer, runs->count);
+		if(fwrite(runs->buffer, sizeof(uint64_t), written, outputFile) != written) {
+			printf("\nERROR: Not all of the shingle hashes were written to file!\n");
+			exit(1);
+		}
+		return written;
+	}
+	
+	if(runs->count > 0) {
+		spillHashRun(runs);
+	}
+	while(runs->runCount > maxMergeFanIn) { //Runs of several levels can be left over
+		collapseHashRuns(runs, maxMergeFanIn);
+	}
+	written = mergeRunFiles(runs->runFiles, runs->runCount, runs->buffer, outputFile);
+	runs->runCount = 0;
+	return written;
+}
+
+/**
+ * The buffer, which must hold hashRunCapacity hashes, is shared out as a window onto each run, so the fewer runs
+ * there are, the more of each is read at a time.
+ */
+uint64_t mergeRunFiles(FILE** runFiles, int runCount, uint64_t* buffer, FILE* outputFile) { /** Sub-function of mergeHashRuns and collapseHashRuns, writes the union of the runs in order and closes them, returning its size **/
+	size_t windowSize = hashRunCapacity / (size_t)runCount;
+	uint64_t written = 0;
+	uint64_t last = 0;
+	int r;
+	
+	uint64_t** heads = malloc(runCount * sizeof(uint64_t*));
+	size_t* positions = calloc(runCount, sizeof(size_t));
+	size_t* fills = calloc(runCount, sizeof(size_t));
+	if(heads == NULL || positions == NULL || fills == NULL) {
+		printf("\nERROR: Unable to allocate memory for merging the shingle hashes!\n");
+		exit(1);
+	}
+	for(r = 0; r < runCount; r++) {
+		heads[r] = buffer + (size_t)r * windowSize;
+		fills[r] = fread(heads[r], sizeof(uint64_t), windowSize, runFiles[r]);
+	}
+	
+	while(true) {
+		int smallest = -1;
+		for(r = 0; r < runCount; r++) { //Find the run whose next hash is smallest
+			if(positions[r] < fills[r] && (smallest < 0 || heads[r][positions[r]] < heads[smallest][positions[smallest]])) {
+				smallest = r;
+			}
+		}
+		if(smallest < 0) {
+			break; //Every run is exhausted
+		}
+		
+		uint64_t next = heads[smallest][positions[smallest]++];
+		if(written == 0 || next != last) { //The same hash can appear in several runs, but is only written once
+			fwrite(&next, sizeof(uint64_t), 1, outputFile);
+			last = next;
+			written++;
+		}
+		if(positions[smallest] == fills[smallest]) {
+			fills[smallest] = fread(heads[smallest], sizeof(uint64_t), windowSize, runFiles[smallest]);
+			positions[smallest] = 0;
+		}
+	}
+	
+	for(r = 0; r < runCount; r++) {
+		fclose(runFiles[r]); //Temporary files are deleted once closed
+	}
+	free(heads);
+	free(positions);
+	free(fills);
+	return written;
+}
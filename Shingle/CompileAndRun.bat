@@ -1,3 +1,12 @@
+if not exist "Object Files" mkdir "Object Files"
 gcc -std=c99 -c "C Files\shingle.c" -o "Object Files\shingle.o"
+gcc -std=c99 -c "..\Common\C Files\ShingleFile.c" -o "Object Files\ShingleFile.o"
+gcc -std=c99 -c "..\Common\C Files\Platform.c" -o "Object Files\Platform.o"
+gcc -std=c99 -c "..\Common\C Files\Stats.c" -o "Object Files\Stats.o"
+gcc -std=c99 -c "..\Common\C Files\SetIntersection.c" -o "Object Files\SetIntersection.o"
+gcc -std=c99 -c "..\Common\C Files\Arena.c" -o "Object Files\Arena.o"
+gcc -std=c99 -c "..\Common\C Files\Similarity.c" -o "Object Files\Similarity.o"
+gcc -std=c99 -c "..\Common\C Files\Tokenizer.c" -o "Object Files\Tokenizer.o"
+gcc -std=c99 -c "..\Common\C Files\ShingleDictionary.c" -o "Object Files\ShingleDictionary.o"
 
-gcc -std=c99 "Object Files\shingle.o" "..\List-Library\Object Files\List.o" -o shingle
\ No newline at end of file
+gcc -std=c99 "Object Files\shingle.o" "Object Files\ShingleFile.o" "Object Files\Platform.o" "Object Files\Stats.o" "Object Files\SetIntersection.o" "Object Files\Arena.o" "Object Files\Similarity.o" "Object Files\Tokenizer.o" "Object Files\ShingleDictionary.o" -o shingle -lpthread
\ No newline at end of file